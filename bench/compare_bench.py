@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+"""Compare two json files written by gplibbench.
+
+Usage: compare_bench.py baseline.json current.json [--threshold 0.1]
+
+For each benchmark that exists in both files the ratio of the median times
+current/baseline is printed. The exit status is 1 if any benchmark is slower
+than the baseline by more than the threshold, so the script can be used to
+fail a CI job on performance regressions.
+"""
+import argparse
+import json
+import sys
+
+
+def load(filename):
+    with open(filename) as infile:
+        data = json.load(infile)
+    return dict((bench["name"], bench) for bench in data["benchmarks"])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.1,
+                        help="maximum relative slowdown before we report a regression")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+    regressions = 0
+    print("%-60s %12s %12s %8s" % ("benchmark", "base [us]", "curr [us]", "ratio"))
+    for name in sorted(set(baseline) & set(current)):
+        base = baseline[name]["median_ns"]
+        curr = current[name]["median_ns"]
+        ratio = curr / base if base > 0 else float("inf")
+        flag = ""
+        if ratio > 1.0 + args.threshold:
+            flag = " SLOWER"
+            regressions += 1
+        elif ratio < 1.0 - args.threshold:
+            flag = " faster"
+        print("%-60s %12.3f %12.3f %8.3f%s" % (name, base / 1e3, curr / 1e3, ratio, flag))
+    for name in sorted(set(baseline) - set(current)):
+        print("%-60s only in baseline" % name)
+    for name in sorted(set(current) - set(baseline)):
+        print("%-60s only in current" % name)
+    if regressions:
+        print("%d benchmark(s) slower than the baseline by more than %g%%"
+              % (regressions, 100 * args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
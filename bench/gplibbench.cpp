@@ -0,0 +1,565 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iomanip>
+#include <cmath>
+#include <ctime>
+#include <boost/program_options.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <chrono>
+#include <boost/asio/ip/host_name.hpp>
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/ostreamwrapper.h"
+#include "C1DMTSynthData.h"
+#include "C1DAnisoMTSynthData.h"
+#include "RecCalc.h"
+#include "SeismicDataComp.h"
+#include "TsSpectrum.h"
+#include "ParetoGA.h"
+#include "BinaryPopulation.h"
+#include "BinaryTranscribe.h"
+#include "TestObjective.h"
+#include "UniformRNG.h"
+#include "UniquePop.h"
+#include "FatalException.h"
+
+/*!
+ * \addtogroup UtilProgs Utility Programs
+ *@{
+ * \file gplibbench.cpp
+ * Micro-benchmarks for the forward calculations and the genetic algorithm internals.
+ * Each benchmark is run for a number of parameter combinations, e.g. number of layers
+ * and frequencies, and the timing results are written as json for comparison with
+ * a stored baseline by compare_bench.py.
+ */
+
+using namespace std;
+using namespace gplib;
+namespace po = boost::program_options;
+
+typedef std::chrono::steady_clock tclock;
+
+//! Write to this variable so the compiler cannot remove the benchmarked calculation
+volatile double BenchSink = 0.0;
+
+//! The parameters of a single benchmark case, e.g. layers=10, freqs=50
+typedef std::vector<std::pair<std::string, int> > tbenchparams;
+
+//! A benchmark case provides a setup that returns the function that is timed
+/*! The setup is not timed, the returned function performs one iteration of the
+ * calculation and returns the number of items that were processed, e.g. frequencies or samples.
+ */
+struct BenchCase
+  {
+  std::string family;
+  tbenchparams params;
+  boost::function<boost::function<size_t()>()> Setup;
+  std::string GetName() const
+    {
+      std::string name = family;
+      for (size_t i = 0; i < params.size(); ++i)
+        name += "/" + params.at(i).first + ":" + std::to_string(
+            params.at(i).second);
+      return name;
+    }
+  };
+
+//! The timing result of a benchmark case
+struct BenchResult
+  {
+  std::string name;
+  std::string family;
+  tbenchparams params;
+  size_t iterations;
+  std::vector<double> pertime;
+  size_t items;
+  };
+
+//! Run the case repeatedly, the number of iterations per repetition is chosen so that a repetition takes at least mintime seconds
+BenchResult RunCase(const BenchCase &Case, const double mintime,
+    const int repetitions)
+  {
+    boost::function<size_t()> Run = Case.Setup();
+    BenchResult Result;
+    Result.name = Case.GetName();
+    Result.family = Case.family;
+    Result.params = Case.params;
+    //warm up caches and fftw plans and count the items of a single iteration
+    Result.items = Run();
+    size_t iterations = 1;
+    double elapsed = 0.0;
+    while (true)
+      {
+        tclock::time_point start = tclock::now();
+        for (size_t i = 0; i < iterations; ++i)
+          Run();
+        elapsed = std::chrono::duration<double>(tclock::now() - start).count();
+        if (elapsed >= mintime || iterations > 1000000000)
+          break;
+        //aim for 20% more than the minimum time, but do not grow too fast on very short first runs
+        const double factor = elapsed > 0.0 ? 1.2 * mintime / elapsed : 100.0;
+        iterations = std::max(iterations + 1, static_cast<size_t> (iterations
+            * std::min(factor, 100.0)));
+      }
+    Result.iterations = iterations;
+    Result.pertime.push_back(elapsed / iterations);
+    for (int r = 1; r < repetitions; ++r)
+      {
+        tclock::time_point start = tclock::now();
+        for (size_t i = 0; i < iterations; ++i)
+          Run();
+        Result.pertime.push_back(std::chrono::duration<double>(tclock::now()
+            - start).count() / iterations);
+      }
+    return Result;
+  }
+
+double Median(std::vector<double> values)
+  {
+    std::sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return (n % 2 == 1) ? values.at(n / 2) : 0.5 * (values.at(n / 2 - 1)
+        + values.at(n / 2));
+  }
+
+//! Create logarithmically spaced frequencies between 1000 Hz and 1e-4 Hz
+trealdata MakeFrequencies(const int nfreq)
+  {
+    trealdata Frequencies(nfreq);
+    for (int i = 0; i < nfreq; ++i)
+      Frequencies.at(i) = std::pow(10.0, 3.0 - 7.0 * i / std::max(nfreq - 1, 1));
+    return Frequencies;
+  }
+
+//! A smooth layered model with resistivities between 1 and 1000 Ohmm
+void MakeLayers(const int nlayers, trealdata &Resistivities,
+    trealdata &Thicknesses)
+  {
+    Resistivities.resize(nlayers);
+    Thicknesses.resize(nlayers);
+    for (int i = 0; i < nlayers; ++i)
+      {
+        Resistivities.at(i) = std::pow(10.0, 1.5 + 1.5 * std::sin(0.7 * i));
+        Thicknesses.at(i) = 0.5 + 0.1 * i;
+      }
+  }
+
+size_t IsoMTRun(boost::shared_ptr<C1DMTSynthData> Synth)
+  {
+    Synth->CalcSynthetic();
+    BenchSink = BenchSink + Synth->GetMTData().front().GetZxy().real();
+    return Synth->GetMTData().size();
+  }
+
+boost::function<size_t()> IsoMTSetup(const int nlayers, const int nfreq)
+  {
+    boost::shared_ptr<C1DMTSynthData> Synth(new C1DMTSynthData());
+    trealdata Resistivities, Thicknesses;
+    MakeLayers(nlayers, Resistivities, Thicknesses);
+    Synth->SetResistivities(Resistivities);
+    Synth->SetThicknesses(Thicknesses);
+    Synth->SetFrequencies(MakeFrequencies(nfreq));
+    return boost::bind(IsoMTRun, Synth);
+  }
+
+size_t AnisoMTRun(boost::shared_ptr<C1DAnisoMTSynthData> Synth)
+  {
+    Synth->GetData();
+    BenchSink = BenchSink + Synth->GetMTData().front().GetZxy().real();
+    return Synth->GetMTData().size();
+  }
+
+boost::function<size_t()> AnisoMTSetup(const int nlayers, const int nfreq)
+  {
+    boost::shared_ptr<C1DAnisoMTSynthData> Synth(new C1DAnisoMTSynthData());
+    trealdata Resistivities, Thicknesses;
+    MakeLayers(nlayers, Resistivities, Thicknesses);
+    trealdata Rho2(Resistivities), Rho3(Resistivities), Strikes(nlayers),
+        Slants(nlayers), Dips(nlayers);
+    for (int i = 0; i < nlayers; ++i)
+      {
+        Rho2.at(i) *= 2.0 + std::cos(0.3 * i);
+        Rho3.at(i) *= 1.5;
+        Strikes.at(i) = 10.0 * (i % 9);
+        Slants.at(i) = 5.0 * (i % 3);
+        Dips.at(i) = 2.0 * (i % 5);
+      }
+    Synth->SetRho1(Resistivities);
+    Synth->SetRho2(Rho2);
+    Synth->SetRho3(Rho3);
+    Synth->SetStrikes(Strikes);
+    Synth->SetSlants(Slants);
+    Synth->SetDips(Dips);
+    Synth->SetThicknesses(Thicknesses);
+    Synth->SetFrequencies(MakeFrequencies(nfreq));
+    return boost::bind(AnisoMTRun, Synth);
+  }
+
+//! A sum of gaussian pulses with the given delays and amplitudes
+void MakePulses(SeismicDataComp &Comp, const int npts, const double dt,
+    const std::vector<double> &delays, const std::vector<double> &amps)
+  {
+    Comp.GetData().assign(npts, 0.0);
+    Comp.SetDt(dt);
+    for (int i = 0; i < npts; ++i)
+      for (size_t j = 0; j < delays.size(); ++j)
+        Comp.GetData().at(i) += amps.at(j) * std::exp(-std::pow((i * dt
+            - delays.at(j)) / 0.5, 2));
+  }
+
+struct RecData
+  {
+  boost::shared_ptr<RecCalc> Calculator;
+  SeismicDataComp RadComp;
+  SeismicDataComp VerComp;
+  SeismicDataComp Receiver;
+  };
+
+size_t RecRun(boost::shared_ptr<RecData> Data)
+  {
+    Data->Calculator->CalcRecData(Data->RadComp, Data->VerComp, Data->Receiver);
+    BenchSink = BenchSink + Data->Receiver.GetData().front();
+    return Data->RadComp.GetData().size();
+  }
+
+boost::function<size_t()> RecSetup(const int npts, const int method)
+  {
+    boost::shared_ptr<RecData> Data(new RecData);
+    const double dt = 0.05;
+    std::vector<double> VerDelays(1, 5.0), VerAmps(1, 1.0);
+    std::vector<double> RadDelays, RadAmps;
+    RadDelays.push_back(5.0);
+    RadAmps.push_back(0.6);
+    RadDelays.push_back(9.0);
+    RadAmps.push_back(0.3);
+    RadDelays.push_back(17.0);
+    RadAmps.push_back(-0.2);
+    MakePulses(Data->VerComp, npts, dt, VerDelays, VerAmps);
+    MakePulses(Data->RadComp, npts, dt, RadDelays, RadAmps);
+    Data->Receiver = Data->RadComp;
+    Data->Calculator.reset(new RecCalc(100, 2.5, 0.001, true,
+        method == 0 ? RecCalc::specdiv : RecCalc::iterdecon));
+    return boost::bind(RecRun, Data);
+  }
+
+struct SpectrumData
+  {
+  boost::shared_ptr<TsSpectrum> Spectrum;
+  ttsdata TimeSeries;
+  tcompdata Frequencies;
+  };
+
+size_t SpectrumRun(boost::shared_ptr<SpectrumData> Data)
+  {
+    Data->Spectrum->CalcSpectrum(Data->TimeSeries.begin(),
+        Data->TimeSeries.end(), Data->Frequencies.begin(),
+        Data->Frequencies.end());
+    BenchSink = BenchSink + Data->Frequencies.back().real();
+    return Data->TimeSeries.size();
+  }
+
+boost::function<size_t()> SpectrumSetup(const int npts, const int multicalc)
+  {
+    boost::shared_ptr<SpectrumData> Data(new SpectrumData);
+    Data->Spectrum.reset(new TsSpectrum(multicalc != 0));
+    Data->TimeSeries.resize(npts);
+    for (int i = 0; i < npts; ++i)
+      Data->TimeSeries.at(i) = std::sin(0.01 * i) + 0.1 * std::cos(1.3 * i);
+    Data->Frequencies.resize(npts / 2 + 1);
+    return boost::bind(SpectrumRun, Data);
+  }
+
+//! The GA objects that are needed to call ParetoGA::CalcProbabilities directly
+struct ParetoData
+  {
+  UniformRNG Random;
+  boost::shared_ptr<BinaryTranscribe> Transcribe;
+  boost::shared_ptr<BinaryPopulation> Population;
+  boost::shared_ptr<ParetoGA> GA;
+  gplib::rmat MisFit;
+  ParetoData() :
+    Random(42)
+    {
+    }
+  };
+
+size_t ParetoRun(boost::shared_ptr<ParetoData> Data)
+  {
+    Data->GA->CalcProbabilities(0, Data->MisFit, *Data->Population);
+    BenchSink = BenchSink + Data->GA->GetNBestmodels();
+    return Data->MisFit.size2();
+  }
+
+boost::function<size_t()> ParetoSetup(const int popsize, const int nobjective)
+  {
+    boost::shared_ptr<ParetoData> Data(new ParetoData);
+    const int nparams = 4;
+    const int bitsperparam = 8;
+    ttranscribed Base(nparams), Step(nparams);
+    tsizev Genes(nparams);
+    for (int i = 0; i < nparams; ++i)
+      {
+        Base(i) = 0.0;
+        Step(i) = 0.1;
+        Genes(i) = bitsperparam;
+      }
+    Data->Transcribe.reset(new BinaryTranscribe(Base, Step, Genes));
+    Data->Population.reset(new BinaryPopulation(popsize, nparams
+        * bitsperparam, Data->Random, true));
+    GeneralGA::tObjectiveVector Objectives;
+    for (int i = 0; i < nobjective; ++i)
+      Objectives.push_back(boost::shared_ptr<GeneralObjective>(
+          new TestObjective()));
+    Data->GA.reset(new ParetoGA(NULL, Data->Population.get(),
+        Data->Transcribe.get(), Objectives));
+    //random misfits give a realistic mix of ranks for a population early in the inversion
+    Data->MisFit.resize(nobjective, popsize);
+    for (int i = 0; i < nobjective; ++i)
+      for (int j = 0; j < popsize; ++j)
+        Data->MisFit(i, j) = Data->Random.GetNumber();
+    return boost::bind(ParetoRun, Data);
+  }
+
+struct UniquePopData
+  {
+  std::vector<ttranscribed> Members;
+  tfitvec Fitness;
+  };
+
+size_t UniquePopRun(boost::shared_ptr<UniquePopData> Data)
+  {
+    UniquePop Unique;
+    size_t inserted = 0;
+    for (size_t i = 0; i < Data->Members.size(); ++i)
+      inserted += Unique.Insert(Data->Fitness, Data->Members.at(i));
+    BenchSink = BenchSink + inserted;
+    return Data->Members.size();
+  }
+
+boost::function<size_t()> UniquePopSetup(const int nmembers, const int nparams)
+  {
+    boost::shared_ptr<UniquePopData> Data(new UniquePopData);
+    UniformRNG Random(42);
+    Data->Fitness.resize(2);
+    Data->Fitness(0) = 1.0;
+    Data->Fitness(1) = 2.0;
+    //about half the members are duplicates of earlier members, as in a converging GA run
+    for (int i = 0; i < nmembers; ++i)
+      {
+        if (i > 0 && Random.GetNumber() < 0.5)
+          {
+            Data->Members.push_back(Data->Members.at(Random.GetNumber(i)));
+          }
+        else
+          {
+            ttranscribed Member(nparams);
+            for (int j = 0; j < nparams; ++j)
+              Member(j) = 0.1 * Random.GetNumber(1000);
+            Data->Members.push_back(Member);
+          }
+      }
+    return boost::bind(UniquePopRun, Data);
+  }
+
+tbenchparams MakeParams(const std::string &name1, const int value1,
+    const std::string &name2, const int value2)
+  {
+    tbenchparams Params;
+    Params.push_back(std::make_pair(name1, value1));
+    Params.push_back(std::make_pair(name2, value2));
+    return Params;
+  }
+
+void AddCase(std::vector<BenchCase> &Cases, const std::string &family,
+    const tbenchparams &Params,
+    boost::function<boost::function<size_t()>()> Setup)
+  {
+    BenchCase Case;
+    Case.family = family;
+    Case.params = Params;
+    Case.Setup = Setup;
+    Cases.push_back(Case);
+  }
+
+std::vector<BenchCase> MakeCases()
+  {
+    std::vector<BenchCase> Cases;
+    const int layers[] =
+      { 5, 20, 50 };
+    const int freqs[] =
+      { 20, 100 };
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 2; ++j)
+        {
+          AddCase(Cases, "C1DMTSynthData::CalcSynthetic", MakeParams("layers",
+              layers[i], "freqs", freqs[j]), boost::bind(IsoMTSetup,
+              layers[i], freqs[j]));
+          AddCase(Cases, "C1DAnisoMTSynthData::CalcZ", MakeParams("layers",
+              layers[i], "freqs", freqs[j]), boost::bind(AnisoMTSetup,
+              layers[i], freqs[j]));
+        }
+    const int rfpoints[] =
+      { 512, 2048, 8192 };
+    for (int i = 0; i < 3; ++i)
+      for (int method = 0; method < 2; ++method)
+        AddCase(Cases, "RecCalc::CalcRecData", MakeParams("npts", rfpoints[i],
+            "iterdecon", method), boost::bind(RecSetup, rfpoints[i], method));
+    const int tspoints[] =
+      { 1024, 16384, 262144 };
+    for (int i = 0; i < 3; ++i)
+      for (int multicalc = 0; multicalc < 2; ++multicalc)
+        AddCase(Cases, "TsSpectrum::CalcSpectrum", MakeParams("npts",
+            tspoints[i], "multicalc", multicalc), boost::bind(SpectrumSetup,
+            tspoints[i], multicalc));
+    const int popsizes[] =
+      { 100, 500, 2000 };
+    for (int i = 0; i < 3; ++i)
+      for (int nobj = 2; nobj <= 3; ++nobj)
+        AddCase(Cases, "ParetoGA::CalcProbabilities", MakeParams("popsize",
+            popsizes[i], "objectives", nobj), boost::bind(ParetoSetup,
+            popsizes[i], nobj));
+    const int members[] =
+      { 1000, 10000, 100000 };
+    for (int i = 0; i < 3; ++i)
+      AddCase(Cases, "UniquePop::Insert", MakeParams("members", members[i],
+          "params", 20), boost::bind(UniquePopSetup, members[i], 20));
+    return Cases;
+  }
+
+void WriteJson(const std::vector<BenchResult> &Results, std::ostream &output)
+  {
+    rapidjson::OStreamWrapper Stream(output);
+    rapidjson::PrettyWriter<rapidjson::OStreamWrapper> Writer(Stream);
+    Writer.StartObject();
+    Writer.Key("context");
+    Writer.StartObject();
+    const std::time_t now = std::time(NULL);
+    char datestring[64];
+    std::strftime(datestring, sizeof(datestring), "%Y-%m-%dT%H:%M:%S",
+        std::localtime(&now));
+    Writer.Key("date");
+    Writer.String(datestring);
+    Writer.Key("host");
+    Writer.String(boost::asio::ip::host_name().c_str());
+#if defined(__VERSION__)
+    Writer.Key("compiler");
+    Writer.String(__VERSION__);
+#endif
+    Writer.EndObject();
+    Writer.Key("benchmarks");
+    Writer.StartArray();
+    for (size_t i = 0; i < Results.size(); ++i)
+      {
+        const BenchResult &Result = Results.at(i);
+        const double median = Median(Result.pertime);
+        Writer.StartObject();
+        Writer.Key("name");
+        Writer.String(Result.name.c_str());
+        Writer.Key("family");
+        Writer.String(Result.family.c_str());
+        Writer.Key("params");
+        Writer.StartObject();
+        for (size_t j = 0; j < Result.params.size(); ++j)
+          {
+            Writer.Key(Result.params.at(j).first.c_str());
+            Writer.Int(Result.params.at(j).second);
+          }
+        Writer.EndObject();
+        Writer.Key("iterations");
+        Writer.Uint64(Result.iterations);
+        Writer.Key("repetitions");
+        Writer.Uint64(Result.pertime.size());
+        Writer.Key("median_ns");
+        Writer.Double(median * 1e9);
+        Writer.Key("min_ns");
+        Writer.Double(*std::min_element(Result.pertime.begin(),
+            Result.pertime.end()) * 1e9);
+        Writer.Key("max_ns");
+        Writer.Double(*std::max_element(Result.pertime.begin(),
+            Result.pertime.end()) * 1e9);
+        Writer.Key("items_per_second");
+        Writer.Double(Result.items / median);
+        Writer.EndObject();
+      }
+    Writer.EndArray();
+    Writer.EndObject();
+    output << std::endl;
+  }
+
+int main(int argc, char *argv[])
+  {
+    std::string filter, jsonname;
+    double mintime;
+    int repetitions;
+    po::options_description desc("General options");
+    desc.add_options()("help", "produce help message")("filter", po::value<
+        std::string>(&filter)->default_value(""),
+        "only run benchmarks whose name contains this string")("json",
+        po::value<std::string>(&jsonname)->default_value(""),
+        "write the results to this json file")("mintime",
+        po::value<double>(&mintime)->default_value(0.2),
+        "minimum time in seconds for each repetition")("repetitions",
+        po::value<int>(&repetitions)->default_value(5),
+        "number of repetitions of each benchmark")("list",
+        "only print the names of the benchmarks");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+      {
+        std::cout << desc << "\n";
+        return 1;
+      }
+    try
+      {
+        const std::vector<BenchCase> Cases(MakeCases());
+        std::vector<BenchResult> Results;
+        for (size_t i = 0; i < Cases.size(); ++i)
+          {
+            const std::string name = Cases.at(i).GetName();
+            if (name.find(filter) == std::string::npos)
+              continue;
+            if (vm.count("list"))
+              {
+                std::cout << name << std::endl;
+                continue;
+              }
+            //some of the library code prints diagnostic messages, we do not want them in the timing
+            std::ostringstream Silent;
+            std::streambuf *CoutBuffer = std::cout.rdbuf(Silent.rdbuf());
+            BenchResult Result;
+            try
+              {
+                Result = RunCase(Cases.at(i), mintime, std::max(repetitions, 1));
+              } catch (...)
+              {
+                std::cout.rdbuf(CoutBuffer);
+                throw;
+              }
+            std::cout.rdbuf(CoutBuffer);
+            Results.push_back(Result);
+            std::cout << std::left << std::setw(60) << name << std::right
+                << std::setw(14) << std::setprecision(4) << Median(
+                Result.pertime) * 1e6 << " us " << std::setw(12)
+                << Result.iterations << " it" << std::endl;
+          }
+        if (!jsonname.empty())
+          {
+            std::ofstream jsonfile(jsonname.c_str());
+            WriteJson(Results, jsonfile);
+          }
+      } catch (FatalException &e)
+      {
+        std::cerr << e.what() << std::endl;
+        return -1;
+      }
+  }
+/*@}*/
@@ -2,6 +2,7 @@
 #define CSTANDARDTRANSCRIBE_H
 #include "GeneralTranscribe.h"
 #include <cmath>
+#include <algorithm>
 #include "FatalException.h"
 #include <boost/numeric/conversion/cast.hpp>
 
@@ -24,6 +25,20 @@ namespace gplib
       const ttranscribed stepsizes;
       //! The number of bits for each parameter
       const tsizev genesizes;
+      //! The integer that encodes the value closest to value for parameter index
+      unsigned long GetLevel(const double value, const unsigned int index) const
+        {
+          const double maxlevel = std::pow(2.0, genesizes(index)) - 1.0;
+          double level = 0.0;
+          if (stepsizes(index) != 0.0)
+            level = floor((value - basevalues(index)) / stepsizes(index) + 0.5);
+          return static_cast<unsigned long> (std::max(0.0, std::min(level, maxlevel)));
+        }
+      //! Convert the integer that GetValues decodes from the genes to the bits we store, the canonic code stores the integer itself
+      virtual unsigned long EncodeInteger(const unsigned long level) const
+        {
+          return level;
+        }
     public:
       //! Implements the abstract function from GeneralTranscribe
       virtual ttranscribed GetValues(const tpopmember &member)
@@ -54,6 +69,37 @@ namespace gplib
         return ReturnValues;
       }
 
+      //! Encode the values with the canonic binary code, values outside the range are clipped
+      virtual tpopmember GetMember(const ttranscribed &values)
+      {
+        if (values.size() != genesizes.size())
+          throw FatalException("Number of values does not match number of parameters !");
+        tpopmember Member(ublas::sum(genesizes));
+        unsigned int currentindex = 0;
+        for (unsigned int i = 0; i < genesizes.size(); ++i)
+          {
+            const unsigned long code = EncodeInteger(GetLevel(values(i), i));
+            for (int j = 0; j < genesizes(i); ++j)
+              Member(currentindex + j) = (code >> j) & 1UL;
+            currentindex += genesizes(i);
+          }
+        return Member;
+      }
+      virtual ttranscribed GetMinValues()
+        {
+          return basevalues;
+        }
+      virtual ttranscribed GetMaxValues()
+        {
+          ttranscribed Result(basevalues);
+          for (unsigned int i = 0; i < genesizes.size(); ++i)
+            Result(i) += stepsizes(i) * (std::pow(2.0, genesizes(i)) - 1.0);
+          return Result;
+        }
+      virtual ttranscribed GetResolution()
+        {
+          return stepsizes;
+        }
       //! Without basevalues, stepsizes and genesizes BinaryTranscribe does not work, so we enforce their use by including them in the constructor
       BinaryTranscribe(const ttranscribed &base, const ttranscribed &step,
           const tsizev &gene) :
@@ -32,6 +32,10 @@ namespace gplib
       std::string gatype;
       int annealinggeneration;
       bool elitist;
+      int refineinterval;
+      int refinemembers;
+      int refineevaluations;
+      std::string historyfile;
       void GetData(std::ifstream &instream)
       {
         po::options_description desc("");
@@ -52,7 +56,15 @@ namespace gplib
             &gatype)->default_value("anneal"),
             "The type of genetic algorithm can be anneal or pareto")("elitist",
             po::value<bool>(&elitist)->default_value("true"),
-            "Do we always preserve the best model from generation to generation");
+            "Do we always preserve the best model from generation to generation")(
+            "refineinterval", po::value<int>(&refineinterval)->default_value(0),
+            "Refine the best models with a local search every refineinterval generations, 0 switches it off")(
+            "refinemembers", po::value<int>(&refinemembers)->default_value(1),
+            "The number of best models to refine")("refineevaluations",
+            po::value<int>(&refineevaluations)->default_value(100),
+            "The maximum number of misfit calculations for the refinement of each model")(
+            "historyfile", po::value<std::string>(&historyfile)->default_value(""),
+            "Write all evaluated models to this binary history file instead of the text output, empty switches it off");
 
         po::variables_map vm;
         po::store(po::parse_config_file(instream, desc, true), vm);
@@ -0,0 +1,254 @@
+#ifndef GAPROFILER_H_
+#define GAPROFILER_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+#include <typeinfo>
+#include <boost/shared_ptr.hpp>
+#include <boost/core/demangle.hpp>
+#include "FatalException.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! Collect timings and counters for each generation of a genetic algorithm
+    /*! An object of this class can be attached to a GeneralGA with SetProfiler. The GA then
+     * measures the time spent in each stage of an iteration and for each objective function
+     * and counts how many models were taken from the cache of previously evaluated models.
+     * At the end of each iteration a report is written as a line of json or csv. Times
+     * for the stages that are executed in parallel are summed over all threads, so they
+     * can be larger than the wall time of the generation. When no profiler is attached,
+     * GeneralGA does not take any time measurements.
+     */
+    class GAProfiler
+      {
+    public:
+      //! The stages of a GA iteration that we measure
+      enum tstage
+        {
+        transcribe, cachelookup, preparallel, safeparallel, postparallel,
+        cacheinsert, elitism, refinement, ranking, statistics, propagation,
+        nstages
+        };
+      //! The output format of the report
+      enum tformat
+        {
+        jsonlines, csv
+        };
+    private:
+      //! The counters for each thread, padded so that different threads do not write to the same cache line
+      struct ThreadCounters
+        {
+        double StageTimes[nstages];
+        std::vector<double> ObjectiveTimes;
+        std::vector<unsigned int> Evaluations;
+        unsigned int hits;
+        unsigned int misses;
+        char padding[64];
+        void Reset(const size_t nobjective)
+          {
+            std::fill(StageTimes, StageTimes + nstages, 0.0);
+            ObjectiveTimes.assign(nobjective, 0.0);
+            Evaluations.assign(nobjective, 0);
+            hits = 0;
+            misses = 0;
+          }
+        };
+      std::vector<ThreadCounters> Counters;
+      std::vector<std::string> ObjectiveNames;
+      boost::shared_ptr<std::ostream> OutFile;
+      std::ostream *Output;
+      tformat format;
+      int iteration;
+      double generationstart;
+      bool headerwritten;
+      ThreadCounters &Local()
+        {
+#ifdef _OPENMP
+          return Counters.at(omp_get_thread_num());
+#else
+          return Counters.front();
+#endif
+        }
+      static const char *StageName(const int stage)
+        {
+          static const char *names[nstages] =
+            { "transcribe", "cachelookup", "preparallel", "safeparallel",
+                "postparallel", "cacheinsert", "elitism", "refinement", "ranking",
+                "statistics", "propagation" };
+          return names[stage];
+        }
+      void WriteHeader()
+        {
+          *Output << "iteration,walltime,hits,misses,hitrate";
+          for (int i = 0; i < nstages; ++i)
+            *Output << "," << StageName(i);
+          for (size_t i = 0; i < ObjectiveNames.size(); ++i)
+            *Output << "," << ObjectiveNames.at(i) << "_time,"
+                << ObjectiveNames.at(i) << "_evaluations";
+          *Output << std::endl;
+          headerwritten = true;
+        }
+    public:
+      //! Return the current time in seconds, we use this for all measurements
+      static double Now()
+        {
+#ifdef _OPENMP
+          return omp_get_wtime();
+#else
+          return std::chrono::duration<double>(
+              std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+      //! Set the names of the objective functions for the report, the GA calls this with the type names
+      void SetObjectiveNames(const std::vector<std::string> &Names)
+        {
+          ObjectiveNames = Names;
+        }
+      //! Reset all counters at the beginning of an iteration
+      void StartGeneration(const int iterationnumber)
+        {
+          int nthreads = 1;
+#ifdef _OPENMP
+          nthreads = omp_get_max_threads();
+#endif
+          Counters.resize(nthreads);
+          for (size_t i = 0; i < Counters.size(); ++i)
+            Counters.at(i).Reset(ObjectiveNames.size());
+          iteration = iterationnumber;
+          generationstart = Now();
+        }
+      //! Add a time measurement for a stage of the calculation, this can be called from several threads
+      void AddTime(const tstage stage, const double seconds)
+        {
+          Local().StageTimes[stage] += seconds;
+        }
+      //! Add the time of one evaluation of objective function objective
+      void AddObjectiveTime(const size_t objective, const double seconds)
+        {
+          ThreadCounters &Curr = Local();
+          Curr.ObjectiveTimes.at(objective) += seconds;
+          Curr.Evaluations.at(objective) += 1;
+        }
+      //! Count a model that was found in or was missing from the cache of evaluated models
+      void CountLookup(const bool found)
+        {
+          if (found)
+            ++Local().hits;
+          else
+            ++Local().misses;
+        }
+      //! Sum the counters of all threads and write the report for the current iteration
+      void EndGeneration()
+        {
+          const double walltime = Now() - generationstart;
+          std::vector<double> StageTimes(nstages, 0.0);
+          std::vector<double> ObjectiveTimes(ObjectiveNames.size(), 0.0);
+          std::vector<unsigned int> Evaluations(ObjectiveNames.size(), 0);
+          unsigned int hits = 0, misses = 0;
+          for (size_t i = 0; i < Counters.size(); ++i)
+            {
+              const ThreadCounters &Curr = Counters.at(i);
+              for (int j = 0; j < nstages; ++j)
+                StageTimes.at(j) += Curr.StageTimes[j];
+              for (size_t j = 0; j < ObjectiveNames.size(); ++j)
+                {
+                  ObjectiveTimes.at(j) += Curr.ObjectiveTimes.at(j);
+                  Evaluations.at(j) += Curr.Evaluations.at(j);
+                }
+              hits += Curr.hits;
+              misses += Curr.misses;
+            }
+          const double hitrate = (hits + misses) > 0 ? double(hits) / double(
+              hits + misses) : 0.0;
+          *Output << std::setprecision(6);
+          if (format == csv)
+            {
+              if (!headerwritten)
+                WriteHeader();
+              *Output << iteration << "," << walltime << "," << hits << ","
+                  << misses << "," << hitrate;
+              for (int i = 0; i < nstages; ++i)
+                *Output << "," << StageTimes.at(i);
+              for (size_t i = 0; i < ObjectiveNames.size(); ++i)
+                *Output << "," << ObjectiveTimes.at(i) << ","
+                    << Evaluations.at(i);
+              *Output << std::endl;
+            }
+          else
+            {
+              *Output << "{\"iteration\":" << iteration << ",\"walltime\":"
+                  << walltime << ",\"hits\":" << hits << ",\"misses\":"
+                  << misses << ",\"hitrate\":" << hitrate << ",\"stages\":{";
+              for (int i = 0; i < nstages; ++i)
+                *Output << (i > 0 ? "," : "") << "\"" << StageName(i)
+                    << "\":" << StageTimes.at(i);
+              *Output << "},\"objectives\":[";
+              for (size_t i = 0; i < ObjectiveNames.size(); ++i)
+                *Output << (i > 0 ? "," : "") << "{\"name\":\""
+                    << ObjectiveNames.at(i) << "\",\"time\":"
+                    << ObjectiveTimes.at(i) << ",\"evaluations\":"
+                    << Evaluations.at(i) << "}";
+              *Output << "]}" << std::endl;
+            }
+        }
+      //! Write the reports to the file filename
+      GAProfiler(const std::string &filename, const tformat f = jsonlines) :
+        OutFile(new std::ofstream(filename.c_str())), Output(OutFile.get()),
+            format(f), iteration(0), generationstart(0.0), headerwritten(false)
+        {
+          if (!OutFile->good())
+            throw FatalException("Cannot open profiling output file: "
+                + filename);
+        }
+      //! Write the reports to an existing stream, the stream has to exist as long as the profiler
+      GAProfiler(std::ostream &output, const tformat f = jsonlines) :
+        Output(&output), format(f), iteration(0), generationstart(0.0),
+            headerwritten(false)
+        {
+        }
+      virtual ~GAProfiler()
+        {
+        }
+      };
+
+    //! Measure the time between construction and destruction and add it to a stage of the profiler, does nothing if the profiler is NULL
+    class ScopedStageTimer
+      {
+    private:
+      GAProfiler *Profiler;
+      GAProfiler::tstage stage;
+      double start;
+    public:
+      ScopedStageTimer(GAProfiler *P, const GAProfiler::tstage s) :
+        Profiler(P), stage(s), start(0.0)
+        {
+          if (Profiler)
+            start = GAProfiler::Now();
+        }
+      ~ScopedStageTimer()
+        {
+          if (Profiler)
+            Profiler->AddTime(stage, GAProfiler::Now() - start);
+        }
+      };
+
+    //! Return a readable name for the dynamic type of an object, we use this to name the objective functions in the report
+    template<typename T>
+    std::string TypeName(const T &object)
+      {
+        return boost::core::demangle(typeid(object).name());
+      }
+  /* @} */
+  }
+#endif /* GAPROFILER_H_ */
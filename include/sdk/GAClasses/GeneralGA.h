@@ -8,6 +8,9 @@
 #include "GeneralRNG.h"
 #include "GeneralSelect.h"
 #include "UniquePop.h"
+#include "GAProfiler.h"
+#include "PatternSearch.h"
+#include "InversionHistory.h"
 #include <vector>
 #include <fstream>
 #include "VecMat.h"
@@ -23,6 +26,7 @@
 #include <boost/bind.hpp>
 #include <algorithm>
 #include <cassert>
+#include <limits>
 #include <unistd.h>
 #ifdef _OPENMP
 #include <omp.h>
@@ -40,25 +44,6 @@ namespace gplib
      */
     class GeneralGA
       {
-        struct CopyFromPointer
-          {
-          boost::shared_ptr<GeneralObjective> operator()(boost::shared_ptr<
-              GeneralObjective> param)
-            {
-              return boost::shared_ptr<GeneralObjective>(param->clone());
-            }
-          };
-        struct GenObjective
-          {
-          GeneralGA::tObjectiveVector operator()(
-              const GeneralGA::tObjectiveVector &IndObjective)
-            {
-              GeneralGA::tObjectiveVector result(IndObjective.size()); //allocate space
-              transform(IndObjective.begin(), IndObjective.end(), result.begin(),
-                  CopyFromPointer());//copy each objective function into result
-              return result;
-            }
-          };
         std::string MakeParallelID(const int j, const int i,
             const int iterationnumber, const int Programnum)
           {
@@ -75,8 +60,241 @@ namespace gplib
           tObjectiveVector;
       typedef std::vector<std::vector<int> > tparamindv;
     private:
+      struct CopyFromPointer
+        {
+        boost::shared_ptr<GeneralObjective> operator()(boost::shared_ptr<
+            GeneralObjective> param)
+          {
+            return boost::shared_ptr<GeneralObjective>(param->clone());
+          }
+        };
+      struct GenObjective
+        {
+        GeneralGA::tObjectiveVector operator()(
+            const GeneralGA::tObjectiveVector &IndObjective)
+          {
+            GeneralGA::tObjectiveVector result(IndObjective.size()); //allocate space
+            transform(IndObjective.begin(), IndObjective.end(), result.begin(),
+                CopyFromPointer());//copy each objective function into result
+            return result;
+          }
+        };
+    protected:
+      //! Calculate the misfit of a single model or look it up in the history, returns true if we had to calculate it
+      /*! This can be called from several threads at the same time, member and iterationnumber only
+       * serve to create a unique identifier for the files the objective functions might write.
+       * The objective functions are calculated in the order of their cost estimate, if early rejection
+       * is switched on we might skip the expensive ones, @see SetEarlyRejection.
+       */
+      bool EvaluateModel(const ttranscribed &Model, const int member,
+          const int iterationnumber, tfitvec &fitvec)
+      {
+        GAProfiler * const Prof = Profiler.get();
+        fitvec.resize(nobjective, false);
+        bool AlreadyCalculated = false;
+          {
+            ScopedStageTimer Timer(Prof, GAProfiler::cachelookup);
+#pragma omp critical(uniquepop)
+              {
+                AlreadyCalculated = UniquePopHist.Find(Model, fitvec);
+              }
+          }
+        if (Prof)
+          Prof->CountLookup(AlreadyCalculated);
+        if (AlreadyCalculated)
+          return false;
+        tparamvector LocalParameters(nobjective);
+        for (unsigned int k = 0; k < nobjective; ++k)
+          {
+            LocalParameters.at(k).resize(ParameterIndices.at(k).size(), false);
+          }
+        SetupParams(Model, LocalParameters);
+        tObjectiveVector LocalObjective(GenObjective()(Objective));
+        fitvec.clear();
+        for (unsigned int k = 0; k < nobjective; ++k)
+          {
+            const unsigned int j = EvaluationOrder.at(k);
+            if (k > 0 && RejectEarly(fitvec, k))
+              {
+                //the model will not survive anyway, so we assign a bad misfit to the remaining objective functions
+                for (; k < nobjective; ++k)
+                  {
+                    const unsigned int skipped = EvaluationOrder.at(k);
+                    fitvec(skipped) = (Weights.at(skipped) != 0) ? PessimisticFit(
+                        skipped) : 0.0;
+                  }
+#pragma omp atomic
+                ++nrejected;
+                //the misfit is not real, so we do not store it in the history
+                return true;
+              }
+            LocalObjective.at(j)->SetParallelID(MakeParallelID(j, member,
+                iterationnumber, Programnum));
+            if (Weights.at(j) != 0)
+              {
+                const double objstart = Prof ? GAProfiler::Now() : 0.0;
+                  {
+                    ScopedStageTimer Timer(Prof, GAProfiler::preparallel);
+#pragma omp critical
+                      {
+                        LocalObjective.at(j)->PreParallel(LocalParameters.at(j));
+                      }
+                  }
+                  {
+                    ScopedStageTimer Timer(Prof, GAProfiler::safeparallel);
+                    LocalObjective.at(j)->SafeParallel(LocalParameters.at(j));
+                  }
+                  {
+                    ScopedStageTimer Timer(Prof, GAProfiler::postparallel);
+#pragma omp critical
+                      {
+                        fitvec(j) = Weights.at(j)
+                            * LocalObjective.at(j)->PostParallel(
+                                LocalParameters.at(j));
+                      }
+                  }
+                if (Prof)
+                  Prof->AddObjectiveTime(j, GAProfiler::Now() - objstart);
+              }
+            else
+              {
+                fitvec(j) = 0;
+              }
+          }
+          {
+            ScopedStageTimer Timer(Prof, GAProfiler::cacheinsert);
+#pragma omp critical(uniquepop)
+              {
+                const size_t index = UniquePopHist.GetSize();
+                if (UniquePopHist.Insert(fitvec, Model) && History)
+                  History->AddModel(index, iterationnumber, Model, fitvec);
+              }
+          }
+        return true;
+      }
+    private:
+      //! Decide whether we can stop the calculation of a model after the first nevaluated objective functions in EvaluationOrder
+      bool RejectEarly(const tfitvec &PartialFit, const unsigned int nevaluated)
+      {
+        if (PessimisticFit.size() != nobjective)
+          return false;
+        //there is no point in stopping if the remaining objective functions do not need any calculations
+        bool remaining = false;
+        for (unsigned int k = nevaluated; k < nobjective && !remaining; ++k)
+          remaining = Weights.at(EvaluationOrder.at(k)) != 0;
+        if (!remaining)
+          return false;
+        //the misfit of the remaining objective functions is positive, so the total misfit will be even larger
+        if (ublas::sum(PartialFit) > rejectionthreshold)
+          return true;
+        if (rejectiondominance == 0)
+          return false;
+        unsigned int ndominating = 0;
+        for (size_t i = 0; i < RejectionFront.size2(); ++i)
+          {
+            bool smaller = false;
+            bool larger = false;
+            for (unsigned int k = 0; k < nevaluated; ++k)
+              {
+                const unsigned int j = EvaluationOrder.at(k);
+                if (RejectionFront(j, i) > PartialFit(j))
+                  larger = true;
+                if (RejectionFront(j, i) < PartialFit(j))
+                  smaller = true;
+              }
+            if (smaller && !larger)
+              ++ndominating;
+          }
+        return ndominating >= rejectiondominance;
+      }
       //! Calculate the misfit for all models, this implements the core functionality for misfit calculations
-      void CalcMisfit(const int iterationnumber);
+      void CalcMisfit(const int iterationnumber)
+      {
+        GAProfiler * const Prof = Profiler.get();
+        int calculatecount = 0;
+        int newcount = 0;
+        // popsize cannot be unsigned because loop variables for openmp have to be signed
+        const int popsize = Population->GetPopsize();
+        nrejected = 0;
+
+#pragma omp parallel for default(shared) reduction(+:calculatecount,newcount)
+        for (int i = 0; i < popsize; ++i)
+          {
+            tfitvec fitvec(nobjective);
+              {
+                ScopedStageTimer Timer(Prof, GAProfiler::transcribe);
+                row(Transcribed, i) = Transcribe->GetValues(row(
+                    Population->GetPopulation(), i));
+              }
+            if (EvaluateModel(row(Transcribed, i), i, iterationnumber, fitvec))
+              newcount++;
+            else
+              calculatecount++;
+            column(MisFit, i) = fitvec;
+            CombMisFit.at(i) = ublas::sum(fitvec);
+          }
+        cout << "New models: " << newcount << " Re-used models: "
+            << calculatecount;
+        if (nrejected > 0)
+          cout << " Rejected early: " << nrejected;
+        cout << endl;
+      }
+      //! The misfit function for the local refinement, counts the models we had to calculate in newcount
+      tfitvec RefinementMisfit(const ttranscribed &Model, const int member,
+          const int iterationnumber, int &newcount)
+      {
+        tfitvec fitvec(nobjective);
+        if (EvaluateModel(Model, member, iterationnumber, fitvec))
+          ++newcount;
+        return fitvec;
+      }
+      //! Refine the best members of the current population with a local search and write them back into the population
+      void RefineMembers(const int iterationnumber)
+      {
+        const int popsize = Population->GetPopsize();
+        //we do not want to refine several copies of the same model
+        const std::vector<int> Candidates(GetRefinementCandidates());
+        std::vector<int> Selected;
+        for (size_t i = 0; i < Candidates.size() && Selected.size()
+            < nrefine; ++i)
+          {
+            bool duplicate = false;
+            for (size_t j = 0; j < Selected.size() && !duplicate; ++j)
+              duplicate = std::equal(row(Transcribed, Candidates.at(i)).begin(),
+                  row(Transcribed, Candidates.at(i)).end(), row(Transcribed,
+                      Selected.at(j)).begin());
+            if (!duplicate)
+              Selected.push_back(Candidates.at(i));
+          }
+        const int nselected = Selected.size();
+        int newcount = 0;
+        int improved = 0;
+#pragma omp parallel for default(shared) reduction(+:newcount,improved)
+        for (int i = 0; i < nselected; ++i)
+          {
+            const int index = Selected.at(i);
+            PatternSearch Search(*Refinement);
+            ttranscribed Model(row(Transcribed, index));
+            tfitvec Fitness(column(MisFit, index));
+            //the identifiers have to be different from the ones of the population members
+            Search.Minimize(Model, Fitness, boost::bind(
+                &GeneralGA::RefinementMisfit, this, _1, popsize + i,
+                iterationnumber, boost::ref(newcount)), boost::bind(
+                &GeneralGA::IsBetter, this, _1, _2));
+            if (!std::equal(Model.begin(), Model.end(),
+                row(Transcribed, index).begin()))
+              {
+                //each thread writes to a different member, so we do not need a critical section
+                Population->SetMember(index, Transcribe->GetMember(Model));
+                row(Transcribed, index) = Model;
+                column(MisFit, index) = Fitness;
+                CombMisFit.at(index) = ublas::sum(Fitness);
+                ++improved;
+              }
+          }
+        cout << "Refined models: " << nselected << " Improved: " << improved
+            << " New models: " << newcount << endl;
+      }
       //! The number of threads for parallel calculation, works only with OpenMP
       int Threads;
       //the process ID of the main program, used for file identification
@@ -102,6 +320,28 @@ namespace gplib
       UniquePop UniquePopHist;
       //! For each objective function we store the indices of the complete model vector that each objective function needs for its calculations
       tparamindv ParameterIndices;
+      //! Records timings and counters for each iteration if set, @see SetProfiler
+      boost::shared_ptr<GAProfiler> Profiler;
+      //! Writes all evaluated models and the population of each iteration to a binary file if set, @see SetHistory
+      boost::shared_ptr<InversionHistory> History;
+      //! The local optimizer for the hybrid mode, empty if we do not refine, @see SetLocalRefinement
+      boost::shared_ptr<PatternSearch> Refinement;
+      //! We refine the population every refineinterval iterations
+      int refineinterval;
+      //! The maximum number of members we refine in each refinement step
+      size_t nrefine;
+      //! The indices of the objective functions sorted by their cost estimate
+      std::vector<unsigned int> EvaluationOrder;
+      //! We stop the calculation of a model when the summed misfit exceeds this threshold
+      double rejectionthreshold;
+      //! We stop when at least this many of the best models dominate the partial misfit, 0 switches this off
+      unsigned int rejectiondominance;
+      //! The misfit of the best models of the last iteration, first index objective function second index model
+      tfitmat RejectionFront;
+      //! The misfit we assign to the objective functions we skip, empty if there is no reference iteration yet
+      tfitvec PessimisticFit;
+      //! The number of models we rejected early in the last misfit calculation
+      int nrejected;
     protected:
       gplib::rmat OldMisFit;
       //! The number of objective functions we're using
@@ -123,6 +363,72 @@ namespace gplib
         {
         }
       ;
+      //! The profiler or NULL if we do not record timings
+      GAProfiler *GetProfiler() const
+        {
+          return Profiler.get();
+        }
+      //! Write the indices of the current population members to the history, if there is one
+      void LogGeneration(const int iterationnumber)
+        {
+          if (!History)
+            return;
+          std::vector<boost::uint32_t> Indices(Transcribed.size1(),
+              HistoryNoModel);
+          size_t index = 0;
+          for (size_t i = 0; i < Transcribed.size1(); ++i)
+            if (UniquePopHist.FindIndex(row(Transcribed, i), index))
+              Indices.at(i) = index;
+          History->AddGeneration(iterationnumber, Indices);
+        }
+      //! Store the misfit of the current best models as a reference for the early rejection, this has to be called after CalcStatistics
+      void UpdateRejectionFront()
+      {
+        if (rejectionthreshold == std::numeric_limits<double>::infinity()
+            && rejectiondominance == 0)
+          return;
+        const std::vector<int> Indices(GetBestModelIndices());
+        RejectionFront.resize(nobjective, Indices.size(), false);
+        for (size_t i = 0; i < Indices.size(); ++i)
+          column(RejectionFront, i) = column(MisFit, Indices.at(i));
+        PessimisticFit.resize(nobjective, false);
+        std::copy(MaxFit.begin(), MaxFit.end(), PessimisticFit.begin());
+      }
+      //! Calculate the fitness statistics of the current population from MisFit
+      void CalcStatistics()
+      {
+        for (unsigned int i = 0; i < nobjective; ++i) // do some statistics on the misfit
+          {
+            ublas::matrix_row<gplib::rmat> mr(MisFit, i);
+            AvgFit.at(i) = Mean(mr.begin(), mr.end());
+            MaxFit.at(i) = *max_element(mr.begin(), mr.end());
+            MinFit.at(i) = *min_element(mr.begin(), mr.end());
+          }
+        for (size_t i = 0; i < CombMisFit.size(); ++i)
+          CombMisFit.at(i) = ublas::sum(column(MisFit, i));
+        CombAvgFit = Mean(CombMisFit.begin(), CombMisFit.end());
+        CombMaxFit = *max_element(CombMisFit.begin(), CombMisFit.end());
+        CombMinFit = *min_element(CombMisFit.begin(), CombMisFit.end());
+      }
+      //! Returns true if the first fitness vector is better than the second, used for the local refinement
+      /*! The default implementation compares the summed misfit, @see ParetoGA for a multi-objective version
+       */
+      bool virtual IsBetter(const tfitvec &Fitness1, const tfitvec &Fitness2)
+        {
+          return ublas::sum(Fitness1) < ublas::sum(Fitness2);
+        }
+      //! The indices of the members we want to refine ordered by preference, the default sorts by summed misfit
+      std::vector<int> virtual GetRefinementCandidates()
+        {
+          tIndexMap SortedMisFit;
+          for (size_t i = 0; i < CombMisFit.size(); ++i)
+            SortedMisFit.insert(make_pair(CombMisFit.at(i), i));
+          std::vector<int> Result;
+          for (tIndexMap::const_iterator it = SortedMisFit.begin(); it
+              != SortedMisFit.end(); ++it)
+            Result.push_back(it->second);
+          return Result;
+        }
     public:
       //! Return the weight for each objecive function
       const std::vector<double> &GetWeights()
@@ -165,6 +471,43 @@ namespace gplib
       {
         ParameterIndices = Indices;
       }
+      //! Switch on the hybrid mode, every interval iterations we refine the nmembers best members with a local search
+      /*! The best members are improved with a pattern search on the grid of the transcription (see PatternSearch)
+       * that calls the objective functions at most maxevaluations times for each member. The searches for the different
+       * members run in parallel and the refined models replace the original members in the population. All
+       * models the search evaluates are stored in the history of models, so they are never calculated twice.
+       * The transcription has to support GeneralTranscribe::GetMember, an interval of 0 switches the refinement off.
+       */
+      void SetLocalRefinement(const int interval, const size_t nmembers,
+          const unsigned int maxevaluations)
+      {
+        refineinterval = interval;
+        nrefine = nmembers;
+        Refinement.reset();
+        if (interval > 0 && nmembers > 0)
+          {
+            Refinement = boost::shared_ptr<PatternSearch>(new PatternSearch(
+                Transcribe->GetMinValues(), Transcribe->GetMaxValues(),
+                Transcribe->GetResolution()));
+            Refinement->SetMaxEvaluations(maxevaluations);
+          }
+      }
+      //! Skip the expensive objective functions for models whose misfit for the cheaper ones is already too large
+      /*! We calculate the objective functions in the order of GeneralObjective::GetCostEstimate and stop after
+       * each objective function if the summed (weighted) misfit so far exceeds threshold or if at least ndominating of
+       * the best models of the last iteration (the Pareto front for ParetoGA) have a better misfit for all objective
+       * functions calculated so far. The objective functions we skip get the maximum misfit of the last iteration, so
+       * these models will hardly be selected, and they are not stored in the history of models. Early rejection starts
+       * in the second iteration, a threshold of infinity and ndominating of 0 switch it off, which is the default.
+       */
+      void SetEarlyRejection(const double threshold,
+          const unsigned int ndominating)
+      {
+        rejectionthreshold = threshold;
+        rejectiondominance = ndominating;
+        RejectionFront.resize(0, 0, false);
+        PessimisticFit.resize(0, false);
+      }
       //! Print Fitness statistics for each objective function to output
       void PrintFitStat(std::ostream &output)
       {
@@ -213,6 +556,51 @@ namespace gplib
           UniquePopHist.PrintAll(output);
         }
       ;
+      //! Copy up to nmigrants of the best members of the last evaluated generation for migration to other GA instances
+      /*! This has to be called after DoIteration for an iteration that was not the last, as
+       * we take the genes from the stored old population. Each row of Genes, Values and Fitness
+       * corresponds to one migrant.
+       */
+      void GetMigrants(const unsigned int nmigrants, tpopulation &Genes,
+          gplib::rmat &Values, tfitmat &Fitness)
+      {
+        std::vector<int> Indices(GetBestModelIndices());
+        const unsigned int nout = std::min<size_t>(nmigrants, Indices.size());
+        const tpopulation &Evaluated = Population->GetOldPopulation();
+        Genes.resize(nout, Evaluated.size2());
+        Values.resize(nout, Transcribed.size2());
+        Fitness.resize(nout, nobjective);
+        for (unsigned int i = 0; i < nout; ++i)
+          {
+            row(Genes, i) = row(Evaluated, Indices.at(i));
+            row(Values, i) = row(Transcribed, Indices.at(i));
+            row(Fitness, i) = column(MisFit, Indices.at(i));
+          }
+      }
+      //! Replace the last members of the current population with migrants from other GA instances
+      /*! The misfit of the migrants is added to the history of evaluated models, so they
+       * do not have to be calculated again in the next iteration. This assumes that all GA
+       * instances use the same objective functions and weights.
+       */
+      void ImportMigrants(const tpopulation &Genes, const gplib::rmat &Values,
+          const tfitmat &Fitness)
+      {
+        const unsigned int popsize = Population->GetPopsize();
+        const unsigned int nin = std::min<size_t>(Genes.size1(), popsize);
+        if (nin == 0)
+          return;
+        if (Genes.size2() != size_t(Population->GetGenesize())
+            || Fitness.size2() != nobjective)
+          throw FatalException(
+              "Migrants do not match the population of this genetic algorithm !");
+        for (unsigned int i = 0; i < nin; ++i)
+          {
+            Population->SetMember(popsize - nin + i, row(Genes, i));
+            const size_t index = UniquePopHist.GetSize();
+            if (UniquePopHist.Insert(row(Fitness, i), row(Values, i)) && History)
+              History->AddModel(index, -1, row(Values, i), row(Fitness, i));
+          }
+      }
       //! Print misfit of the best population members
       void PrintBestMisfit(std::ostream &output)
       {
@@ -236,108 +624,77 @@ namespace gplib
       //! Do one iteration of the GA
       void virtual DoIteration(const int iterationnumber, const bool last)
       {
+        GAProfiler * const Prof = Profiler.get();
+        if (Prof)
+          Prof->StartGeneration(iterationnumber);
         cout << endl << endl << "Iteration: " << iterationnumber + 1 << endl;
         cout << "Calculating Misfit ...";
         CalcMisfit(iterationnumber);
         cout << " done" << endl << flush;
-        //cout << "Before Elitism " << endl;
-        //PrintMisfit(cout);
         cout << endl;
         if ((iterationnumber >= 1) && Elitist)
           {
+            ScopedStageTimer Timer(Prof, GAProfiler::elitism);
             Elitism(iterationnumber);
           }
-        CalcMisfit(iterationnumber)
-        {
-          int calculatecount = 0;
-          int newcount = 0;
-          // popsize cannot be unsigned because loop variables for openmp have to be signed
-          const int popsize = Population->GetPopsize();
-          ublas::vector<bool> AlreadyCalculated(popsize);
-          tfitvec fitvec(nobjective);
-
-  #pragma omp parallel for default(shared)
-          for (int i = 0; i < popsize; ++i)
-            {
-              tparamvector LocalParameters(nobjective);
-              for (unsigned int k = 0; k < nobjective; ++k)
-                {
-                  LocalParameters.at(k).resize(ParameterIndices.at(k).size(),
-                      false);
-                }
-              row(Transcribed, i) = Transcribe->GetValues(row(
-                  Population->GetPopulation(), i));
-              AlreadyCalculated(i) = UniquePopHist.Find(row(Transcribed, i),
-                  fitvec);
-              if (!AlreadyCalculated(i))
-                {
-                  SetupParams(row(Transcribed, i), LocalParameters);
-                  tObjectiveVector LocalObjective(GenObjective()(Objective));
-                  for (unsigned int j = 0; j < nobjective; ++j)
-                    {
-                      LocalObjective.at(j)->SetParallelID(MakeParallelID(j, i,
-                          iterationnumber, Programnum));
-                      if (Weights.at(j) != 0)
-                        {
-  #pragma omp critical
-                            {
-                              LocalObjective.at(j)->PreParallel(
-                                  LocalParameters.at(j));
-                            }
-                          LocalObjective.at(j)->SafeParallel(
-                              LocalParameters.at(j));
-  #pragma omp critical
-                            {
-                              MisFit(j, i) = Weights.at(j)
-                                  * LocalObjective.at(j)->PostParallel(
-                                      LocalParameters.at(j));
-                              CombMisFit.at(i) += MisFit(j, i);
-                            }
-
-                        }
-                      else
-                        {
-                          MisFit(j, i) = 0;
-                        }
-                    }
-                  tfitvec fitvector(column(MisFit, i));
-  #pragma omp critical
-                    {
-                      UniquePopHist.Insert(fitvector, ublas::matrix_row<
-                          gplib::rmat>(Transcribed, i));
-                    }
-                  newcount++;
-                }
-              else // if already calculated
-                {
-                  column(MisFit, i) = fitvec;
-                  CombMisFit.at(i) = ublas::sum(fitvec);
-                  calculatecount++;
-                }
-            }
-          cout << "New models: " << newcount << " Re-used models: "
-              << calculatecount << endl;
-        }// we have to update the misfit after elitism
+        // we have to update the misfit after elitism
         //because we cache the misfit values, the cost is low for this
-        CalcProbabilities(iterationnumber, MisFit, *Population);
-        for (unsigned int i = 0; i < nobjective; ++i) // do some statistics on the misfit
-
+        CalcMisfit(iterationnumber);
+        if (Refinement && ((iterationnumber + 1) % refineinterval == 0))
           {
-            ublas::matrix_row<gplib::rmat> mr(MisFit, i);
-            AvgFit.at(i) = Mean(mr.begin(), mr.end());
-            MaxFit.at(i) = *max_element(mr.begin(), mr.end());
-            MinFit.at(i) = *min_element(mr.begin(), mr.end());
+            ScopedStageTimer Timer(Prof, GAProfiler::refinement);
+            RefineMembers(iterationnumber);
+          }
+          {
+            ScopedStageTimer Timer(Prof, GAProfiler::ranking);
+            CalcProbabilities(iterationnumber, MisFit, *Population);
+          }
+          {
+            ScopedStageTimer Timer(Prof, GAProfiler::statistics);
+            CalcStatistics();
+            UpdateRejectionFront();
+            LogGeneration(iterationnumber);
           }
-        CombAvgFit = Mean(CombMisFit.begin(), CombMisFit.end());
-        CombMaxFit = *max_element(CombMisFit.begin(), CombMisFit.end());
-        CombMinFit = *min_element(CombMisFit.begin(), CombMisFit.end());
         if (!last) // if we're not in the last iteration, we store the last population for elitism
-
           {
+            ScopedStageTimer Timer(Prof, GAProfiler::propagation);
             Population->StoreOldPopulation();
             OldMisFit = MisFit;
             Propagation->NextGeneration();
           }
+        if (Prof)
+          Prof->EndGeneration();
+      }
+      //! A name for each objective function made from its type and its index
+      std::vector<std::string> GetObjectiveNames() const
+      {
+        std::vector<std::string> Names;
+        for (unsigned int i = 0; i < nobjective; ++i)
+          Names.push_back(TypeName(*Objective.at(i)) + "#" + std::to_string(i));
+        return Names;
+      }
+      //! Attach a profiler that records timings and counters for each iteration, pass an empty pointer to switch profiling off
+      void SetProfiler(boost::shared_ptr<GAProfiler> P)
+      {
+        Profiler = P;
+        if (Profiler)
+          Profiler->SetObjectiveNames(GetObjectiveNames());
+      }
+      //! Write all evaluated models and the population of each iteration to a binary history file, pass an empty pointer to switch it off
+      /*! This replaces the text output of PrintMisfit, PrintTranscribed and PrintUniquePop for long runs, the file
+       * is written in the background and can be read with InversionHistoryReader or converted with ConvertHistoryToText.
+       * Each model is written when it is first calculated, the population of each iteration is stored as the indices of these models.
+       * The genes are not stored as they can be recreated with GeneralTranscribe::GetMember. Models from
+       * ImportMigrants are written with iteration -1. The history should be attached before the first iteration, models
+       * calculated before are not in the file.
+       */
+      void SetHistory(boost::shared_ptr<InversionHistory> H)
+      {
+        if (H && (H->GetNParams() != Transcribed.size2() || H->GetNObjectives()
+            != nobjective))
+          throw FatalException(
+              "History does not match the number of parameters and objective functions !");
+        History = H;
       }
       //! Calculate the Probabilities
       void virtual CalcProbabilities(const int iterationnumber,
@@ -349,7 +706,10 @@ namespace gplib
           :
                 CombMisFit(LocalPopulation->GetPopsize()), AvgFit(IndObjective.size()),
                     MaxFit(IndObjective.size()), MinFit(IndObjective.size()), Weights(
-                        IndObjective.size(), 1), nobjective(IndObjective.size()),
+                        IndObjective.size(), 1), refineinterval(0), nrefine(0),
+                    rejectionthreshold(std::numeric_limits<double>::infinity()),
+                    rejectiondominance(0), nrejected(0),
+                    nobjective(IndObjective.size()),
                     Transcribed(LocalPopulation->GetPopsize(),
                         LocalTranscribe->GetNparams()), MisFit(IndObjective.size(),
                         LocalPopulation->GetPopsize()), Objective(IndObjective),
@@ -359,6 +719,13 @@ namespace gplib
                   Threads = nthreads;
                   Elitist = true;
                   Programnum = getpid();
+                  //cheap objective functions first, the order of equally expensive ones is preserved
+                  std::multimap<double, unsigned int> Costs;
+                  for (unsigned int i = 0; i < nobjective; ++i)
+                    Costs.insert(std::make_pair(Objective.at(i)->GetCostEstimate(), i));
+                  for (std::multimap<double, unsigned int>::const_iterator it =
+                      Costs.begin(); it != Costs.end(); ++it)
+                    EvaluationOrder.push_back(it->second);
                 }
 
       virtual ~GeneralGA();
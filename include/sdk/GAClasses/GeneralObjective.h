@@ -104,6 +104,14 @@ namespace gplib
         }
       //! We need clone and create for building an array of derived objects, see FAQ lite 20.8, the return type depends on the derived class
       virtual GeneralObjective *clone() const = 0;
+      //! An estimate of the cost of one misfit calculation relative to a 1D MT forward calculation
+      /*! The genetic algorithm calculates cheap objective functions first, so it can avoid
+       * expensive calculations for models that are rejected early, see GeneralGA::SetEarlyRejection.
+       */
+      virtual double GetCostEstimate() const
+        {
+          return 1.0;
+        }
       //! Some operations cannot be done in parallel, these are done before
       virtual void PreParallel(const ttranscribed &member);
       //! Some operations cannot be done in parallel, these are done after, returns the misfit value
@@ -120,6 +120,12 @@ namespace gplib
           OldStored = true;
         }
       ;
+      //! Replace the genes of a single member of the current population, unlike SetPopulation this does not change the old population
+      template<typename VectorType>
+      void SetMember(const int index, const VectorType &Genes)
+        {
+          ublas::row(Population, index) = Genes;
+        }
       void SetProbabilities(const tprobabilityv &LocalProb)
         {
           Probabilities = LocalProb;
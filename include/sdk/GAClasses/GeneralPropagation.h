@@ -48,6 +48,13 @@ namespace gplib
       double CrossoverProb;
     public:
       virtual void NextGeneration() = 0;
+      //! Replace father and mother by two children created with crossover and mutation, this is used by steady state algorithms
+      void Recombine(tpopmember &father, tpopmember &mother)
+        {
+          Crossover(father, mother);
+          Mutation(father);
+          Mutation(mother);
+        }
       void SetParams(const double mutation, const double crossover)
         {
           MutationProb = mutation;
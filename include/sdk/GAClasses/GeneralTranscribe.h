@@ -2,6 +2,7 @@
 #ifndef CGENERALTRANSCRIBE_H
 #define CGENERALTRANSCRIBE_H
 #include "gentypes.h"
+#include "FatalException.h"
 
 namespace gplib
   {
@@ -21,6 +22,30 @@ namespace gplib
        * vector of doubles, that are used as parameters for the objective functions*/
       virtual ttranscribed GetValues(const tpopmember &member)=0;
       virtual int GetNparams() = 0;
+      //! Encode a vector of parameter values as a population member, the inverse of GetValues
+      /*! Values that cannot be represented exactly are rounded to the nearest value that can be encoded.
+       * Transcriptions that support this also have to implement GetMinValues, GetMaxValues and GetResolution,
+       * they are needed to refine models outside the genetic algorithm, see GeneralGA::SetLocalRefinement.
+       */
+      virtual tpopmember GetMember(const ttranscribed &values)
+        {
+          throw FatalException("Transcription does not support encoding of models !");
+        }
+      //! The smallest value that can be encoded for each parameter
+      virtual ttranscribed GetMinValues()
+        {
+          throw FatalException("Transcription does not support encoding of models !");
+        }
+      //! The largest value that can be encoded for each parameter
+      virtual ttranscribed GetMaxValues()
+        {
+          throw FatalException("Transcription does not support encoding of models !");
+        }
+      //! The difference between two neighbouring values that can be encoded for each parameter
+      virtual ttranscribed GetResolution()
+        {
+          throw FatalException("Transcription does not support encoding of models !");
+        }
       GeneralTranscribe();
       /*! The copy constructor is empty and will be removed in the future*/
       GeneralTranscribe(const GeneralTranscribe &Old);
@@ -11,6 +11,12 @@ namespace gplib
     //! This class implements the Gray code representation of a binary string and the corresponding transcription
     class GrayTranscribe: public BinaryTranscribe
       {
+    protected:
+      //! The Gray code of level, so that GetMember is the inverse of GetValues
+      virtual unsigned long EncodeInteger(const unsigned long level) const
+        {
+          return level ^ (level >> 1);
+        }
     public:
       virtual ttranscribed GetValues(const tpopmember &member)
         {
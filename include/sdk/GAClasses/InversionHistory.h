@@ -0,0 +1,496 @@
+#ifndef INVERSIONHISTORY_H_
+#define INVERSIONHISTORY_H_
+#include "gentypes.h"
+#include "FatalException.h"
+#include <boost/cstdint.hpp>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! The magic string at the beginning of each binary history file
+    static const char HistoryMagic[8] =
+      { 'G', 'P', 'H', 'I', 'S', 'T', '\0', '\0' };
+    //! The version of the binary history format written by this code
+    static const boost::uint32_t HistoryVersion = 1;
+    //! Written as a native integer so we can detect files from machines with different byte order
+    static const boost::uint32_t HistoryByteOrder = 0x01020304;
+
+    //! The fixed size header of a binary history file, it is followed by the names of the objective functions and parameters
+    struct HistoryHeader
+      {
+      char magic[8];
+      boost::uint32_t byteorder;
+      boost::uint32_t version;
+      boost::uint32_t nparams;
+      boost::uint32_t nobjectives;
+      };
+
+    //! Each chunk of a history file starts with this header
+    /*! size is the number of bytes that follow the header, so a reader can skip chunk types it does not know.
+     */
+    struct HistoryChunkHeader
+      {
+      boost::uint32_t type;
+      boost::uint32_t iteration;
+      boost::uint32_t nrecords;
+      boost::uint32_t size;
+      };
+
+    //! The types of chunks in a history file
+    enum thistorychunk
+      {
+      //! Newly evaluated models, each record is the index of the model, the parameters and the misfit for each objective function
+      historymodels = 1,
+      //! The members of the population at the end of an iteration, each record is the index of a model written before
+      historygeneration = 2
+      };
+
+    //! The index in a generation chunk for members that are not in the history, e.g. because they were rejected early
+    static const boost::uint32_t HistoryNoModel = 0xFFFFFFFF;
+
+    //! Write the history of a genetic algorithm run to a compact binary file
+    /*! Instead of printing the population and the misfit of each iteration as text, we store each evaluated model
+     * once, when it is first calculated, together with its misfit. For each iteration we then only store the indices
+     * of the models in the population. Parameters and misfit are stored as single precision floats, which is sufficient for the
+     * analysis of the results, so the file is usually more than ten times smaller than the text output for the same run.
+     *
+     * The file is written in chunks, each chunk is complete in itself, so if a run is aborted, the file can be
+     * read up to the last complete chunk. The chunks are written by a background thread, the calling threads
+     * only copy the data into a buffer and hand full buffers over to the writer. If the disk cannot keep up, the
+     * callers wait when maxqueued bytes are waiting to be written. All functions can be called from several threads.
+     */
+    class InversionHistory
+      {
+    private:
+      std::ofstream outfile;
+      const size_t nparams;
+      const size_t nobjectives;
+      //! We hand over a buffer to the writer thread when it reaches this size
+      const size_t chunksize;
+      //! The maximum number of bytes waiting to be written before the callers have to wait
+      const size_t maxqueued;
+      //! The models we have collected for the current chunk
+      std::vector<char> Current;
+      boost::uint32_t currentrecords;
+      boost::uint32_t currentiteration;
+      //! Protects Current
+      std::mutex CurrentMutex;
+      //! Complete chunks waiting to be written and the number of bytes in them
+      std::deque<std::vector<char> > Queue;
+      size_t queued;
+      //! Is the writer thread writing a chunk at the moment
+      bool writing;
+      //! Has a write failed, we cannot throw in the writer thread, so we report it to the next caller
+      bool failed;
+      bool stopping;
+      std::mutex QueueMutex;
+      //! Signals the writer that there is work or that it should stop
+      std::condition_variable WorkReady;
+      //! Signals the callers that the writer has finished a chunk
+      std::condition_variable ChunkWritten;
+      std::thread Writer;
+      size_t ModelRecordSize() const
+        {
+          return sizeof(boost::uint32_t) + (nparams + nobjectives) * sizeof(float);
+        }
+      //! The loop of the writer thread
+      void WriteQueue()
+        {
+          std::unique_lock<std::mutex> Lock(QueueMutex);
+          while (true)
+            {
+              while (Queue.empty() && !stopping)
+                WorkReady.wait(Lock);
+              if (Queue.empty())
+                break;
+              std::vector<char> Chunk;
+              Chunk.swap(Queue.front());
+              Queue.pop_front();
+              writing = true;
+              Lock.unlock();
+              //we flush after each chunk, so an aborted run leaves a readable file
+              outfile.write(&Chunk[0], Chunk.size());
+              outfile.flush();
+              const bool good = outfile.good();
+              Lock.lock();
+              writing = false;
+              queued -= Chunk.size();
+              if (!good)
+                failed = true;
+              ChunkWritten.notify_all();
+            }
+        }
+      //! Append a chunk to the queue of the writer, waits if the queue is full
+      void Submit(std::vector<char> &Chunk)
+        {
+          std::unique_lock<std::mutex> Lock(QueueMutex);
+          while (queued > 0 && queued + Chunk.size() > maxqueued && !failed)
+            ChunkWritten.wait(Lock);
+          if (failed)
+            throw FatalException("Cannot write inversion history !");
+          queued += Chunk.size();
+          Queue.push_back(std::vector<char>());
+          Queue.back().swap(Chunk);
+          WorkReady.notify_one();
+        }
+      //! Fill in the header in front of the models in Current, CurrentMutex has to be locked
+      void CloseCurrent()
+        {
+          HistoryChunkHeader Header;
+          Header.type = historymodels;
+          Header.iteration = currentiteration;
+          Header.nrecords = currentrecords;
+          Header.size = Current.size() - sizeof(Header);
+          std::memcpy(&Current[0], &Header, sizeof(Header));
+        }
+      //! Submit the models in Current to the writer, CurrentMutex has to be locked
+      void SubmitCurrent()
+        {
+          if (currentrecords == 0)
+            return;
+          CloseCurrent();
+          Submit(Current);
+          Current.assign(sizeof(HistoryChunkHeader), 0);
+          currentrecords = 0;
+        }
+      static void AppendName(std::vector<char> &Buffer, const std::string &Name)
+        {
+          const boost::uint32_t length = Name.size();
+          const char *pos = reinterpret_cast<const char *> (&length);
+          Buffer.insert(Buffer.end(), pos, pos + sizeof(length));
+          Buffer.insert(Buffer.end(), Name.begin(), Name.end());
+        }
+    public:
+      //! The number of parameters of each model
+      size_t GetNParams() const
+        {
+          return nparams;
+        }
+      //! The number of objective functions, i.e. the length of each misfit vector
+      size_t GetNObjectives() const
+        {
+          return nobjectives;
+        }
+      //! Store a newly evaluated model with the index index that was calculated in iteration iteration
+      void AddModel(const size_t index, const int iteration,
+          const ttranscribed &Model, const tfitvec &Fitness)
+        {
+          if (Model.size() != nparams || Fitness.size() != nobjectives)
+            throw FatalException("Model size does not match inversion history !");
+          std::lock_guard<std::mutex> Lock(CurrentMutex);
+          if (currentrecords > 0 && (boost::uint32_t(iteration)
+              != currentiteration || Current.size() + ModelRecordSize()
+              > chunksize))
+            SubmitCurrent();
+          currentiteration = iteration;
+          const size_t start = Current.size();
+          Current.resize(start + ModelRecordSize());
+          char *pos = &Current[start];
+          const boost::uint32_t id = index;
+          std::memcpy(pos, &id, sizeof(id));
+          pos += sizeof(id);
+          for (size_t i = 0; i < nparams; ++i, pos += sizeof(float))
+            {
+              const float value = Model(i);
+              std::memcpy(pos, &value, sizeof(value));
+            }
+          for (size_t i = 0; i < nobjectives; ++i, pos += sizeof(float))
+            {
+              const float value = Fitness(i);
+              std::memcpy(pos, &value, sizeof(value));
+            }
+          ++currentrecords;
+        }
+      //! Store the indices of the population members at the end of iteration iteration
+      /*! The models that were collected so far are written before, so a reader always knows all models of a generation.
+       */
+      void AddGeneration(const int iteration,
+          const std::vector<boost::uint32_t> &Indices)
+        {
+          std::lock_guard<std::mutex> Lock(CurrentMutex);
+          SubmitCurrent();
+          HistoryChunkHeader Header;
+          Header.type = historygeneration;
+          Header.iteration = iteration;
+          Header.nrecords = Indices.size();
+          Header.size = Indices.size() * sizeof(boost::uint32_t);
+          std::vector<char> Chunk(sizeof(Header) + Header.size);
+          std::memcpy(&Chunk[0], &Header, sizeof(Header));
+          if (!Indices.empty())
+            std::memcpy(&Chunk[sizeof(Header)], &Indices[0], Header.size);
+          Submit(Chunk);
+        }
+      //! Hand over all collected models and wait until everything has been written to the file
+      void Flush()
+        {
+            {
+              std::lock_guard<std::mutex> Lock(CurrentMutex);
+              SubmitCurrent();
+            }
+          std::unique_lock<std::mutex> Lock(QueueMutex);
+          while ((!Queue.empty() || writing) && !failed)
+            ChunkWritten.wait(Lock);
+          if (failed)
+            throw FatalException("Cannot write inversion history !");
+        }
+      //! Create a new history file and start the writer thread
+      /*! @param filename The name of the file, an existing file is overwritten
+       * @param ObjectiveNames The names of the objective functions, this determines the length of the misfit vector
+       * @param ParameterNames The names of the model parameters, this determines the length of the models
+       * @param localchunksize The size of the chunks of models in bytes
+       * @param localmaxqueued The maximum number of bytes waiting to be written before the callers have to wait
+       */
+      InversionHistory(const std::string &filename,
+          const std::vector<std::string> &ObjectiveNames,
+          const std::vector<std::string> &ParameterNames,
+          const size_t localchunksize = 1024 * 1024,
+          const size_t localmaxqueued = 64 * 1024 * 1024) :
+        outfile(filename.c_str(), std::ios::binary | std::ios::trunc), nparams(
+            ParameterNames.size()), nobjectives(ObjectiveNames.size()),
+            chunksize(localchunksize), maxqueued(localmaxqueued), Current(
+                sizeof(HistoryChunkHeader), 0), currentrecords(0),
+            currentiteration(0), queued(0), writing(false), failed(false),
+            stopping(false)
+        {
+          if (!outfile)
+            throw FatalException("Cannot open history file: " + filename);
+          HistoryHeader Header;
+          std::memcpy(Header.magic, HistoryMagic, sizeof(Header.magic));
+          Header.byteorder = HistoryByteOrder;
+          Header.version = HistoryVersion;
+          Header.nparams = nparams;
+          Header.nobjectives = nobjectives;
+          std::vector<char> Names;
+          for (size_t i = 0; i < ObjectiveNames.size(); ++i)
+            AppendName(Names, ObjectiveNames.at(i));
+          for (size_t i = 0; i < ParameterNames.size(); ++i)
+            AppendName(Names, ParameterNames.at(i));
+          outfile.write(reinterpret_cast<const char *> (&Header), sizeof(Header));
+          if (!Names.empty())
+            outfile.write(&Names[0], Names.size());
+          if (!outfile.good())
+            throw FatalException("Cannot write history file: " + filename);
+          Writer = std::thread(&InversionHistory::WriteQueue, this);
+        }
+      virtual ~InversionHistory()
+        {
+          //we cannot throw in the destructor, so the writer thread writes whatever it can
+            {
+              std::lock_guard<std::mutex> CurrentLock(CurrentMutex);
+              std::lock_guard<std::mutex> Lock(QueueMutex);
+              if (currentrecords > 0 && !failed)
+                {
+                  CloseCurrent();
+                  Queue.push_back(Current);
+                  queued += Current.size();
+                }
+              stopping = true;
+              WorkReady.notify_one();
+            }
+          Writer.join();
+        }
+      };
+
+    //! A chunk of a history file as read by InversionHistoryReader
+    struct HistoryChunk
+      {
+      thistorychunk type;
+      int iteration;
+      //! The index of each model or population member
+      std::vector<boost::uint32_t> Indices;
+      //! For model chunks the parameters of each model, one row per model
+      gplib::rmat Models;
+      //! For model chunks the misfit of each model, one row per model
+      gplib::rmat Fitness;
+      };
+
+    //! Read a history file written by InversionHistory chunk by chunk
+    class InversionHistoryReader
+      {
+    private:
+      std::ifstream infile;
+      std::vector<std::string> ObjectiveNames;
+      std::vector<std::string> ParameterNames;
+      std::vector<char> Buffer;
+      std::string ReadName()
+        {
+          boost::uint32_t length = 0;
+          infile.read(reinterpret_cast<char *> (&length), sizeof(length));
+          std::string Name(length, ' ');
+          if (length > 0)
+            infile.read(&Name[0], length);
+          if (!infile.good())
+            throw FatalException("Corrupt header in history file !");
+          return Name;
+        }
+    public:
+      //! The names of the objective functions, i.e. the columns of the misfit
+      const std::vector<std::string> &GetObjectiveNames() const
+        {
+          return ObjectiveNames;
+        }
+      //! The names of the model parameters
+      const std::vector<std::string> &GetParameterNames() const
+        {
+          return ParameterNames;
+        }
+      //! Read the next chunk, returns false at the end of the file or if the last chunk is incomplete
+      /*! Chunks of unknown type are skipped.
+       */
+      bool Next(HistoryChunk &Chunk)
+        {
+          const size_t nparams = ParameterNames.size();
+          const size_t nobjectives = ObjectiveNames.size();
+          const size_t recordsize = sizeof(boost::uint32_t) + (nparams
+              + nobjectives) * sizeof(float);
+          while (true)
+            {
+              HistoryChunkHeader Header;
+              infile.read(reinterpret_cast<char *> (&Header), sizeof(Header));
+              if (!infile.good())
+                return false;
+              Buffer.resize(Header.size);
+              if (Header.size > 0)
+                infile.read(&Buffer[0], Header.size);
+              if (!infile.good())
+                return false;
+              Chunk.iteration = Header.iteration;
+              if (Header.type == historymodels)
+                {
+                  if (Header.size != Header.nrecords * recordsize)
+                    throw FatalException("Corrupt model chunk in history file !");
+                  Chunk.type = historymodels;
+                  Chunk.Indices.resize(Header.nrecords);
+                  Chunk.Models.resize(Header.nrecords, nparams, false);
+                  Chunk.Fitness.resize(Header.nrecords, nobjectives, false);
+                  const char *pos = Buffer.empty() ? 0 : &Buffer[0];
+                  float value;
+                  for (size_t i = 0; i < Header.nrecords; ++i)
+                    {
+                      std::memcpy(&Chunk.Indices[i], pos, sizeof(boost::uint32_t));
+                      pos += sizeof(boost::uint32_t);
+                      for (size_t j = 0; j < nparams; ++j, pos += sizeof(float))
+                        {
+                          std::memcpy(&value, pos, sizeof(value));
+                          Chunk.Models(i, j) = value;
+                        }
+                      for (size_t j = 0; j < nobjectives; ++j, pos += sizeof(float))
+                        {
+                          std::memcpy(&value, pos, sizeof(value));
+                          Chunk.Fitness(i, j) = value;
+                        }
+                    }
+                  return true;
+                }
+              if (Header.type == historygeneration)
+                {
+                  if (Header.size != Header.nrecords * sizeof(boost::uint32_t))
+                    throw FatalException(
+                        "Corrupt generation chunk in history file !");
+                  Chunk.type = historygeneration;
+                  Chunk.Indices.resize(Header.nrecords);
+                  if (Header.nrecords > 0)
+                    std::memcpy(&Chunk.Indices[0], &Buffer[0], Header.size);
+                  Chunk.Models.resize(0, nparams, false);
+                  Chunk.Fitness.resize(0, nobjectives, false);
+                  return true;
+                }
+            }
+        }
+      explicit InversionHistoryReader(const std::string &filename) :
+        infile(filename.c_str(), std::ios::binary)
+        {
+          HistoryHeader Header;
+          infile.read(reinterpret_cast<char *> (&Header), sizeof(Header));
+          if (!infile.good() || std::memcmp(Header.magic, HistoryMagic,
+              sizeof(Header.magic)) != 0)
+            throw FatalException("Not a valid history file: " + filename);
+          if (Header.byteorder != HistoryByteOrder)
+            throw FatalException("History file has a different byte order: "
+                + filename);
+          if (Header.version != HistoryVersion)
+            throw FatalException("Unsupported version of history file: "
+                + filename);
+          for (size_t i = 0; i < Header.nobjectives; ++i)
+            ObjectiveNames.push_back(ReadName());
+          for (size_t i = 0; i < Header.nparams; ++i)
+            ParameterNames.push_back(ReadName());
+        }
+      virtual ~InversionHistoryReader()
+        {
+        }
+      };
+
+    //! Convert a binary history file to text
+    /*! Each evaluated model is written once to models in the format of GeneralGA::PrintUniquePop, i.e.
+     * the parameters and the misfit separated by four blanks. If misfit is not null, we write the misfit
+     * of the population members of each iteration to it, one line per member in the order of the population, with an empty line
+     * after each iteration. Members that are not in the history, e.g. because they were rejected early, are skipped.
+     */
+    inline void ConvertHistoryToText(const std::string &filename,
+        std::ostream &models, std::ostream *misfit = 0)
+      {
+        InversionHistoryReader Reader(filename);
+        HistoryChunk Chunk;
+        //the misfit of each model by index, only needed for the generations
+        std::vector<std::vector<float> > AllFitness;
+        models.precision(7);
+        if (misfit)
+          misfit->precision(7);
+        while (Reader.Next(Chunk))
+          {
+            if (Chunk.type == historymodels)
+              {
+                for (size_t i = 0; i < Chunk.Indices.size(); ++i)
+                  {
+                    for (size_t j = 0; j < Chunk.Models.size2(); ++j)
+                      models << Chunk.Models(i, j) << " ";
+                    models << "    ";
+                    for (size_t j = 0; j < Chunk.Fitness.size2(); ++j)
+                      models << Chunk.Fitness(i, j) << " ";
+                    models << "\n";
+                    if (misfit)
+                      {
+                        const size_t index = Chunk.Indices.at(i);
+                        if (AllFitness.size() <= index)
+                          AllFitness.resize(index + 1);
+                        AllFitness.at(index).assign(row(Chunk.Fitness, i).begin(),
+                            row(Chunk.Fitness, i).end());
+                      }
+                  }
+              }
+            else if (misfit)
+              {
+                for (size_t i = 0; i < Chunk.Indices.size(); ++i)
+                  {
+                    const size_t index = Chunk.Indices.at(i);
+                    if (index >= AllFitness.size() || AllFitness.at(index).empty())
+                      continue;
+                    std::copy(AllFitness.at(index).begin(),
+                        AllFitness.at(index).end(), std::ostream_iterator<float>(
+                            *misfit, " "));
+                    *misfit << "\n";
+                  }
+                *misfit << "\n";
+              }
+          }
+        models.flush();
+        if (misfit)
+          misfit->flush();
+      }
+  /* @} */
+  }
+#endif /*INVERSIONHISTORY_H_*/
@@ -0,0 +1,389 @@
+#ifndef ISLANDMIGRATION_H_
+#define ISLANDMIGRATION_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/lexical_cast.hpp>
+#include "GeneralGA.h"
+#include "ParetoGA.h"
+#include "UniquePop.h"
+#include "gentypes.h"
+#include "FatalException.h"
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! Return a reproducible seed for island number island of a distributed genetic algorithm
+    /*! All islands can use the same base seed from a configuration file and still get
+     * different, but reproducible, random number sequences, e.g. UniformRNG Random(IslandSeed(seed, island));
+     */
+    inline unsigned int IslandSeed(const unsigned int baseseed,
+        const unsigned int island)
+      {
+        std::size_t seed = baseseed;
+        boost::hash_combine(seed, island);
+        return static_cast<unsigned int> (seed);
+      }
+
+    //! The members that are exchanged between islands, each row of the matrices is one member
+    struct tMigrants
+      {
+      tpopulation Genes;
+      gplib::rmat Values;
+      tfitmat Fitness;
+      };
+
+    //! Convert migrants into a binary message, all values are written in native byte order
+    inline std::string SerializeMigrants(const tMigrants &Migrants)
+      {
+        const boost::uint64_t header[4] =
+          { Migrants.Genes.size1(), Migrants.Genes.size2(),
+              Migrants.Values.size2(), Migrants.Fitness.size2() };
+        std::vector<double> values;
+        values.reserve(header[0] * (header[1] + header[2] + header[3]));
+        for (size_t i = 0; i < header[0]; ++i)
+          {
+            for (size_t j = 0; j < header[1]; ++j)
+              values.push_back(Migrants.Genes(i, j));
+            for (size_t j = 0; j < header[2]; ++j)
+              values.push_back(Migrants.Values(i, j));
+            for (size_t j = 0; j < header[3]; ++j)
+              values.push_back(Migrants.Fitness(i, j));
+          }
+        std::string message(reinterpret_cast<const char *> (header),
+            sizeof(header));
+        if (!values.empty())
+          message.append(reinterpret_cast<const char *> (&values[0]),
+              values.size() * sizeof(double));
+        return message;
+      }
+
+    //! Convert a binary message created by SerializeMigrants back into migrants
+    inline tMigrants DeserializeMigrants(const std::string &message)
+      {
+        boost::uint64_t header[4];
+        if (message.size() < sizeof(header))
+          throw FatalException("Migration message is too short !");
+        std::memcpy(header, message.data(), sizeof(header));
+        const size_t rowsize = header[1] + header[2] + header[3];
+        if (message.size() != sizeof(header) + header[0] * rowsize
+            * sizeof(double))
+          throw FatalException("Migration message has wrong size !");
+        std::vector<double> values(header[0] * rowsize);
+        if (!values.empty())
+          std::memcpy(&values[0], message.data() + sizeof(header),
+              values.size() * sizeof(double));
+        tMigrants Migrants;
+        Migrants.Genes.resize(header[0], header[1]);
+        Migrants.Values.resize(header[0], header[2]);
+        Migrants.Fitness.resize(header[0], header[3]);
+        std::vector<double>::const_iterator curr = values.begin();
+        for (size_t i = 0; i < header[0]; ++i)
+          {
+            for (size_t j = 0; j < header[1]; ++j)
+              Migrants.Genes(i, j) = *curr++;
+            for (size_t j = 0; j < header[2]; ++j)
+              Migrants.Values(i, j) = *curr++;
+            for (size_t j = 0; j < header[3]; ++j)
+              Migrants.Fitness(i, j) = *curr++;
+          }
+        return Migrants;
+      }
+
+    //! The base class for the transport of migration messages between the islands of a distributed GA
+    /*! The islands are arranged in a ring, each island sends its message to the next
+     * island and receives the message of the previous island.
+     */
+    class GeneralMigrationTransport
+      {
+    public:
+      //! Send outgoing to the next island and return the message of the previous island in incoming, blocks until both are done
+      virtual void Exchange(const std::string &outgoing, std::string &incoming) = 0;
+      GeneralMigrationTransport()
+        {
+        }
+      virtual ~GeneralMigrationTransport()
+        {
+        }
+      };
+
+    //! Migration transport over stream sockets with boost::asio, works for tcp and for local (unix domain) sockets
+    /*! Each message is preceded by its length as a 64bit integer. Sending and receiving
+     * happen asynchronously at the same time, so all islands can call Exchange simultaneously
+     * without deadlock, regardless of the message size.
+     */
+    template<typename Protocol>
+    class AsioMigrationTransport: public GeneralMigrationTransport
+      {
+    private:
+      typedef typename Protocol::endpoint tendpoint;
+      typedef typename Protocol::socket tsocket;
+      typedef typename Protocol::acceptor tacceptor;
+      //! How often we try to connect to the next island before we give up
+      int maxretries;
+      //! The connection to the next island
+      boost::shared_ptr<tsocket> ToNext;
+      //! The connection from the previous island
+      boost::shared_ptr<tsocket> FromPrevious;
+      //! Wait for the given number of milliseconds
+      void Wait(const int milliseconds)
+        {
+          boost::asio::deadline_timer Timer(io, boost::posix_time::milliseconds(
+              milliseconds));
+          Timer.wait();
+        }
+      //! Connect to the next island and accept the connection of the previous island
+      void Connect()
+        {
+          ToNext.reset(new tsocket(io));
+          boost::system::error_code error;
+          int tries = 0;
+          do
+            {
+              ToNext->close();
+              ToNext->connect(Next, error);
+              if (error)
+                Wait(200);
+              ++tries;
+            } while (error && tries < maxretries);
+          if (error)
+            throw FatalException("Cannot connect to next island: "
+                + error.message());
+          FromPrevious.reset(new tsocket(io));
+          Acceptor->accept(*FromPrevious);
+        }
+      static void Done(boost::system::error_code &result,
+          const boost::system::error_code &error)
+        {
+          result = error;
+        }
+    protected:
+      boost::asio::io_service io;
+      //! The endpoint of the next island in the ring
+      tendpoint Next;
+      //! Listens for the connection from the previous island
+      boost::shared_ptr<tacceptor> Acceptor;
+      //! Start listening on our own endpoint, has to be called by the derived class constructor
+      void Listen(const tendpoint &Own)
+        {
+          Acceptor.reset(new tacceptor(io, Own));
+        }
+    public:
+      virtual void Exchange(const std::string &outgoing, std::string &incoming)
+        {
+          if (!ToNext)
+            Connect();
+          boost::uint64_t outsize = outgoing.size();
+          boost::uint64_t insize = 0;
+          std::vector<boost::asio::const_buffer> OutBuffers;
+          OutBuffers.push_back(boost::asio::buffer(&outsize, sizeof(outsize)));
+          OutBuffers.push_back(boost::asio::buffer(outgoing));
+          boost::system::error_code writeerror, readerror;
+          io.reset();
+          boost::asio::async_write(*ToNext, OutBuffers, boost::bind(
+              &AsioMigrationTransport::Done, boost::ref(writeerror), _1));
+          boost::asio::async_read(*FromPrevious, boost::asio::buffer(&insize,
+              sizeof(insize)), boost::bind(&AsioMigrationTransport::Done,
+              boost::ref(readerror), _1));
+          io.run();
+          if (writeerror || readerror)
+            throw FatalException("Migration failed: " + (writeerror ? writeerror
+                : readerror).message());
+          incoming.assign(insize, '\0');
+          if (insize > 0)
+            boost::asio::read(*FromPrevious, boost::asio::buffer(&incoming[0],
+                insize));
+        }
+      //! Set how often we try to connect to the next island, we wait 200ms between tries
+      void SetMaxRetries(const int n)
+        {
+          maxretries = n;
+        }
+      AsioMigrationTransport() :
+        maxretries(300)
+        {
+        }
+      virtual ~AsioMigrationTransport()
+        {
+        }
+      };
+
+    //! Migration between islands over tcp, the islands can run on different hosts
+    /*! Island i listens on port baseport + i, hosts contains the host name of each island
+     */
+    class TcpMigrationTransport: public AsioMigrationTransport<
+        boost::asio::ip::tcp>
+      {
+    public:
+      TcpMigrationTransport(const unsigned int island,
+          const std::vector<std::string> &hosts, const unsigned short baseport)
+        {
+          using boost::asio::ip::tcp;
+          const unsigned int next = (island + 1) % hosts.size();
+          Listen(tcp::endpoint(tcp::v4(), baseport + island));
+          tcp::resolver Resolver(io);
+          tcp::resolver::query Query(tcp::v4(), hosts.at(next),
+              boost::lexical_cast<std::string>(baseport + next));
+          Next = *Resolver.resolve(Query);
+        }
+      virtual ~TcpMigrationTransport()
+        {
+        }
+      };
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    //! Migration between islands on the same host over unix domain sockets
+    /*! Island i listens on the socket file prefix + i
+     */
+    class LocalMigrationTransport: public AsioMigrationTransport<
+        boost::asio::local::stream_protocol>
+      {
+    private:
+      std::string OwnPath;
+    public:
+      LocalMigrationTransport(const unsigned int island,
+          const unsigned int nislands, const std::string &prefix)
+        {
+          using boost::asio::local::stream_protocol;
+          OwnPath = prefix + boost::lexical_cast<std::string>(island);
+          //remove the socket file from a previous run
+          std::remove(OwnPath.c_str());
+          Listen(stream_protocol::endpoint(OwnPath));
+          Next = stream_protocol::endpoint(prefix
+              + boost::lexical_cast<std::string>((island + 1) % nislands));
+        }
+      virtual ~LocalMigrationTransport()
+        {
+          Acceptor.reset();
+          std::remove(OwnPath.c_str());
+        }
+      };
+#endif
+
+    //! Periodically exchange the best members between several instances of a genetic algorithm
+    /*! Each island runs its own ParetoGA or AnnealingGA on a subpopulation, usually as a separate process.
+     * Every interval iterations each island sends up to nmigrants of its best models to the next
+     * island in the ring and replaces the last members of its own new population with the migrants
+     * it receives. The misfit of the migrants is sent along, so they do not have to be calculated again.
+     * A typical main loop looks like
+     * \code
+     * for (int i = 0; i < maxgen; ++i)
+     *   {
+     *     GA->DoIteration(i, i == (maxgen - 1));
+     *     if (i < maxgen - 1)
+     *       Migration.Migrate(*GA, i);
+     *   }
+     * \endcode
+     * All islands have to use the same interval and the same number of generations, as Migrate blocks
+     * until the exchange with the neighbouring islands is complete.
+     */
+    class IslandMigration
+      {
+    private:
+      boost::shared_ptr<GeneralMigrationTransport> Transport;
+      //! Migrate every interval iterations
+      int interval;
+      //! The maximum number of members we send
+      unsigned int nmigrants;
+    public:
+      //! Exchange migrants if iterationnumber is a migration iteration, returns the number of imported members
+      unsigned int Migrate(GeneralGA &GA, const int iterationnumber)
+        {
+          if (interval <= 0 || (iterationnumber + 1) % interval != 0)
+            return 0;
+          tMigrants Outgoing;
+          GA.GetMigrants(nmigrants, Outgoing.Genes, Outgoing.Values,
+              Outgoing.Fitness);
+          std::string incoming;
+          Transport->Exchange(SerializeMigrants(Outgoing), incoming);
+          tMigrants Incoming(DeserializeMigrants(incoming));
+          GA.ImportMigrants(Incoming.Genes, Incoming.Values, Incoming.Fitness);
+          return Incoming.Genes.size1();
+        }
+      IslandMigration(boost::shared_ptr<GeneralMigrationTransport> LocalTransport,
+          const int migrationinterval, const unsigned int migrants) :
+        Transport(LocalTransport), interval(migrationinterval), nmigrants(
+            migrants)
+        {
+        }
+      virtual ~IslandMigration()
+        {
+        }
+      };
+
+    //! Merge the unique population files written by PrintUniquePop on each island
+    /*! Each model is written only once to uniqueout and the models that are not dominated
+     * by any other model of all islands are written to frontout, both in the format of PrintUniquePop.
+     */
+    inline void MergeIslandUniquePop(const std::vector<std::string> &filenames,
+        std::ostream &uniqueout, std::ostream &frontout)
+      {
+        //PrintUniquePop separates the model values and the misfit by four blanks
+        const std::string separator = "    ";
+        UniquePop Merged;
+        std::vector<ttranscribed> Models;
+        std::vector<tfitvec> Fits;
+        for (size_t i = 0; i < filenames.size(); ++i)
+          {
+            std::ifstream infile(filenames.at(i).c_str());
+            if (!infile)
+              throw FatalException("File not found: " + filenames.at(i));
+            std::string line;
+            while (std::getline(infile, line))
+              {
+                const size_t seppos = line.find(separator);
+                if (seppos == std::string::npos)
+                  continue;
+                std::istringstream valuestream(line.substr(0, seppos));
+                std::istringstream fitstream(line.substr(seppos));
+                std::vector<double> values, fit;
+                double curr;
+                while (valuestream >> curr)
+                  values.push_back(curr);
+                while (fitstream >> curr)
+                  fit.push_back(curr);
+                ttranscribed Model(values.size());
+                std::copy(values.begin(), values.end(), Model.begin());
+                tfitvec Fit(fit.size());
+                std::copy(fit.begin(), fit.end(), Fit.begin());
+                if (Merged.Insert(Fit, Model))
+                  {
+                    Models.push_back(Model);
+                    Fits.push_back(Fit);
+                  }
+              }
+          }
+        Merged.PrintAll(uniqueout);
+        const size_t nmodels = Models.size();
+        frontout << std::setprecision(10);
+        for (size_t i = 0; i < nmodels; ++i)
+          {
+            bool isdominated = false;
+            for (size_t j = 0; j < nmodels && !isdominated; ++j)
+              isdominated = (Fits.at(j).size() == Fits.at(i).size())
+                  && dominates()(Fits.at(j), Fits.at(i));
+            if (!isdominated)
+              {
+                std::copy(Models.at(i).begin(), Models.at(i).end(),
+                    std::ostream_iterator<double>(frontout, " "));
+                frontout << separator;
+                std::copy(Fits.at(i).begin(), Fits.at(i).end(),
+                    std::ostream_iterator<double>(frontout, " "));
+                frontout << std::endl;
+              }
+          }
+      }
+  /* @} */
+  }
+#endif /*ISLANDMIGRATION_H_*/
@@ -0,0 +1,273 @@
+#ifndef MCMCSAMPLESTORE_H_
+#define MCMCSAMPLESTORE_H_
+#include "gentypes.h"
+#include "FatalException.h"
+#include <boost/cstdint.hpp>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! The magic string at the beginning of each binary sample file
+    static const char McmcSampleMagic[8] =
+      { 'G', 'P', 'M', 'C', 'M', 'C', 'S', '\0' };
+    //! The version of the binary sample format written by this code
+    static const boost::uint32_t McmcSampleVersion = 1;
+    //! Written as a native integer so we can detect files from machines with different byte order
+    static const boost::uint32_t McmcSampleByteOrder = 0x01020304;
+
+    //! The fixed size header of a binary sample file
+    struct McmcSampleHeader
+      {
+      char magic[8];
+      boost::uint32_t byteorder;
+      boost::uint32_t version;
+      boost::uint32_t nparams;
+      boost::uint32_t reserved;
+      };
+
+    //! Write samples of a Markov chain Monte Carlo run to a compact binary file
+    /*! After the header each sample is stored as a fixed size record: the index of the chain as a 32 bit integer,
+     * the energy (half the weighted misfit) and the model parameters as single precision floats. Single precision is
+     * sufficient for posterior statistics and halves the size of the file, so a run with ten million samples of a
+     * model with 40 parameters needs about 1.7 GB. The records are collected in a buffer and written in large blocks.
+     * The class is not thread safe, ParallelTempering serializes the calls to Append.
+     */
+    class McmcSampleWriter
+      {
+    private:
+      std::ofstream outfile;
+      std::vector<char> Buffer;
+      size_t nparams;
+      size_t buffered;
+      boost::uint64_t nsamples;
+      size_t RecordSize() const
+        {
+          return sizeof(boost::uint32_t) + (nparams + 1) * sizeof(float);
+        }
+    public:
+      //! Add a sample, the model has to have the number of parameters we specified in the constructor
+      void Append(const unsigned int chain, const double energy,
+          const ttranscribed &Model)
+        {
+          if (Model.size() != nparams)
+            throw FatalException("Model size does not match sample file !");
+          if (buffered + RecordSize() > Buffer.size())
+            Flush();
+          char *pos = &Buffer[buffered];
+          const boost::uint32_t index = chain;
+          std::memcpy(pos, &index, sizeof(index));
+          pos += sizeof(index);
+          const float value = energy;
+          std::memcpy(pos, &value, sizeof(value));
+          pos += sizeof(value);
+          for (size_t i = 0; i < nparams; ++i)
+            {
+              const float param = Model(i);
+              std::memcpy(pos, &param, sizeof(param));
+              pos += sizeof(param);
+            }
+          buffered += RecordSize();
+          ++nsamples;
+        }
+      //! Write all buffered samples to the file
+      void Flush()
+        {
+          if (buffered > 0)
+            outfile.write(&Buffer[0], buffered);
+          buffered = 0;
+          outfile.flush();
+          if (!outfile.good())
+            throw FatalException("Cannot write samples !");
+        }
+      //! The number of samples written so far
+      boost::uint64_t GetNSamples() const
+        {
+          return nsamples;
+        }
+      //! Create a new file for models with np parameters, buffersize is the size of the write buffer in bytes
+      McmcSampleWriter(const std::string &filename, const size_t np,
+          const size_t buffersize = 16 * 1024 * 1024) :
+        outfile(filename.c_str(), std::ios::binary | std::ios::trunc), nparams(
+            np), buffered(0), nsamples(0)
+        {
+          if (!outfile)
+            throw FatalException("Cannot open sample file: " + filename);
+          Buffer.resize(std::max(buffersize, RecordSize()));
+          McmcSampleHeader Header;
+          std::memcpy(Header.magic, McmcSampleMagic, sizeof(Header.magic));
+          Header.byteorder = McmcSampleByteOrder;
+          Header.version = McmcSampleVersion;
+          Header.nparams = nparams;
+          Header.reserved = 0;
+          outfile.write(reinterpret_cast<const char *> (&Header), sizeof(Header));
+        }
+      virtual ~McmcSampleWriter()
+        {
+          //we cannot throw in the destructor, so we only try to write the rest
+          if (buffered > 0 && outfile.good())
+            outfile.write(&Buffer[0], buffered);
+        }
+      };
+
+    //! Read the samples written by McmcSampleWriter one after the other
+    class McmcSampleReader
+      {
+    private:
+      std::ifstream infile;
+      size_t nparams;
+      std::vector<float> Record;
+    public:
+      //! The number of model parameters of each sample
+      size_t GetNParams() const
+        {
+          return nparams;
+        }
+      //! Read the next sample, returns false at the end of the file
+      bool Next(unsigned int &chain, double &energy, ttranscribed &Model)
+        {
+          boost::uint32_t index = 0;
+          infile.read(reinterpret_cast<char *> (&index), sizeof(index));
+          infile.read(reinterpret_cast<char *> (&Record[0]), Record.size()
+              * sizeof(float));
+          if (!infile.good())
+            return false;
+          chain = index;
+          energy = Record[0];
+          Model.resize(nparams, false);
+          for (size_t i = 0; i < nparams; ++i)
+            Model(i) = Record[i + 1];
+          return true;
+        }
+      explicit McmcSampleReader(const std::string &filename) :
+        infile(filename.c_str(), std::ios::binary), nparams(0)
+        {
+          McmcSampleHeader Header;
+          infile.read(reinterpret_cast<char *> (&Header), sizeof(Header));
+          if (!infile.good() || std::memcmp(Header.magic, McmcSampleMagic,
+              sizeof(Header.magic)) != 0)
+            throw FatalException("Not a valid sample file: " + filename);
+          if (Header.byteorder != McmcSampleByteOrder)
+            throw FatalException("Sample file has a different byte order: "
+                + filename);
+          if (Header.version != McmcSampleVersion)
+            throw FatalException("Unsupported version of sample file: "
+                + filename);
+          nparams = Header.nparams;
+          Record.resize(nparams + 1);
+        }
+      virtual ~McmcSampleReader()
+        {
+        }
+      };
+
+    //! Online mean, standard deviation and histogram of each parameter for a stream of samples
+    /*! The samples themselves are not stored, so the memory does not grow with the length of a run.
+     * The mean and standard deviation are updated with Welford's algorithm, the histograms divide the range
+     * between the minimum and maximum value of each parameter into equal bins. Parameters whose minimum and
+     * maximum are equal are fixed, we do not accumulate them.
+     */
+    class McmcStatistics
+      {
+    private:
+      const ttranscribed MinValues;
+      const ttranscribed MaxValues;
+      std::vector<std::vector<boost::uint64_t> > Histograms;
+      //! Running mean and sum of squared deviations of each parameter
+      std::vector<double> Mean;
+      std::vector<double> SumSquares;
+      boost::uint64_t nsamples;
+    public:
+      //! Add a sample to the statistics
+      void Add(const ttranscribed &Model)
+        {
+          if (Model.size() != MinValues.size())
+            throw FatalException("Model size does not match statistics !");
+          ++nsamples;
+          for (size_t i = 0; i < Model.size(); ++i)
+            {
+              if (MaxValues(i) <= MinValues(i))
+                continue;
+              const double value = Model(i);
+              const double delta = value - Mean.at(i);
+              Mean.at(i) += delta / nsamples;
+              SumSquares.at(i) += delta * (value - Mean.at(i));
+              std::vector<boost::uint64_t> &Hist = Histograms.at(i);
+              const double relative = (value - MinValues(i)) / (MaxValues(i)
+                  - MinValues(i));
+              const size_t bin = std::min(Hist.size() - 1, size_t(std::max(0.0,
+                  relative * Hist.size())));
+              ++Hist.at(bin);
+            }
+        }
+      //! The number of samples we have added so far
+      boost::uint64_t GetNSamples() const
+        {
+          return nsamples;
+        }
+      //! The mean of each parameter, fixed parameters have their minimum value
+      ttranscribed GetMean() const
+        {
+          ttranscribed Result(MinValues);
+          for (size_t i = 0; i < Result.size(); ++i)
+            if (MaxValues(i) > MinValues(i))
+              Result(i) = Mean.at(i);
+          return Result;
+        }
+      //! The standard deviation of each parameter
+      ttranscribed GetStdDev() const
+        {
+          ttranscribed Result(MinValues.size());
+          Result.clear();
+          for (size_t i = 0; i < Result.size() && nsamples > 1; ++i)
+            Result(i) = std::sqrt(SumSquares.at(i) / (nsamples - 1));
+          return Result;
+        }
+      //! The histogram of parameter index
+      const std::vector<boost::uint64_t> &GetHistogram(const size_t index) const
+        {
+          return Histograms.at(index);
+        }
+      //! Write the mean, standard deviation and histogram of each parameter to output, one line per parameter
+      /*! Each line contains the index of the parameter, the range, mean, standard deviation and the
+       * counts for each bin.
+       */
+      void Write(std::ostream &output) const
+        {
+          const ttranscribed MeanValues(GetMean()), StdDev(GetStdDev());
+          for (size_t i = 0; i < Histograms.size(); ++i)
+            {
+              output << i << " " << MinValues(i) << " " << MaxValues(i) << " "
+                  << MeanValues(i) << " " << StdDev(i);
+              for (size_t j = 0; j < Histograms.at(i).size(); ++j)
+                output << " " << Histograms.at(i).at(j);
+              output << "\n";
+            }
+          output.flush();
+        }
+      //! Min and Max define the range of the histograms for each parameter, each histogram has nbins bins
+      McmcStatistics(const ttranscribed &Min, const ttranscribed &Max,
+          const size_t nbins = 100) :
+        MinValues(Min), MaxValues(Max), Histograms(Min.size(), std::vector<
+            boost::uint64_t>(std::max<size_t>(nbins, 1), 0)), Mean(Min.size(),
+            0.0), SumSquares(Min.size(), 0.0), nsamples(0)
+        {
+          if (Min.size() != Max.size())
+            throw FatalException(
+                "Minimum and maximum values do not have equal length !");
+        }
+      virtual ~McmcStatistics()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*MCMCSAMPLESTORE_H_*/
@@ -0,0 +1,480 @@
+#ifndef NEIGHBOURHOODALGORITHM_H_
+#define NEIGHBOURHOODALGORITHM_H_
+
+#include "GeneralGA.h"
+#include "McmcSampleStore.h"
+#include "NumUtil.h"
+#include "FatalException.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/random/lagged_fibonacci.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! The neighbourhood algorithm for the search and appraisal of a parameter space (Sambridge, 1999)
+    /*! Each model we have evaluated so far defines a Voronoi cell, the region of the parameter space that is closer
+     * to this model than to any other model. In each iteration we choose the ncells models with the smallest summed misfit
+     * and create as many new models as the population has members by uniform random walks inside their cells. The walks only change
+     * one parameter at a time, so we need the interval of the axis through the current point that lies inside the cell.
+     * For this we keep the squared distance of the current point to all models and update it after each step along
+     * an axis, which makes each step proportional to the number of models instead of the number of models times the number of parameters.
+     * The walks for the different cells run in parallel. Distances are measured in the parameter space scaled by the range of each parameter.
+     *
+     * The parameter space is the grid of the transcription, @see GeneralTranscribe::GetMinValues and GeneralTranscribe::GetResolution,
+     * and we move each new model to the nearest grid point, so the models can be stored as genes in the population and identical
+     * models are calculated only once. Apart from that the population and the propagation are not used, the propagation can be a null pointer.
+     * As NeighbourhoodAlgorithm is derived from GeneralGA, the models are evaluated and cached in the same way and we have the same output
+     * functions. The first call to DoIteration creates uniformly distributed random models.
+     *
+     * After the search Appraise resamples the ensemble of all evaluated models without further calls to the objective functions.
+     */
+    class NeighbourhoodAlgorithm: public GeneralGA
+      {
+    private:
+      //! The number of cells we resample in each iteration
+      const unsigned int ncells;
+      //! The seed for the random numbers, the walks in each cell and iteration use a different seed derived from it
+      const unsigned int seed;
+      //! The smallest value of each parameter
+      const ttranscribed MinValues;
+      //! The range of each parameter
+      ttranscribed Range;
+      //! The spacing of the grid for each parameter
+      const ttranscribed Resolution;
+      //! The indices of the parameters that are not fixed
+      std::vector<size_t> Free;
+      //! The free parameters of all models we have evaluated, scaled to the unit cube, one model after the other
+      std::vector<double> Ensemble;
+      //! The summed misfit of each model in the ensemble
+      std::vector<double> EnsembleMisFit;
+      //! The indices of the ncells best models in the ensemble
+      std::vector<size_t> BestCells;
+      //! The indices of the members of the current iteration that are among the best models in the ensemble
+      std::vector<int> BestIndices;
+      boost::lagged_fibonacci607 Generator;
+      //! The coordinate of model index along the free axis axis
+      double Coordinate(const size_t index, const size_t axis) const
+        {
+          return Ensemble[index * Free.size() + axis];
+        }
+      //! The squared distances of Point to all models in the ensemble
+      std::vector<double> Distances(const std::vector<double> &Point) const
+        {
+          const size_t nmodels = EnsembleMisFit.size();
+          std::vector<double> Result(nmodels, 0.0);
+          for (size_t j = 0; j < nmodels; ++j)
+            for (size_t i = 0; i < Free.size(); ++i)
+              Result[j] += pow2(Point[i] - Coordinate(j, i));
+          return Result;
+        }
+      //! Move the current point along axis to value and update its squared distances to all models
+      void MovePoint(std::vector<double> &Point, const size_t axis,
+          const double value, std::vector<double> &Distance) const
+        {
+          for (size_t j = 0; j < Distance.size(); ++j)
+            {
+              const double coordinate = Coordinate(j, axis);
+              Distance[j] += pow2(value - coordinate) - pow2(Point[axis]
+                  - coordinate);
+            }
+          Point[axis] = value;
+        }
+      //! Calculate the interval of the axis through the current point that lies inside the cell of model cell
+      /*! Distance contains the squared distances of the current point, whose coordinate along axis is x, to all models.
+       * The distance of the axis to each model does not depend on where we are on the axis, so the boundary with
+       * each other cell follows from the two squared distances without looking at the other parameters.
+       * lowerneighbour and upperneighbour are the models whose cells adjoin the interval or -1 at the boundary of the parameter space.
+       */
+      void CellInterval(const size_t cell, const size_t axis, const double x,
+          const std::vector<double> &Distance, double &lower, double &upper,
+          long &lowerneighbour, long &upperneighbour) const
+        {
+          lower = 0.0;
+          upper = 1.0;
+          lowerneighbour = -1;
+          upperneighbour = -1;
+          const double vk = Coordinate(cell, axis);
+          const double pk = Distance[cell] - pow2(x - vk);
+          for (size_t j = 0; j < Distance.size(); ++j)
+            {
+              const double vj = Coordinate(j, axis);
+              if (vj == vk)
+                continue;
+              const double pj = Distance[j] - pow2(x - vj);
+              const double boundary = 0.5 * (vk + vj) + 0.5 * (pj - pk) / (vj
+                  - vk);
+              if (vj > vk)
+                {
+                  if (boundary < upper)
+                    {
+                      upper = boundary;
+                      upperneighbour = j;
+                    }
+                }
+              else if (boundary > lower)
+                {
+                  lower = boundary;
+                  lowerneighbour = j;
+                }
+            }
+          //rounding errors can make the interval empty when the point is very close to a boundary
+          if (upper < lower)
+            lower = upper = std::max(0.0, std::min(1.0, x));
+        }
+      //! Convert a point in the scaled parameter space to the nearest model on the grid of the transcription
+      ttranscribed ToModel(const std::vector<double> &Point) const
+        {
+          ttranscribed Model(MinValues);
+          for (size_t i = 0; i < Free.size(); ++i)
+            {
+              const size_t index = Free.at(i);
+              double offset = Point[i] * Range(index);
+              if (Resolution(index) > 0.0)
+                offset = std::min(Range(index), floor(offset / Resolution(index)
+                    + 0.5) * Resolution(index));
+              Model(index) += offset;
+            }
+          return Model;
+        }
+      //! Create nsamples models by a random walk inside the cell of model cell that starts at the model
+      void WalkCell(const size_t cell, const size_t nsamples,
+          boost::lagged_fibonacci607 &CellGenerator,
+          std::vector<ttranscribed> &Samples) const
+        {
+          const size_t ndim = Free.size();
+          std::vector<double> Point(Ensemble.begin() + cell * ndim,
+              Ensemble.begin() + (cell + 1) * ndim);
+          std::vector<double> Distance(Distances(Point));
+          double lower, upper;
+          long lowerneighbour, upperneighbour;
+          for (size_t s = 0; s < nsamples; ++s)
+            {
+              for (size_t axis = 0; axis < ndim; ++axis)
+                {
+                  CellInterval(cell, axis, Point[axis], Distance, lower, upper,
+                      lowerneighbour, upperneighbour);
+                  MovePoint(Point, axis, lower + boost::uniform_01<double>()(
+                      CellGenerator) * (upper - lower), Distance);
+                }
+              Samples.push_back(ToModel(Point));
+            }
+        }
+      //! Create popsize models with a uniform distribution in the parameter space
+      std::vector<ttranscribed> UniformSamples()
+        {
+          std::vector<ttranscribed> Samples;
+          std::vector<double> Point(Free.size());
+          for (int s = 0; s < Population->GetPopsize(); ++s)
+            {
+              for (size_t i = 0; i < Point.size(); ++i)
+                Point[i] = boost::uniform_01<double>()(Generator);
+              Samples.push_back(ToModel(Point));
+            }
+          return Samples;
+        }
+      //! Create popsize models by random walks in the best cells, the walks for different cells run in parallel
+      std::vector<ttranscribed> Resample(const int iterationnumber)
+        {
+          const int nchosen = BestCells.size();
+          const int popsize = Population->GetPopsize();
+          std::vector<std::vector<ttranscribed> > CellSamples(nchosen);
+#pragma omp parallel for default(shared) schedule(dynamic,1)
+          for (int r = 0; r < nchosen; ++r)
+            {
+              //the better cells get the remaining samples if popsize is not a multiple of the number of cells
+              const size_t nsamples = popsize / nchosen + (r < popsize % nchosen ? 1
+                  : 0);
+              boost::lagged_fibonacci607 CellGenerator(seed + 1
+                  + iterationnumber * ncells + r);
+              WalkCell(BestCells.at(r), nsamples, CellGenerator,
+                  CellSamples.at(r));
+            }
+          std::vector<ttranscribed> Samples;
+          for (int r = 0; r < nchosen; ++r)
+            Samples.insert(Samples.end(), CellSamples.at(r).begin(),
+                CellSamples.at(r).end());
+          return Samples;
+        }
+      //! Calculate the misfit of the new models and add them to the ensemble
+      void Evaluate(const int iterationnumber,
+          const std::vector<ttranscribed> &Samples)
+        {
+          const int popsize = Population->GetPopsize();
+          std::vector<char> IsNew(popsize, 0);
+          int newcount = 0;
+#pragma omp parallel for default(shared) schedule(dynamic,1) reduction(+:newcount)
+          for (int i = 0; i < popsize; ++i)
+            {
+              tfitvec Fitness(nobjective);
+              row(Transcribed, i) = Samples.at(i);
+              if (EvaluateModel(Samples.at(i), i, iterationnumber, Fitness))
+                {
+                  IsNew.at(i) = 1;
+                  ++newcount;
+                }
+              column(MisFit, i) = Fitness;
+            }
+            {
+              ScopedStageTimer Timer(GetProfiler(), GAProfiler::transcribe);
+              for (int i = 0; i < popsize; ++i)
+                Population->SetMember(i, Transcribe->GetMember(Samples.at(i)));
+            }
+          //models that we found in the history are already in the ensemble
+          const size_t ndim = Free.size();
+          for (int i = 0; i < popsize; ++i)
+            {
+              bool duplicate = !IsNew.at(i);
+              for (int j = 0; j < i && !duplicate; ++j)
+                duplicate = IsNew.at(j) && std::equal(Samples.at(i).begin(),
+                    Samples.at(i).end(), Samples.at(j).begin());
+              if (duplicate)
+                continue;
+              for (size_t k = 0; k < ndim; ++k)
+                {
+                  const size_t index = Free.at(k);
+                  Ensemble.push_back((Samples.at(i)(index) - MinValues(index))
+                      / Range(index));
+                }
+              EnsembleMisFit.push_back(ublas::sum(column(MisFit, i)));
+            }
+          cout << "New models: " << newcount << " Re-used models: " << popsize
+              - newcount << " Ensemble size: " << EnsembleMisFit.size() << endl;
+        }
+      //! Sort the ensemble by misfit and return the indices of the nbest best models
+      std::vector<size_t> RankEnsemble(const size_t nbest) const
+        {
+          std::vector<size_t> Indices(EnsembleMisFit.size());
+          for (size_t i = 0; i < Indices.size(); ++i)
+            Indices.at(i) = i;
+          const size_t nout = std::min(nbest, Indices.size());
+          std::partial_sort(Indices.begin(), Indices.begin() + nout,
+              Indices.end(), boost::bind(&NeighbourhoodAlgorithm::IsLower,
+                  this, _1, _2));
+          Indices.resize(nout);
+          return Indices;
+        }
+      bool IsLower(const size_t a, const size_t b) const
+        {
+          return EnsembleMisFit.at(a) < EnsembleMisFit.at(b);
+        }
+    public:
+      //! The number of models in the ensemble, i.e. all different models we have evaluated
+      size_t GetEnsembleSize() const
+        {
+          return EnsembleMisFit.size();
+        }
+      //! Search the parameter space in one iteration, the first iteration creates random models
+      void virtual DoIteration(const int iterationnumber, const bool last)
+        {
+          GAProfiler * const Prof = GetProfiler();
+          if (Prof)
+            Prof->StartGeneration(iterationnumber);
+          cout << endl << endl << "Iteration: " << iterationnumber + 1 << endl;
+          std::vector<ttranscribed> Samples;
+            {
+              ScopedStageTimer Timer(Prof, GAProfiler::propagation);
+              Samples = BestCells.empty() ? UniformSamples() : Resample(
+                  iterationnumber);
+            }
+          Evaluate(iterationnumber, Samples);
+            {
+              ScopedStageTimer Timer(Prof, GAProfiler::ranking);
+              CalcProbabilities(iterationnumber, MisFit, *Population);
+            }
+            {
+              ScopedStageTimer Timer(Prof, GAProfiler::statistics);
+              CalcStatistics();
+              UpdateRejectionFront();
+              LogGeneration(iterationnumber);
+            }
+          Population->StoreOldPopulation();
+          OldMisFit = MisFit;
+          if (Prof)
+            Prof->EndGeneration();
+        }
+      //! The number of members of the current iteration whose cells we resample in the next iteration
+      unsigned int virtual GetNBestmodels()
+        {
+          return BestIndices.size();
+        }
+      //! The indices of the members of the current iteration whose cells we resample, or of the best member if there are none
+      std::vector<int> virtual GetBestModelIndices()
+        {
+          return BestIndices;
+        }
+      //! Choose the cells for the next iteration, all members have the same probability as we do not use it for selection
+      void virtual CalcProbabilities(const int iterationnumber,
+          gplib::rmat &LocalMisFit, GeneralPopulation &LocalPopulation)
+        {
+          const int popsize = LocalPopulation.GetPopsize();
+          BestCells = RankEnsemble(ncells);
+          const double threshold = BestCells.empty() ? std::numeric_limits<
+              double>::infinity() : EnsembleMisFit.at(BestCells.back());
+          BestIndices.clear();
+          int best = 0;
+          for (int i = 0; i < popsize; ++i)
+            {
+              const double misfit = ublas::sum(column(LocalMisFit, i));
+              if (misfit <= threshold)
+                BestIndices.push_back(i);
+              if (misfit < ublas::sum(column(LocalMisFit, best)))
+                best = i;
+            }
+          if (BestIndices.empty())
+            BestIndices.push_back(best);
+          tprobabilityv Probabilities(popsize);
+          std::fill(Probabilities.begin(), Probabilities.end(), 1.0 / popsize);
+          LocalPopulation.SetProbabilities(Probabilities);
+        }
+      //! Resample the ensemble with the neighbourhood approximation of the posterior distribution (Sambridge, 1999b)
+      /*! The posterior is approximated by a constant exp(-misfit/temperature) inside the cell of each model, where misfit is
+       * the summed weighted misfit, so for a chi-squared misfit a temperature of 2 corresponds to a Gaussian likelihood.
+       * The objective functions are not called. Each of the nwalkers walks starts at one of the best models and
+       * does nsteps Gibbs steps, each of which changes all free parameters one after the other. Along each axis the
+       * approximate posterior is piecewise constant, we find the pieces by following the chain of adjoining cells from the current cell.
+       * After burnin steps each model is added to Statistics and, if given, to Writer with the energy misfit/temperature.
+       * The walks run in parallel.
+       */
+      void Appraise(McmcStatistics &Statistics, const unsigned int nwalkers,
+          const boost::uint64_t nsteps, const boost::uint64_t burnin,
+          const double temperature, boost::shared_ptr<McmcSampleWriter> Writer =
+              boost::shared_ptr<McmcSampleWriter>())
+        {
+          if (EnsembleMisFit.empty())
+            throw FatalException("No models for the appraisal !");
+          if (temperature <= 0.0)
+            throw FatalException("Temperature has to be positive !");
+          const size_t ndim = Free.size();
+          const size_t nmodels = EnsembleMisFit.size();
+          const std::vector<size_t> Start(RankEnsemble(nwalkers));
+          const double minmisfit = EnsembleMisFit.at(Start.front());
+          const int nwalks = nwalkers;
+#pragma omp parallel for default(shared) schedule(dynamic,1)
+          for (int w = 0; w < nwalks; ++w)
+            {
+              boost::lagged_fibonacci607 WalkGenerator(seed + 1 + w);
+              size_t cell = Start.at(w % Start.size());
+              std::vector<double> Point(Ensemble.begin() + cell * ndim,
+                  Ensemble.begin() + (cell + 1) * ndim);
+              std::vector<double> Distance(Distances(Point));
+              //the pieces along the current axis: end of each interval and its cell
+              std::vector<double> Ends, Cumulative;
+              std::vector<size_t> Cells;
+              double lower, upper;
+              long lowerneighbour, upperneighbour;
+              for (boost::uint64_t step = 0; step < nsteps; ++step)
+                {
+                  //the updates accumulate rounding errors, so we recalculate the distances from time to time
+                  if (step % 100 == 99)
+                    Distance = Distances(Point);
+                  for (size_t axis = 0; axis < ndim; ++axis)
+                    {
+                      const double x = Point[axis];
+                      CellInterval(cell, axis, x, Distance, lower, upper,
+                          lowerneighbour, upperneighbour);
+                      //walk to the lower end of the axis and then collect the pieces upwards
+                      size_t first = cell;
+                      double start = lower;
+                      for (size_t n = 0; lowerneighbour >= 0 && n < nmodels; ++n)
+                        {
+                          first = lowerneighbour;
+                          CellInterval(first, axis, x, Distance, start, upper,
+                              lowerneighbour, upperneighbour);
+                        }
+                      Ends.clear();
+                      Cumulative.clear();
+                      Cells.clear();
+                      size_t current = first;
+                      upperneighbour = 0;
+                      double total = 0.0;
+                      for (size_t n = 0; upperneighbour >= 0 && n < nmodels; ++n)
+                        {
+                          CellInterval(current, axis, x, Distance, lower, upper,
+                              lowerneighbour, upperneighbour);
+                          const double weight = std::max(0.0, upper - std::max(
+                              lower, start)) * std::exp(-(EnsembleMisFit.at(
+                              current) - minmisfit) / temperature);
+                          total += weight;
+                          Ends.push_back(upper);
+                          Cumulative.push_back(total);
+                          Cells.push_back(current);
+                          start = std::max(start, upper);
+                          if (upperneighbour >= 0)
+                            current = upperneighbour;
+                        }
+                      if (total <= 0.0)
+                        continue;
+                      //choose a piece with probability proportional to its weight and a uniform value inside it
+                      const double r = boost::uniform_01<double>()(WalkGenerator)
+                          * total;
+                      const size_t piece = std::min<size_t>(Cumulative.size() - 1,
+                          std::upper_bound(Cumulative.begin(), Cumulative.end(), r)
+                              - Cumulative.begin());
+                      const double pieceend = Ends.at(piece);
+                      const double piecestart = std::min(pieceend, piece > 0 ? Ends.at(piece
+                          - 1) : 0.0);
+                      cell = Cells.at(piece);
+                      MovePoint(Point, axis, piecestart + boost::uniform_01<
+                          double>()(WalkGenerator) * (pieceend - piecestart),
+                          Distance);
+                    }
+                  if (step < burnin)
+                    continue;
+                  //we record the continuous point, not the nearest point on the grid
+                  ttranscribed Model(MinValues);
+                  for (size_t i = 0; i < ndim; ++i)
+                    Model(Free.at(i)) += Point[i] * Range(Free.at(i));
+#pragma omp critical(naappraisal)
+                    {
+                      Statistics.Add(Model);
+                      if (Writer)
+                        Writer->Append(w, EnsembleMisFit.at(cell) / temperature,
+                            Model);
+                    }
+                }
+            }
+          if (Writer)
+            Writer->Flush();
+        }
+      //! In addition to the parameters of GeneralGA we need the number of cells we resample in each iteration
+      /*! The number of new models in each iteration is the size of the population, the transcription has to
+       * support GeneralTranscribe::GetMember and the functions for the parameter grid.
+       */
+      NeighbourhoodAlgorithm(GeneralPropagation* const LocalPropagation,
+          GeneralPopulation* const LocalPopulation,
+          GeneralTranscribe* const LocalTranscribe,
+          const tObjectiveVector &IndObjective, const unsigned int nresample,
+          const unsigned int localseed = 1, const int nthreads = 1) :
+        GeneralGA(LocalPropagation, LocalPopulation, LocalTranscribe,
+            IndObjective, nthreads), ncells(nresample), seed(localseed),
+            MinValues(LocalTranscribe->GetMinValues()), Range(
+                LocalTranscribe->GetMaxValues() - MinValues), Resolution(
+                LocalTranscribe->GetResolution()), Generator(localseed)
+        {
+          if (nresample == 0)
+            throw FatalException("We need at least one cell to resample !");
+          for (size_t i = 0; i < Range.size(); ++i)
+            if (Range(i) > 0.0)
+              Free.push_back(i);
+          if (Free.empty())
+            throw FatalException("No free parameters for the neighbourhood algorithm !");
+        }
+      virtual ~NeighbourhoodAlgorithm()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*NEIGHBOURHOODALGORITHM_H_*/
@@ -0,0 +1,443 @@
+#ifndef PARALLELTEMPERING_H_
+#define PARALLELTEMPERING_H_
+#include "GeneralObjective.h"
+#include "McmcSampleStore.h"
+#include "gentypes.h"
+#include "FatalException.h"
+#include <boost/shared_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/random/lagged_fibonacci.hpp>
+#include <boost/random/uniform_01.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <ostream>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! Sample the posterior distribution of models with parallel tempering Markov chain Monte Carlo
+    /*! The prior is uniform between a minimum and maximum value for each parameter and the likelihood is exp(-E),
+     * where the energy E is half the weighted sum of the misfit vectors of the objective functions (or of their
+     * return value if they do not provide a misfit vector). For a fit exponent of 2 this is the usual Gaussian likelihood.
+     * Similar to GeneralGA the objective functions can use different parts of the model vector, see SetParameterIndices.
+     *
+     * We run several chains, each at a temperature T that flattens the likelihood to exp(-E/T), and distribute
+     * them to the threads. Each step of a chain changes a single, randomly chosen parameter with a Gaussian proposal,
+     * proposals outside the prior range are reflected at the bounds. During the burn-in the width of the proposal is adapted
+     * separately for each chain and parameter so that about 44% of the proposals are accepted, afterwards it stays fixed
+     * so the chains satisfy detailed balance. Every swapinterval steps we propose to exchange the models of chains with neighbouring
+     * temperatures, so the hot chains that move freely between modes feed the chains at temperature 1.
+     * Only chains at temperature 1 sample the posterior, we add every thinning-th of their models to online histograms
+     * of each parameter and, if set, to a binary sample file (McmcSampleWriter), so we never keep samples in memory.
+     */
+    class ParallelTempering
+      {
+    public:
+      typedef std::vector<boost::shared_ptr<GeneralObjective> >
+          tObjectiveVector;
+      typedef std::vector<std::vector<int> > tparamindv;
+    private:
+      //! The state of a single Markov chain
+      struct Chain
+        {
+        //! Each chain has its own copy of the objective functions, so we can run the chains in parallel
+        tObjectiveVector Objectives;
+        boost::lagged_fibonacci607 Generator;
+        double temperature;
+        ttranscribed Model;
+        double energy;
+        //! The standard deviation of the proposal for each parameter
+        std::vector<double> StepSizes;
+        //! Number of proposals and accepted proposals for each parameter in the current adaptation batch
+        std::vector<unsigned int> BatchProposed;
+        std::vector<unsigned int> BatchAccepted;
+        //! The number of completed adaptation batches
+        unsigned int nbatches;
+        boost::uint64_t nsteps;
+        boost::uint64_t proposed;
+        boost::uint64_t accepted;
+        Chain(const tObjectiveVector &Obj, const double T, const unsigned int seed) :
+          Generator(seed), temperature(T), energy(0.0), nbatches(0), nsteps(0),
+              proposed(0), accepted(0)
+          {
+            for (size_t i = 0; i < Obj.size(); ++i)
+              Objectives.push_back(boost::shared_ptr<GeneralObjective>(
+                  Obj.at(i)->clone()));
+          }
+        double Uniform()
+          {
+            return boost::uniform_01<double>()(Generator);
+          }
+        double Normal()
+          {
+            return boost::normal_distribution<double>(0.0, 1.0)(Generator);
+          }
+        };
+      //! Sort the indices of the chains by temperature
+      struct LadderOrder
+        {
+        const std::vector<double> &T;
+        LadderOrder(const std::vector<double> &Temp) :
+          T(Temp)
+          {
+          }
+        bool operator()(const size_t a, const size_t b) const
+          {
+            return T.at(a) < T.at(b);
+          }
+        };
+      //! The number of proposals for each parameter before we adapt its step size
+      static const unsigned int batchlength = 50;
+      tObjectiveVector Objectives;
+      tparamindv ParameterIndices;
+      std::vector<double> Weights;
+      const ttranscribed MinValues;
+      const ttranscribed MaxValues;
+      //! The parameters that are not fixed by the prior range
+      std::vector<size_t> Free;
+      std::vector<Chain> Chains;
+      //! The number of steps of each chain during which we adapt the step sizes and do not sample
+      boost::uint64_t burnin;
+      //! We propose swaps after this number of steps of each chain
+      unsigned int swapinterval;
+      //! We sample every thinning-th step of the chains at temperature 1
+      unsigned int thinning;
+      //! Number of proposed and accepted swaps between each pair of neighbouring temperatures
+      std::vector<boost::uint64_t> SwapsProposed;
+      std::vector<boost::uint64_t> SwapsAccepted;
+      //! The indices of the chains sorted by temperature
+      std::vector<size_t> Ladder;
+      //! Random numbers for the swaps
+      boost::lagged_fibonacci607 SwapGenerator;
+      //! The histogram, mean and standard deviation of each parameter within its prior range
+      McmcStatistics Statistics;
+      boost::shared_ptr<McmcSampleWriter> Writer;
+      bool initialized;
+      //! Calculate the energy of Model with the objective functions of chain C
+      double CalcEnergy(Chain &C, const ttranscribed &Model,
+          const std::string &ID)
+        {
+          double energy = 0.0;
+          for (size_t j = 0; j < C.Objectives.size(); ++j)
+            {
+              if (Weights.at(j) == 0.0)
+                continue;
+              ttranscribed Params(Model);
+              if (!ParameterIndices.empty())
+                {
+                  Params.resize(ParameterIndices.at(j).size(), false);
+                  for (size_t k = 0; k < ParameterIndices.at(j).size(); ++k)
+                    Params(k) = Model(ParameterIndices.at(j).at(k));
+                }
+              GeneralObjective &Obj = *C.Objectives.at(j);
+              Obj.SetParallelID(ID);
+              double value = 0.0;
+              //the same division into serial and parallel parts as in GeneralGA
+#pragma omp critical
+                {
+                  Obj.PreParallel(Params);
+                }
+              Obj.SafeParallel(Params);
+#pragma omp critical
+                {
+                  value = Obj.PostParallel(Params);
+                }
+              const tmisfit &Misfit = Obj.GetMisfit();
+              energy += Weights.at(j) * (Misfit.empty() ? value : ublas::sum(
+                  Misfit));
+            }
+          return energy / 2.0;
+        }
+      //! Add the model of a chain at temperature 1 to the statistics and the sample file
+      void Record(const size_t chainindex)
+        {
+          const Chain &C = Chains.at(chainindex);
+          Statistics.Add(C.Model);
+          if (Writer)
+            Writer->Append(chainindex, C.energy, C.Model);
+        }
+      //! Do nsteps Metropolis steps with chain chainindex
+      void Advance(const size_t chainindex, const unsigned int nsteps)
+        {
+          Chain &C = Chains.at(chainindex);
+          std::ostringstream ID;
+          ID << "mcmc" << chainindex;
+          for (unsigned int step = 0; step < nsteps; ++step)
+            {
+              const size_t freeindex = std::min(Free.size() - 1, size_t(
+                  C.Uniform() * Free.size()));
+              const size_t index = Free.at(freeindex);
+              const double low = MinValues(index);
+              const double high = MaxValues(index);
+              double value = C.Model(index) + C.StepSizes.at(freeindex)
+                  * C.Normal();
+              //reflection keeps the proposal symmetric
+              while (value < low || value > high)
+                value = (value < low) ? 2.0 * low - value : 2.0 * high - value;
+              ttranscribed Trial(C.Model);
+              Trial(index) = value;
+              const double trialenergy = CalcEnergy(C, Trial, ID.str());
+              ++C.proposed;
+              ++C.BatchProposed.at(freeindex);
+              if (std::log(C.Uniform()) < -(trialenergy - C.energy)
+                  / C.temperature)
+                {
+                  C.Model = Trial;
+                  C.energy = trialenergy;
+                  ++C.accepted;
+                  ++C.BatchAccepted.at(freeindex);
+                }
+              ++C.nsteps;
+              if (C.nsteps <= burnin)
+                {
+                  if (C.BatchProposed.at(freeindex) == batchlength)
+                    Adapt(C, freeindex);
+                }
+              else if (C.temperature == 1.0 && (C.nsteps - burnin) % thinning
+                  == 0)
+                {
+#pragma omp critical(mcmcrecord)
+                    {
+                      Record(chainindex);
+                    }
+                }
+            }
+        }
+      //! Change the step size of parameter freeindex towards an acceptance rate of 0.44
+      void Adapt(Chain &C, const size_t freeindex)
+        {
+          const size_t index = Free.at(freeindex);
+          const double rate = double(C.BatchAccepted.at(freeindex))
+              / C.BatchProposed.at(freeindex);
+          ++C.nbatches;
+          //the adaptation gets smaller with time (Roberts and Rosenthal, 2009)
+          const double delta = std::min(0.5, 1.0 / std::sqrt(double(C.nbatches)));
+          const double range = MaxValues(index) - MinValues(index);
+          double &step = C.StepSizes.at(freeindex);
+          step *= std::exp(rate > 0.44 ? delta : -delta);
+          step = std::max(1e-6 * range, std::min(range, step));
+          C.BatchProposed.at(freeindex) = 0;
+          C.BatchAccepted.at(freeindex) = 0;
+        }
+      //! Propose to swap the models of chains with neighbouring temperatures
+      void Swap()
+        {
+          for (size_t i = 0; i + 1 < Ladder.size(); ++i)
+            {
+              Chain &Cold = Chains.at(Ladder.at(i));
+              Chain &Hot = Chains.at(Ladder.at(i + 1));
+              if (Cold.temperature == Hot.temperature)
+                continue;
+              ++SwapsProposed.at(i);
+              const double logratio = (1.0 / Cold.temperature - 1.0
+                  / Hot.temperature) * (Cold.energy - Hot.energy);
+              if (std::log(boost::uniform_01<double>()(SwapGenerator))
+                  < logratio)
+                {
+                  std::swap(Cold.Model, Hot.Model);
+                  std::swap(Cold.energy, Hot.energy);
+                  ++SwapsAccepted.at(i);
+                }
+            }
+        }
+      //! Calculate the initial energies of all chains
+      void Initialize()
+        {
+          const int nchains = Chains.size();
+#pragma omp parallel for default(shared) schedule(dynamic,1)
+          for (int i = 0; i < nchains; ++i)
+            {
+              std::ostringstream ID;
+              ID << "mcmc" << i;
+              Chains.at(i).energy = CalcEnergy(Chains.at(i), Chains.at(i).Model,
+                  ID.str());
+            }
+          initialized = true;
+        }
+    public:
+      //! Set the weight for each objective function, the default is 1 for all
+      void SetWeights(const std::vector<double> &LocalWeights)
+        {
+          if (LocalWeights.size() != Objectives.size())
+            throw FatalException(
+                "Number of weights does not match number of objective functions !");
+          Weights = LocalWeights;
+        }
+      //! Configure which parts of the model vector each objective function uses, by default they get the whole vector
+      void SetParameterIndices(const tparamindv &Indices)
+        {
+          if (Indices.size() != Objectives.size())
+            throw FatalException(
+                "Number of parameter indices does not match number of objective functions !");
+          ParameterIndices = Indices;
+        }
+      //! Set the number of steps of each chain used for the adaptation of the step sizes, these steps are not sampled
+      void SetBurnIn(const boost::uint64_t nsteps)
+        {
+          burnin = nsteps;
+        }
+      //! Set the number of steps of each chain between the proposals to swap chains
+      void SetSwapInterval(const unsigned int nsteps)
+        {
+          swapinterval = std::max(1u, nsteps);
+        }
+      //! We sample every n-th step of the chains at temperature 1
+      void SetThinning(const unsigned int n)
+        {
+          thinning = std::max(1u, n);
+        }
+      //! Write all samples to a binary file, pass an empty pointer to switch this off
+      void SetSampleWriter(boost::shared_ptr<McmcSampleWriter> W)
+        {
+          Writer = W;
+        }
+      //! Set the same start model for all chains, by default each chain starts with a random model from the prior
+      void SetStartModel(const ttranscribed &Model)
+        {
+          if (Model.size() != MinValues.size())
+            throw FatalException("Start model has the wrong number of parameters !");
+          for (size_t i = 0; i < Model.size(); ++i)
+            if (Model(i) < MinValues(i) || Model(i) > MaxValues(i))
+              throw FatalException("Start model is outside the prior range !");
+          for (size_t i = 0; i < Chains.size(); ++i)
+            Chains.at(i).Model = Model;
+          initialized = false;
+        }
+      //! Run each chain for nsteps steps, we can call this several times to continue the chains
+      void Run(const boost::uint64_t nsteps)
+        {
+          if (!initialized)
+            Initialize();
+          boost::uint64_t done = 0;
+          while (done < nsteps)
+            {
+              const unsigned int block = std::min<boost::uint64_t>(swapinterval,
+                  nsteps - done);
+              const int nchains = Chains.size();
+#pragma omp parallel for default(shared) schedule(dynamic,1)
+              for (int i = 0; i < nchains; ++i)
+                Advance(i, block);
+              Swap();
+              done += block;
+            }
+          if (Writer)
+            Writer->Flush();
+        }
+      //! The number of samples we have added to the statistics so far
+      boost::uint64_t GetNSamples() const
+        {
+          return Statistics.GetNSamples();
+        }
+      //! The posterior mean of each parameter
+      ttranscribed GetMean() const
+        {
+          return Statistics.GetMean();
+        }
+      //! The posterior standard deviation of each parameter
+      ttranscribed GetStdDev() const
+        {
+          return Statistics.GetStdDev();
+        }
+      //! The histogram of parameter index, the bins divide the prior range into equal intervals
+      const std::vector<boost::uint64_t> &GetHistogram(const size_t index) const
+        {
+          return Statistics.GetHistogram(index);
+        }
+      //! The fraction of accepted proposals for each chain, in the order of the temperatures given to the constructor
+      std::vector<double> GetAcceptanceRates() const
+        {
+          std::vector<double> Result;
+          for (size_t i = 0; i < Chains.size(); ++i)
+            Result.push_back(Chains.at(i).proposed > 0 ? double(
+                Chains.at(i).accepted) / Chains.at(i).proposed : 0.0);
+          return Result;
+        }
+      //! The fraction of accepted swaps between neighbouring temperatures, starting with the coldest pair
+      std::vector<double> GetSwapRates() const
+        {
+          std::vector<double> Result;
+          for (size_t i = 0; i < SwapsProposed.size(); ++i)
+            Result.push_back(SwapsProposed.at(i) > 0 ? double(SwapsAccepted.at(i))
+                / SwapsProposed.at(i) : 0.0);
+          return Result;
+        }
+      //! Write the mean, standard deviation and histogram of each parameter to output, one line per parameter
+      /*! Each line contains the index of the parameter, the prior range, mean, standard deviation and the
+       * counts for each bin.
+       */
+      void WriteHistograms(std::ostream &output) const
+        {
+          Statistics.Write(output);
+        }
+      //! The objective functions are copied for each chain, Min and Max define the uniform prior
+      /*! @param Obj The objective functions, the energy is half their weighted misfit
+       * @param Min The minimum value of each parameter
+       * @param Max The maximum value of each parameter, parameters with Max equal to Min are fixed
+       * @param Temperatures The temperature of each chain, we need at least one chain with temperature 1
+       * @param nbins The number of bins of the histograms for each parameter
+       * @param seed The seed for the random number generators, each chain uses seed plus its index
+       */
+      ParallelTempering(const tObjectiveVector &Obj, const ttranscribed &Min,
+          const ttranscribed &Max, const std::vector<double> &Temperatures,
+          const size_t nbins = 100, const unsigned int seed = 1) :
+        Objectives(Obj), Weights(Obj.size(), 1.0), MinValues(Min),
+            MaxValues(Max), burnin(10000), swapinterval(10), thinning(10),
+            SwapGenerator(seed + Temperatures.size()), Statistics(Min, Max,
+                nbins), initialized(false)
+        {
+          if (Min.size() != Max.size())
+            throw FatalException(
+                "Minimum and maximum values do not have equal length !");
+          if (Obj.empty())
+            throw FatalException("No objective functions for sampling !");
+          if (std::find(Temperatures.begin(), Temperatures.end(), 1.0)
+              == Temperatures.end())
+            throw FatalException("We need at least one chain at temperature 1 !");
+          for (size_t i = 0; i < Min.size(); ++i)
+            {
+              if (Max(i) < Min(i))
+                throw FatalException("Maximum value is smaller than minimum !");
+              if (Max(i) > Min(i))
+                Free.push_back(i);
+            }
+          if (Free.empty())
+            throw FatalException("No free parameters for sampling !");
+          for (size_t i = 0; i < Temperatures.size(); ++i)
+            {
+              if (Temperatures.at(i) < 1.0)
+                throw FatalException("Temperatures have to be at least 1 !");
+              Chains.push_back(Chain(Obj, Temperatures.at(i), seed + i));
+              Chain &C = Chains.back();
+              C.Model = Min;
+              for (size_t j = 0; j < Free.size(); ++j)
+                {
+                  const double range = Max(Free.at(j)) - Min(Free.at(j));
+                  C.Model(Free.at(j)) += C.Uniform() * range;
+                  C.StepSizes.push_back(0.1 * range);
+                }
+              C.BatchProposed.assign(Free.size(), 0);
+              C.BatchAccepted.assign(Free.size(), 0);
+              Ladder.push_back(i);
+            }
+          std::stable_sort(Ladder.begin(), Ladder.end(), LadderOrder(
+              Temperatures));
+          SwapsProposed.assign(Ladder.size() - 1, 0);
+          SwapsAccepted.assign(Ladder.size() - 1, 0);
+        }
+      virtual ~ParallelTempering()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*PARALLELTEMPERING_H_*/
@@ -145,7 +145,31 @@ public:
         Population->SetPopulation(Newpopulation);
       }
 
-    void ParetoGA::PrintRanks(std::ostream &output)
+      //! For the local refinement a model is only better if it dominates the other model
+      bool virtual IsBetter(const tfitvec &Fitness1, const tfitvec &Fitness2)
+        {
+          return dominates()(Fitness1, Fitness2);
+        }
+      //! We refine the members of the current Pareto front, ordered by their summed misfit
+      std::vector<int> virtual GetRefinementCandidates()
+        {
+          const std::vector<int> Sorted(GeneralGA::GetRefinementCandidates());
+          std::vector<int> Result;
+          for (size_t i = 0; i < Sorted.size(); ++i)
+            {
+              bool dominated = false;
+              for (size_t j = 0; j < Sorted.size() && !dominated; ++j)
+                dominated = dominates()(ublas::column(MisFit, Sorted.at(j)),
+                    ublas::column(MisFit, Sorted.at(i)));
+              if (!dominated)
+                Result.push_back(Sorted.at(i));
+            }
+          return Result;
+        }
+
+    public:
+      //! Write the population by ranks to the stream output
+      void PrintRanks(std::ostream &output)
       {
         const unsigned int nobj = MisFit.size1();
         const unsigned int nranks = Ranks.size();
@@ -162,8 +186,6 @@ public:
           }
         output << endl;
       }
-
-    public:
       //! Return the size of the pareto-optimal front
       unsigned int virtual GetNBestmodels()
         {
@@ -247,8 +269,6 @@ public:
 
         CalcCrowdingDistance(LocalMisFit, LocalPopulation);
       }
-      //! Write the population by ranks to the stream output
-      void PrintRanks(std::ostream &output);
       //! Write the models in the pareto-optimal front to stream output
       void PrintFront(std::ostream &output)
       {
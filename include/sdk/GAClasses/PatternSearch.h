@@ -0,0 +1,172 @@
+#ifndef PATTERNSEARCH_H_
+#define PATTERNSEARCH_H_
+#include "gentypes.h"
+#include "FatalException.h"
+#include <boost/function.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! A derivative free local optimizer that searches on the grid of values a genetic algorithm can encode
+    /*! PatternSearch implements the pattern search by Hooke and Jeeves for bounded parameters.
+     * We only evaluate models whose parameters are the minimum value plus a multiple of the resolution,
+     * so every model we find can be written back into a population without loss, see GeneralTranscribe::GetMember.
+     * The exploratory moves start with a step of a fraction of the range of each parameter, this step
+     * is halved each time the exploration fails until it reaches the resolution. Which of two fitness vectors is
+     * better is decided by a function object, so we can use it for single and multi-objective problems.
+     */
+    class PatternSearch
+      {
+    public:
+      //! The function that calculates the fitness of a model
+      typedef boost::function<tfitvec(const ttranscribed &)> tEvaluator;
+      //! Returns true if the first fitness vector is better than the second
+      typedef boost::function<bool(const tfitvec &, const tfitvec &)>
+          tComparison;
+    private:
+      typedef std::vector<long> tlevels;
+      //! The smallest value for each parameter
+      const ttranscribed MinValues;
+      //! The spacing of the grid for each parameter
+      const ttranscribed Resolution;
+      //! The number of grid points for each parameter
+      tlevels NLevels;
+      //! The initial step as a fraction of the range of each parameter
+      double initialstep;
+      //! The maximum number of evaluations for each call to Minimize
+      unsigned int maxevaluations;
+      //! The number of evaluations in the current call to Minimize
+      unsigned int nevaluations;
+      ttranscribed ToValues(const tlevels &Levels) const
+        {
+          ttranscribed Result(Levels.size());
+          for (size_t i = 0; i < Levels.size(); ++i)
+            Result(i) = MinValues(i) + Levels.at(i) * Resolution(i);
+          return Result;
+        }
+      tfitvec Evaluate(const tlevels &Levels, tEvaluator &Evaluator)
+        {
+          ++nevaluations;
+          return Evaluator(ToValues(Levels));
+        }
+      //! Try a step up and down for each parameter from Levels and keep each step that improves the fitness
+      void Explore(tlevels &Levels, tfitvec &Fitness, const tlevels &Steps,
+          tEvaluator &Evaluator, tComparison &Better)
+        {
+          for (size_t i = 0; i < Levels.size(); ++i)
+            {
+              const long start = Levels.at(i);
+              for (int direction = 1; direction >= -1; direction -= 2)
+                {
+                  if (nevaluations >= maxevaluations)
+                    return;
+                  const long trial = std::max(0L, std::min(NLevels.at(i) - 1,
+                      start + direction * Steps.at(i)));
+                  if (trial == start)
+                    continue;
+                  Levels.at(i) = trial;
+                  const tfitvec TrialFitness(Evaluate(Levels, Evaluator));
+                  if (Better(TrialFitness, Fitness))
+                    {
+                      Fitness = TrialFitness;
+                      break;
+                    }
+                  Levels.at(i) = start;
+                }
+            }
+        }
+    public:
+      //! Set the first step of the exploration as a fraction of the range of each parameter, the default is 0.125
+      void SetInitialStep(const double fraction)
+        {
+          initialstep = fraction;
+        }
+      //! Set the maximum number of evaluations for each call to Minimize
+      void SetMaxEvaluations(const unsigned int n)
+        {
+          maxevaluations = n;
+        }
+      //! Improve Model with the fitness Fitness in place, returns the number of times we called Evaluator
+      /*! Model is moved to the closest grid point first, Fitness has to be the fitness of that point.
+       */
+      unsigned int Minimize(ttranscribed &Model, tfitvec &Fitness,
+          tEvaluator Evaluator, tComparison Better)
+        {
+          const size_t nparams = NLevels.size();
+          if (Model.size() != nparams)
+            throw FatalException(
+                "Model size does not match pattern search parameters !");
+          nevaluations = 0;
+          tlevels Base(nparams), Steps(nparams, 1);
+          for (size_t i = 0; i < nparams; ++i)
+            {
+              const long maxlevel = NLevels.at(i) - 1;
+              const long level = (maxlevel > 0) ? long(floor((Model(i)
+                  - MinValues(i)) / Resolution(i) + 0.5)) : 0;
+              Base.at(i) = std::max(0L, std::min(maxlevel, level));
+              Steps.at(i) = std::max(1L, long(initialstep * maxlevel));
+            }
+          tfitvec BaseFitness(Fitness);
+          while (nevaluations < maxevaluations)
+            {
+              tlevels Current(Base);
+              tfitvec CurrentFitness(BaseFitness);
+              Explore(Current, CurrentFitness, Steps, Evaluator, Better);
+              if (Current == Base)
+                {
+                  //we are at a local minimum on the finest grid
+                  if (*std::max_element(Steps.begin(), Steps.end()) == 1)
+                    break;
+                  for (size_t i = 0; i < nparams; ++i)
+                    Steps.at(i) = std::max(1L, Steps.at(i) / 2);
+                  continue;
+                }
+              //as long as the exploration succeeds we extrapolate along the direction of the last improvement
+              while (Current != Base)
+                {
+                  tlevels Pattern(Current);
+                  for (size_t i = 0; i < nparams; ++i)
+                    Pattern.at(i) = std::max(0L, std::min(NLevels.at(i) - 1, 2
+                        * Current.at(i) - Base.at(i)));
+                  Base = Current;
+                  BaseFitness = CurrentFitness;
+                  if (nevaluations >= maxevaluations || Pattern == Current)
+                    break;
+                  tfitvec PatternFitness(Evaluate(Pattern, Evaluator));
+                  Explore(Pattern, PatternFitness, Steps, Evaluator, Better);
+                  if (Better(PatternFitness, BaseFitness))
+                    {
+                      Current = Pattern;
+                      CurrentFitness = PatternFitness;
+                    }
+                }
+            }
+          Model = ToValues(Base);
+          Fitness = BaseFitness;
+          return nevaluations;
+        }
+      //! The grid is given by the minimum and maximum value and the resolution of each parameter
+      PatternSearch(const ttranscribed &Min, const ttranscribed &Max,
+          const ttranscribed &Res) :
+        MinValues(Min), Resolution(Res), NLevels(Min.size(), 1),
+            initialstep(0.125), maxevaluations(100), nevaluations(0)
+        {
+          if (Max.size() != Min.size() || Res.size() != Min.size())
+            throw FatalException(
+                "Minimum, maximum and resolution do not have equal length !");
+          for (size_t i = 0; i < Min.size(); ++i)
+            if (Res(i) > 0.0 && Max(i) > Min(i))
+              NLevels.at(i) = long(floor((Max(i) - Min(i)) / Res(i) + 0.5)) + 1;
+        }
+      virtual ~PatternSearch()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*PATTERNSEARCH_H_*/
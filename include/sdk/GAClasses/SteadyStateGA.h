@@ -0,0 +1,274 @@
+#ifndef STEADYSTATEGA_H_
+#define STEADYSTATEGA_H_
+
+#include "GeneralGA.h"
+#include "ParetoGA.h"
+#include "GeneralRNG.h"
+#include "FatalException.h"
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <iostream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace gplib
+  {
+    /** \addtogroup gainv Genetic algorithm optimization */
+    /* @{ */
+
+    //! An asynchronous steady state genetic algorithm for objective functions with very different costs
+    /*! In the generational algorithms all members of a generation have to be evaluated before
+     * we can create the next generation, so when the calculation time varies strongly between models, e.g.
+     * because of external forward codes, most threads wait for the slowest model at the end of each generation.
+     * SteadyStateGA does not have generations, instead each thread works on a queue of children: as soon as a thread has
+     * calculated the misfit of a child, the child competes for a place in the population and the thread breeds and evaluates
+     * the next child from the current population. The population is ranked by the number of members that dominate each member
+     * (Fonseca and Fleming, 1993), which we can update incrementally for each new member, so for a single objective function
+     * this corresponds to the usual ranking by misfit. A child replaces the worst member of the population if it has a better
+     * rank, ties are decided by the summed misfit. Parents are chosen by binary tournaments with the same criterion.
+     *
+     * To work with the existing programs one call to DoIteration creates and evaluates as many children as there are population
+     * members, this is the only point where the threads synchronize, the first call only evaluates the initial population.
+     * The population and propagation objects are only used for storage and for crossover and mutation, we do not call
+     * GeneralPropagation::NextGeneration.
+     */
+    class SteadyStateGA: public GeneralGA
+      {
+    private:
+      //! The random number generator for the selection of parents
+      GeneralRNG &Random;
+      //! For each member the number of members that dominate it
+      std::vector<int> DominationCount;
+      //! Children that have been bred but not evaluated yet, crossover always creates two children
+      std::deque<tpopmember> Pending;
+      //! Has the initial population been evaluated
+      bool initialized;
+      //! Is a member with domination count count1 and summed misfit sum1 better than a member with count2 and sum2
+      static bool IsFitter(const int count1, const double sum1, const int count2,
+          const double sum2)
+        {
+          return count1 < count2 || (count1 == count2 && sum1 < sum2);
+        }
+      //! Select a parent by binary tournament
+      int SelectParent()
+        {
+          const int popsize = Population->GetPopsize();
+          const int first = Random.GetNumber(popsize);
+          const int second = Random.GetNumber(popsize);
+          return IsFitter(DominationCount.at(second), ublas::sum(column(MisFit,
+              second)), DominationCount.at(first), ublas::sum(column(MisFit,
+              first))) ? second : first;
+        }
+      //! Create the next child that we want to evaluate, this has to be called in a critical section
+      tpopmember NextChild()
+        {
+          if (Pending.empty())
+            {
+              tpopmember Father(row(Population->GetPopulation(), SelectParent()));
+              tpopmember Mother(row(Population->GetPopulation(), SelectParent()));
+              Propagation->Recombine(Father, Mother);
+              Pending.push_back(Father);
+              Pending.push_back(Mother);
+            }
+          tpopmember Child(Pending.front());
+          Pending.pop_front();
+          return Child;
+        }
+      //! Let an evaluated child compete with the worst member of the population, this has to be called in a critical section
+      /*! Returns true if the child has replaced a member.
+       */
+      bool Insert(const tpopmember &Child, const ttranscribed &Model,
+          const tfitvec &Fitness)
+        {
+          const int popsize = Population->GetPopsize();
+          //we do not want several copies of the same model in the population
+          for (int i = 0; i < popsize; ++i)
+            if (std::equal(Model.begin(), Model.end(), row(Transcribed, i).begin()))
+              return false;
+          int childcount = 0;
+          int worst = 0;
+          for (int i = 0; i < popsize; ++i)
+            {
+              if (dominates()(column(MisFit, i), Fitness))
+                ++childcount;
+              if (IsFitter(DominationCount.at(worst), ublas::sum(column(MisFit,
+                  worst)), DominationCount.at(i), ublas::sum(column(MisFit, i))))
+                worst = i;
+            }
+          if (!IsFitter(childcount, ublas::sum(Fitness),
+              DominationCount.at(worst), ublas::sum(column(MisFit, worst))))
+            return false;
+          //update the ranks of the other members for the removal of the worst member and the addition of the child
+          for (int i = 0; i < popsize; ++i)
+            {
+              if (i == worst)
+                continue;
+              if (dominates()(column(MisFit, worst), column(MisFit, i)))
+                --DominationCount.at(i);
+              if (dominates()(Fitness, column(MisFit, i)))
+                ++DominationCount.at(i);
+            }
+          //the worst member cannot dominate the child, otherwise the child would have a worse rank
+          DominationCount.at(worst) = childcount;
+          Population->SetMember(worst, Child);
+          row(Transcribed, worst) = Model;
+          column(MisFit, worst) = Fitness;
+          return true;
+        }
+      //! Evaluate the initial population, the members are distributed dynamically to the threads
+      void EvaluatePopulation(const int iterationnumber)
+        {
+          GAProfiler * const Prof = GetProfiler();
+          const int popsize = Population->GetPopsize();
+          int newcount = 0;
+#pragma omp parallel for default(shared) schedule(dynamic,1) reduction(+:newcount)
+          for (int i = 0; i < popsize; ++i)
+            {
+              tfitvec Fitness(nobjective);
+                {
+                  ScopedStageTimer Timer(Prof, GAProfiler::transcribe);
+                  row(Transcribed, i) = Transcribe->GetValues(row(
+                      Population->GetPopulation(), i));
+                }
+              if (EvaluateModel(row(Transcribed, i), i, iterationnumber, Fitness))
+                ++newcount;
+              column(MisFit, i) = Fitness;
+            }
+          CalcProbabilities(iterationnumber, MisFit, *Population);
+          cout << "New models: " << newcount << " Re-used models: " << popsize
+              - newcount << endl;
+        }
+    public:
+      //! Create, evaluate and insert nchildren children, the threads only synchronize at the end
+      void Evolve(const int iterationnumber, const int nchildren)
+        {
+          GAProfiler * const Prof = GetProfiler();
+          //the identifiers for the objective functions have to be different from the ones of the initial population
+          const int firstid = Population->GetPopsize();
+          int dispatched = 0;
+          int newcount = 0;
+          int inserted = 0;
+#pragma omp parallel default(shared) reduction(+:newcount)
+            {
+              while (true)
+                {
+                  bool finished = false;
+                  int id = 0;
+                  tpopmember Child;
+#pragma omp critical(steadystate)
+                    {
+                      if (dispatched < nchildren)
+                        {
+                          id = firstid + dispatched;
+                          ++dispatched;
+                          Child = NextChild();
+                        }
+                      else
+                        finished = true;
+                    }
+                  if (finished)
+                    break;
+                  ttranscribed Model;
+                    {
+                      ScopedStageTimer Timer(Prof, GAProfiler::transcribe);
+                      Model = Transcribe->GetValues(Child);
+                    }
+                  tfitvec Fitness(nobjective);
+                  if (EvaluateModel(Model, id, iterationnumber, Fitness))
+                    ++newcount;
+                  ScopedStageTimer Timer(Prof, GAProfiler::ranking);
+#pragma omp critical(steadystate)
+                    {
+                      if (Insert(Child, Model, Fitness))
+                        ++inserted;
+                    }
+                }
+            }
+          cout << "New models: " << newcount << " Re-used models: "
+              << nchildren - newcount << " Accepted: " << inserted << endl;
+        }
+      //! Evaluate the initial population in the first call, afterwards create and insert as many children as the population has members
+      void virtual DoIteration(const int iterationnumber, const bool last)
+        {
+          GAProfiler * const Prof = GetProfiler();
+          if (Prof)
+            Prof->StartGeneration(iterationnumber);
+          cout << endl << endl << "Iteration: " << iterationnumber + 1 << endl;
+          if (!initialized)
+            {
+              EvaluatePopulation(iterationnumber);
+              initialized = true;
+            }
+          else
+            {
+              Evolve(iterationnumber, Population->GetPopsize());
+            }
+            {
+              ScopedStageTimer Timer(Prof, GAProfiler::statistics);
+              CalcStatistics();
+              UpdateRejectionFront();
+              LogGeneration(iterationnumber);
+              tprobabilityv Probabilities(Population->GetPopsize());
+              for (size_t i = 0; i < Probabilities.size(); ++i)
+                Probabilities(i) = 1.0 / (1.0 + DominationCount.at(i));
+              Probabilities /= ublas::sum(Probabilities);
+              Population->SetProbabilities(Probabilities);
+            }
+          //the population is always evaluated, so the old population is the current one
+          Population->StoreOldPopulation();
+          OldMisFit = MisFit;
+          if (Prof)
+            Prof->EndGeneration();
+        }
+      //! The number of members that are not dominated by any other member
+      unsigned int virtual GetNBestmodels()
+        {
+          return std::count(DominationCount.begin(), DominationCount.end(), 0);
+        }
+      //! The indices of the members that are not dominated by any other member
+      std::vector<int> virtual GetBestModelIndices()
+        {
+          std::vector<int> Result;
+          for (size_t i = 0; i < DominationCount.size(); ++i)
+            if (DominationCount.at(i) == 0)
+              Result.push_back(i);
+          return Result;
+        }
+      //! Rank the whole population from scratch by counting the members that dominate each member
+      void virtual CalcProbabilities(const int iterationnumber,
+          gplib::rmat &LocalMisFit, GeneralPopulation &LocalPopulation)
+        {
+          const int popsize = LocalPopulation.GetPopsize();
+          DominationCount.assign(popsize, 0);
+          for (int i = 0; i < popsize; ++i)
+            for (int j = 0; j < popsize; ++j)
+              if (dominates()(column(LocalMisFit, j), column(LocalMisFit, i)))
+                ++DominationCount.at(i);
+          tprobabilityv Probabilities(popsize);
+          for (int i = 0; i < popsize; ++i)
+            Probabilities(i) = 1.0 / (1.0 + DominationCount.at(i));
+          Probabilities /= ublas::sum(Probabilities);
+          LocalPopulation.SetProbabilities(Probabilities);
+        }
+      //! In addition to the parameters of GeneralGA we need a random number generator to select parents
+      /*! The propagation object is only used for crossover and mutation and can therefore use any selection scheme.
+       */
+      SteadyStateGA(GeneralPropagation* const LocalPropagation,
+          GeneralPopulation* const LocalPopulation,
+          GeneralTranscribe* const LocalTranscribe,
+          const tObjectiveVector &IndObjective, GeneralRNG &LocalRandom,
+          const int nthreads = 1) :
+        GeneralGA(LocalPropagation, LocalPopulation, LocalTranscribe,
+            IndObjective, nthreads), Random(LocalRandom), DominationCount(
+            LocalPopulation->GetPopsize(), 0), initialized(false)
+        {
+        }
+      virtual ~SteadyStateGA()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*STEADYSTATEGA_H_*/
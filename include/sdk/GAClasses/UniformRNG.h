@@ -48,6 +48,12 @@ namespace gplib
               generator)
           {
 
+          }
+      //! Create a generator with a fixed seed, so runs can be reproduced, e.g. for each island of a distributed GA
+      explicit UniformRNG(const unsigned int seed) :
+          generator(seed), real_dist(generator)
+          {
+
           }
 
       virtual ~UniformRNG();
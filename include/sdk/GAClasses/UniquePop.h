@@ -17,6 +17,8 @@ namespace gplib
      * that makes sure that we only have a single copy of each population member. This class also
      * stores the associated fitness values, so we can use it to look up the fitness of a member
      * instead of calculating it if the member has already been evaluated before.
+     * Each member gets a sequential index in the order of insertion, which InversionHistory uses
+     * to refer to models that have been written before.
      */
     class UniquePop
       {
@@ -43,7 +45,9 @@ namespace gplib
           }
         };
 
-      typedef boost::unordered_map<ttranscribed, tfitvec,memb_hash,memb_equal> tmembermap;
+      //! The fitness of a member and its index in the order of insertion
+      typedef std::pair<tfitvec, size_t> tentry;
+      typedef boost::unordered_map<ttranscribed, tentry,memb_hash,memb_equal> tmembermap;
       tmembermap MemberHashMap;
     public:
       bool Find(const ttranscribed &popmember, tfitvec &fitness)
@@ -52,14 +56,29 @@ namespace gplib
         if (FindPos == MemberHashMap.end())
           return false;
 
-        fitness = FindPos->second;
+        fitness = FindPos->second.first;
         return true;
 
       }
+      //! Look up the index of a member, returns false if we have not stored it
+      bool FindIndex(const ttranscribed &popmember, size_t &index) const
+      {
+        tmembermap::const_iterator FindPos = MemberHashMap.find(popmember);
+        if (FindPos == MemberHashMap.end())
+          return false;
+        index = FindPos->second.second;
+        return true;
+      }
+      //! The number of members stored so far, this is also the index the next new member gets
+      size_t GetSize() const
+      {
+        return MemberHashMap.size();
+      }
       bool Insert(const tfitvec &fitness, const ttranscribed &popmember)
       {
         pair<tmembermap::iterator, bool> insertresult = MemberHashMap.insert(
-            std::make_pair(popmember,fitness));
+            std::make_pair(popmember, std::make_pair(fitness,
+                MemberHashMap.size())));
         return insertresult.second;
       }
       void PrintAll(std::ostream &output)
@@ -72,7 +91,7 @@ namespace gplib
             copy(outit->first.begin(), outit->first.end(), ostream_iterator<
                 double> (output, " "));
             output << "    ";
-            copy(outit->second.begin(), outit->second.end(),
+            copy(outit->second.first.begin(), outit->second.first.end(),
                 ostream_iterator<double> (output, " "));
             output << endl;
           }
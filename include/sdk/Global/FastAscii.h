@@ -0,0 +1,370 @@
+#ifndef FASTASCII_H_
+#define FASTASCII_H_
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include "rapidjson/internal/dtoa.h"
+#include "rapidjson/internal/itoa.h"
+#include "FatalException.h"
+
+namespace gplib
+  {
+    /** \addtogroup genfunc General functions from various areas */
+    /* @{ */
+
+    /*! \file This header contains routines to write and read large ascii files with numbers quickly.
+     * The numbers are formatted into memory buffers that are written with large writes, so we avoid the
+     * per number overhead of the iostream formatting and locale handling. Doubles are written with as few
+     * digits as possible while still reading back to exactly the same value.
+     */
+
+    //! The maximum number of characters FormatDouble writes
+    const size_t maxdoublechars = 32;
+
+    //! Write value with few digits so that it reads back to the same double, returns a pointer behind the last character
+    /*! Integral values are written without a decimal point, all other values with the Grisu2 algorithm from rapidjson,
+     * which gives the shortest representation for almost all values and always reads back exactly.
+     * The buffer needs space for at least maxdoublechars characters, no terminating 0 is written.
+     */
+    inline char *FormatDouble(const double value, char *buffer)
+      {
+        if (value != value)
+          {
+            std::memcpy(buffer, "nan", 3);
+            return buffer + 3;
+          }
+        if (std::abs(value) > 1.7976931348623157e308)
+          {
+            if (value < 0)
+              *buffer++ = '-';
+            std::memcpy(buffer, "inf", 3);
+            return buffer + 3;
+          }
+        //integral values, e.g. the counts from a logger, are the most common case
+        if (std::abs(value) < 9.007199254740992e15 && value == double(
+            boost::int64_t(value)))
+          {
+            if (value == 0.0 && 1.0 / value < 0.0)
+              *buffer++ = '-';
+            return rapidjson::internal::i64toa(boost::int64_t(value), buffer);
+          }
+        return rapidjson::internal::dtoa(value, buffer);
+      }
+
+    //! Parse a double starting at begin, leading blanks and tabs are skipped
+    /*! Returns a pointer behind the number or begin if there is no number. Numbers with at most 19 significant
+     * digits and a small exponent are converted exactly with integer arithmetic, all others with strtod.
+     */
+    inline const char *ParseDouble(const char *begin, double &value)
+      {
+        static const double powers[] =
+          { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+              1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        const char *p = begin;
+        while (*p == ' ' || *p == '\t')
+          ++p;
+        const char *start = p;
+        bool negative = false;
+        if (*p == '-' || *p == '+')
+          negative = (*p++ == '-');
+        boost::uint64_t mantissa = 0;
+        int ndigits = 0, exponent = 0;
+        bool havedigits = false;
+        for (; *p >= '0' && *p <= '9'; ++p)
+          {
+            havedigits = true;
+            if (ndigits < 19)
+              {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                  ++ndigits;
+              }
+            else
+              ++exponent;
+          }
+        if (*p == '.')
+          {
+            ++p;
+            for (; *p >= '0' && *p <= '9'; ++p)
+              {
+                havedigits = true;
+                if (ndigits < 19)
+                  {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa != 0)
+                      ++ndigits;
+                    --exponent;
+                  }
+              }
+          }
+        if (!havedigits)
+          {
+            //nan, inf and other special cases
+            char *end = NULL;
+            value = std::strtod(start, &end);
+            return end == start ? begin : end;
+          }
+        bool exact = ndigits < 19;
+        if (*p == 'e' || *p == 'E')
+          {
+            const char *expstart = p;
+            ++p;
+            bool expnegative = false;
+            if (*p == '-' || *p == '+')
+              expnegative = (*p++ == '-');
+            if (*p < '0' || *p > '9')
+              p = expstart;
+            else
+              {
+                int expvalue = 0;
+                for (; *p >= '0' && *p <= '9'; ++p)
+                  if (expvalue < 10000)
+                    expvalue = expvalue * 10 + (*p - '0');
+                exponent += expnegative ? -expvalue : expvalue;
+              }
+          }
+        //mantissa and power of ten are exact doubles, so a single multiplication or division is correctly rounded
+        if (exact && mantissa < (boost::uint64_t(1) << 53) && exponent >= -22
+            && exponent <= 22)
+          {
+            value = exponent < 0 ? double(mantissa) / powers[-exponent]
+                : double(mantissa) * powers[exponent];
+            if (negative)
+              value = -value;
+            return p;
+          }
+        char *end = NULL;
+        value = std::strtod(start, &end);
+        return end;
+      }
+
+    //! A buffer for formatted text, that is faster than a stringstream
+    class TextBuffer
+      {
+    private:
+      std::vector<char> Buffer;
+      size_t length;
+      void Reserve(const size_t n)
+        {
+          if (length + n > Buffer.size())
+            Buffer.resize(std::max(2 * Buffer.size(), length + n));
+        }
+    public:
+      //! Append a double in the round trip format of FormatDouble
+      void Put(const double value)
+        {
+          Reserve(maxdoublechars);
+          length = FormatDouble(value, &Buffer[length]) - &Buffer[0];
+        }
+      //! Append a double right aligned in a field of width characters
+      void Put(const double value, const size_t width)
+        {
+          char number[maxdoublechars];
+          const size_t n = FormatDouble(value, number) - number;
+          Reserve(std::max(width, n));
+          if (n < width)
+            {
+              std::memset(&Buffer[length], ' ', width - n);
+              length += width - n;
+            }
+          std::memcpy(&Buffer[length], number, n);
+          length += n;
+        }
+      void Put(const char c)
+        {
+          Reserve(1);
+          Buffer[length++] = c;
+        }
+      void Put(const std::string &s)
+        {
+          Reserve(s.size());
+          std::memcpy(&Buffer[length], s.data(), s.size());
+          length += s.size();
+        }
+      const char *Data() const
+        {
+          return Buffer.empty() ? NULL : &Buffer[0];
+        }
+      size_t Size() const
+        {
+          return length;
+        }
+      void Clear()
+        {
+          length = 0;
+        }
+      explicit TextBuffer(const size_t capacity = 4096) :
+        Buffer(capacity), length(0)
+        {
+        }
+      };
+
+    //! Write text to a file with large writes, the file is flushed and closed when the object is destroyed
+    class BufferedWriter
+      {
+    private:
+      std::FILE *file;
+      std::string name;
+    public:
+      //! Write the content of a buffer to the file
+      void Write(const TextBuffer &Text)
+        {
+          Write(Text.Data(), Text.Size());
+        }
+      void Write(const char *data, const size_t size)
+        {
+          if (size > 0 && std::fwrite(data, 1, size, file) != size)
+            throw FatalException("Error writing to file: " + name);
+        }
+      explicit BufferedWriter(const std::string &filename) :
+        file(std::fopen(filename.c_str(), "wb")), name(filename)
+        {
+          if (!file)
+            throw FatalException("Cannot write file: " + filename);
+          std::setvbuf(file, NULL, _IOFBF, 1 << 20);
+        }
+      virtual ~BufferedWriter()
+        {
+          std::fclose(file);
+        }
+      };
+
+    //! Format nrows rows in parallel and write them in the original order
+    /*! Formatter is called as Formatter(row, Buffer) and has to append the text for the row to the TextBuffer
+     * Buffer. The rows are split into chunks of chunkrows rows, each thread formats whole chunks into its own
+     * buffer and the buffers are written in the order of the chunks. At most one batch of chunks is kept in memory.
+     */
+    template<typename Formatter>
+    void WriteRows(BufferedWriter &Writer, const size_t nrows,
+        const Formatter &Format, const size_t chunkrows = 16384)
+      {
+        const size_t nchunks = (nrows + chunkrows - 1) / chunkrows;
+        const size_t batchsize = 64;
+        std::vector<TextBuffer> Buffers(std::min(batchsize, nchunks));
+        bool haveerror = false;
+        std::string errormessage;
+        for (size_t batch = 0; batch < nchunks; batch += batchsize)
+          {
+            const int ncurrent = std::min(batchsize, nchunks - batch);
+#pragma omp parallel for default(shared) schedule(dynamic)
+            for (int i = 0; i < ncurrent; ++i)
+              {
+                try
+                  {
+                    Buffers[i].Clear();
+                    const size_t first = (batch + i) * chunkrows;
+                    const size_t last = std::min(first + chunkrows, nrows);
+                    for (size_t row = first; row < last; ++row)
+                      Format(row, Buffers[i]);
+                  } catch (FatalException &e)
+                  {
+#pragma omp critical(writerows_error)
+                      {
+                        haveerror = true;
+                        errormessage = e.what();
+                      }
+                  }
+              }
+            if (haveerror)
+              throw FatalException(errormessage);
+            for (int i = 0; i < ncurrent; ++i)
+              Writer.Write(Buffers[i]);
+          }
+      }
+
+    //! Read a text file line by line with large reads, much faster than std::getline
+    class LineReader
+      {
+    private:
+      std::FILE *file;
+      std::vector<char> Buffer;
+      //! The valid data in the buffer is between begin and end
+      size_t begin;
+      size_t end;
+      bool eof;
+      //! Move the remaining data to the front of the buffer and read more, returns false if nothing was read
+      bool Fill()
+        {
+          if (eof)
+            return false;
+          std::memmove(&Buffer[0], &Buffer[begin], end - begin);
+          end -= begin;
+          begin = 0;
+          //we always keep one character free for the terminating 0
+          if (end + 1 >= Buffer.size())
+            Buffer.resize(2 * Buffer.size());
+          const size_t nread = std::fread(&Buffer[end], 1, Buffer.size() - end
+              - 1, file);
+          end += nread;
+          if (nread == 0)
+            eof = true;
+          return nread > 0;
+        }
+    public:
+      //! Get the next line, the line is terminated by 0 and does not contain the line break, returns false at the end of the file
+      /*! The pointer is valid until the next call to NextLine.
+       */
+      bool NextLine(const char *&line, size_t &length)
+        {
+          char *newline = NULL;
+          while (!(newline = static_cast<char *> (std::memchr(&Buffer[begin],
+              '\n', end - begin))))
+            {
+              if (!Fill())
+                {
+                  if (begin >= end)
+                    return false;
+                  //the last line of the file has no line break
+                  newline = &Buffer[end];
+                  break;
+                }
+            }
+          char *start = &Buffer[begin];
+          length = newline - start;
+          if (length > 0 && start[length - 1] == '\r')
+            --length;
+          start[length] = '\0';
+          begin = std::min(size_t(newline - &Buffer[0]) + 1, end);
+          line = start;
+          return true;
+        }
+      explicit LineReader(const std::string &filename, const size_t buffersize =
+          1 << 22) :
+        file(std::fopen(filename.c_str(), "rb")), Buffer(buffersize), begin(0),
+            end(0), eof(false)
+        {
+          if (!file)
+            throw FatalException("Cannot open file: " + filename);
+        }
+      virtual ~LineReader()
+        {
+          std::fclose(file);
+        }
+      };
+
+    //! Parse up to n doubles separated by blanks, tabs or the character separator from line, returns the number of values read
+    inline size_t ParseValues(const char *line, double *Values, const size_t n,
+        const char separator = ' ')
+      {
+        size_t nvalues = 0;
+        const char *p = line;
+        while (nvalues < n)
+          {
+            while (*p == ' ' || *p == '\t' || *p == separator)
+              ++p;
+            const char *next = ParseDouble(p, Values[nvalues]);
+            if (next == p)
+              break;
+            ++nvalues;
+            p = next;
+          }
+        return nvalues;
+      }
+  /* @} */
+  }
+#endif /* FASTASCII_H_ */
@@ -0,0 +1,355 @@
+#ifndef LINALGKERNELS_H_
+#define LINALGKERNELS_H_
+
+#include "VecMat.h"
+#include "FatalException.h"
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#ifdef HAVEBLAS
+#include <cblas.h>
+#endif
+
+/** \addtogroup genfunc General functions from various areas */
+/* @{ */
+
+/*! \file LinAlgKernels.h
+ * Dense matrix kernels for the statistics and signal processing code. All matrices are stored in column major
+ * order as the ublas matrices in VecMat.h. When HAVEBLAS is defined the kernels call cblas (e.g. OpenBLAS), when
+ * HAVELAPACK is defined the eigenvalue problems are solved with lapack. Otherwise we use blocked implementations
+ * that access the memory in the order it is stored and a Jacobi eigenvalue solver, which is sufficient for the
+ * small number of channels we usually have.
+ */
+
+#ifdef HAVELAPACK
+extern "C"
+  {
+    void dsyev_(const char *jobz, const char *uplo, const int *n, double *a,
+        const int *lda, double *w, double *work, const int *lwork, int *info);
+    void zheev_(const char *jobz, const char *uplo, const int *n,
+        std::complex<double> *a, const int *lda, double *w,
+        std::complex<double> *work, const int *lwork, double *rwork,
+        int *info);
+  }
+#endif
+
+namespace gplib
+  {
+    namespace linalg
+      {
+        //! The number of columns that we process together in the blocked kernels
+        const size_t blocksize = 256;
+
+        inline double Conj(const double x)
+          {
+            return x;
+          }
+        inline std::complex<double> Conj(const std::complex<double> &x)
+          {
+            return std::conj(x);
+          }
+
+        //! Add X * X^H to the n x n matrix C, X has n rows and ncols columns with leading dimension ld
+        /*! Only the lower triangle of C is updated, call FillUpper to get the full matrix. For real data this is
+         * the symmetric rank-k update X * X^T.
+         */
+        template<typename ScalarType>
+        void RankKUpdate(const ScalarType *X, const size_t n, const size_t ncols,
+            const size_t ld, ScalarType *C)
+          {
+            //we go through X column by column, so we read the data in the order it is stored,
+            //C only has n x n elements and stays in the cache
+            for (size_t start = 0; start < ncols; start += blocksize)
+              {
+                const size_t end = std::min(start + blocksize, ncols);
+                for (size_t k = start; k < end; ++k)
+                  {
+                    const ScalarType *column = X + k * ld;
+                    for (size_t j = 0; j < n; ++j)
+                      {
+                        const ScalarType xj = Conj(column[j]);
+                        ScalarType *Cj = C + j * n;
+                        for (size_t i = j; i < n; ++i)
+                          Cj[i] += column[i] * xj;
+                      }
+                  }
+              }
+          }
+#ifdef HAVEBLAS
+        inline void RankKUpdate(const double *X, const size_t n,
+            const size_t ncols, const size_t ld, double *C)
+          {
+            cblas_dsyrk(CblasColMajor, CblasLower, CblasNoTrans, n, ncols, 1.0,
+                X, ld, 1.0, C, n);
+          }
+        inline void RankKUpdate(const std::complex<double> *X, const size_t n,
+            const size_t ncols, const size_t ld, std::complex<double> *C)
+          {
+            cblas_zherk(CblasColMajor, CblasLower, CblasNoTrans, n, ncols, 1.0,
+                X, ld, 1.0, C, n);
+          }
+#endif
+
+        //! Copy the conjugate of the lower triangle of the n x n matrix C to the upper triangle
+        template<typename ScalarType>
+        void FillUpper(ScalarType *C, const size_t n)
+          {
+            for (size_t j = 0; j < n; ++j)
+              for (size_t i = j + 1; i < n; ++i)
+                C[i * n + j] = Conj(C[j * n + i]);
+          }
+
+        //! Calculate C = alpha * op(A) * op(B) + beta * C with op either identity ('N'), transpose ('T') or conjugate transpose ('C')
+        /*! C is m x n, op(A) is m x k and op(B) is k x n, all matrices are column major with leading dimensions
+         * lda, ldb and ldc.
+         */
+        template<typename ScalarType>
+        void Gemm(const char transa, const char transb, const size_t m,
+            const size_t n, const size_t k, const ScalarType alpha,
+            const ScalarType *A, const size_t lda, const ScalarType *B,
+            const size_t ldb, const ScalarType beta, ScalarType *C,
+            const size_t ldc)
+          {
+            const bool ca = (transa == 'C' || transa == 'c');
+            const bool cb = (transb == 'C' || transb == 'c');
+            const bool ta = ca || (transa == 'T' || transa == 't');
+            const bool tb = cb || (transb == 'T' || transb == 't');
+            for (size_t j = 0; j < n; ++j)
+              {
+                ScalarType *Cj = C + j * ldc;
+                if (beta == ScalarType(0.0))
+                  std::fill(Cj, Cj + m, ScalarType(0.0));
+                else if (beta != ScalarType(1.0))
+                  for (size_t i = 0; i < m; ++i)
+                    Cj[i] *= beta;
+              }
+            if (!ta)
+              {
+                //C(:,j) += A(:,l) * op(B)(l,j), the innermost loop runs over contiguous columns of A and C
+                for (size_t lstart = 0; lstart < k; lstart += blocksize)
+                  {
+                    const size_t lend = std::min(lstart + blocksize, k);
+                    for (size_t j = 0; j < n; ++j)
+                      {
+                        ScalarType *Cj = C + j * ldc;
+                        for (size_t l = lstart; l < lend; ++l)
+                          {
+                            const ScalarType bval = tb ? B[l * ldb + j]
+                                : B[j * ldb + l];
+                            const ScalarType factor = alpha * (cb ? Conj(bval)
+                                : bval);
+                            const ScalarType *Al = A + l * lda;
+                            for (size_t i = 0; i < m; ++i)
+                              Cj[i] += factor * Al[i];
+                          }
+                      }
+                  }
+              }
+            else
+              {
+                //C(i,j) += sum_l A(l,i) op(B)(l,j), with A transposed the sum runs over a contiguous column of A
+                for (size_t j = 0; j < n; ++j)
+                  {
+                    ScalarType *Cj = C + j * ldc;
+                    for (size_t i = 0; i < m; ++i)
+                      {
+                        const ScalarType *Ai = A + i * lda;
+                        ScalarType sum(0.0);
+                        for (size_t l = 0; l < k; ++l)
+                          {
+                            const ScalarType aval = ca ? Conj(Ai[l]) : Ai[l];
+                            const ScalarType bval = tb ? B[l * ldb + j] : B[j
+                                * ldb + l];
+                            sum += aval * (cb ? Conj(bval) : bval);
+                          }
+                        Cj[i] += alpha * sum;
+                      }
+                  }
+              }
+          }
+#ifdef HAVEBLAS
+        inline CBLAS_TRANSPOSE BlasTrans(const char trans)
+          {
+            if (trans == 'C' || trans == 'c')
+              return CblasConjTrans;
+            return (trans == 'T' || trans == 't') ? CblasTrans : CblasNoTrans;
+          }
+        inline void Gemm(const char transa, const char transb, const size_t m,
+            const size_t n, const size_t k, const double alpha,
+            const double *A, const size_t lda, const double *B,
+            const size_t ldb, const double beta, double *C, const size_t ldc)
+          {
+            cblas_dgemm(CblasColMajor, BlasTrans(transa), BlasTrans(transb), m,
+                n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+          }
+        inline void Gemm(const char transa, const char transb, const size_t m,
+            const size_t n, const size_t k, const std::complex<double> alpha,
+            const std::complex<double> *A, const size_t lda,
+            const std::complex<double> *B, const size_t ldb,
+            const std::complex<double> beta, std::complex<double> *C,
+            const size_t ldc)
+          {
+            cblas_zgemm(CblasColMajor, BlasTrans(transa), BlasTrans(transb), m,
+                n, k, &alpha, A, lda, B, ldb, &beta, C, ldc);
+          }
+#endif
+
+        //! Calculate the product A * B of two column major ublas matrices
+        template<typename MatrixType>
+        MatrixType Prod(const MatrixType &A, const MatrixType &B)
+          {
+            typedef typename MatrixType::value_type ScalarType;
+            if (A.size2() != B.size1())
+              throw FatalException("Incompatible matrix sizes in Prod !");
+            MatrixType C(A.size1(), B.size2());
+            if (C.size1() == 0 || C.size2() == 0)
+              return C;
+            if (A.size2() == 0)
+              {
+                std::fill(C.data().begin(), C.data().end(), ScalarType(0.0));
+                return C;
+              }
+            Gemm('N', 'N', A.size1(), B.size2(), A.size2(), ScalarType(1.0),
+                &A.data()[0], A.size1(), &B.data()[0], B.size1(),
+                ScalarType(0.0), &C.data()[0], C.size1());
+            return C;
+          }
+
+        //! Calculate eigenvalues and eigenvectors of the n x n hermitian (or real symmetric) matrix A
+        /*! The eigenvalues are returned in descending order, the corresponding eigenvectors are the columns of
+         * Vectors. A is overwritten. Without lapack we use the cyclic Jacobi method.
+         */
+        template<typename ScalarType>
+        void HermitianEigen(std::vector<ScalarType> &A, const size_t n,
+            std::vector<double> &Values, std::vector<ScalarType> &Vectors)
+          {
+            Vectors.assign(n * n, ScalarType(0.0));
+            for (size_t i = 0; i < n; ++i)
+              Vectors[i * n + i] = 1.0;
+            const int maxsweeps = 100;
+            for (int sweep = 0; sweep < maxsweeps; ++sweep)
+              {
+                double offdiag = 0.0, diag = 0.0;
+                for (size_t q = 0; q < n; ++q)
+                  {
+                    diag += std::norm(A[q * n + q]);
+                    for (size_t p = 0; p < q; ++p)
+                      offdiag += std::norm(A[q * n + p]);
+                  }
+                if (offdiag <= 1e-30 * diag || offdiag == 0.0)
+                  break;
+                for (size_t q = 1; q < n; ++q)
+                  for (size_t p = 0; p < q; ++p)
+                    {
+                      const ScalarType apq = A[q * n + p];
+                      const double absapq = std::abs(apq);
+                      if (absapq == 0.0)
+                        continue;
+                      //first make A(p,q) real by changing the phase of row and column q
+                      const ScalarType phase = apq / absapq;
+                      for (size_t k = 0; k < n; ++k)
+                        {
+                          A[q * n + k] *= Conj(phase);
+                          Vectors[q * n + k] *= Conj(phase);
+                        }
+                      for (size_t k = 0; k < n; ++k)
+                        A[k * n + q] *= phase;
+                      //then a real Jacobi rotation zeroes A(p,q)
+                      const double theta = (std::real(A[q * n + q]) - std::real(
+                          A[p * n + p])) / (2.0 * absapq);
+                      const double t = (theta >= 0.0 ? 1.0 : -1.0)
+                          / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                      const double c = 1.0 / std::sqrt(t * t + 1.0);
+                      const double s = t * c;
+                      for (size_t k = 0; k < n; ++k)
+                        {
+                          const ScalarType akp = A[p * n + k];
+                          const ScalarType akq = A[q * n + k];
+                          A[p * n + k] = c * akp - s * akq;
+                          A[q * n + k] = s * akp + c * akq;
+                          const ScalarType vkp = Vectors[p * n + k];
+                          const ScalarType vkq = Vectors[q * n + k];
+                          Vectors[p * n + k] = c * vkp - s * vkq;
+                          Vectors[q * n + k] = s * vkp + c * vkq;
+                        }
+                      for (size_t k = 0; k < n; ++k)
+                        {
+                          const ScalarType apk = A[k * n + p];
+                          const ScalarType aqk = A[k * n + q];
+                          A[k * n + p] = c * apk - s * aqk;
+                          A[k * n + q] = s * apk + c * aqk;
+                        }
+                    }
+              }
+            //sort by descending eigenvalue
+            std::vector<std::pair<double, size_t> > Order(n);
+            for (size_t i = 0; i < n; ++i)
+              Order[i] = std::make_pair(-std::real(A[i * n + i]), i);
+            std::sort(Order.begin(), Order.end());
+            std::vector<ScalarType> Sorted(n * n);
+            Values.resize(n);
+            for (size_t i = 0; i < n; ++i)
+              {
+                Values[i] = -Order[i].first;
+                std::copy(Vectors.begin() + Order[i].second * n,
+                    Vectors.begin() + (Order[i].second + 1) * n,
+                    Sorted.begin() + i * n);
+              }
+            Vectors.swap(Sorted);
+          }
+#ifdef HAVELAPACK
+        //! Reverse the order of eigenvalues and eigenvectors, lapack returns them in ascending order
+        template<typename ScalarType>
+        void ReverseEigen(const size_t n, std::vector<double> &Values,
+            std::vector<ScalarType> &Vectors)
+          {
+            std::reverse(Values.begin(), Values.end());
+            for (size_t i = 0; i < n / 2; ++i)
+              std::swap_ranges(Vectors.begin() + i * n, Vectors.begin() + (i
+                  + 1) * n, Vectors.begin() + (n - 1 - i) * n);
+          }
+        inline void HermitianEigen(std::vector<double> &A, const size_t n,
+            std::vector<double> &Values, std::vector<double> &Vectors)
+          {
+            const int size = n;
+            int info = 0, lwork = -1;
+            double worksize;
+            Values.resize(n);
+            dsyev_("V", "L", &size, &A[0], &size, &Values[0], &worksize,
+                &lwork, &info);
+            lwork = int(worksize);
+            std::vector<double> work(lwork);
+            dsyev_("V", "L", &size, &A[0], &size, &Values[0], &work[0],
+                &lwork, &info);
+            if (info != 0)
+              throw FatalException("dsyev failed !");
+            Vectors.swap(A);
+            ReverseEigen(n, Values, Vectors);
+          }
+        inline void HermitianEigen(std::vector<std::complex<double> > &A,
+            const size_t n, std::vector<double> &Values, std::vector<
+                std::complex<double> > &Vectors)
+          {
+            const int size = n;
+            int info = 0, lwork = -1;
+            std::complex<double> worksize;
+            std::vector<double> rwork(std::max(1, 3 * size - 2));
+            Values.resize(n);
+            zheev_("V", "L", &size, &A[0], &size, &Values[0], &worksize,
+                &lwork, &rwork[0], &info);
+            lwork = int(worksize.real());
+            std::vector<std::complex<double> > work(lwork);
+            zheev_("V", "L", &size, &A[0], &size, &Values[0], &work[0],
+                &lwork, &rwork[0], &info);
+            if (info != 0)
+              throw FatalException("zheev failed !");
+            Vectors.swap(A);
+            ReverseEigen(n, Values, Vectors);
+          }
+#endif
+      }
+  }
+/* @} */
+#endif /* LINALGKERNELS_H_ */
@@ -20,12 +20,20 @@ namespace gplib
         return Value * Value;
       }
     //! Floating point comparison with tolerance epsilon, this is the implementation from the GNU Scientific library
-    int fcmp (const double x1, const double x2, const double epsilon)
+    /*! Returns 0 if x1 and x2 are equal within a relative tolerance epsilon, -1 if x1 is smaller and 1 if x1 is bigger than x2.
+     */
+    inline int fcmp (const double x1, const double x2, const double epsilon)
     {
-        if (abs(x1 - x2) < epsilon)
+        int exponent;
+        //the tolerance is scaled with the binary exponent of the larger value
+        frexp(fabs(x1) > fabs(x2) ? x1 : x2, &exponent);
+        const double delta = ldexp(epsilon, exponent);
+        const double difference = x1 - x2;
+        if (difference > delta)
             return 1;
-        else
-            return 0;
+        if (difference < -delta)
+            return -1;
+        return 0;
     }
 
     /* @} */
@@ -17,6 +17,13 @@ namespace gplib
       SurfaceWaveData SynthAbsVel;
       double absvelweight;
       double recweight;
+    protected:
+      //! We need the synthetic seismograms for the absolute velocities, so we can only use cached receiver functions without them
+      virtual bool CanReuseSynthetics() const
+        {
+          return absvelweight <= 0.0
+              || MeasuredAbsVel.GetPhaseVelocities().empty();
+        }
     public:
       //! return a pointer to a copy of the current object
       virtual AbsVelRecObjective *clone() const
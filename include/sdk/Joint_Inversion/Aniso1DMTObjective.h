@@ -14,6 +14,13 @@ namespace gplib
           Member2Aniso(member, AnisoMTSynth); //setup forward model with parameter given in member
           AnisoMTSynth.GetData(); //do forward calculation
         }
+      //! C1DAnisoMTSynthData calculates the sensitivities for the model format of Member2Aniso
+      virtual void CalcSensitivities(const ttranscribed &member,
+          cmat &Sensitivities)
+        {
+          CalcSynthData(member);
+          AnisoMTSynth.CalcSensitivities(Sensitivities);
+        }
       C1DAnisoMTSynthData AnisoMTSynth;
       virtual MTStation &GetMTSynth()
         {
@@ -39,6 +46,11 @@ namespace gplib
           }
 
       virtual ~Aniso1DMTObjective();
+      //! The model contains log10 resistivity, thickness, log10 anisotropy and strike for each layer
+      virtual size_t GetParametersPerLayer() const
+        {
+          return 4;
+        }
       virtual Aniso1DMTObjective *clone() const
         {
           return new Aniso1DMTObjective(*this);
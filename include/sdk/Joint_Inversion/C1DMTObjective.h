@@ -3,6 +3,7 @@
 
 #include "PlottableObjective.h"
 #include "MTStation.h"
+#include "VecMat.h"
 #include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <iostream>
@@ -40,6 +41,120 @@ namespace gplib
       MTStation MTData;
       //! This abstract function has to calculate the Synthetic data and fill the MTSynth object with it
       virtual void CalcSynthData(const ttranscribed &member) = 0;
+      //! Calculate the synthetic data and the derivatives of the impedance elements with respect to each element of member
+      /*! Sensitivities has four rows for each frequency with the derivatives of Zxx, Zxy, Zyx and Zyy
+       * and one column for each element of member.
+       */
+      virtual void CalcSensitivities(const ttranscribed &member,
+          cmat &Sensitivities) = 0;
+      //! Make sure the modelled frequencies match the data frequencies, if we didn't set the frequencies before
+      void InitFrequencies()
+        {
+          if (GetMTSynth().GetFrequencies().empty())
+            {
+              GetMTSynth().SetFrequencies(MTData.GetFrequencies());
+            }
+        }
+      //! The element of the impedance tensor with index 0 to 3 for xx, xy, yx and yy
+      static dcomp &TensorElement(MTTensor &Tensor, const size_t index)
+        {
+          switch (index)
+            {
+          case 0:
+            return Tensor.SetZxx();
+          case 1:
+            return Tensor.SetZxy();
+          case 2:
+            return Tensor.SetZyx();
+          default:
+            return Tensor.SetZyy();
+            }
+        }
+      //! Calculate the derivatives of a data function with respect to the real and imaginary parts of the impedance elements
+      /*! The data functions are arbitrary functions of the tensor, so we use central differences. This does not need any
+       * forward calculations. Gradient contains the derivatives with respect to Re Zxx, Im Zxx, Re Zxy etc.
+       */
+      static void DataGradient(const datafunc_t &Function, const MTTensor &Tensor,
+          double Gradient[8])
+        {
+          MTTensor Perturbed(Tensor);
+          double maxabs = 0.0;
+          for (size_t k = 0; k < 4; ++k)
+            maxabs = std::max(maxabs, std::abs(TensorElement(Perturbed, k)));
+          for (size_t k = 0; k < 4; ++k)
+            {
+              dcomp &Element = TensorElement(Perturbed, k);
+              const dcomp Original(Element);
+              const double step = 1e-6 * std::max(std::abs(Original), 1e-3
+                  * maxabs);
+              if (step == 0.0)
+                {
+                  Gradient[2 * k] = 0.0;
+                  Gradient[2 * k + 1] = 0.0;
+                  continue;
+                }
+              const dcomp Steps[2] =
+                { dcomp(step, 0.0), dcomp(0.0, step) };
+              for (size_t part = 0; part < 2; ++part)
+                {
+                  Element = Original + Steps[part];
+                  const double upper = Function(&Perturbed);
+                  Element = Original - Steps[part];
+                  const double lower = Function(&Perturbed);
+                  Gradient[2 * k + part] = (upper - lower) / (2.0 * step);
+                }
+              Element = Original;
+            }
+        }
+      //! Calculate the normalized residuals from the current synthetic data and optionally the corresponding derivatives
+      /*! The errors are the same as in the misfit calculation of SafeParallel. If Sensitivities is not null, Jacobian contains
+       * the derivative of each normalized predicted datum with respect to each model parameter.
+       */
+      void CalcNormalized(const cmat *Sensitivities, rvec &Residuals,
+          rmat &Jacobian)
+        {
+          const std::vector<MTTensor> &Measured = MTData.GetMTData();
+          const std::vector<MTTensor> &Predicted = GetMTSynth().GetMTData();
+          const size_t nfreq = Measured.size();
+          if (Predicted.size() != nfreq)
+            throw FatalException(
+                "Number of synthetic and measured frequencies does not match !");
+          const size_t ndata = DataFunctions.size() * nfreq;
+          Residuals.resize(ndata);
+          if (Sensitivities)
+            {
+              Jacobian.resize(ndata, Sensitivities->size2(), false);
+              Jacobian.clear();
+            }
+          double Gradient[8];
+          size_t index = 0;
+          for (size_t i = 0; i < DataFunctions.size(); ++i)
+            {
+              for (size_t j = 0; j < nfreq; ++j, ++index)
+                {
+                  const double measured = DataFunctions[i](&Measured[j]);
+                  const double predicted = DataFunctions[i](&Predicted[j]);
+                  const double error = std::max(1e-6, std::max(
+                      ErrorFunctions[i](&Measured[j]), std::abs(measured
+                          * ErrorLevels[i])));
+                  Residuals(index) = (measured - predicted) / error;
+                  if (!Sensitivities)
+                    continue;
+                  DataGradient(DataFunctions[i], Predicted[j], Gradient);
+                  for (size_t k = 0; k < 4; ++k)
+                    {
+                      if (Gradient[2 * k] == 0.0 && Gradient[2 * k + 1] == 0.0)
+                        continue;
+                      for (size_t l = 0; l < Sensitivities->size2(); ++l)
+                        {
+                          const dcomp deriv = (*Sensitivities)(4 * j + k, l);
+                          Jacobian(index, l) += (Gradient[2 * k] * deriv.real()
+                              + Gradient[2 * k + 1] * deriv.imag()) / error;
+                        }
+                    }
+                }
+            }
+        }
     protected:
       virtual MTStation &GetMTSynth() = 0;
     public:
@@ -98,12 +213,7 @@ namespace gplib
                 << endl;
             cerr << "You should change your program !" << endl;
           }
-        //if we didn't set the frequencies before
-        if (GetMTSynth().GetFrequencies().empty())
-          {
-            //make sure the modelled frequencies match the data frequencies
-            GetMTSynth().SetFrequencies(MTData.GetFrequencies());
-          }
+        InitFrequencies();
         //calculate the synthetic data for the model
         CalcSynthData(member);
 
@@ -151,6 +261,31 @@ namespace gplib
       {
         return GetRMS();
       }
+      //! The number of parameters for each layer in the model vector member
+      virtual size_t GetParametersPerLayer() const = 0;
+      //! Calculate the residuals (measured - predicted)/error for the model member
+      /*! The residuals are in the same order as the misfit vector and use the data and errors selected with SetFitParameters.
+       * The sum of their squares is the misfit for a fit exponent of 2.
+       */
+      void CalcResiduals(const ttranscribed &member, rvec &Residuals)
+        {
+          InitFrequencies();
+          CalcSynthData(member);
+          rmat Dummy;
+          CalcNormalized(NULL, Residuals, Dummy);
+        }
+      //! Calculate the residuals and the derivatives of the normalized predicted data with respect to each element of member
+      /*! The derivatives of the impedances are calculated analytically by the synthetic data objects, we only
+       * differentiate the data functions numerically. For small changes dm of the model the residuals change by - Jacobian dm.
+       */
+      void CalcJacobian(const ttranscribed &member, rvec &Residuals,
+          rmat &Jacobian)
+        {
+          InitFrequencies();
+          cmat Sensitivities;
+          CalcSensitivities(member, Sensitivities);
+          CalcNormalized(&Sensitivities, Residuals, Jacobian);
+        }
       //! return a vector with pointers to the functions used to calculate the errors
       const datafuncvector_t &GetErrorFunctions() const
         {
@@ -2,6 +2,7 @@
 #define C1DRECOBJECTIVE_H
 #include "PlottableObjective.h"
 #include "RecCalc.h"
+#include "DirectRecCalc.h"
 #include "SeismicDataComp.h"
 #include <boost/shared_ptr.hpp>
 #include <numeric>
@@ -13,6 +14,7 @@
 #include <boost/cast.hpp>
 #include "NumUtil.h"
 #include "CollapseModel.h"
+#include "CollapsedModelCache.h"
 #include "SeisTools.h"
 #include "convert.h"
 #include "miscfunc.h"
@@ -32,6 +34,9 @@ namespace gplib
      */
     class C1DRecObjective: public PlottableObjective
       {
+    public:
+      //! The cache for synthetic receiver functions of collapsed models
+      typedef CollapsedModelCache<SeismicDataComp> tsynthcache;
     private:
       //! The object holding the calculated synthetic data
       SeismicDataComp RecSynthData;
@@ -41,6 +46,10 @@ namespace gplib
       ResPkModel Model;
       //! The object used to calculate the synthetics
       RecCalc RecCalculator;
+      //! The object used to calculate the synthetics without external programs
+      DirectRecCalc DirectCalculator;
+      //! Do we calculate the synthetic receiver functions directly in the frequency domain
+      bool directsynth;
       //! The relative errorfloor
       double errorlevel;
       //! The absolute errorfloor is calculated from the relative errorfloor
@@ -56,17 +65,35 @@ namespace gplib
        * class that all work with the same ObservedData. To save memory we use a shared_pointer
        * and to avoid collisions SeismicDataComp is const */
       boost::shared_ptr<const SeismicDataComp> ObservedData;
+      //! The parameters of the receiver function calculation from the constructor, part of the key for the cache
+      std::vector<double> CalcSettings;
+      //! Synthetic data for collapsed models, shared with all copies of this object, empty if we do not use a cache
+      boost::shared_ptr<tsynthcache> SynthCache;
+      //! The key of the current model for the cache
+      tsynthcache::tkey CacheKey;
+      //! Did we find the synthetic data for the current model in the cache
+      bool cachedsynth;
     protected:
       const SeismicDataComp &GetObservedData()
         {
           return *ObservedData;
         }
+      //! Can we take the synthetic receiver function from the cache, derived classes that need more than the receiver function return false
+      virtual bool CanReuseSynthetics() const
+        {
+          return true;
+        }
     public:
       //! return a pointer to a copy of the current object
       virtual C1DRecObjective *clone() const
         {
           return new C1DRecObjective(*this);
         }
+      //! A receiver function needs a full reflectivity calculation, this is about ten times the cost of a 1D MT forward calculation
+      virtual double GetCostEstimate() const
+        {
+          return 10.0;
+        }
       //! Set the time window used for misfit calculations, start and end are in seconds
       void SetTimeWindow(const double start, const double end)
       {
@@ -95,6 +122,25 @@ namespace gplib
           // here we calculate its value
           errorvalue = errorlevel * recmaxamp;
         }
+      //! Calculate the synthetic receiver functions directly in the frequency domain instead of deconvolving synthetic seismograms
+      /*! This does not need any files or external programs and is much faster, but it does not provide the
+       * synthetic seismograms, so it cannot be used by AbsVelRecObjective. The receiver function is calculated
+       * with the same filter as RecCalc::specdiv, for data calculated with iterative deconvolution
+       * the amplitudes only agree for normalized receiver functions.
+       */
+      void SetDirectSynthetics(const bool direct)
+        {
+          directsynth = direct;
+        }
+      //! Take the synthetic receiver functions of models that collapse to the same layers from Cache instead of calculating them
+      /*! Copies of this object, e.g. for the different threads of a genetic algorithm, share the cache. The key includes
+       * all parameters of the calculation, so several receiver function objectives can share a cache and reuse each other's
+       * synthetics if they have the same slowness and filter parameters. An empty pointer switches the cache off, which is the default.
+       */
+      void SetCollapsedModelCache(boost::shared_ptr<tsynthcache> Cache)
+        {
+          SynthCache = Cache;
+        }
       //! Set poisson's ratio, at the moment the same for all layers, used for calculating P-velocity
       void SetPoisson(const double ratio)
         {
@@ -137,14 +183,30 @@ namespace gplib
                 _1, poisson));
         Model.SetDt(ObservedData->GetDt()); // set dt
         Model.SetNpts(ObservedData->GetData().size()); //set number of points
-        RecCalculator.SynthPreParallel(GetParallelID(), Model, RecSynthData,
-            true);
+        cachedsynth = false;
+        if (SynthCache && CanReuseSynthetics())
+          {
+            std::vector<double> Settings(CalcSettings);
+            Settings.push_back(slowness);
+            Settings.push_back(poisson);
+            Settings.push_back(ObservedData->GetDt());
+            Settings.push_back(ObservedData->GetData().size());
+            Settings.push_back(directsynth);
+            CacheKey = tsynthcache::MakeKey(thickness, velocity, Settings);
+            cachedsynth = SynthCache->Find(CacheKey, RecSynthData);
+          }
+        if (!directsynth && !cachedsynth)
+          RecCalculator.SynthPreParallel(GetParallelID(), Model, RecSynthData,
+              true);
       }
       //! We also clean up files serially
       virtual double PostParallel(const ttranscribed &member)
       {
-        RecCalculator.SynthPostParallel(GetParallelID(), Model, RecSynthData,
-            true);
+        if (!directsynth && !cachedsynth)
+          RecCalculator.SynthPostParallel(GetParallelID(), Model, RecSynthData,
+              true);
+        if (SynthCache && !cachedsynth && CanReuseSynthetics())
+          SynthCache->Insert(CacheKey, RecSynthData);
         SetMisfit().resize(endpoint - startpoint);//we need vectors of the right size for misfit
         SetSynthData().resize(endpoint - startpoint);//and  data
         double returnvalue = 0.0;//init returnvalue
@@ -168,15 +230,23 @@ namespace gplib
       //! Calculate the misfit between the data calculated from model vector member and measured data given in the constructor.
       virtual void SafeParallel(const ttranscribed &member)
       {
-        RecCalculator.SynthSafeParallel(GetParallelID(), Model, RecSynthData,
-            true); // Calculate forward model
+        if (cachedsynth)
+          return;
+        if (directsynth)
+          DirectCalculator.CalcRecData(Model, RecSynthData);
+        else
+          RecCalculator.SynthSafeParallel(GetParallelID(), Model, RecSynthData,
+              true); // Calculate forward model
       }
       C1DRecObjective(const C1DRecObjective &Old) :
           PlottableObjective(Old), RecSynthData(Old.RecSynthData), slowness(
               Old.slowness), Model(Old.Model), RecCalculator(Old.RecCalculator),
-              errorlevel(Old.errorlevel), errorvalue(Old.errorvalue), poisson(
+              DirectCalculator(Old.DirectCalculator), directsynth(
+                  Old.directsynth), errorlevel(Old.errorlevel), errorvalue(Old.errorvalue), poisson(
                   Old.poisson), startpoint(Old.startpoint), endpoint(Old.endpoint),
-              ObservedData(Old.ObservedData)
+              ObservedData(Old.ObservedData), CalcSettings(Old.CalcSettings),
+              SynthCache(Old.SynthCache), CacheKey(Old.CacheKey), cachedsynth(
+                  Old.cachedsynth)
           {
           }
 
@@ -189,12 +259,18 @@ namespace gplib
         slowness = source.slowness;
         Model = source.Model;
         RecCalculator = source.RecCalculator;
+        DirectCalculator = source.DirectCalculator;
+        directsynth = source.directsynth;
         poisson = source.poisson;
         errorlevel = source.errorlevel;
         errorvalue = source.errorvalue;
         startpoint = source.startpoint;
         endpoint = source.endpoint;
         ObservedData = source.ObservedData;
+        CalcSettings = source.CalcSettings;
+        SynthCache = source.SynthCache;
+        CacheKey = source.CacheKey;
+        cachedsynth = source.cachedsynth;
         return *this;
       }
       //! The constructor needs a few essential parameters
@@ -210,9 +286,15 @@ namespace gplib
           const int myshift, const double mysigma, const double myc,
           const double myslowness, const RecCalc::trfmethod method =
               RecCalc::specdiv, const bool normalized = true) :
-          RecCalculator(myshift, mysigma, myc, true, method), ObservedData(
-              TheRecData)
+          RecCalculator(myshift, mysigma, myc, true, method), DirectCalculator(
+              myshift, mysigma), directsynth(false), ObservedData(TheRecData),
+              cachedsynth(false)
           {
+            CalcSettings.push_back(myshift);
+            CalcSettings.push_back(mysigma);
+            CalcSettings.push_back(myc);
+            CalcSettings.push_back(method);
+            CalcSettings.push_back(normalized);
             slowness = myslowness; //copy parameter value
             poisson = sqrt(3.); //set some default values
             //we specify a default errorlevel of 1%
@@ -232,6 +314,7 @@ namespace gplib
               throw FatalException(
                   "Input data does not have an amplitude of 1, but normalization is used");
             RecCalculator.SetNormalize(normalized);// we can choose we want to model normalized data
+            DirectCalculator.SetNormalize(normalized);
           }
 
       virtual ~C1DRecObjective();
@@ -17,6 +17,11 @@ namespace gplib
         {
           return new CombinedRoughness(*this);
         }
+      //! The roughness only depends on the model, so it is much cheaper than a forward calculation
+      virtual double GetCostEstimate() const
+        {
+          return 0.01;
+        }
       //! Set reference conductivity for roughness calculation, changes weighting between velocity and conductivity
       void SetRefCond(const double cond)
         {
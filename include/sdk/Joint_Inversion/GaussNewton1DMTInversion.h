@@ -0,0 +1,113 @@
+#ifndef GAUSSNEWTON1DMTINVERSION_H_
+#define GAUSSNEWTON1DMTINVERSION_H_
+#include "Linearized1DMTInversion.h"
+#include <cmath>
+#include <limits>
+
+namespace gplib
+  {
+    /** \addtogroup mttools MT data analysis, processing and inversion */
+    /* @{ */
+
+    //! Minimize the misfit plus a fixed multiple of the roughness with a damped Gauss-Newton method
+    /*! In contrast to Occam1DMTInversion the regularization weight lambda is fixed, which is useful
+     * when the thicknesses are free parameters or when we want to compare models with the same regularization.
+     * We damp the Gauss-Newton step with the Levenberg-Marquardt method, the damping is decreased after each
+     * successful step and increased when the objective function does not decrease. Steps that result in negative
+     * thicknesses are rejected in the same way.
+     */
+    class GaussNewton1DMTInversion: public Linearized1DMTInversion
+      {
+    private:
+      //! The weight of the roughness in the objective function
+      double lambda;
+      //! We stop when the relative decrease of the objective function is smaller than this value
+      double tolerance;
+    public:
+      //! Set the weight of the roughness in the objective function
+      void SetLambda(const double l)
+        {
+          lambda = l;
+        }
+      //! Set the relative decrease of the objective function below which we stop
+      void SetTolerance(const double tol)
+        {
+          tolerance = tol;
+        }
+      virtual ttranscribed Invert(const ttranscribed &StartModel)
+        {
+          namespace ublas = boost::numeric::ublas;
+          ResetCounters();
+          Setup(StartModel);
+          const size_t maxtries = 10;
+          ttranscribed Model(StartModel);
+          rvec Residuals;
+          rmat Jacobian;
+          const rmat RtR(ublas::prod(ublas::trans(Roughness), Roughness));
+          double damping = 1e-3;
+          double currrms = CalcJacobian(Model, Residuals, Jacobian);
+          double objective = ublas::inner_prod(Residuals, Residuals) + lambda
+              * CalcRoughness(GetFree(Model));
+          size_t iteration = 0;
+          for (; iteration < GetMaxIterations(); ++iteration)
+            {
+              const rvec FreeModel(GetFree(Model));
+              const rmat Hessian(ublas::prod(ublas::trans(Jacobian), Jacobian)
+                  + lambda * RtR);
+              //the negative gradient of the objective function divided by 2
+              const rvec Gradient(ublas::prod(ublas::trans(Jacobian), Residuals)
+                  - lambda * ublas::prod(RtR, FreeModel));
+              bool accepted = false;
+              ttranscribed Trial;
+              rvec TrialResiduals;
+              double trialrms = 0.0, trialobjective = 0.0;
+              for (size_t tries = 0; tries < maxtries && !accepted; ++tries)
+                {
+                  rmat Damped(Hessian);
+                  for (size_t i = 0; i < Damped.size1(); ++i)
+                    Damped(i, i) += damping * Hessian(i, i);
+                  const rvec NewModel(FreeModel + Solve(Damped, Gradient));
+                  Trial = SetFree(Model, NewModel);
+                  trialrms = CalcRMS(Trial, TrialResiduals);
+                  trialobjective = ublas::inner_prod(TrialResiduals,
+                      TrialResiduals) + lambda * CalcRoughness(NewModel);
+                  //an infinite rms signals an invalid model, so the comparison fails
+                  if (trialrms < std::numeric_limits<double>::infinity()
+                      && trialobjective < objective)
+                    {
+                      accepted = true;
+                      damping = std::max(damping / 10.0, 1e-8);
+                    }
+                  else
+                    damping *= 10.0;
+                }
+              if (!accepted)
+                break;
+              const bool converged = objective - trialobjective < tolerance
+                  * objective;
+              Model = Trial;
+              currrms = trialrms;
+              objective = trialobjective;
+              if (converged)
+                {
+                  ++iteration;
+                  break;
+                }
+              currrms = CalcJacobian(Model, Residuals, Jacobian);
+            }
+          SetResult(iteration, currrms);
+          return Model;
+        }
+      //! The objective function calculates the data and sensitivities, l is the weight of the roughness
+      explicit GaussNewton1DMTInversion(C1DMTObjective &TheObjective,
+          const double l = 1.0) :
+        Linearized1DMTInversion(TheObjective), lambda(l), tolerance(1e-4)
+        {
+        }
+      virtual ~GaussNewton1DMTInversion()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*GAUSSNEWTON1DMTINVERSION_H_*/
@@ -33,6 +33,13 @@ namespace gplib
           IsoMTSynth.SetResistivities(res);
           IsoMTSynth.CalcSynthetic(); // do forward calculation
         }
+      //! The model vector has the same format as the model vector of C1DMTSynthData, so we can use its sensitivities directly
+      virtual void CalcSensitivities(const ttranscribed &member,
+          cmat &Sensitivities)
+        {
+          CalcSynthData(member);
+          IsoMTSynth.CalcSensitivities(Sensitivities);
+        }
       C1DMTSynthData IsoMTSynth;
       virtual MTStation &GetMTSynth()
         {
@@ -57,6 +64,11 @@ namespace gplib
 
           }
       virtual ~Iso1DMTObjective();
+      //! The model contains log10 resistivity and thickness for each layer
+      virtual size_t GetParametersPerLayer() const
+        {
+          return 2;
+        }
       //! clone clones the current object, derived from GeneralObjective
       virtual Iso1DMTObjective *clone() const
         {
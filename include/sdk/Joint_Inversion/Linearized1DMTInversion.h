@@ -0,0 +1,274 @@
+#ifndef LINEARIZED1DMTINVERSION_H_
+#define LINEARIZED1DMTINVERSION_H_
+#include "C1DMTObjective.h"
+#include "VecMat.h"
+#include "FatalException.h"
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/lu.hpp>
+#include <vector>
+#include <limits>
+#include <cmath>
+
+namespace gplib
+  {
+    /** \addtogroup mttools MT data analysis, processing and inversion */
+    /* @{ */
+
+    //! The common functionality of the linearized, regularized inversions of 1D MT data
+    /*! The derived classes minimize the squared normalized residuals of a C1DMTObjective object, i.e. the
+     * misfit for the data selected with C1DMTObjective::SetFitParameters and a fit exponent of 2, plus a regularization
+     * term lambda |R m|^2. R contains the first differences between neighbouring layers for each type of parameter,
+     * weighted by a factor for each type. The model vectors have the same format as the members of the genetic algorithm,
+     * e.g. log10 resistivities followed by thicknesses for Iso1DMTObjective. By default only the thicknesses are fixed,
+     * the thickness of the half-space is never changed. Internally we invert for the logarithm of free thicknesses,
+     * so they always stay positive. The sensitivities of the impedances are calculated analytically
+     * by the objective function, so each iteration needs one calculation of the sensitivities and a few forward calculations.
+     */
+    class Linearized1DMTInversion
+      {
+    private:
+      //! The objective function that calculates residuals and sensitivities
+      C1DMTObjective &Objective;
+      //! Which elements of the model vector we change, if empty we use the default
+      std::vector<bool> Free;
+      //! The weight of the roughness for each type of parameter, if empty we use the default
+      std::vector<double> RoughnessWeights;
+      //! The maximum number of iterations
+      size_t maxiterations;
+      //! The number of forward calculations without sensitivities
+      size_t nforward;
+      //! The number of calculations of the sensitivities
+      size_t nsensitivities;
+      //! The number of iterations of the last inversion
+      size_t niterations;
+      //! The rms of the last accepted model
+      double rms;
+    protected:
+      //! The indices of the elements of the model vector that we change
+      std::vector<size_t> FreeIndices;
+      //! For each free parameter, do we invert for its natural logarithm
+      std::vector<bool> Logarithmic;
+      //! The roughness matrix for the free parameters
+      rmat Roughness;
+      //! Check the model vector and setup the free parameters and the roughness matrix
+      void Setup(const ttranscribed &StartModel)
+        {
+          const size_t nparams = StartModel.size();
+          const size_t ntypes = Objective.GetParametersPerLayer();
+          if (nparams == 0 || nparams % ntypes != 0)
+            throw FatalException("Invalid size of start model for inversion !");
+          const size_t nlayers = nparams / ntypes;
+          std::vector<bool> IsFree(Free);
+          if (IsFree.empty())
+            {
+              //by default we invert for everything except the thicknesses
+              IsFree.assign(nparams, true);
+              for (size_t i = 0; i < nlayers; ++i)
+                IsFree.at(nlayers + i) = false;
+            }
+          if (IsFree.size() != nparams)
+            throw FatalException(
+                "Number of free parameters does not match model size !");
+          //the thickness of the half-space has no influence on the data
+          IsFree.at(2 * nlayers - 1) = false;
+          std::vector<double> Weights(RoughnessWeights);
+          if (Weights.empty())
+            {
+              Weights.assign(ntypes, 1.0);
+              Weights.at(1) = 0.0;
+            }
+          if (Weights.size() != ntypes)
+            throw FatalException(
+                "Number of roughness weights does not match parameter types !");
+          FreeIndices.clear();
+          Logarithmic.clear();
+          std::vector<size_t> Position(nparams, nparams);
+          for (size_t i = 0; i < nparams; ++i)
+            if (IsFree.at(i))
+              {
+                const bool isthickness = i >= nlayers && i < 2 * nlayers;
+                if (isthickness && StartModel(i) <= 0.0)
+                  throw FatalException(
+                      "Free thicknesses in the start model have to be positive !");
+                Position.at(i) = FreeIndices.size();
+                FreeIndices.push_back(i);
+                Logarithmic.push_back(isthickness);
+              }
+          if (FreeIndices.empty())
+            throw FatalException("No free parameters for inversion !");
+          //one row for each pair of neighbouring free parameters of the same type
+          std::vector<size_t> Upper, Lower;
+          std::vector<double> RowWeights;
+          for (size_t type = 0; type < ntypes; ++type)
+            for (size_t i = 0; i + 1 < nlayers; ++i)
+              {
+                const size_t upper = type * nlayers + i;
+                if (Weights.at(type) > 0.0 && IsFree.at(upper) && IsFree.at(
+                    upper + 1))
+                  {
+                    Upper.push_back(Position.at(upper));
+                    Lower.push_back(Position.at(upper + 1));
+                    RowWeights.push_back(Weights.at(type));
+                  }
+              }
+          Roughness.resize(Upper.size(), FreeIndices.size(), false);
+          Roughness.clear();
+          for (size_t i = 0; i < Upper.size(); ++i)
+            {
+              Roughness(i, Upper.at(i)) = -RowWeights.at(i);
+              Roughness(i, Lower.at(i)) = RowWeights.at(i);
+            }
+        }
+      //! Extract the free parameters from a model vector
+      rvec GetFree(const ttranscribed &Model) const
+        {
+          rvec Result(FreeIndices.size());
+          for (size_t i = 0; i < FreeIndices.size(); ++i)
+            {
+              const double value = Model(FreeIndices.at(i));
+              Result(i) = Logarithmic.at(i) ? std::log(value) : value;
+            }
+          return Result;
+        }
+      //! Replace the free parameters in a copy of Model
+      ttranscribed SetFree(const ttranscribed &Model, const rvec &Values) const
+        {
+          ttranscribed Result(Model);
+          for (size_t i = 0; i < FreeIndices.size(); ++i)
+            Result(FreeIndices.at(i)) = Logarithmic.at(i) ? std::exp(Values(i))
+                : Values(i);
+          return Result;
+        }
+      //! The columns of the jacobian for the free parameters of Model
+      rmat FreeColumns(const ttranscribed &Model, const rmat &Jacobian) const
+        {
+          rmat Result(Jacobian.size1(), FreeIndices.size());
+          for (size_t i = 0; i < FreeIndices.size(); ++i)
+            {
+              //for a logarithmic parameter we need the derivative with respect to the logarithm
+              const double factor = Logarithmic.at(i) ? Model(FreeIndices.at(i))
+                  : 1.0;
+              boost::numeric::ublas::column(Result, i) = factor
+                  * boost::numeric::ublas::column(Jacobian, FreeIndices.at(i));
+            }
+          return Result;
+        }
+      //! The squared norm of the roughness of the free parameters
+      double CalcRoughness(const rvec &FreeModel) const
+        {
+          const rvec Rough(boost::numeric::ublas::prod(Roughness, FreeModel));
+          return boost::numeric::ublas::inner_prod(Rough, Rough);
+        }
+      //! Calculate the rms of the normalized residuals for a model, infinite if a layer thickness is not positive
+      double CalcRMS(const ttranscribed &Model, rvec &Residuals)
+        {
+          const size_t nlayers = Model.size()
+              / Objective.GetParametersPerLayer();
+          for (size_t i = 0; i + 1 < nlayers; ++i)
+            if (Model(nlayers + i) <= 0.0)
+              return std::numeric_limits<double>::infinity();
+          Objective.CalcResiduals(Model, Residuals);
+          ++nforward;
+          return std::sqrt(boost::numeric::ublas::inner_prod(Residuals,
+              Residuals) / Residuals.size());
+        }
+      //! Calculate the residuals and the jacobian for the free parameters, returns the rms
+      double CalcJacobian(const ttranscribed &Model, rvec &Residuals,
+          rmat &Jacobian)
+        {
+          rmat Full;
+          Objective.CalcJacobian(Model, Residuals, Full);
+          ++nsensitivities;
+          Jacobian = FreeColumns(Model, Full);
+          return std::sqrt(boost::numeric::ublas::inner_prod(Residuals,
+              Residuals) / Residuals.size());
+        }
+      //! Solve the symmetric positive definite system Matrix x = Rhs, the matrix is overwritten
+      /*! The thicknesses are not regularized, so we add a tiny multiple of the identity to keep the system regular.
+       */
+      static rvec Solve(rmat Matrix, const rvec &Rhs)
+        {
+          const size_t n = Matrix.size1();
+          double trace = 0.0;
+          for (size_t i = 0; i < n; ++i)
+            trace += Matrix(i, i);
+          for (size_t i = 0; i < n; ++i)
+            Matrix(i, i) += 1e-12 * trace / n;
+          boost::numeric::ublas::permutation_matrix<std::size_t> Permutation(n);
+          if (boost::numeric::ublas::lu_factorize(Matrix, Permutation) != 0)
+            throw FatalException("Singular matrix in linearized inversion !");
+          rvec Result(Rhs);
+          boost::numeric::ublas::lu_substitute(Matrix, Permutation, Result);
+          return Result;
+        }
+      //! The derived classes update the statistics of the last inversion with this function
+      void SetResult(const size_t iterations, const double finalrms)
+        {
+          niterations = iterations;
+          rms = finalrms;
+        }
+      //! Reset the counters before a new inversion
+      void ResetCounters()
+        {
+          nforward = 0;
+          nsensitivities = 0;
+          niterations = 0;
+        }
+      size_t GetMaxIterations() const
+        {
+          return maxiterations;
+        }
+    public:
+      //! Set which elements of the model vector are changed by the inversion, the size has to match the start model
+      void SetFreeParameters(const std::vector<bool> &IsFree)
+        {
+          Free = IsFree;
+        }
+      //! Set the weight of the roughness for each type of parameter
+      /*! The default is 1 for all types except the thicknesses, which are not regularized. Strike angles are in degree,
+       * so for Aniso1DMTObjective a weight of about 1/45 for the strikes usually works better.
+       */
+      void SetRoughnessWeights(const std::vector<double> &Weights)
+        {
+          RoughnessWeights = Weights;
+        }
+      //! Set the maximum number of iterations
+      void SetMaxIterations(const size_t iterations)
+        {
+          maxiterations = iterations;
+        }
+      //! The number of forward calculations of the last inversion, not counting the calculations of the sensitivities
+      size_t GetNForward() const
+        {
+          return nforward;
+        }
+      //! The number of calculations of the sensitivities of the last inversion
+      size_t GetNSensitivities() const
+        {
+          return nsensitivities;
+        }
+      //! The number of iterations of the last inversion
+      size_t GetIterations() const
+        {
+          return niterations;
+        }
+      //! The rms of the final model of the last inversion
+      double GetRMS() const
+        {
+          return rms;
+        }
+      //! Invert the data of the objective function starting with StartModel and return the final model
+      virtual ttranscribed Invert(const ttranscribed &StartModel) = 0;
+      //! The objective function has to stay valid while we use the inversion object
+      explicit Linearized1DMTInversion(C1DMTObjective &TheObjective) :
+        Objective(TheObjective), maxiterations(20), nforward(0),
+            nsensitivities(0), niterations(0), rms(0.0)
+        {
+        }
+      virtual ~Linearized1DMTInversion()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*LINEARIZED1DMTINVERSION_H_*/
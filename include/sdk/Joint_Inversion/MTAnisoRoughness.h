@@ -29,6 +29,11 @@ namespace gplib
         {
           return new MTAnisoRoughness(*this);
         }
+      //! The roughness only depends on the model, so it is much cheaper than a forward calculation
+      virtual double GetCostEstimate() const
+        {
+          return 0.01;
+        }
       virtual void SafeParallel(const ttranscribed &member)
       {
         const unsigned int length = member.size() / 4; //we have 4 parameters in the model, so size/4 layers
@@ -33,6 +33,11 @@ namespace gplib
         {
           return new MTRecObjective(*this);
         }
+      //! We calculate both the receiver function and the MT response
+      virtual double GetCostEstimate() const
+        {
+          return RecObjective.GetCostEstimate() + MTObjective.GetCostEstimate();
+        }
       virtual double PostParallel(const ttranscribed &member)
       {
         const int nlayers = member.size() / 3;
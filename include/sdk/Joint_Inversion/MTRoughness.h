@@ -8,6 +8,8 @@ class MTRoughness: public GeneralObjective
 {
 public:
 	virtual MTRoughness *clone() const {return new MTRoughness(*this);}
+	//! The roughness only depends on the model, so it is much cheaper than a forward calculation
+	virtual double GetCostEstimate() const {return 0.01;}
         virtual void SafeParallel(const ttranscribed &member)
     {
       const unsigned int length = member.size() / 3; //we have 3 parameters in the model, so size/3 layers
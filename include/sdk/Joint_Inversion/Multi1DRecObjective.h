@@ -27,6 +27,14 @@ namespace gplib
         {
           return new Multi1DRecObjective(*this);
         }
+      //! We calculate one receiver function for each objective
+      virtual double GetCostEstimate() const
+        {
+          double cost = 0.0;
+          for (size_t i = 0; i < Objectives.size(); ++i)
+            cost += Objectives.at(i)->GetCostEstimate();
+          return cost;
+        }
       //! Set the start and end time in s for the part we want to fit
       void SetTimeWindow(const double start, const double end)
       {
@@ -39,6 +47,15 @@ namespace gplib
         for_each(Objectives.begin(), Objectives.end(), boost::bind(
             &C1DRecObjective::SetPoisson, _1, ratio));
       }
+      //! Let all receiver functions share Cache for the synthetics of collapsed models, @see C1DRecObjective::SetCollapsedModelCache
+      /*! This only applies to the receiver functions that have been added so far.
+       */
+      void SetCollapsedModelCache(
+          boost::shared_ptr<C1DRecObjective::tsynthcache> Cache)
+      {
+        for (size_t i = 0; i < Objectives.size(); ++i)
+          Objectives.at(i)->SetCollapsedModelCache(Cache);
+      }
       //! Add another reciever function to fit
       void AddRecFunction(boost::shared_ptr<const SeismicDataComp> TheRecData,
           const int myshift, const double mysigma, const double myc,
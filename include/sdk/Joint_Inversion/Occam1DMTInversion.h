@@ -0,0 +1,139 @@
+#ifndef OCCAM1DMTINVERSION_H_
+#define OCCAM1DMTINVERSION_H_
+#include "Linearized1DMTInversion.h"
+#include <cmath>
+#include <limits>
+
+namespace gplib
+  {
+    /** \addtogroup mttools MT data analysis, processing and inversion */
+    /* @{ */
+
+    //! Find the smoothest model that fits the data to a target rms with Occam's inversion
+    /*! In each iteration we linearize the forward problem around the current model and calculate the
+     * models that minimize the linearized misfit plus lambda times the roughness for a few values of lambda
+     * around the previous value. If none of them reaches the target rms, we take the model with the smallest rms,
+     * otherwise the smoothest model that fits the target rms (Constable et al., 1987). If the linearization is so poor that
+     * none of the models reduces the misfit, we shorten the step towards the best of them. We stop when the target is reached
+     * and the roughness does not change any more, or the misfit cannot be reduced any further.
+     */
+    class Occam1DMTInversion: public Linearized1DMTInversion
+      {
+    private:
+      //! The rms we want to reach
+      double targetrms;
+      //! The regularization weight used for the last model
+      double lambda;
+    public:
+      //! Set the rms we want to fit the data to
+      void SetTargetRMS(const double target)
+        {
+          targetrms = target;
+        }
+      //! The regularization weight of the final model
+      double GetLambda() const
+        {
+          return lambda;
+        }
+      virtual ttranscribed Invert(const ttranscribed &StartModel)
+        {
+          namespace ublas = boost::numeric::ublas;
+          ResetCounters();
+          Setup(StartModel);
+          //we try lambda times 10^-2 to 10^2 in each iteration
+          const int nsteps = 2;
+          const double stepfactor = 10.0;
+          //the maximum number of times we halve a step that does not reduce the misfit
+          const size_t maxhalvings = 4;
+          ttranscribed Model(StartModel);
+          rvec Residuals;
+          rmat Jacobian;
+          double currrms = std::numeric_limits<double>::infinity();
+          double roughness = CalcRoughness(GetFree(Model));
+          lambda = 0.0;
+          size_t iteration = 0;
+          for (; iteration < GetMaxIterations(); ++iteration)
+            {
+              currrms = CalcJacobian(Model, Residuals, Jacobian);
+              const rvec FreeModel(GetFree(Model));
+              const rmat JtJ(ublas::prod(ublas::trans(Jacobian), Jacobian));
+              const rmat RtR(ublas::prod(ublas::trans(Roughness), Roughness));
+              //the linearized data for the free parameters
+              const rvec Rhs(ublas::prod(ublas::trans(Jacobian), Residuals
+                  + ublas::prod(Jacobian, FreeModel)));
+              if (lambda == 0.0)
+                {
+                  //the first guess balances the two terms
+                  double datatrace = 0.0, roughtrace = 0.0;
+                  for (size_t i = 0; i < JtJ.size1(); ++i)
+                    {
+                      datatrace += JtJ(i, i);
+                      roughtrace += RtR(i, i);
+                    }
+                  lambda = (roughtrace > 0.0) ? datatrace / roughtrace : 1.0;
+                }
+              ttranscribed BestModel(Model);
+              double bestrms = std::numeric_limits<double>::infinity();
+              double bestlambda = lambda;
+              bool fits = false;
+              rvec Dummy;
+              for (int step = -nsteps; step <= nsteps; ++step)
+                {
+                  const double currlambda = lambda * std::pow(stepfactor, step);
+                  const ttranscribed Trial(SetFree(Model, Solve(JtJ
+                      + currlambda * RtR, Rhs)));
+                  const double trialrms = CalcRMS(Trial, Dummy);
+                  //while we cannot fit the data we take the smallest misfit, afterwards the largest lambda that fits
+                  if (trialrms <= targetrms)
+                    {
+                      fits = true;
+                      BestModel = Trial;
+                      bestrms = trialrms;
+                      bestlambda = currlambda;
+                    }
+                  else if (!fits && trialrms < bestrms)
+                    {
+                      BestModel = Trial;
+                      bestrms = trialrms;
+                      bestlambda = currlambda;
+                    }
+                }
+              for (size_t halving = 0; !fits && halving < maxhalvings
+                  && !(bestrms < currrms); ++halving)
+                {
+                  const rvec Shorter(0.5 * (FreeModel + GetFree(BestModel)));
+                  BestModel = SetFree(Model, Shorter);
+                  bestrms = CalcRMS(BestModel, Dummy);
+                }
+              //we cannot improve the misfit with the linearization
+              if (!fits && !(bestrms < currrms * (1.0 - 1e-3)))
+                break;
+              const double newroughness = CalcRoughness(GetFree(BestModel));
+              const bool converged = currrms <= targetrms && std::abs(
+                  newroughness - roughness) <= 0.01 * roughness;
+              Model = BestModel;
+              currrms = bestrms;
+              lambda = bestlambda;
+              roughness = newroughness;
+              if (converged)
+                {
+                  ++iteration;
+                  break;
+                }
+            }
+          SetResult(iteration, currrms);
+          return Model;
+        }
+      //! The objective function calculates the data and sensitivities, target is the rms we want to reach
+      explicit Occam1DMTInversion(C1DMTObjective &TheObjective,
+          const double target = 1.0) :
+        Linearized1DMTInversion(TheObjective), targetrms(target), lambda(0.0)
+        {
+        }
+      virtual ~Occam1DMTInversion()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*OCCAM1DMTINVERSION_H_*/
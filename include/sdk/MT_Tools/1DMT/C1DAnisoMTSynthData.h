@@ -8,6 +8,7 @@
 #include <fstream>
 #include "NumUtil.h"
 #include "FatalException.h"
+#include "DiffComplex.h"
 
 namespace gplib
   {
@@ -193,7 +194,132 @@ namespace gplib
 
           }
       }
+      //! Rotate the impedance elements xx, xy, yx, yy by angle in the same way as MTTensor::Rotate
+      static void DiffRotate(autodiff::DiffComplex Z[4],
+          const autodiff::DiffComplex &angle)
+        {
+          using autodiff::DiffComplex;
+          const DiffComplex c = cos(angle);
+          const DiffComplex s = sin(angle);
+          const DiffComplex ca2 = c * c;
+          const DiffComplex sa2 = s * s;
+          const DiffComplex casa = s * c;
+          const DiffComplex newxx = Z[0] * ca2 - (Z[1] + Z[2]) * casa + Z[3]
+              * sa2;
+          const DiffComplex newxy = Z[1] * ca2 + (Z[0] - Z[3]) * casa - Z[2]
+              * sa2;
+          const DiffComplex newyx = Z[2] * ca2 + (Z[0] - Z[3]) * casa - Z[1]
+              * sa2;
+          const DiffComplex newyy = Z[3] * ca2 + (Z[1] + Z[2]) * casa + Z[0]
+              * sa2;
+          Z[0] = newxx;
+          Z[1] = newxy;
+          Z[2] = newyx;
+          Z[3] = newyy;
+        }
+      //! The same recursion as CalcZ for a single frequency, with the derivative with respect to parameter param
+      /*! For horizontal anisotropy the first principal conductivity is along the strike direction and the second
+       * perpendicular to it, so we can use them directly instead of the effective values that are ordered by size.
+       * This keeps the response differentiable when the two resistivities are equal. The parameters are
+       * log10 rho1, the thickness in km, log10(rho2/rho1) and the strike in degree for each layer, as in Member2Aniso.
+       */
+      void DiffCalcZ(const double frequency, const size_t param,
+          autodiff::DiffComplex Z[4]) const
+        {
+          using autodiff::DiffComplex;
+          const size_t nlayers = thicknesses.size();
+          const double ln10 = std::log(10.0);
+          std::vector<DiffComplex> cond1(nlayers), cond2(nlayers), strike(
+              nlayers);
+          for (size_t i = 0; i < nlayers; ++i)
+            {
+              const double s1 = 1. / rho1.at(i);
+              const double s2 = 1. / rho2.at(i);
+              cond1[i] = DiffComplex(s1, (param == i) ? -ln10 * s1 : 0.0);
+              cond2[i] = DiffComplex(s2, (param == i || param == 2 * nlayers
+                  + i) ? -ln10 * s2 : 0.0);
+              strike[i] = DiffComplex(PI * strikes.at(i) / 180.0, (param == 3
+                  * nlayers + i) ? PI / 180.0 : 0.0);
+            }
+          const dcomp k0 = (1. - I) * 2.0e-3 * PI * sqrt(frequency / 10.0);
+          Z[0] = 0.0;
+          Z[1] = k0 / sqrt(cond1.back());
+          Z[2] = -k0 / sqrt(cond2.back());
+          Z[3] = 0.0;
+          DiffComplex currstrike = strike.back();
+          for (int layerindex = nlayers - 2; layerindex >= 0; --layerindex)
+            {
+              //the update for an isotropic layer does not change under rotation, so we can always rotate
+              DiffRotate(Z, strike[layerindex] - currstrike);
+              currstrike = strike[layerindex];
+              const DiffComplex currthick(1000.0 * thicknesses.at(layerindex),
+                  (param == nlayers + layerindex) ? 1000.0 : 0.0);
+              const DiffComplex dz1 = k0 / sqrt(cond1[layerindex]);
+              const DiffComplex dz2 = k0 / sqrt(cond2[layerindex]);
+              const DiffComplex ag1 = k0 * sqrt(cond1[layerindex]) * currthick;
+              const DiffComplex ag2 = k0 * sqrt(cond2[layerindex]) * currthick;
+              const DiffComplex fp1 = 1.0 + exp(-2.0 * ag1);
+              const DiffComplex fm1 = 1.0 - exp(-2.0 * ag1);
+              const DiffComplex fp2 = 1.0 + exp(-2.0 * ag2);
+              const DiffComplex fm2 = 1.0 - exp(-2.0 * ag2);
+              const DiffComplex det = Z[0] * Z[3] - Z[1] * Z[2];
+              const DiffComplex denominator = det * fm1 * fm2 / (dz1 * dz2)
+                  + Z[1] * fm1 * fp2 / dz1 - Z[2] * fp1 * fm2 / dz2 + fp1 * fp2;
+              const DiffComplex decay = exp(-ag1 - ag2);
+              const DiffComplex newxy = (Z[1] * fp1 * fp2 - Z[2] * fm1 * fm2
+                  * dz1 / dz2 + det * fp1 * fm2 / dz2 + fm1 * fp2 * dz1)
+                  / denominator;
+              const DiffComplex newyx = (Z[2] * fp1 * fp2 - Z[1] * fm1 * fm2
+                  * dz2 / dz1 - det * fm1 * fp2 / dz1 - fp1 * fm2 * dz2)
+                  / denominator;
+              Z[0] = 4.0 * Z[0] * decay / denominator;
+              Z[1] = newxy;
+              Z[2] = newyx;
+              Z[3] = 4.0 * Z[3] * decay / denominator;
+            }
+          const double convfactor = 1. / (1000. * mu);
+          for (size_t i = 0; i < 4; ++i)
+            Z[i] = convfactor * conj(Z[i]);
+          DiffRotate(Z, -currstrike);
+        }
     public:
+      //! Calculate the derivatives of the impedance elements with respect to the parameters of each layer
+      /*! The derivatives are calculated analytically by differentiating the recursion of the forward calculation.
+       * This is only implemented for horizontal anisotropy, i.e. all slants and dips have to be zero and rho3 has no influence.
+       * Sensitivities has four rows for each frequency of the last call to GetData, with the derivatives of
+       * Zxx, Zxy, Zyx and Zyy in this order. The columns are the derivatives with respect to log10 rho1 for all layers,
+       * then the thicknesses in km, then log10(rho2/rho1) and finally the strike angles in degree, i.e. the model
+       * parametrization of Member2Aniso.
+       */
+      void CalcSensitivities(cmat &Sensitivities)
+      {
+        const size_t nlayers = thicknesses.size();
+        if (calc_frequencies.empty() || nlayers == 0)
+          throw FatalException(
+              "Have to calculate the synthetic data before the sensitivities !");
+        if (rho1.size() != nlayers || rho2.size() != nlayers
+            || strikes.size() != nlayers || slants.size() != nlayers
+            || dips.size() != nlayers)
+          throw FatalException("Inconsistent model in C1DAnisoMTSynthData !");
+        for (size_t i = 0; i < nlayers; ++i)
+          if (slants.at(i) != 0.0 || dips.at(i) != 0.0)
+            throw FatalException(
+                "Sensitivities are only available for horizontal anisotropy !");
+        const size_t nparams = 4 * nlayers;
+        Sensitivities.resize(4 * calc_frequencies.size(), nparams, false);
+        Sensitivities.clear();
+        autodiff::DiffComplex Z[4];
+        for (size_t i = 0; i < calc_frequencies.size(); ++i)
+          for (size_t j = 0; j < nparams; ++j)
+            {
+              //the thickness of the half-space has no influence
+              if (j == 2 * nlayers - 1)
+                continue;
+              DiffCalcZ(calc_frequencies.at(i), j, Z);
+              for (size_t k = 0; k < 4; ++k)
+                Sensitivities(4 * i + k, j) = Z[k].deriv;
+            }
+      }
       //! Set the anisotropy strike for each layer in degree
       void SetStrikes(const trealdata &a)
         {
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <cassert>
 #include "FatalException.h"
+#include "DiffComplex.h"
 
 namespace gplib
   {
@@ -71,6 +72,41 @@ namespace gplib
 
           }
       }
+      //! The same recursion as Calc for a single frequency, with the derivative with respect to element param of the model vector
+      autodiff::DiffComplex DiffImpedance(const double frequency,
+          const size_t param) const
+        {
+          using autodiff::DiffComplex;
+          const size_t nlayers = resistivity.size();
+          const dcomp omegamu = -I * 8e-7 * PI * PI * frequency;
+          //the derivative of the conductivity with respect to log10 resistivity is -ln(10) sigma
+          std::vector<DiffComplex> sigma(nlayers);
+          for (size_t i = 0; i < nlayers; ++i)
+            sigma[i] = DiffComplex(1.0 / resistivity[i], (i == param) ? -std::log(
+                10.0) / resistivity[i] : 0.0);
+          DiffComplex kcurr = sqrt(omegamu * sigma.back());
+          DiffComplex alpha(0.0);
+          for (int layerindex = nlayers - 2; layerindex >= 0; --layerindex)
+            {
+              kcurr = sqrt(omegamu * sigma[layerindex]);
+              DiffComplex klow = sqrt(omegamu * sigma[layerindex + 1]);
+              if (kcurr.value.real() < 0.0)
+                {
+                  kcurr = -kcurr;
+                  klow = -klow;
+                }
+              const DiffComplex ksum = kcurr + klow;
+              const DiffComplex xi = omegamu * (sigma[layerindex]
+                  - sigma[layerindex + 1]) / (ksum * ksum);
+              alpha = (xi + alpha) / (1. + xi * alpha);
+              const DiffComplex d(thickness.at(layerindex) * 1000.0, (param
+                  == nlayers + layerindex) ? 1000.0 : 0.0);
+              alpha = alpha * exp(-2. * kcurr * d);
+            }
+          const DiffComplex adm = kcurr / (-I * 2. * PI * frequency) * ((1.
+              - alpha) / (1. + alpha));
+          return conj(1. / (1000.0 * adm));
+        }
       trealdata calc_frequencies;
       trealdata resistivity; //
       trealdata thickness; // Thickness for each layer
@@ -120,6 +156,33 @@ namespace gplib
           }
         return result;
       }
+      //! Calculate the derivatives of the impedance elements with respect to the elements of the model vector
+      /*! We differentiate the recursion of the forward calculation analytically for one parameter at a time.
+       * Sensitivities has four rows for each frequency of the last call to CalcSynthetic, with the derivatives of
+       * Zxx, Zxy, Zyx and Zyy in this order, and one column for each element of GetModelVector,
+       * i.e. log10 of the resistivities and the thicknesses in km.
+       */
+      void CalcSensitivities(cmat &Sensitivities)
+      {
+        assert(resistivity.size() == thickness.size());
+        if (calc_frequencies.empty() || resistivity.empty())
+          throw FatalException(
+              "Have to calculate the synthetic data before the sensitivities !");
+        const size_t nparams = 2 * resistivity.size();
+        Sensitivities.resize(4 * calc_frequencies.size(), nparams, false);
+        Sensitivities.clear();
+        for (size_t i = 0; i < calc_frequencies.size(); ++i)
+          for (size_t j = 0; j < nparams; ++j)
+            {
+              //the thickness of the half-space has no influence
+              if (j == nparams - 1)
+                continue;
+              const dcomp deriv =
+                  DiffImpedance(calc_frequencies.at(i), j).deriv;
+              Sensitivities(4 * i + 1, j) = deriv;
+              Sensitivities(4 * i + 2, j) = -deriv;
+            }
+      }
       //! Write model into file for cagniard algorithm
       void WriteModel(std::string filename)
       {
@@ -0,0 +1,129 @@
+#ifndef COLLAPSEDMODELCACHE_H_
+#define COLLAPSEDMODELCACHE_H_
+#include "gentypes.h"
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
+#include <vector>
+#include <deque>
+#include <cmath>
+
+namespace gplib
+  {
+    //! Store synthetic data for layered models after CollapseModel, so models that collapse to the same layers are only calculated once
+    /*! Many models of a genetic algorithm differ only in layers that CollapseModel merges, e.g. two layers with the same
+     * velocity and thicknesses of 5 and 5 km or of 3 and 7 km. UniquePop compares the parameters before the collapse, so it
+     * treats them as different models, but the synthetic data are identical. The key for this cache is the collapsed model
+     * together with all settings of the forward calculation, so objective functions with different settings can share
+     * a single cache. For the key we round all values to 40 significant bits, so thicknesses that are summed in a different order
+     * give the same key. The cache holds at most capacity entries, when it is full we remove the oldest entry.
+     * All functions can be called from several threads.
+     */
+    template<typename DataType>
+    class CollapsedModelCache
+      {
+    public:
+      typedef std::vector<double> tkey;
+    private:
+      typedef boost::unordered_map<tkey, DataType, boost::hash<tkey> >
+          tcachemap;
+      tcachemap Cache;
+      //! The keys in the order we inserted them, so we can remove the oldest entries
+      std::deque<tkey> InsertionOrder;
+      size_t capacity;
+      size_t hits;
+      size_t misses;
+      static double Canonical(const double value)
+        {
+          int exponent;
+          const double fraction = frexp(value, &exponent);
+          return ldexp(floor(ldexp(fraction, 40) + 0.5), exponent - 40);
+        }
+      //! Remove the oldest entries until we have at most capacity entries, has to be called in the critical section
+      void Shrink()
+        {
+          while (InsertionOrder.size() > capacity)
+            {
+              Cache.erase(InsertionOrder.front());
+              InsertionOrder.pop_front();
+            }
+        }
+    public:
+      //! Create the key for the collapsed layer thicknesses and parameter values and the settings of the forward calculation
+      static tkey MakeKey(const ttranscribed &Thickness,
+          const ttranscribed &Values, const std::vector<double> &Settings)
+        {
+          tkey Key;
+          Key.reserve(Settings.size() + Thickness.size() + Values.size() + 1);
+          Key.push_back(Thickness.size());
+          for (size_t i = 0; i < Settings.size(); ++i)
+            Key.push_back(Canonical(Settings.at(i)));
+          for (size_t i = 0; i < Thickness.size(); ++i)
+            Key.push_back(Canonical(Thickness(i)));
+          for (size_t i = 0; i < Values.size(); ++i)
+            Key.push_back(Canonical(Values(i)));
+          return Key;
+        }
+      //! Copy the data for Key to Data, returns false if we do not have it
+      bool Find(const tkey &Key, DataType &Data)
+        {
+          bool found = false;
+#pragma omp critical(collapsedmodelcache)
+            {
+              typename tcachemap::const_iterator FindPos = Cache.find(Key);
+              if (FindPos != Cache.end())
+                {
+                  Data = FindPos->second;
+                  found = true;
+                  ++hits;
+                }
+              else
+                ++misses;
+            }
+          return found;
+        }
+      //! Store the data for Key, if we already have data for Key we keep the old data
+      void Insert(const tkey &Key, const DataType &Data)
+        {
+#pragma omp critical(collapsedmodelcache)
+            {
+              if (capacity > 0 && Cache.insert(std::make_pair(Key, Data)).second)
+                {
+                  InsertionOrder.push_back(Key);
+                  Shrink();
+                }
+            }
+        }
+      //! Set the maximum number of models we store
+      void SetCapacity(const size_t maxentries)
+        {
+#pragma omp critical(collapsedmodelcache)
+            {
+              capacity = maxentries;
+              Shrink();
+            }
+        }
+      //! The number of models we store at the moment
+      size_t GetSize() const
+        {
+          return Cache.size();
+        }
+      //! The number of successful lookups
+      size_t GetHits() const
+        {
+          return hits;
+        }
+      //! The number of lookups for models we did not have
+      size_t GetMisses() const
+        {
+          return misses;
+        }
+      explicit CollapsedModelCache(const size_t maxentries = 10000) :
+        capacity(maxentries), hits(0), misses(0)
+        {
+        }
+      virtual ~CollapsedModelCache()
+        {
+        }
+      };
+  }
+#endif /*COLLAPSEDMODELCACHE_H_*/
@@ -0,0 +1,99 @@
+#ifndef DIFFCOMPLEX_H_
+#define DIFFCOMPLEX_H_
+#include <complex>
+#include <cmath>
+
+namespace gplib
+  {
+    /** \addtogroup mttools MT data analysis, processing and inversion */
+    /* @{ */
+
+    //! Forward mode differentiation, the math functions are only found by argument dependent lookup
+    /*! We keep the overloads in their own namespace, otherwise unqualified calls of exp, sqrt etc.
+     * with real arguments in namespace gplib would resolve to the versions for DiffComplex.
+     */
+    namespace autodiff
+      {
+        //! A complex number together with its derivative with respect to a single real parameter
+        /*! We use this class to differentiate the layer recursions of the 1D MT forward calculations
+         * in forward mode: the derivative of each intermediate result is propagated together with its value
+         * according to the chain rule, so the result is exact up to rounding errors.
+         */
+        class DiffComplex
+          {
+        public:
+          typedef std::complex<double> tcomp;
+          //! The value
+          tcomp value;
+          //! The derivative with respect to the parameter
+          tcomp deriv;
+          DiffComplex(const tcomp &v, const tcomp &d = tcomp(0.0, 0.0)) :
+            value(v), deriv(d)
+            {
+            }
+          DiffComplex(const double v = 0.0) :
+            value(v, 0.0), deriv(0.0, 0.0)
+            {
+            }
+          };
+
+        inline DiffComplex operator+(const DiffComplex &a, const DiffComplex &b)
+          {
+            return DiffComplex(a.value + b.value, a.deriv + b.deriv);
+          }
+
+        inline DiffComplex operator-(const DiffComplex &a, const DiffComplex &b)
+          {
+            return DiffComplex(a.value - b.value, a.deriv - b.deriv);
+          }
+
+        inline DiffComplex operator-(const DiffComplex &a)
+          {
+            return DiffComplex(-a.value, -a.deriv);
+          }
+
+        inline DiffComplex operator*(const DiffComplex &a, const DiffComplex &b)
+          {
+            return DiffComplex(a.value * b.value, a.deriv * b.value + a.value
+                * b.deriv);
+          }
+
+        inline DiffComplex operator/(const DiffComplex &a, const DiffComplex &b)
+          {
+            const DiffComplex::tcomp quotient = a.value / b.value;
+            return DiffComplex(quotient, (a.deriv - quotient * b.deriv) / b.value);
+          }
+
+        inline DiffComplex exp(const DiffComplex &a)
+          {
+            const DiffComplex::tcomp e = std::exp(a.value);
+            return DiffComplex(e, e * a.deriv);
+          }
+
+        //! The principal square root, not differentiable at zero
+        inline DiffComplex sqrt(const DiffComplex &a)
+          {
+            const DiffComplex::tcomp s = std::sqrt(a.value);
+            return DiffComplex(s, a.deriv / (2.0 * s));
+          }
+
+        inline DiffComplex cos(const DiffComplex &a)
+          {
+            return DiffComplex(std::cos(a.value), -std::sin(a.value) * a.deriv);
+          }
+
+        inline DiffComplex sin(const DiffComplex &a)
+          {
+            return DiffComplex(std::sin(a.value), std::cos(a.value) * a.deriv);
+          }
+
+        //! The complex conjugate, the derivative is conjugated as well as the parameter is real
+        inline DiffComplex conj(const DiffComplex &a)
+          {
+            return DiffComplex(std::conj(a.value), std::conj(a.deriv));
+          }
+      }
+  /* @} */
+  }
+#endif /*DIFFCOMPLEX_H_*/
+
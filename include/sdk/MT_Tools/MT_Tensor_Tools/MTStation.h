@@ -711,7 +711,10 @@ void TrimFilename(std::string &name)
             TFData.resize(nfreqs);
           }
         for (unsigned int i = 0; i < nfreqs; ++i)
-          MTData.at(i).frequency = freqs.at(i);
+          {
+            MTData.at(i).frequency = freqs.at(i);
+            TFData.at(i).frequency = freqs.at(i);
+          }
         assert(MTData.size() == TFData.size());
 
       }
@@ -736,15 +739,27 @@ void TrimFilename(std::string &name)
         {
           return elevation;
         }
+      void SetElevation(double elev)
+        {
+          elevation = elev;
+        }
       std::string GetName()
         {
           return name;
         }
+      void SetName(const std::string &n)
+        {
+          name = n;
+        }
       double GetAzimuth() const
         {
           return azimuth;
         }
       ;
+      void SetAzimuth(double az)
+        {
+          azimuth = az;
+        }
       //! direct acces to a tensor at a given index
       const MTTensor &at(const unsigned int i) const
         {
@@ -760,6 +775,16 @@ void TrimFilename(std::string &name)
         {
           return MTData;
         }
+      //! Get the full vector of magnetic transfer functions read only
+      const std::vector<MagneticTF> &GetTFData() const
+        {
+          return TFData;
+        }
+      //! Get the full vector of magnetic transfer functions for reading and writing
+      std::vector<MagneticTF> &SetTFData()
+        {
+          return TFData;
+        }
       //! for parallel runs we need to make a copy of the object and its derived classes
       virtual MTStation *clone() const
         {
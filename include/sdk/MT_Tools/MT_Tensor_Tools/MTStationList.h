@@ -3,6 +3,7 @@
 
 #include <string>
 #include "MTStation.h"
+#include "MTSurvey.h"
 #include <vector>
 #include <utility>
 #include "StationParser.h"
@@ -93,8 +94,16 @@ namespace gplib
           return StationData;
         }
       //! Read a list of filenames and the associated data in those files to fill the list
+      /*! If filename has the ending of a binary survey file, the stations are read from this file
+       * instead, see ReadSurvey.
+       */
       void GetData(const std::string filename)
       {
+        if (boost::filesystem::extension(filename) == MTSurveyEnding)
+          {
+            ReadSurvey(filename);
+            return;
+          }
         ifstream infile(filename.c_str());
 
         if (infile)
@@ -149,6 +158,24 @@ namespace gplib
             outfile << endl;
           }
       }
+      //! Read all stations from a binary survey file, see MTSurvey
+      void ReadSurvey(const std::string filename)
+      {
+        MTSurvey Survey;
+        Survey.GetData(filename);
+        Survey.GetStations(StationData);
+        if (!StationData.empty())
+          {
+            FindCommon();
+          }
+      }
+      //! Write all stations to a single binary survey file, see MTSurvey
+      void WriteSurvey(const std::string filename)
+      {
+        MTSurvey Survey;
+        Survey.Assign(StationData);
+        Survey.WriteData(filename);
+      }
       //! Write the data of each station to an individual file
       void WriteAllData()
       {
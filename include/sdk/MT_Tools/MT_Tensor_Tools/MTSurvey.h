@@ -0,0 +1,402 @@
+#ifndef MTSURVEY_H_
+#define MTSURVEY_H_
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "MTStation.h"
+#include "FatalException.h"
+
+namespace gplib
+  {
+    /** \addtogroup mttools MT data analysis, processing and inversion */
+    /* @{ */
+
+    //! The magic string at the beginning of each binary survey file
+    static const char MTSurveyMagic[8] =
+      { 'G', 'P', 'M', 'T', 'S', 'V', 'Y', '\0' };
+    //! The version of the binary survey format written by this code
+    static const boost::uint32_t MTSurveyVersion = 1;
+    //! Written as a native integer so we can detect files from machines with different byte order
+    static const boost::uint32_t MTSurveyByteOrder = 0x01020304;
+    //! The file ending we use for binary survey files
+    static const std::string MTSurveyEnding = ".mtsurvey";
+
+    //! The fixed size header of a binary survey file
+    struct MTSurveyHeader
+      {
+      char magic[8];
+      boost::uint32_t byteorder;
+      boost::uint32_t version;
+      boost::uint32_t ncolumns;
+      boost::uint32_t reserved;
+      boost::uint64_t nstations;
+      boost::uint64_t nrows;
+      boost::uint64_t namebytes;
+      };
+
+    //! Stores the impedances and tippers of a whole survey in columnar arrays
+    /*! MTSurvey is the structure of arrays counterpart to a list of MTStation objects. Each quantity,
+     * e.g. the real part of Zxy or the error of Ty, is stored as one contiguous column of doubles
+     * that contains the values for all frequencies of all stations. The rows of each station are stored
+     * contiguously, GetStationOffset and GetStationSize give the range of rows for a station.
+     *
+     * The columns can be written to and read from a versioned binary file. When reading, the
+     * file is memory mapped and the columns point directly into the mapped region, so opening
+     * a large survey does not involve any parsing or copying of the impedance data.
+     *
+     * The file consists of the MTSurveyHeader, nstations+1 row offsets as 64bit integers,
+     * the latitude, longitude, elevation and azimuth columns of the stations, the zero separated
+     * station names padded to a multiple of 8 bytes and finally ncolumns data columns with nrows
+     * doubles each. All values are stored in native byte order.
+     */
+    class MTSurvey
+      {
+    public:
+      //! The data columns in the order in which they are stored in the file
+      enum tcolumn
+        {
+        frequency,
+        rotangle,
+        zxx_re,
+        zxx_im,
+        zxy_re,
+        zxy_im,
+        zyx_re,
+        zyx_im,
+        zyy_re,
+        zyy_im,
+        dzxx,
+        dzxy,
+        dzyx,
+        dzyy,
+        tx_re,
+        tx_im,
+        ty_re,
+        ty_im,
+        dtx,
+        dty,
+        ncolumns
+        };
+    private:
+      //! The index of the first row for each station, has nstations + 1 elements
+      std::vector<boost::uint64_t> Offsets;
+      std::vector<double> Latitudes;
+      std::vector<double> Longitudes;
+      std::vector<double> Elevations;
+      std::vector<double> Azimuths;
+      std::vector<std::string> Names;
+      //! Storage for the columns if the survey was not read from a file
+      std::vector<double> ColumnStorage;
+      //! The mapped file if the survey was read from a file
+      boost::shared_ptr<boost::interprocess::mapped_region> Region;
+      //! Points to the first element of the first column, either in ColumnStorage or in Region
+      double *Base;
+      //! Let Base point to the beginning of the owned column storage
+      void AttachStorage()
+        {
+          Base = ColumnStorage.empty() ? NULL : &ColumnStorage[0];
+        }
+      static size_t Padded(const size_t nbytes)
+        {
+          return (nbytes + 7) / 8 * 8;
+        }
+      static void WriteDoubles(std::ofstream &outfile,
+          const std::vector<double> &values)
+        {
+          if (!values.empty())
+            outfile.write(reinterpret_cast<const char *> (&values[0]),
+                values.size() * sizeof(double));
+        }
+    public:
+      //! The number of stations in the survey
+      size_t GetNStations() const
+        {
+          return Names.size();
+        }
+      //! The total number of rows, i.e. the sum of the number of frequencies over all stations
+      size_t GetNRows() const
+        {
+          return Offsets.empty() ? 0 : Offsets.back();
+        }
+      //! The index of the first row that belongs to station i
+      size_t GetStationOffset(const size_t i) const
+        {
+          return Offsets.at(i);
+        }
+      //! The number of rows (frequencies) that belong to station i
+      size_t GetStationSize(const size_t i) const
+        {
+          return Offsets.at(i + 1) - Offsets.at(i);
+        }
+      //! Read only access to one column for all stations
+      const double *GetColumn(const tcolumn col) const
+        {
+          return Base + size_t(col) * GetNRows();
+        }
+      //! Read only access to one column starting at the first row of station i
+      const double *GetColumn(const tcolumn col, const size_t i) const
+        {
+          return GetColumn(col) + GetStationOffset(i);
+        }
+      const std::string &GetName(const size_t i) const
+        {
+          return Names.at(i);
+        }
+      const std::vector<double> &GetLatitudes() const
+        {
+          return Latitudes;
+        }
+      const std::vector<double> &GetLongitudes() const
+        {
+          return Longitudes;
+        }
+      const std::vector<double> &GetElevations() const
+        {
+          return Elevations;
+        }
+      const std::vector<double> &GetAzimuths() const
+        {
+          return Azimuths;
+        }
+      //! Copy the data of a list of stations into the columns
+      void Assign(const std::vector<MTStation> &Stations)
+      {
+        const size_t nstations = Stations.size();
+        Region.reset();
+        Offsets.assign(1, 0);
+        Latitudes.clear();
+        Longitudes.clear();
+        Elevations.clear();
+        Azimuths.clear();
+        Names.clear();
+        for (size_t i = 0; i < nstations; ++i)
+          {
+            MTStation Station(Stations.at(i));
+            Offsets.push_back(Offsets.back() + Station.GetMTData().size());
+            Latitudes.push_back(Station.GetLatitude());
+            Longitudes.push_back(Station.GetLongitude());
+            Elevations.push_back(Station.GetElevation());
+            Azimuths.push_back(Station.GetAzimuth());
+            Names.push_back(Station.GetName());
+          }
+        const size_t nrows = GetNRows();
+        ColumnStorage.assign(size_t(ncolumns) * nrows, 0.0);
+        AttachStorage();
+        for (size_t i = 0; i < nstations; ++i)
+          {
+            const std::vector<MTTensor> &MTData = Stations.at(i).GetMTData();
+            const std::vector<MagneticTF> &TFData = Stations.at(i).GetTFData();
+            for (size_t j = 0; j < MTData.size(); ++j)
+              {
+                double *row = Base + Offsets.at(i) + j;
+                const MTTensor &Z = MTData.at(j);
+                row[frequency * nrows] = Z.GetFrequency();
+                row[rotangle * nrows] = Z.GetRotangle();
+                row[zxx_re * nrows] = Z.GetZxx().real();
+                row[zxx_im * nrows] = Z.GetZxx().imag();
+                row[zxy_re * nrows] = Z.GetZxy().real();
+                row[zxy_im * nrows] = Z.GetZxy().imag();
+                row[zyx_re * nrows] = Z.GetZyx().real();
+                row[zyx_im * nrows] = Z.GetZyx().imag();
+                row[zyy_re * nrows] = Z.GetZyy().real();
+                row[zyy_im * nrows] = Z.GetZyy().imag();
+                row[dzxx * nrows] = Z.GetdZxx();
+                row[dzxy * nrows] = Z.GetdZxy();
+                row[dzyx * nrows] = Z.GetdZyx();
+                row[dzyy * nrows] = Z.GetdZyy();
+                if (j < TFData.size())
+                  {
+                    const MagneticTF &T = TFData.at(j);
+                    row[tx_re * nrows] = T.GetTx().real();
+                    row[tx_im * nrows] = T.GetTx().imag();
+                    row[ty_re * nrows] = T.GetTy().real();
+                    row[ty_im * nrows] = T.GetTy().imag();
+                    row[dtx * nrows] = T.GetdTx();
+                    row[dty * nrows] = T.GetdTy();
+                  }
+              }
+          }
+      }
+      //! Create a list of stations from the columns, the stations will be appended to Stations
+      void GetStations(std::vector<MTStation> &Stations) const
+      {
+        const size_t nstations = GetNStations();
+        for (size_t i = 0; i < nstations; ++i)
+          {
+            const size_t nfreq = GetStationSize(i);
+            MTStation Station(nfreq);
+            Station.SetName(Names.at(i));
+            Station.SetLatitude(Latitudes.at(i));
+            Station.SetLongitude(Longitudes.at(i));
+            Station.SetElevation(Elevations.at(i));
+            Station.SetAzimuth(Azimuths.at(i));
+            Station.SetFrequencies(trealdata(GetColumn(frequency, i),
+                GetColumn(frequency, i) + nfreq));
+            for (size_t j = 0; j < nfreq; ++j)
+              {
+                MTTensor &Z = Station.SetMTData().at(j);
+                Z.SetRotangle() = GetColumn(rotangle, i)[j];
+                Z.SetZxx() = dcomp(GetColumn(zxx_re, i)[j],
+                    GetColumn(zxx_im, i)[j]);
+                Z.SetZxy() = dcomp(GetColumn(zxy_re, i)[j],
+                    GetColumn(zxy_im, i)[j]);
+                Z.SetZyx() = dcomp(GetColumn(zyx_re, i)[j],
+                    GetColumn(zyx_im, i)[j]);
+                Z.SetZyy() = dcomp(GetColumn(zyy_re, i)[j],
+                    GetColumn(zyy_im, i)[j]);
+                Z.SetErrors(GetColumn(dzxx, i)[j], GetColumn(dzxy, i)[j],
+                    GetColumn(dzyx, i)[j], GetColumn(dzyy, i)[j]);
+                MagneticTF &T = Station.SetTFData().at(j);
+                T.SetTx() = dcomp(GetColumn(tx_re, i)[j],
+                    GetColumn(tx_im, i)[j]);
+                T.SetTy() = dcomp(GetColumn(ty_re, i)[j],
+                    GetColumn(ty_im, i)[j]);
+                T.SetdTx() = GetColumn(dtx, i)[j];
+                T.SetdTy() = GetColumn(dty, i)[j];
+              }
+            Stations.push_back(Station);
+          }
+      }
+      //! Write the survey to a binary file
+      void WriteData(const std::string &filename) const
+      {
+        std::ofstream outfile(filename.c_str(), std::ios::binary);
+        if (!outfile)
+          throw FatalException("Cannot write survey file: " + filename);
+        std::string namestring;
+        for (size_t i = 0; i < Names.size(); ++i)
+          {
+            namestring += Names.at(i);
+            namestring.push_back('\0');
+          }
+        const size_t namebytes = Padded(namestring.size());
+        namestring.resize(namebytes, '\0');
+
+        MTSurveyHeader Header;
+        std::memset(&Header, 0, sizeof(Header));
+        std::memcpy(Header.magic, MTSurveyMagic, sizeof(Header.magic));
+        Header.byteorder = MTSurveyByteOrder;
+        Header.version = MTSurveyVersion;
+        Header.ncolumns = ncolumns;
+        Header.nstations = GetNStations();
+        Header.nrows = GetNRows();
+        Header.namebytes = namebytes;
+        outfile.write(reinterpret_cast<const char *> (&Header), sizeof(Header));
+        outfile.write(reinterpret_cast<const char *> (&Offsets[0]),
+            Offsets.size() * sizeof(boost::uint64_t));
+        WriteDoubles(outfile, Latitudes);
+        WriteDoubles(outfile, Longitudes);
+        WriteDoubles(outfile, Elevations);
+        WriteDoubles(outfile, Azimuths);
+        outfile.write(namestring.data(), namestring.size());
+        if (GetNRows() > 0)
+          outfile.write(reinterpret_cast<const char *> (Base), size_t(ncolumns)
+              * GetNRows() * sizeof(double));
+        if (!outfile)
+          throw FatalException("Error writing survey file: " + filename);
+      }
+      //! Map a binary survey file into memory, the columns are not copied
+      void GetData(const std::string &filename)
+      {
+        using namespace boost::interprocess;
+        boost::shared_ptr<mapped_region> NewRegion;
+        try
+          {
+            file_mapping File(filename.c_str(), read_only);
+            NewRegion.reset(new mapped_region(File, read_only));
+          } catch (interprocess_exception &e)
+          {
+            throw FatalException("Cannot map survey file: " + filename + " "
+                + e.what());
+          }
+        const char *data = static_cast<const char *> (NewRegion->get_address());
+        const size_t filesize = NewRegion->get_size();
+        MTSurveyHeader Header;
+        if (filesize < sizeof(Header))
+          throw FatalException("Survey file too short: " + filename);
+        std::memcpy(&Header, data, sizeof(Header));
+        if (std::memcmp(Header.magic, MTSurveyMagic, sizeof(Header.magic)) != 0)
+          throw FatalException("Not a survey file: " + filename);
+        if (Header.byteorder != MTSurveyByteOrder)
+          throw FatalException("Survey file has wrong byte order: " + filename);
+        if (Header.version > MTSurveyVersion || Header.ncolumns < ncolumns)
+          throw FatalException("Unsupported survey file version: " + filename);
+        const size_t nstations = Header.nstations;
+        const size_t nrows = Header.nrows;
+        const size_t offsetpos = sizeof(Header);
+        const size_t stationpos = offsetpos + (nstations + 1)
+            * sizeof(boost::uint64_t);
+        const size_t namepos = stationpos + 4 * nstations * sizeof(double);
+        const size_t columnpos = namepos + Header.namebytes;
+        if (Header.namebytes % 8 != 0 || filesize < columnpos + size_t(
+            Header.ncolumns) * nrows * sizeof(double))
+          throw FatalException("Survey file is corrupt: " + filename);
+
+        const boost::uint64_t *offsets =
+            reinterpret_cast<const boost::uint64_t *> (data + offsetpos);
+        Offsets.assign(offsets, offsets + nstations + 1);
+        if (Offsets.front() != 0 || Offsets.back() != nrows)
+          throw FatalException("Survey file is corrupt: " + filename);
+        const double *stations = reinterpret_cast<const double *> (data
+            + stationpos);
+        Latitudes.assign(stations, stations + nstations);
+        Longitudes.assign(stations + nstations, stations + 2 * nstations);
+        Elevations.assign(stations + 2 * nstations, stations + 3 * nstations);
+        Azimuths.assign(stations + 3 * nstations, stations + 4 * nstations);
+        Names.clear();
+        const char *name = data + namepos;
+        for (size_t i = 0; i < nstations; ++i)
+          {
+            Names.push_back(std::string(name));
+            name += Names.back().size() + 1;
+          }
+        ColumnStorage.clear();
+        Region = NewRegion;
+        // the mapping is read only, Base is only non-const to share the code path with ColumnStorage
+        Base = const_cast<double *> (reinterpret_cast<const double *> (data
+            + columnpos));
+      }
+      MTSurvey() :
+        Offsets(1, 0), Base(NULL)
+        {
+        }
+      MTSurvey(const MTSurvey &Old) :
+        Offsets(Old.Offsets), Latitudes(Old.Latitudes), Longitudes(
+            Old.Longitudes), Elevations(Old.Elevations), Azimuths(Old.Azimuths),
+            Names(Old.Names), ColumnStorage(Old.ColumnStorage), Region(
+                Old.Region), Base(Old.Base)
+        {
+          if (!Region)
+            AttachStorage();
+        }
+      MTSurvey &operator=(const MTSurvey &source)
+      {
+        if (this != &source)
+          {
+            Offsets = source.Offsets;
+            Latitudes = source.Latitudes;
+            Longitudes = source.Longitudes;
+            Elevations = source.Elevations;
+            Azimuths = source.Azimuths;
+            Names = source.Names;
+            ColumnStorage = source.ColumnStorage;
+            Region = source.Region;
+            Base = source.Base;
+            if (!Region)
+              AttachStorage();
+          }
+        return *this;
+      }
+      virtual ~MTSurvey()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*MTSURVEY_H_*/
@@ -0,0 +1,344 @@
+#ifndef MTSURVEYQUANTITIES_H_
+#define MTSURVEYQUANTITIES_H_
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <boost/random/variate_generator.hpp>
+#include "MTSurvey.h"
+#include "types.h"
+#include "FatalException.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace gplib
+  {
+    /** \addtogroup mttools MT data analysis, processing and inversion */
+    /* @{ */
+
+    //! Calculate apparent resistivity, phase and phase tensor quantities for all impedances of a survey at once
+    /*! MTSurveyQuantities takes the impedance columns of a MTSurvey and calculates the derived quantities
+     * that MTTensor provides through its member functions, e.g. GetRhoxy, GetPhi12 or GetPhiStrike, for all
+     * frequencies of all stations in one pass. The results are stored as columns with the same row order as
+     * the survey, so they can be used directly for maps or averages over the survey.
+     *
+     * The rows are processed in blocks that are distributed over threads with OpenMP, within each block
+     * the loop over rows has no dependencies and is written so that the compiler can vectorize it.
+     *
+     * Errors can either be calculated by linearized error propagation from the impedance errors or by
+     * parametric bootstrap, i.e. drawing normally distributed impedances around the measured values
+     * in the same way as MTSampleGenerator does for a single tensor. In both cases real and imaginary
+     * part of each impedance element are assumed to have an independent error of dZ.
+     *
+     * Units follow MTTensor: apparent resistivities in Ohmm, impedance phases in degree and phase tensor
+     * angles in radian.
+     */
+    class MTSurveyQuantities
+      {
+    public:
+      //! The quantities we calculate for each row of the survey
+      enum tquantity
+        {
+        rhoxx,
+        rhoxy,
+        rhoyx,
+        rhoyy,
+        phixx,
+        phixy,
+        phiyx,
+        phiyy,
+        phi11,
+        phi12,
+        phi21,
+        phi22,
+        phimin,
+        phimax,
+        alpha_phi,
+        beta_phi,
+        phistrike,
+        phiellip,
+        kappa,
+        nquantities
+        };
+      //! The type of error calculation
+      enum terrortype
+        {
+        noerrors, linearized, bootstrap
+        };
+    private:
+      //! The number of rows processed by a thread in one go
+      static const size_t blocksize = 256;
+      //! The number of rows of the last calculation
+      size_t nrows;
+      //! The calculated quantities, nquantities columns with nrows each
+      std::vector<double> Values;
+      //! The error for each quantity, same layout as Values
+      std::vector<double> Errors;
+      //! The number of samples for bootstrap errors
+      int nsamples;
+      //! The relative error floor for the impedance elements
+      double errorlevel;
+      //! The seed for the bootstrap random numbers, each row uses seed + rowindex
+      unsigned int seed;
+      //! Divide, but return 0 if the denominator is 0, so we get the same behaviour as MTTensor
+      static double SafeDiv(const double num, const double denom)
+        {
+          return denom != 0.0 ? num / denom : 0.0;
+        }
+      //! The period of the angular quantities, 0 for quantities that are not angles
+      static double AnglePeriod(const int q)
+        {
+          switch (q)
+            {
+          case phixx:
+          case phixy:
+          case phiyx:
+          case phiyy:
+            return 360.0;
+          case alpha_phi:
+          case beta_phi:
+          case phistrike:
+            return PI;
+          default:
+            return 0.0;
+            }
+        }
+      //! The difference of two values of quantity q, for angles this is wrapped to half the period
+      static double Difference(const int q, const double a, const double b)
+        {
+          const double period = AnglePeriod(q);
+          double diff = a - b;
+          if (period > 0.0)
+            diff -= period * std::floor(diff / period + 0.5);
+          return diff;
+        }
+      //! Calculate all quantities from the 8 real impedance values and the frequency, results are written with stride
+      /*! The order of z is zxx_re, zxx_im, zxy_re, zxy_im, zyx_re, zyx_im, zyy_re, zyy_im.
+       */
+      static void CalcRow(const double *z, const double freq, double *out,
+          const size_t stride)
+        {
+          const double rhofactor = mu / (2 * PI * freq) * 1000000.0;
+          const double degree = 180.0 / PI;
+          for (int k = 0; k < 4; ++k)
+            {
+              const double re = z[2 * k];
+              const double im = z[2 * k + 1];
+              out[(rhoxx + k) * stride] = rhofactor * (re * re + im * im);
+              out[(phixx + k) * stride] = re != 0.0 ? std::atan2(im, re)
+                  * degree : 0.0;
+            }
+          // Phi = X^-1 Y with X the real part and Y the imaginary part of Z
+          const double detreal = z[0] * z[6] - z[2] * z[4];
+          const double p11 = SafeDiv(z[6] * z[1] - z[2] * z[5], detreal);
+          const double p12 = SafeDiv(z[6] * z[3] - z[2] * z[7], detreal);
+          const double p21 = SafeDiv(z[0] * z[5] - z[4] * z[1], detreal);
+          const double p22 = SafeDiv(z[0] * z[7] - z[4] * z[3], detreal);
+          const double pi1 = 0.5 * std::sqrt((p11 - p22) * (p11 - p22) + (p12
+              + p21) * (p12 + p21));
+          const double pi2 = 0.5 * std::sqrt((p11 + p22) * (p11 + p22) + (p12
+              - p21) * (p12 - p21));
+          const double alpha = (p11 - p22) != 0.0 ? 0.5 * std::atan2(p12 + p21,
+              p11 - p22) : 0.0;
+          const double beta = 0.5 * std::atan2(p12 - p21, p11 + p22);
+          out[phi11 * stride] = p11;
+          out[phi12 * stride] = p12;
+          out[phi21 * stride] = p21;
+          out[phi22 * stride] = p22;
+          out[phimin * stride] = pi2 - pi1;
+          out[phimax * stride] = pi2 + pi1;
+          out[alpha_phi * stride] = alpha;
+          out[beta_phi * stride] = beta;
+          out[phistrike * stride] = alpha - beta;
+          out[phiellip * stride] = SafeDiv(2.0 * pi1, 2.0 * pi2);
+          // Swift's skew |Zxx + Zyy| / |Zxy - Zyx|
+          const double s1re = z[0] + z[6];
+          const double s1im = z[1] + z[7];
+          const double d2re = z[2] - z[4];
+          const double d2im = z[3] - z[5];
+          out[kappa * stride] = SafeDiv(std::sqrt(s1re * s1re + s1im * s1im),
+              std::sqrt(d2re * d2re + d2im * d2im));
+        }
+      //! Linearized errors, analytic for resistivity and phase, numerical derivatives w.r.t. the impedances otherwise
+      void CalcLinearizedRow(const double *z, const double *dz,
+          const double freq, const double *values, double *err,
+          const size_t stride) const
+        {
+          const double rhofactor = mu / (PI * freq) * 1000000.0;
+          const double degree = 180.0 / PI;
+          double variance[nquantities];
+          double perturbed[nquantities];
+          double zp[8];
+          for (int q = 0; q < nquantities; ++q)
+            variance[q] = 0.0;
+          double scale = 0.0;
+          for (int k = 0; k < 8; ++k)
+            {
+              zp[k] = z[k];
+              scale = std::max(scale, std::abs(z[k]));
+            }
+          const double h = std::max(scale, 1e-30) * 1e-7;
+          for (int k = 0; k < 8; ++k)
+            {
+              zp[k] = z[k] + h;
+              CalcRow(zp, freq, perturbed, 1);
+              zp[k] = z[k];
+              for (int q = phi11; q < nquantities; ++q)
+                {
+                  const double deriv = Difference(q, perturbed[q], values[q
+                      * stride]) / h;
+                  variance[q] += deriv * deriv * dz[k / 2] * dz[k / 2];
+                }
+            }
+          for (int k = 0; k < 4; ++k)
+            {
+              const double absz = std::sqrt(z[2 * k] * z[2 * k] + z[2 * k + 1]
+                  * z[2 * k + 1]);
+              err[(rhoxx + k) * stride] = rhofactor * absz * dz[k];
+              err[(phixx + k) * stride] = SafeDiv(dz[k], absz) * degree;
+            }
+          for (int q = phi11; q < nquantities; ++q)
+            err[q * stride] = std::sqrt(variance[q]);
+        }
+      //! Bootstrap errors by drawing random impedances with the given errors
+      void CalcBootstrapRow(const double *z, const double *dz,
+          const double freq, const double *values, double *err,
+          const size_t stride, const size_t rowindex) const
+        {
+          boost::mt19937 generator(seed + static_cast<unsigned int> (rowindex));
+          boost::normal_distribution<> dist(0.0, 1.0);
+          boost::variate_generator<boost::mt19937&, boost::normal_distribution<> >
+              normal(generator, dist);
+          double sum[nquantities];
+          double sumsq[nquantities];
+          double sample[nquantities];
+          double zp[8];
+          for (int q = 0; q < nquantities; ++q)
+            {
+              sum[q] = 0.0;
+              sumsq[q] = 0.0;
+            }
+          for (int i = 0; i < nsamples; ++i)
+            {
+              for (int k = 0; k < 8; ++k)
+                zp[k] = z[k] + normal() * dz[k / 2];
+              CalcRow(zp, freq, sample, 1);
+              for (int q = 0; q < nquantities; ++q)
+                {
+                  // we accumulate deviations from the unperturbed value to handle angles close to the wrap around
+                  const double diff = Difference(q, sample[q], values[q
+                      * stride]);
+                  sum[q] += diff;
+                  sumsq[q] += diff * diff;
+                }
+            }
+          for (int q = 0; q < nquantities; ++q)
+            {
+              const double mean = sum[q] / nsamples;
+              err[q * stride] = std::sqrt(std::max(0.0, (sumsq[q] - nsamples
+                  * mean * mean) / (nsamples - 1)));
+            }
+        }
+    public:
+      //! Calculate all quantities for all rows of Survey, with errors of the given type
+      void Calculate(const MTSurvey &Survey, const terrortype errortype =
+          linearized)
+      {
+        if (errortype == bootstrap && nsamples < 2)
+          throw FatalException(
+              "Need at least 2 samples for bootstrap error calculation !");
+        nrows = Survey.GetNRows();
+        Values.assign(size_t(nquantities) * nrows, 0.0);
+        Errors.assign(size_t(nquantities) * nrows, 0.0);
+        if (nrows == 0)
+          return;
+        const double *freq = Survey.GetColumn(MTSurvey::frequency);
+        const double *zcol[8] =
+          { Survey.GetColumn(MTSurvey::zxx_re), Survey.GetColumn(
+              MTSurvey::zxx_im), Survey.GetColumn(MTSurvey::zxy_re),
+              Survey.GetColumn(MTSurvey::zxy_im), Survey.GetColumn(
+                  MTSurvey::zyx_re), Survey.GetColumn(MTSurvey::zyx_im),
+              Survey.GetColumn(MTSurvey::zyy_re), Survey.GetColumn(
+                  MTSurvey::zyy_im) };
+        const double *dzcol[4] =
+          { Survey.GetColumn(MTSurvey::dzxx), Survey.GetColumn(MTSurvey::dzxy),
+              Survey.GetColumn(MTSurvey::dzyx), Survey.GetColumn(MTSurvey::dzyy) };
+        double *values = &Values[0];
+        double *errors = &Errors[0];
+        const int nblocks = (nrows + blocksize - 1) / blocksize;
+#pragma omp parallel for default(shared) schedule(dynamic)
+        for (int block = 0; block < nblocks; ++block)
+          {
+            const size_t start = size_t(block) * blocksize;
+            const size_t end = std::min(nrows, start + blocksize);
+            double z[8];
+            double dz[4];
+#pragma omp simd private(z)
+            for (size_t i = start; i < end; ++i)
+              {
+                for (int k = 0; k < 8; ++k)
+                  z[k] = zcol[k][i];
+                CalcRow(z, freq[i], values + i, nrows);
+              }
+            if (errortype == noerrors)
+              continue;
+            for (size_t i = start; i < end; ++i)
+              {
+                for (int k = 0; k < 8; ++k)
+                  z[k] = zcol[k][i];
+                for (int k = 0; k < 4; ++k)
+                  dz[k] = std::max(dzcol[k][i], errorlevel * std::sqrt(z[2
+                      * k] * z[2 * k] + z[2 * k + 1] * z[2 * k + 1]));
+                if (errortype == linearized)
+                  CalcLinearizedRow(z, dz, freq[i], values + i, errors + i,
+                      nrows);
+                else
+                  CalcBootstrapRow(z, dz, freq[i], values + i, errors + i,
+                      nrows, i);
+              }
+          }
+      }
+      //! The number of rows of the last calculation, identical to the number of rows in the survey
+      size_t GetNRows() const
+        {
+          return nrows;
+        }
+      //! The values of quantity q for all rows
+      const double *GetValues(const tquantity q) const
+        {
+          return Values.empty() ? NULL : &Values[0] + size_t(q) * nrows;
+        }
+      //! The errors of quantity q for all rows
+      const double *GetErrors(const tquantity q) const
+        {
+          return Errors.empty() ? NULL : &Errors[0] + size_t(q) * nrows;
+        }
+      //! Set the number of samples for bootstrap errors
+      void SetNSamples(const int n)
+        {
+          nsamples = n;
+        }
+      //! Set a relative error floor for the impedance elements
+      void SetErrorLevel(const double level)
+        {
+          errorlevel = level;
+        }
+      //! Set the seed for bootstrap errors, the same seed gives the same errors
+      void SetSeed(const unsigned int s)
+        {
+          seed = s;
+        }
+      MTSurveyQuantities() :
+        nrows(0), nsamples(1000), errorlevel(0.0), seed(42)
+        {
+        }
+      virtual ~MTSurveyQuantities()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*MTSURVEYQUANTITIES_H_*/
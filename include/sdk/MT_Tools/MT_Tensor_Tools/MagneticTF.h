@@ -38,6 +38,28 @@ namespace gplib
         {
           return dTy;
         }
+      //! Write access to the transfer function elements and their errors
+      std::complex<double> &SetTx()
+        {
+          return Tx;
+        }
+      std::complex<double> &SetTy()
+        {
+          return Ty;
+        }
+      double &SetdTx()
+        {
+          return dTx;
+        }
+      double &SetdTy()
+        {
+          return dTy;
+        }
+      //! Get the frequency for the transfer function
+      double GetFrequency() const
+        {
+          return frequency;
+        }
       friend class MTStation;
       MagneticTF(): Tx(0), Ty(0), dTx(0), dTy(0), Rz(0), frequency(0)
       {
@@ -5,6 +5,7 @@
 #include "MtuFormat.h"
 #include "BirrpAsciiFormat.h"
 #include "FatalException.h"
+#include "FastAscii.h"
 #include <boost/cast.hpp>
 #include <fstream>
 
@@ -21,6 +22,50 @@ namespace gplib
     //! Read and write ascii files produced by the LEMI instruments
     class LemiTsFormat: public TimeSeries
       {
+    private:
+      //! Format one row with the time, the five components and the unused columns for WriteRows
+      class RowFormatter
+        {
+      private:
+        const TimeSeries::ttimedata &t;
+        const std::vector<double> &Ex, &Ey, &Hx, &Hy, &Hz;
+        static void PutField(const double value, TextBuffer &Buffer)
+          {
+            Buffer.Put(value);
+            Buffer.Put(' ');
+          }
+      public:
+        void operator()(const size_t i, TextBuffer &Buffer) const
+          {
+            const boost::gregorian::date date(t[i].date());
+            const boost::posix_time::time_duration time(t[i].time_of_day());
+            PutField(double(date.year()), Buffer);
+            PutField(double(date.month()), Buffer);
+            PutField(double(date.day()), Buffer);
+            PutField(double(time.hours()), Buffer);
+            PutField(double(time.minutes()), Buffer);
+            PutField(time.seconds() + time.fractional_seconds()
+                / double(boost::posix_time::time_duration::ticks_per_second()),
+                Buffer);
+            PutField(Hx[i], Buffer);
+            PutField(Hy[i], Buffer);
+            PutField(Hz[i], Buffer);
+            PutField(0.0, Buffer);
+            PutField(0.0, Buffer);
+            PutField(Ex[i], Buffer);
+            PutField(Ey[i], Buffer);
+            PutField(0.0, Buffer);
+            PutField(0.0, Buffer);
+            Buffer.Put(0.0);
+            Buffer.Put('\n');
+          }
+        explicit RowFormatter(TimeSeries &Data) :
+          t(Data.GetTime()), Ex(Data.GetEx().GetData()), Ey(
+              Data.GetEy().GetData()), Hx(Data.GetHx().GetData()), Hy(
+              Data.GetHy().GetData()), Hz(Data.GetHz().GetData())
+          {
+          }
+        };
     public:
         LemiTsFormat()
         {
@@ -36,42 +81,46 @@ namespace gplib
       }
       virtual void GetData(const std::string filename)
       {
-        ifstream infile(filename.c_str());
-        double rawsecond, fraction; //the second information stored in the file
-        int year, month, day, hour, minute, second;
+        LineReader infile(filename);
         const double rate = 4.0; // the fixed sampling rate is 4 Hz
-        double number;
-
-        while (infile.good())
+        const char *line = NULL;
+        size_t length = 0;
+        double Fields[16];
+        //constructing the date is relatively expensive, so we only do it when the day changes
+        int lastyear = -1, lastmonth = -1, lastday = -1;
+        boost::gregorian::date currdate(2000, 1, 1);
+        while (infile.NextLine(line, length))
           {
-            infile.precision(15);
-            infile >> year >> month >> day >> hour >> minute >> rawsecond; //read in time information
-            second = static_cast<int> (rawsecond); //chop of the fractional part
-            fraction = rawsecond - static_cast<int> (rawsecond); // calculate the fractional part
-            TimeSeries::ttime currtime(
-                boost::gregorian::date(year, month, day),
-                boost::posix_time::time_duration(hour, minute, second)); //construct time structure
+            const size_t nfields = ParseValues(line, Fields, 16);
+            if (nfields == 0 && line[std::strspn(line, " \t")] == '\0')
+              continue;
+            if (nfields < 13)
+              throw FatalException("Problem reading from file: " + filename);
+            const int year = static_cast<int> (Fields[0]);
+            const int month = static_cast<int> (Fields[1]);
+            const int day = static_cast<int> (Fields[2]);
+            if (year != lastyear || month != lastmonth || day != lastday)
+              {
+                currdate = boost::gregorian::date(year, month, day);
+                lastyear = year;
+                lastmonth = month;
+                lastday = day;
+              }
+            const double rawsecond = Fields[5]; //the second information stored in the file
+            const int second = static_cast<int> (rawsecond); //chop of the fractional part
+            const double fraction = rawsecond - second; // calculate the fractional part
+            TimeSeries::ttime currtime(currdate,
+                boost::posix_time::time_duration(static_cast<int> (Fields[3]),
+                    static_cast<int> (Fields[4]), second)); //construct time structure
             currtime += boost::posix_time::microseconds(
                 boost::numeric_cast<int>(fraction * 1000000));
             t.push_back(currtime);
-            if (infile.good()) //if read was successfull
-              {
-                infile >> number;
-                Hx.GetData().push_back(number);
-                infile >> number;
-                Hy.GetData().push_back(number);
-                infile >> number;
-                Hz.GetData().push_back(number);
-                infile >> number >> number >> number; //we skip the two temperature values and read Ex
-                Ex.GetData().push_back(number);
-                infile >> number;
-                Ey.GetData().push_back(number);
-                infile >> number >> number >> number; // we skip the two additional channels and the extra time information
-              }
-          }
-        if (!infile.eof())
-          {
-            throw FatalException("Problem reading from file: " + filename);
+            Hx.GetData().push_back(Fields[6]);
+            Hy.GetData().push_back(Fields[7]);
+            Hz.GetData().push_back(Fields[8]);
+            //we skip the two temperature values
+            Ex.GetData().push_back(Fields[11]);
+            Ey.GetData().push_back(Fields[12]);
           }
         Hx.SetSamplerate(rate);
         Hy.SetSamplerate(rate);
@@ -79,9 +128,15 @@ namespace gplib
         Ex.SetSamplerate(rate);
         Ey.SetSamplerate(rate);
       }
+      //! Write the data in the column layout of the LEMI files
+      /*! We do not have the temperatures, the additional channels and the extra time information, these columns are written as 0.
+       */
       virtual void WriteData(const std::string filename)
       {
-        throw FatalException("Not implemented");
+        if (t.size() != Size())
+          throw FatalException("Need time information to write LEMI file !");
+        BufferedWriter outfile(filename);
+        WriteRows(outfile, t.size(), RowFormatter(*this));
       }
       LemiTsFormat& operator=(BirrpAsciiFormat& source)
       {
@@ -0,0 +1,344 @@
+#ifndef MTSYNTHFILTER_H_
+#define MTSYNTHFILTER_H_
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <boost/bind.hpp>
+#include <boost/math/constants/constants.hpp>
+#include "MTStation.h"
+#include "TsSpectrum.h"
+#include "FatalException.h"
+#include "types.h"
+
+namespace gplib
+  {
+    /** \addtogroup tstools Time series analysis methods */
+    /* @{ */
+
+    //! Short FIR filters that turn magnetic into electric time series according to the impedance of an MT station
+    /*! Instead of evaluating the impedance at each frequency of a full length fft of the time series,
+     * we only need the impedance on a sparse, logarithmically spaced frequency grid. The amplitude and phase
+     * are interpolated onto the frequencies of a filter of length filterlength and transformed into the
+     * impulse response of each impedance element. The impulse responses are centred in the filter and windowed,
+     * so the filters have a delay of half the filter length, which MTSynthStream compensates for. Above about
+     * five times samplerate/filterlength the relative error of the filter response is well below one percent.
+     */
+    class MTSynthFilter
+      {
+    public:
+      //! The four impedance elements, the electric field is Ex = Zxx Hx + Zxy Hy, Ey = Zyx Hx + Zyy Hy
+      enum telement
+        {
+        xx, xy, yx, yy, nelements
+        };
+    private:
+      double samplerate;
+      size_t filterlength;
+      //! The impulse response of each element, empty if the element is zero everywhere
+      std::vector<trealdata> Responses;
+      //! Interpolate log amplitude and unwrapped phase of Z linearly in log frequency
+      static dcomp Interpolate(const trealdata &LogFreqs, const trealdata &LogAmps,
+          const trealdata &Phases, const double logfreq)
+        {
+          const size_t nfreq = LogFreqs.size();
+          if (logfreq <= LogFreqs.front())
+            return std::polar(std::exp(LogAmps.front()), Phases.front());
+          if (logfreq >= LogFreqs.back())
+            return std::polar(std::exp(LogAmps.back()), Phases.back());
+          const size_t upper = std::upper_bound(LogFreqs.begin(),
+              LogFreqs.end(), logfreq) - LogFreqs.begin();
+          const size_t lower = std::min(upper, nfreq - 1) - 1;
+          const double w = (logfreq - LogFreqs.at(lower))
+              / (LogFreqs.at(lower + 1) - LogFreqs.at(lower));
+          return std::polar(std::exp((1.0 - w) * LogAmps.at(lower) + w
+              * LogAmps.at(lower + 1)), (1.0 - w) * Phases.at(lower) + w
+              * Phases.at(lower + 1));
+        }
+      //! Calculate the impulse response for one element from the impedance values at ascending frequencies
+      void DesignElement(const trealdata &Frequencies,
+          const std::vector<dcomp> &Z, trealdata &Response)
+        {
+          const double pi = boost::math::constants::pi<double>();
+          const size_t nfreq = Frequencies.size();
+          trealdata LogFreqs(nfreq), LogAmps(nfreq), Phases(nfreq);
+          const double tiny = std::numeric_limits<double>::min();
+          for (size_t i = 0; i < nfreq; ++i)
+            {
+              LogFreqs.at(i) = std::log(Frequencies.at(i));
+              LogAmps.at(i) = std::log(std::max(std::abs(Z.at(i)), tiny));
+              Phases.at(i) = std::arg(Z.at(i));
+              //unwrap the phase so we do not interpolate across a jump of 2 pi
+              if (i > 0)
+                {
+                  while (Phases.at(i) - Phases.at(i - 1) > pi)
+                    Phases.at(i) -= 2.0 * pi;
+                  while (Phases.at(i) - Phases.at(i - 1) < -pi)
+                    Phases.at(i) += 2.0 * pi;
+                }
+            }
+          const size_t nbins = filterlength / 2 + 1;
+          std::vector<dcomp> Spectrum(nbins);
+          //the static response of the electric field is zero, which also removes the mean of the magnetic field
+          Spectrum.front() = 0.0;
+          for (size_t i = 1; i < nbins; ++i)
+            Spectrum.at(i) = Interpolate(LogFreqs, LogAmps, Phases, std::log(i
+                * samplerate / filterlength));
+          //the nyquist frequency has to be real for a real time series
+          Spectrum.back() = Spectrum.back().real();
+          trealdata Periodic(filterlength);
+          TsSpectrum Spec;
+          Spec.CalcTimeSeries(Spectrum.begin(), Spectrum.end(),
+              Periodic.begin(), Periodic.end());
+          //the band limited impedance has a two-sided impulse response, so we centre it in the filter
+          //and apply a Hann window, this gives a linear phase delay of half the filter length
+          const size_t delay = filterlength / 2;
+          Response.resize(filterlength);
+          for (size_t i = 0; i < filterlength; ++i)
+            Response.at(i) = Periodic.at((i + filterlength - delay)
+                % filterlength) * 0.5 * (1.0 - std::cos(2.0 * pi * i
+                / filterlength));
+        }
+    public:
+      //! Return the logarithmically spaced frequencies needed to design a filter of given length
+      /*! The frequencies range from the lowest frequency of the filter samplerate/filterlength
+       * to the Nyquist frequency with nperdecade frequencies per decade.
+       */
+      static trealdata LogFrequencies(const double samplerate,
+          const size_t filterlength, const int nperdecade)
+        {
+          const double fmin = samplerate / filterlength;
+          const double fmax = samplerate / 2.0;
+          const size_t nfreq = std::max<size_t>(2, static_cast<size_t> (std::ceil(
+              std::log10(fmax / fmin) * nperdecade)) + 1);
+          trealdata Frequencies(nfreq);
+          for (size_t i = 0; i < nfreq; ++i)
+            Frequencies.at(i) = fmin * std::pow(fmax / fmin, double(i) / (nfreq
+                - 1));
+          return Frequencies;
+        }
+      //! Design the filters from the impedances of a station, the frequencies of the station should cover samplerate/filterlength to samplerate/2
+      void Design(const MTStation &Station, const double rate,
+          const size_t length)
+        {
+          if (length < 4 || length % 2 != 0)
+            throw FatalException("Filter length has to be even and at least 4 !");
+          samplerate = rate;
+          filterlength = length;
+          std::vector<MTTensor> Data(Station.GetMTData());
+          if (Data.size() < 2)
+            throw FatalException(
+                "Need at least two frequencies to design synthetic filter !");
+          //we need ascending frequencies for interpolation
+          std::sort(Data.begin(), Data.end(), boost::bind(
+              &MTTensor::GetFrequency, _1) < boost::bind(&MTTensor::GetFrequency,
+              _2));
+          const size_t nfreq = Data.size();
+          trealdata Frequencies(nfreq);
+          std::vector<std::vector<dcomp> > Z(nelements, std::vector<dcomp>(
+              nfreq));
+          for (size_t i = 0; i < nfreq; ++i)
+            {
+              Frequencies.at(i) = Data.at(i).GetFrequency();
+              Z.at(xx).at(i) = Data.at(i).GetZxx();
+              Z.at(xy).at(i) = Data.at(i).GetZxy();
+              Z.at(yx).at(i) = Data.at(i).GetZyx();
+              Z.at(yy).at(i) = Data.at(i).GetZyy();
+            }
+          Responses.assign(nelements, trealdata());
+          for (int i = 0; i < nelements; ++i)
+            {
+              //for 1D models the diagonal elements vanish and we do not have to filter at all
+              bool allzero = true;
+              for (size_t j = 0; j < nfreq && allzero; ++j)
+                allzero = (Z.at(i).at(j) == dcomp(0.0, 0.0));
+              if (!allzero)
+                DesignElement(Frequencies, Z.at(i), Responses.at(i));
+            }
+        }
+      //! Return the impulse response for an element, the vector is empty if the element is zero
+      const trealdata &GetResponse(const telement element) const
+        {
+          return Responses.at(element);
+        }
+      double GetSamplerate() const
+        {
+          return samplerate;
+        }
+      size_t GetFilterLength() const
+        {
+          return filterlength;
+        }
+      MTSynthFilter() :
+        samplerate(1.0), filterlength(0)
+        {
+        }
+      MTSynthFilter(const MTStation &Station, const double rate,
+          const size_t length)
+        {
+          Design(Station, rate, length);
+        }
+      virtual ~MTSynthFilter()
+        {
+        }
+      };
+
+    //! Apply the filters of a MTSynthFilter to a stream of magnetic field data in fixed memory
+    /*! The magnetic field can be passed in chunks of arbitrary size. Internally we use overlap-add with
+     * blocks of the filter length, so processing is most efficient if the chunks are a multiple of the filter
+     * length. The filters have a delay of half the filter length, we compensate for this so that the
+     * first sample of the electric field we return corresponds to the first sample of the magnetic field. As a
+     * consequence Process returns fewer samples than it was given at the beginning and Finish has to be called
+     * at the end of the time series to get the remaining samples. All fftw plans are created in the constructor,
+     * different objects can therefore be used in parallel, e.g. to calculate the response of many models for
+     * the same magnetic field, but each object has to be created serially.
+     */
+    class MTSynthStream
+      {
+    private:
+      size_t filterlength;
+      //! The size of the ffts, twice the filter length
+      size_t fftlength;
+      //! The delay of the filters in samples
+      size_t delay;
+      //! The number of output samples we still have to discard to compensate for the delay
+      size_t toskip;
+      //! The number of input samples we have seen, used to limit the output of Finish
+      size_t ninput;
+      TsSpectrum Spectrum;
+      //! The spectrum of each zero padded filter, empty if the element is zero
+      std::vector<std::vector<dcomp> > FilterSpectra;
+      //! The part of the convolution for Ex and Ey that extends beyond the samples we have output so far
+      trealdata ExTail, EyTail;
+      //! Temporary storage for the ffts
+      trealdata TimeBuffer, ConvBuffer;
+      std::vector<dcomp> HxSpec, HySpec, Product;
+      //! Add the convolution of the filter spectrum for element with the transformed input to Tail
+      void AddConvolution(const MTSynthFilter::telement element,
+          const std::vector<dcomp> &InSpec, trealdata &Tail)
+        {
+          const std::vector<dcomp> &Filter = FilterSpectra.at(element);
+          if (Filter.empty())
+            return;
+          for (size_t i = 0; i < Product.size(); ++i)
+            Product.at(i) = Filter.at(i) * InSpec.at(i);
+          Spectrum.CalcTimeSeries(Product.begin(), Product.end(),
+              ConvBuffer.begin(), ConvBuffer.end());
+          std::transform(ConvBuffer.begin(), ConvBuffer.end(), Tail.begin(),
+              Tail.begin(), std::plus<double>());
+        }
+      //! Filter a block of at most filterlength samples, returns the number of samples written to ex and ey
+      size_t ProcessBlock(const double *hx, const double *hy, const size_t n,
+          double *ex, double *ey)
+        {
+          std::fill(TimeBuffer.begin(), TimeBuffer.end(), 0.0);
+          if (hx)
+            std::copy(hx, hx + n, TimeBuffer.begin());
+          Spectrum.CalcSpectrum(TimeBuffer.begin(), TimeBuffer.end(),
+              HxSpec.begin(), HxSpec.end());
+          std::fill(TimeBuffer.begin(), TimeBuffer.end(), 0.0);
+          if (hy)
+            std::copy(hy, hy + n, TimeBuffer.begin());
+          Spectrum.CalcSpectrum(TimeBuffer.begin(), TimeBuffer.end(),
+              HySpec.begin(), HySpec.end());
+          AddConvolution(MTSynthFilter::xx, HxSpec, ExTail);
+          AddConvolution(MTSynthFilter::xy, HySpec, ExTail);
+          AddConvolution(MTSynthFilter::yx, HxSpec, EyTail);
+          AddConvolution(MTSynthFilter::yy, HySpec, EyTail);
+          const size_t skip = std::min(toskip, n);
+          toskip -= skip;
+          std::copy(ExTail.begin() + skip, ExTail.begin() + n, ex);
+          std::copy(EyTail.begin() + skip, EyTail.begin() + n, ey);
+          //shift the remaining part of the convolution to the beginning
+          std::copy(ExTail.begin() + n, ExTail.end(), ExTail.begin());
+          std::fill(ExTail.end() - n, ExTail.end(), 0.0);
+          std::copy(EyTail.begin() + n, EyTail.end(), EyTail.begin());
+          std::fill(EyTail.end() - n, EyTail.end(), 0.0);
+          return n - skip;
+        }
+    public:
+      //! Return the delay of the filters in samples
+      size_t GetDelay() const
+        {
+          return delay;
+        }
+      //! Feed the next n samples of Hx and Hy, writes the electric field for the earliest samples that are complete and returns their number
+      /*! The output arrays have to hold n values. In total we return the same number of samples as we have been
+       * given, but the output lags the input by the delay of the filters until Finish is called.
+       */
+      size_t Process(const double *hx, const double *hy, const size_t n,
+          double *ex, double *ey)
+        {
+          size_t nout = 0;
+          for (size_t start = 0; start < n; start += filterlength)
+            {
+              const size_t blocksize = std::min(filterlength, n - start);
+              nout += ProcessBlock(hx + start, hy + start, blocksize, ex + nout,
+                  ey + nout);
+            }
+          ninput += n;
+          return nout;
+        }
+      //! Return the electric field for the last samples of the time series, the output arrays have to hold GetDelay() values
+      size_t Finish(double *ex, double *ey)
+        {
+          //if the time series was shorter than the delay, we have not passed the start yet
+          size_t remaining = std::min(delay, ninput);
+          size_t nout = 0;
+          while (remaining > 0)
+            {
+              //feeding zeros moves the rest of the convolution to the output
+              const size_t blocksize = std::min(filterlength, remaining + toskip);
+              const size_t curr = std::min(remaining, ProcessBlock(NULL, NULL,
+                  blocksize, ex + nout, ey + nout));
+              nout += curr;
+              remaining -= curr;
+            }
+          Reset();
+          return nout;
+        }
+      //! Forget the previous samples, e.g. before a new, unrelated time series
+      void Reset()
+        {
+          std::fill(ExTail.begin(), ExTail.end(), 0.0);
+          std::fill(EyTail.begin(), EyTail.end(), 0.0);
+          toskip = delay;
+          ninput = 0;
+        }
+      explicit MTSynthStream(const MTSynthFilter &Filter) :
+        filterlength(Filter.GetFilterLength()), fftlength(2
+            * Filter.GetFilterLength()), delay(Filter.GetFilterLength() / 2),
+            toskip(delay), ninput(0), Spectrum(true), FilterSpectra(
+                MTSynthFilter::nelements), ExTail(fftlength, 0.0), EyTail(
+                fftlength, 0.0), TimeBuffer(fftlength, 0.0), ConvBuffer(
+                fftlength, 0.0), HxSpec(fftlength / 2 + 1), HySpec(fftlength
+                / 2 + 1), Product(fftlength / 2 + 1)
+        {
+          if (filterlength == 0)
+            throw FatalException("Filter has not been designed !");
+          for (int i = 0; i < MTSynthFilter::nelements; ++i)
+            {
+              const trealdata &Response = Filter.GetResponse(
+                  MTSynthFilter::telement(i));
+              if (Response.empty())
+                continue;
+              std::fill(TimeBuffer.begin(), TimeBuffer.end(), 0.0);
+              std::copy(Response.begin(), Response.end(), TimeBuffer.begin());
+              FilterSpectra.at(i).resize(fftlength / 2 + 1);
+              Spectrum.CalcSpectrum(TimeBuffer.begin(), TimeBuffer.end(),
+                  FilterSpectra.at(i).begin(), FilterSpectra.at(i).end());
+            }
+          //make sure the plans exist even if all filters are zero
+          std::fill(TimeBuffer.begin(), TimeBuffer.end(), 0.0);
+          Spectrum.CalcSpectrum(TimeBuffer.begin(), TimeBuffer.end(),
+              HxSpec.begin(), HxSpec.end());
+        }
+      virtual ~MTSynthStream()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /* MTSYNTHFILTER_H_ */
@@ -0,0 +1,312 @@
+#ifndef MULTISITESTREAM_H_
+#define MULTISITESTREAM_H_
+#include <string>
+#include <vector>
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include "FatalException.h"
+#include "TsStreamReader.h"
+
+namespace gplib
+  {
+    /** \addtogroup tstools Time series analysis methods */
+    /* @{ */
+
+    //! Read synchronized time series from many sites chunk by chunk on a common time axis
+    /*! Each site is read with a TsStreamReader, so only one block per site and the current chunk are kept in
+     * memory, independent of the length of the recordings. The samples are placed on a common time axis with
+     * the sampling rate of the sites, a sample with the time t has the index round(t * samplerate).
+     * Sites that start at a time that is not a multiple of the sampling interval are shifted to the nearest
+     * sample. The common axis starts with the latest start time of all sites and ends when the first site ends,
+     * samples that are missing at a site because of a gap in its recording are set to NaN.
+     */
+    class MultiSiteStream
+      {
+    private:
+      //! The state of the reader for one site
+      struct SiteState
+        {
+        boost::shared_ptr<TsStreamReader> Reader;
+        TsStreamBlock Block;
+        //! The index of the first sample of the current block on the common time axis
+        boost::int64_t blockstart;
+        //! Does Block contain data that has not been used yet
+        bool haveblock;
+        //! Has the end of the file been reached
+        bool finished;
+        };
+      std::vector<SiteState> Sites;
+      std::vector<std::string> Names;
+      size_t chunksize;
+      double samplerate;
+      //! The index of the next sample on the common time axis
+      boost::int64_t position;
+      //! The chunk, for each site the channels Ex, Ey, Hx, Hy, Hz one after the other, each with chunksize samples
+      std::vector<std::vector<double> > Chunk;
+      //! Calculate the position of the current block of a site on the common time axis
+      void PlaceBlock(SiteState &Site)
+        {
+          if (!Site.Block.hastime)
+            throw FatalException(
+                "Cannot align files without time information !");
+          if (std::abs(Site.Reader->GetSamplerate() - samplerate) > 1e-6
+              * samplerate)
+            throw FatalException("All sites need the same sampling rate !");
+          Site.blockstart = boost::int64_t(std::floor(Site.Block.starttime
+              * samplerate + 0.5));
+          Site.haveblock = true;
+        }
+      //! Read the next block of a site, returns false at the end of the file
+      bool NextBlock(SiteState &Site)
+        {
+          if (Site.finished || !Site.Reader->ReadBlock(Site.Block))
+            {
+              Site.finished = true;
+              Site.haveblock = false;
+              return false;
+            }
+          PlaceBlock(Site);
+          return true;
+        }
+      //! Fill the chunk of one site from position to position + length, returns the number of samples before the site ended
+      size_t FillSite(SiteState &Site, std::vector<double> &Data,
+          const size_t length)
+        {
+          const double nan = std::numeric_limits<double>::quiet_NaN();
+          size_t filled = 0;
+          while (filled < length)
+            {
+              if (!Site.haveblock && !NextBlock(Site))
+                break;
+              const boost::int64_t current = position + filled;
+              const boost::int64_t blockend = Site.blockstart
+                  + Site.Block.GetNSamples();
+              if (blockend <= current)
+                {
+                  //the block is before the current position, e.g. because records overlap
+                  Site.haveblock = false;
+                  continue;
+                }
+              if (Site.blockstart > current)
+                {
+                  //there is a gap in the recording
+                  const size_t ngap = std::min<boost::int64_t>(
+                      Site.blockstart - current, length - filled);
+                  for (size_t c = 0; c < tsstreamchannels; ++c)
+                    std::fill_n(Data.begin() + c * chunksize + filled, ngap, nan);
+                  filled += ngap;
+                  continue;
+                }
+              const size_t offset = current - Site.blockstart;
+              const size_t ncopy = std::min<size_t>(blockend - current, length
+                  - filled);
+              const double *in = &Site.Block.Data[offset * tsstreamchannels];
+              for (size_t i = 0; i < ncopy; ++i, in += tsstreamchannels)
+                for (size_t c = 0; c < tsstreamchannels; ++c)
+                  Data[c * chunksize + filled + i] = in[c];
+              filled += ncopy;
+              if (offset + ncopy == Site.Block.GetNSamples())
+                Site.haveblock = false;
+            }
+          return filled;
+        }
+    public:
+      //! The number of sites
+      size_t GetNSites() const
+        {
+          return Sites.size();
+        }
+      double GetSamplerate() const
+        {
+          return samplerate;
+        }
+      //! The time of the next sample that ReadChunk returns in seconds since 1.1.1970
+      double GetTime() const
+        {
+          return position / samplerate;
+        }
+      //! The maximum number of samples in a chunk
+      size_t GetChunkSize() const
+        {
+          return chunksize;
+        }
+      //! The samples of a channel of a site in the current chunk, channel is 0 to 4 for Ex, Ey, Hx, Hy, Hz
+      const double *GetChannel(const size_t site, const size_t channel) const
+        {
+          return &Chunk.at(site)[channel * chunksize];
+        }
+      //! Read the next chunk for all sites in parallel, returns the number of samples in the chunk, 0 at the end
+      size_t ReadChunk()
+        {
+          const int nsites = Sites.size();
+          size_t length = chunksize;
+          bool haveerror = false;
+          std::string errormessage;
+#pragma omp parallel for default(shared) schedule(dynamic)
+          for (int i = 0; i < nsites; ++i)
+            {
+              try
+                {
+                  const size_t filled = FillSite(Sites[i], Chunk[i], chunksize);
+#pragma omp critical(multisite_length)
+                  length = std::min(length, filled);
+                } catch (FatalException &e)
+                {
+#pragma omp critical(multisite_error)
+                    {
+                      haveerror = true;
+                      errormessage = Names[i] + ": " + e.what();
+                    }
+                }
+            }
+          if (haveerror)
+            throw FatalException(errormessage);
+          position += length;
+          return length;
+        }
+      //! Open the files, chunk is the maximum number of samples for each channel that ReadChunk returns
+      MultiSiteStream(const std::vector<std::string> &Filenames,
+          const size_t chunk = 65536) :
+        Sites(Filenames.size()), Names(Filenames), chunksize(chunk),
+            samplerate(0.0), position(0), Chunk(Filenames.size(),
+                std::vector<double>(tsstreamchannels * chunk))
+        {
+          if (Filenames.empty() || chunksize == 0)
+            throw FatalException("Need at least one site and a chunk size > 0 !");
+          //we need the first block of each site to find the common start time
+          for (size_t i = 0; i < Sites.size(); ++i)
+            {
+              Sites[i].Reader = OpenTsStream(Filenames[i]);
+              Sites[i].finished = false;
+              Sites[i].haveblock = false;
+              if (!Sites[i].Reader->ReadBlock(Sites[i].Block))
+                throw FatalException("No data in file: " + Filenames[i]);
+            }
+          samplerate = Sites.front().Reader->GetSamplerate();
+          position = std::numeric_limits<boost::int64_t>::min();
+          for (size_t i = 0; i < Sites.size(); ++i)
+            {
+              try
+                {
+                  PlaceBlock(Sites[i]);
+                } catch (FatalException &e)
+                {
+                  throw FatalException(Filenames[i] + ": " + e.what());
+                }
+              position = std::max(position, Sites[i].blockstart);
+            }
+        }
+      virtual ~MultiSiteStream()
+        {
+        }
+      };
+
+    //! Calculate the mean of each sample over the sites, samples that are NaN are ignored
+    /*! Values points to the first sample of each site, the result is NaN where all sites are NaN.
+     * The loops over the samples contain no branches, so the compiler can vectorize them.
+     */
+    inline void SiteMean(const std::vector<const double *> &Values,
+        const size_t nsamples, double *Result)
+      {
+        std::vector<double> Count(nsamples, 0.0);
+        std::fill_n(Result, nsamples, 0.0);
+        for (size_t s = 0; s < Values.size(); ++s)
+          {
+            const double *x = Values[s];
+            for (size_t i = 0; i < nsamples; ++i)
+              {
+                const bool valid = (x[i] == x[i]);
+                Result[i] += valid ? x[i] : 0.0;
+                Count[i] += valid ? 1.0 : 0.0;
+              }
+          }
+        for (size_t i = 0; i < nsamples; ++i)
+          Result[i] = Count[i] > 0.0 ? Result[i] / Count[i]
+              : std::numeric_limits<double>::quiet_NaN();
+      }
+
+    //! Calculate the median of each sample over the sites, samples that are NaN are ignored
+    inline void SiteMedian(const std::vector<const double *> &Values,
+        const size_t nsamples, double *Result)
+      {
+        const int n = nsamples;
+        const size_t nsites = Values.size();
+#pragma omp parallel default(shared)
+          {
+            std::vector<double> Current(nsites);
+#pragma omp for
+            for (int i = 0; i < n; ++i)
+              {
+                size_t nvalid = 0;
+                for (size_t s = 0; s < nsites; ++s)
+                  if (Values[s][i] == Values[s][i])
+                    Current[nvalid++] = Values[s][i];
+                if (nvalid == 0)
+                  {
+                    Result[i] = std::numeric_limits<double>::quiet_NaN();
+                    continue;
+                  }
+                const size_t mid = nvalid / 2;
+                std::nth_element(Current.begin(), Current.begin() + mid,
+                    Current.begin() + nvalid);
+                double median = Current[mid];
+                if (nvalid % 2 == 0)
+                  median = 0.5 * (median + *std::max_element(Current.begin(),
+                      Current.begin() + mid));
+                Result[i] = median;
+              }
+          }
+      }
+
+    //! Write time series in a simple binary format, the header is followed by the samples of all channels interleaved
+    /*! The header consists of the magic string GPTS, the number of channels as a 32 bit integer,
+     * the sampling rate and the time of the first sample in seconds since 1.1.1970 as doubles. The samples
+     * are written as doubles in the byte order of the machine.
+     */
+    class BinaryTsWriter
+      {
+    private:
+      std::ofstream outfile;
+      boost::uint32_t nchannels;
+      std::vector<double> Buffer;
+    public:
+      //! Write nsamples samples, Channels contains a pointer to the first sample of each channel
+      void Write(const std::vector<const double *> &Channels,
+          const size_t nsamples)
+        {
+          if (Channels.size() != nchannels)
+            throw FatalException("Wrong number of channels for binary output !");
+          Buffer.resize(nsamples * nchannels);
+          for (size_t c = 0; c < nchannels; ++c)
+            for (size_t i = 0; i < nsamples; ++i)
+              Buffer[i * nchannels + c] = Channels[c][i];
+          outfile.write(reinterpret_cast<const char *> (&Buffer[0]),
+              Buffer.size() * sizeof(double));
+          if (!outfile)
+            throw FatalException("Error writing binary time series !");
+        }
+      BinaryTsWriter(const std::string &filename, const size_t channels,
+          const double samplerate, const double starttime) :
+        outfile(filename.c_str(), std::ios::binary), nchannels(channels)
+        {
+          if (!outfile)
+            throw FatalException("Cannot write file: " + filename);
+          outfile.write("GPTS", 4);
+          outfile.write(reinterpret_cast<const char *> (&nchannels),
+              sizeof(nchannels));
+          outfile.write(reinterpret_cast<const char *> (&samplerate),
+              sizeof(samplerate));
+          outfile.write(reinterpret_cast<const char *> (&starttime),
+              sizeof(starttime));
+        }
+      virtual ~BinaryTsWriter()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /* MULTISITESTREAM_H_ */
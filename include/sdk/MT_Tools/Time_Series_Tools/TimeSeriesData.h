@@ -189,7 +189,41 @@ namespace gplib
           }
         return *this;
       }
-
+      //! Return an independent copy, in contrast to operator= the copy does not share the time series with this object
+      TimeSeriesData Clone() const
+      {
+        TimeSeriesData Copy;
+        Copy.name = name;
+        Copy.datatype = datatype;
+        switch (datatype)
+          {
+        case mtu:
+          Copy.Data = boost::shared_ptr<TimeSeries>(new MtuFormat(
+              *boost::polymorphic_downcast<MtuFormat*>(Data.get())));
+          break;
+        case birrp:
+          Copy.Data = boost::shared_ptr<TimeSeries>(new BirrpAsciiFormat(
+              *boost::polymorphic_downcast<BirrpAsciiFormat*>(Data.get())));
+          break;
+        case csv:
+          Copy.Data = boost::shared_ptr<TimeSeries>(new CsvFormat(
+              *boost::polymorphic_downcast<CsvFormat*>(Data.get())));
+          break;
+        case lemi:
+          Copy.Data = boost::shared_ptr<TimeSeries>(new LemiTsFormat(
+              *boost::polymorphic_downcast<LemiTsFormat*>(Data.get())));
+          break;
+        default:
+          throw FatalException("Cannot copy data ! Unknown datatype !");
+          break;
+          }
+        return Copy;
+      }
+      //! Return the name of the site, this is the filename without the ending
+      const std::string &GetName() const
+        {
+          return name;
+        }
       };
   /* @} */
   }
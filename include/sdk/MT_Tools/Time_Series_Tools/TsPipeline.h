@@ -0,0 +1,681 @@
+#ifndef TSPIPELINE_H_
+#define TSPIPELINE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <numeric>
+#include <complex>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <boost/shared_ptr.hpp>
+#include <boost/bind.hpp>
+#include "rapidjson/document.h"
+#include "TimeSeriesData.h"
+#include "FilterFunc.h"
+#include "StackedSpectrum.h"
+#include "WFunc.h"
+#include "miscfunc.h"
+#include "statutils.h"
+#include "FatalException.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace gplib
+  {
+    /** \addtogroup mttools MT data analysis, processing and inversion */
+    /* @{ */
+
+    //! The base class for a single processing step in a TsPipeline
+    /*! Each stage works on the data of one site in memory and changes it in place. Stages
+     * that only write data to disk leave it unchanged, so the data can be processed further.
+     * Most operations are applied independently to each of the five components, these
+     * stages use ProcessComponents which processes the components in parallel.
+     */
+    class TsPipelineStage
+      {
+    private:
+      //! The name of the stage, other stages use it to refer to the output of this stage
+      std::string name;
+      //! The name of the stage whose output we process
+      std::string input;
+      //! Do we process the components of a site in parallel
+      bool parallelchannels;
+    protected:
+      //! Return component number i of Data, the order is Ex, Ey, Hx, Hy, Hz
+      static TimeSeriesComponent &Component(TimeSeries &Data, const int i)
+        {
+          switch (i)
+            {
+          case 0:
+            return Data.GetEx();
+          case 1:
+            return Data.GetEy();
+          case 2:
+            return Data.GetHx();
+          case 3:
+            return Data.GetHy();
+          default:
+            return Data.GetHz();
+            }
+        }
+      //! Apply Function to each component of the data, Function is called with the component and its index
+      template<typename FunctionType>
+      void ProcessComponents(TimeSeries &Data, FunctionType Function) const
+        {
+          const int ncomponents = 5;
+          bool parallel = parallelchannels;
+#ifdef _OPENMP
+          //when the sites are already processed in parallel we do not create nested threads
+          parallel = parallel && !omp_in_parallel();
+#endif
+          std::string errormessage;
+#pragma omp parallel for if(parallel) default(shared)
+          for (int i = 0; i < ncomponents; ++i)
+            {
+              //exceptions cannot leave an openmp block, so we store the message and throw afterwards
+              try
+                {
+                  Function(Component(Data, i), i);
+                } catch (FatalException &e)
+                {
+#pragma omp critical(tspipeline_error)
+                  errormessage = e.what();
+                }
+            }
+          if (!errormessage.empty())
+            throw FatalException(errormessage);
+        }
+    public:
+      //! The type of the stage as used in the json description, e.g. "bandpass"
+      virtual std::string GetType() const = 0;
+      //! Process the data of one site, data is changed in place
+      virtual void Process(TimeSeriesData &Data) const = 0;
+      const std::string &GetName() const
+        {
+          return name;
+        }
+      const std::string &GetInput() const
+        {
+          return input;
+        }
+      void SetName(const std::string &n)
+        {
+          name = n;
+        }
+      void SetInput(const std::string &i)
+        {
+          input = i;
+        }
+      void SetParallelChannels(const bool p)
+        {
+          parallelchannels = p;
+        }
+      TsPipelineStage() :
+        parallelchannels(true)
+        {
+        }
+      virtual ~TsPipelineStage()
+        {
+        }
+      };
+
+    //! Cut a segment of length samples starting at startindex, as Mtucut
+    class TsCutStage: public TsPipelineStage
+      {
+    private:
+      size_t startindex;
+      size_t length;
+    public:
+      virtual std::string GetType() const
+        {
+          return "cut";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          const size_t tslength = Data.GetData().Size();
+          if (startindex + length > tslength)
+            throw FatalException(
+                "Selected segment is partially outside time series ! Site: "
+                    + Data.GetName());
+          Data.GetData().erase(length + startindex, tslength);
+          Data.GetData().erase(0, startindex);
+        }
+      TsCutStage(const size_t start, const size_t l) :
+        startindex(start), length(l)
+        {
+        }
+      virtual ~TsCutStage()
+        {
+        }
+      };
+
+    //! Remove the mean from each component
+    class TsSubMeanStage: public TsPipelineStage
+      {
+    private:
+      static void SubMeanComponent(TimeSeriesComponent &Comp, const int)
+        {
+          SubMean(Comp.GetData().begin(), Comp.GetData().end());
+        }
+    public:
+      virtual std::string GetType() const
+        {
+          return "submean";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          ProcessComponents(Data.GetData(), SubMeanComponent);
+        }
+      virtual ~TsSubMeanStage()
+        {
+        }
+      };
+
+    //! Remove the mean and apply npass passes of a simple recursive band pass, as Mtubandpass
+    class TsBandpassStage: public TsPipelineStage
+      {
+    private:
+      double lowfreq;
+      double upfreq;
+      size_t npass;
+      void FilterComponent(TimeSeriesComponent &Comp, const int) const
+        {
+          // calculate the dimensionless corner frequency for the filtering class
+          const double lowfilfreq = lowfreq * Comp.GetSamplerate();
+          const double upfilfreq = upfreq * Comp.GetSamplerate();
+          SubMean(Comp.GetData().begin(), Comp.GetData().end());
+          for (size_t i = 0; i < npass; ++i)
+            {
+              std::transform(Comp.GetData().begin(), Comp.GetData().end(),
+                  Comp.GetData().begin(), SimpleBp(lowfilfreq, upfilfreq));
+            }
+        }
+    public:
+      virtual std::string GetType() const
+        {
+          return "bandpass";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          ProcessComponents(Data.GetData(), boost::bind(
+              &TsBandpassStage::FilterComponent, this, _1, _2));
+        }
+      TsBandpassStage(const double low, const double up, const size_t n) :
+        lowfreq(low), upfreq(up), npass(n)
+        {
+        }
+      virtual ~TsBandpassStage()
+        {
+        }
+      };
+
+    //! Replace each component by its first difference, as Mtufdiff
+    class TsDiffStage: public TsPipelineStage
+      {
+    private:
+      static void DiffComponent(TimeSeriesComponent &Comp, const int)
+        {
+          std::adjacent_difference(Comp.GetData().begin(),
+              Comp.GetData().end(), Comp.GetData().begin());
+        }
+    public:
+      virtual std::string GetType() const
+        {
+          return "fdiff";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          ProcessComponents(Data.GetData(), DiffComponent);
+        }
+      virtual ~TsDiffStage()
+        {
+        }
+      };
+
+    //! Calculate a Hanning weighted running average with a window of windowlength samples, as Mtura
+    class TsRunningAverageStage: public TsPipelineStage
+      {
+    private:
+      size_t windowlength;
+      void AverageComponent(TimeSeriesComponent &Comp, const int) const
+        {
+          ttsdata &Values = Comp.GetData();
+          if (windowlength > Values.size())
+            throw FatalException(
+                "Averaging window is longer than the time series !");
+          //construct the window time series
+          ttsdata Window(Values.size(), 0.0);
+          std::fill_n(Window.begin(), windowlength, 1.0);
+          ApplyWindow(Window.begin(), Window.begin() + windowlength,
+              Window.begin(), Hanning());
+          std::transform(Window.begin(), Window.begin() + windowlength,
+              Window.begin(), boost::bind(std::multiplies<double>(), _1, 1.
+                  / double(windowlength)));
+          // make sure we have zero mean to avoid offsets after windowing
+          SubMean(Values.begin(), Values.end());
+          Convolve(Values, Window, Values);
+          //correct for the shift introduced by the convolution
+          std::rotate(Values.begin(), Values.begin() + windowlength / 2,
+              Values.end());
+        }
+    public:
+      virtual std::string GetType() const
+        {
+          return "runningaverage";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          ProcessComponents(Data.GetData(), boost::bind(
+              &TsRunningAverageStage::AverageComponent, this, _1, _2));
+        }
+      TsRunningAverageStage(const size_t length) :
+        windowlength(length)
+        {
+        }
+      virtual ~TsRunningAverageStage()
+        {
+        }
+      };
+
+    //! Rotate the horizontal magnetic field so that the median of Hy becomes small, as Rotts
+    class TsRotateStage: public TsPipelineStage
+      {
+    public:
+      virtual std::string GetType() const
+        {
+          return "rotate";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          ttsdata &Hx = Data.GetData().GetHx().GetData();
+          ttsdata &Hy = Data.GetData().GetHy().GetData();
+          const double hymedian = Median(Hy.begin(), Hy.end());
+          const double hxmedian = Median(Hx.begin(), Hx.end());
+          const double phi = hymedian / sqrt(std::pow(hxmedian, 2)
+              + std::pow(hymedian, 2));
+          const double sinphi = sin(-phi);
+          const double cosphi = cos(-phi);
+          const size_t ndata = Hy.size();
+          for (size_t i = 0; i < ndata; ++i)
+            {
+              const double newhx = cosphi * Hx[i] + sinphi * Hy[i];
+              const double newhy = sinphi * Hx[i] + cosphi * Hy[i];
+              Hx[i] = newhx;
+              Hy[i] = newhy;
+            }
+        }
+      virtual ~TsRotateStage()
+        {
+        }
+      };
+
+    //! Calculate stacked power spectra for each component and write them to ascii files, as Mtupspec
+    /*! The files have the name of the site with the suffix of the stage and _specex, _specey etc.
+     * appended. The data is not changed.
+     */
+    class TsPowerSpectrumStage: public TsPipelineStage
+      {
+    private:
+      size_t seglength;
+      std::string suffix;
+      void SpectrumComponent(TimeSeriesComponent &Comp, const int index,
+          const std::string &base) const
+        {
+          static const char *names[5] =
+            { "_specex", "_specey", "_spechx", "_spechy", "_spechz" };
+          if (seglength > Comp.GetData().size())
+            throw FatalException("Segment must shorter than the time series !");
+          std::vector<std::complex<double> > Spectrum(seglength / 2 + 1);
+          StackedSpectrum(Comp.GetData().begin(), Comp.GetData().end(),
+              Spectrum.begin(), seglength, Hanning());
+          const double samplerate = Comp.GetSamplerate();
+          std::ofstream outfile((base + names[index]).c_str());
+          //we do not output the static contribution (0 frequency)
+          for (size_t i = 1; i < Spectrum.size(); ++i)
+            outfile << i * samplerate / seglength << " " << std::abs(
+                Spectrum.at(i)) << "\n";
+        }
+    public:
+      virtual std::string GetType() const
+        {
+          return "pspec";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          ProcessComponents(Data.GetData(), boost::bind(
+              &TsPowerSpectrumStage::SpectrumComponent, this, _1, _2,
+              Data.GetName() + suffix));
+        }
+      TsPowerSpectrumStage(const size_t length, const std::string &s) :
+        seglength(length), suffix(s)
+        {
+        }
+      virtual ~TsPowerSpectrumStage()
+        {
+        }
+      };
+
+    //! Write the data to disk, the data is not changed
+    /*! The filename is the name of the site with suffix appended, format
+     * is one of "back" (the format the data was read in), "mtu", "birrp" or "lemi".
+     */
+    class TsWriteStage: public TsPipelineStage
+      {
+    private:
+      std::string format;
+      std::string suffix;
+    public:
+      virtual std::string GetType() const
+        {
+          return "write";
+        }
+      virtual void Process(TimeSeriesData &Data) const
+        {
+          const std::string filename = Data.GetName() + suffix;
+          if (format == "back")
+            Data.WriteBack(filename);
+          else if (format == "mtu")
+            Data.WriteAsMtu(filename);
+          else if (format == "birrp")
+            Data.WriteAsBirrp(filename);
+          else if (format == "lemi")
+            Data.WriteAsLemi(filename);
+          else
+            throw FatalException("Unknown output format: " + format);
+        }
+      TsWriteStage(const std::string &f, const std::string &s) :
+        format(f), suffix(s)
+        {
+        }
+      virtual ~TsWriteStage()
+        {
+        }
+      };
+
+    //! Run a graph of processing stages on the time series of several sites without intermediate files
+    /*! The pipeline is described by a json document of the form
+     * \verbatim
+     {
+     "MainInfo": { "parallelsites": true, "parallelchannels": true },
+     "Input": [ "site1.ts4", "site2.ts4" ],
+     "Stages": [
+     { "name": "cut", "type": "cut", "start": 1000, "length": 100000 },
+     { "name": "bp", "type": "bandpass", "lowfreq": 0.001, "upfreq": 10.0, "npass": 2 },
+     { "name": "spec", "type": "pspec", "input": "cut", "seglength": 2400 },
+     { "name": "out", "type": "write", "input": "bp", "format": "birrp", "suffix": ".bp" }
+     ]
+     }
+     \endverbatim
+     * Each stage processes the output of the stage given in "input", if it is missing the
+     * output of the previous stage is used. The name "input" refers to the data as read from disk.
+     * Stages have to be listed after the stage they depend on. When the output of a stage
+     * is used by several other stages we work on copies, otherwise the data is processed in place,
+     * so a linear chain of stages never copies the time series. Sites are processed in
+     * parallel and within a site the five components are processed in parallel, if the sites
+     * are already processed in parallel we do not create additional threads for the components.
+     */
+    class TsPipeline
+      {
+    public:
+      typedef boost::shared_ptr<TsPipelineStage> tstage;
+    private:
+      //! The stages in the order of execution
+      std::vector<tstage> Stages;
+      //! For each stage the number of other stages that use its output, the last entry is for the input data
+      std::vector<int> Consumers;
+      //! The accumulated wall time for each stage over all sites
+      std::vector<double> StageTimes;
+      //! The time spent reading the input data
+      double readtime;
+      //! The wall time of the last call to Run
+      double totaltime;
+      //! The number of sites processed in the last call to Run
+      size_t nsites;
+      bool parallelsites;
+      bool parallelchannels;
+      static double Now()
+        {
+#ifdef _OPENMP
+          return omp_get_wtime();
+#else
+          return std::chrono::duration<double>(
+              std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+      //! Return the index of the stage with name, the input data has index Stages.size()
+      size_t FindStage(const std::string &name, const size_t before) const
+        {
+          if (name == "input")
+            return Stages.size();
+          for (size_t i = 0; i < before; ++i)
+            if (Stages.at(i)->GetName() == name)
+              return i;
+          throw FatalException("Unknown input stage: " + name
+              + ", stages have to be defined before they are used !");
+        }
+      //! Determine how often the output of each stage is used
+      void CountConsumers()
+        {
+          Consumers.assign(Stages.size() + 1, 0);
+          for (size_t i = 0; i < Stages.size(); ++i)
+            ++Consumers.at(FindStage(Stages.at(i)->GetInput(), i));
+        }
+      //! Create a stage from its json description
+      static tstage MakeStage(const rapidjson::Value &Desc)
+        {
+          if (!Desc.IsObject() || !Desc.HasMember("type")
+              || !Desc["type"].IsString())
+            throw FatalException("Each stage needs a type !");
+          const std::string type = Desc["type"].GetString();
+          tstage Stage;
+          if (type == "cut")
+            {
+              Stage = tstage(new TsCutStage(GetUint(Desc, "start", 0), GetUint(
+                  Desc, "length", 0)));
+            }
+          else if (type == "submean")
+            {
+              Stage = tstage(new TsSubMeanStage);
+            }
+          else if (type == "bandpass")
+            {
+              Stage = tstage(new TsBandpassStage(GetDouble(Desc, "lowfreq"),
+                  GetDouble(Desc, "upfreq"), GetUint(Desc, "npass", 1)));
+            }
+          else if (type == "fdiff")
+            {
+              Stage = tstage(new TsDiffStage);
+            }
+          else if (type == "runningaverage")
+            {
+              Stage = tstage(new TsRunningAverageStage(GetUint(Desc,
+                  "windowlength", 0)));
+            }
+          else if (type == "rotate")
+            {
+              Stage = tstage(new TsRotateStage);
+            }
+          else if (type == "pspec")
+            {
+              Stage = tstage(new TsPowerSpectrumStage(GetUint(Desc,
+                  "seglength", 2400), GetString(Desc, "suffix", "")));
+            }
+          else if (type == "write")
+            {
+              Stage = tstage(new TsWriteStage(GetString(Desc, "format", "back"),
+                  GetString(Desc, "suffix", ".proc")));
+            }
+          else
+            throw FatalException("Unknown stage type: " + type);
+          return Stage;
+        }
+      static double GetDouble(const rapidjson::Value &Desc, const char *key)
+        {
+          if (!Desc.HasMember(key) || !Desc[key].IsNumber())
+            throw FatalException(std::string("Missing numerical parameter: ")
+                + key);
+          return Desc[key].GetDouble();
+        }
+      static size_t GetUint(const rapidjson::Value &Desc, const char *key,
+          const size_t defaultvalue)
+        {
+          if (!Desc.HasMember(key))
+            return defaultvalue;
+          if (!Desc[key].IsUint())
+            throw FatalException(std::string(
+                "Parameter has to be a positive integer: ") + key);
+          return Desc[key].GetUint();
+        }
+      static std::string GetString(const rapidjson::Value &Desc,
+          const char *key, const std::string &defaultvalue)
+        {
+          if (!Desc.HasMember(key))
+            return defaultvalue;
+          if (!Desc[key].IsString())
+            throw FatalException(std::string("Parameter has to be a string: ")
+                + key);
+          return Desc[key].GetString();
+        }
+      //! Run all stages on the data of a single site and add the times for each stage to Times
+      void ProcessSite(TimeSeriesData &Input, std::vector<double> &Times) const
+        {
+          //the output of each stage that is still needed by later stages
+          std::vector<TimeSeriesData> Outputs(Stages.size() + 1);
+          std::vector<int> Remaining(Consumers);
+          Outputs.back() = Input;
+          for (size_t i = 0; i < Stages.size(); ++i)
+            {
+              const size_t source = FindStage(Stages.at(i)->GetInput(), i);
+              const double start = Now();
+              //the last stage that uses an output can work in place
+              if (Remaining.at(source) > 1)
+                Outputs.at(i) = Outputs.at(source).Clone();
+              else
+                {
+                  Outputs.at(i) = Outputs.at(source);
+                  Outputs.at(source) = TimeSeriesData();
+                }
+              --Remaining.at(source);
+              Stages.at(i)->Process(Outputs.at(i));
+              Times.at(i) += Now() - start;
+            }
+        }
+    public:
+      //! Add a stage at the end of the pipeline, input is the name of the stage that provides the data
+      void AddStage(tstage Stage, const std::string &name,
+          const std::string &input)
+        {
+          Stage->SetName(name);
+          Stage->SetInput(input);
+          Stage->SetParallelChannels(parallelchannels);
+          Stages.push_back(Stage);
+          CountConsumers();
+        }
+      //! Set up the pipeline from a json document as described above
+      void ReadJson(const rapidjson::Value &Doc)
+        {
+          if (!Doc.IsObject() || !Doc.HasMember("Stages")
+              || !Doc["Stages"].IsArray())
+            throw FatalException("Pipeline description needs a Stages array !");
+          if (Doc.HasMember("MainInfo") && Doc["MainInfo"].IsObject())
+            {
+              const rapidjson::Value &Info = Doc["MainInfo"];
+              if (Info.HasMember("parallelsites"))
+                parallelsites = Info["parallelsites"].GetBool();
+              if (Info.HasMember("parallelchannels"))
+                parallelchannels = Info["parallelchannels"].GetBool();
+            }
+          Stages.clear();
+          const rapidjson::Value &StageDesc = Doc["Stages"];
+          std::string previous("input");
+          for (rapidjson::SizeType i = 0; i < StageDesc.Size(); ++i)
+            {
+              const std::string name = GetString(StageDesc[i], "name",
+                  "stage" + stringify(i));
+              const std::string input = GetString(StageDesc[i], "input",
+                  previous);
+              AddStage(MakeStage(StageDesc[i]), name, input);
+              previous = name;
+            }
+        }
+      //! Read the time series in each file, run all stages and return the number of sites that failed
+      /*! Errors for a single site are reported on cerr and do not stop the processing of the other sites.
+       */
+      size_t Run(const std::vector<std::string> &Filenames)
+        {
+          const double start = Now();
+          StageTimes.assign(Stages.size(), 0.0);
+          readtime = 0.0;
+          nsites = Filenames.size();
+          size_t nfailed = 0;
+          const int nfiles = Filenames.size();
+#pragma omp parallel default(shared) if(parallelsites && nfiles > 1)
+            {
+              std::vector<double> LocalTimes(Stages.size(), 0.0);
+              double localread = 0.0;
+#pragma omp for schedule(dynamic) reduction(+:nfailed)
+              for (int i = 0; i < nfiles; ++i)
+                {
+                  try
+                    {
+                      const double readstart = Now();
+                      TimeSeriesData Data;
+                      Data.GetData(Filenames.at(i));
+                      localread += Now() - readstart;
+                      ProcessSite(Data, LocalTimes);
+                    } catch (FatalException &e)
+                    {
+#pragma omp critical(tspipeline_output)
+                        {
+                          std::cerr << "Error processing " << Filenames.at(i)
+                              << ": " << e.what() << std::endl;
+                        }
+                      ++nfailed;
+                    }
+                }
+#pragma omp critical(tspipeline_times)
+                {
+                  readtime += localread;
+                  for (size_t j = 0; j < Stages.size(); ++j)
+                    StageTimes.at(j) += LocalTimes.at(j);
+                }
+            }
+          totaltime = Now() - start;
+          return nfailed;
+        }
+      //! The time for each stage summed over all sites, the order is the same as the stages
+      const std::vector<double> &GetStageTimes() const
+        {
+          return StageTimes;
+        }
+      //! Write the timing of the last run as a json object
+      void WriteTimings(std::ostream &output) const
+        {
+          output << std::setprecision(6);
+          output << "{\"sites\":" << nsites << ",\"walltime\":" << totaltime
+              << ",\"read\":" << readtime << ",\"stages\":[";
+          for (size_t i = 0; i < Stages.size(); ++i)
+            output << (i > 0 ? "," : "") << "{\"name\":\""
+                << Stages.at(i)->GetName() << "\",\"type\":\""
+                << Stages.at(i)->GetType() << "\",\"time\":"
+                << StageTimes.at(i) << "}";
+          output << "]}" << std::endl;
+        }
+      TsPipeline() :
+        readtime(0.0), totaltime(0.0), nsites(0), parallelsites(true),
+            parallelchannels(true)
+        {
+        }
+      virtual ~TsPipeline()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /* TSPIPELINE_H_ */
@@ -0,0 +1,415 @@
+#ifndef TSQUALITYCONTROL_H_
+#define TSQUALITYCONTROL_H_
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <boost/cstdint.hpp>
+#include "FatalException.h"
+#include "TsStreamReader.h"
+
+namespace gplib
+  {
+    /** \addtogroup tstools Time series analysis methods */
+    /* @{ */
+
+    //! The number of channels the quality control examines: Ex, Ey, Hx, Hy, Hz
+    const size_t qcchannels = tsstreamchannels;
+
+    //! The reasons why a window of time series data can be marked as bad, several flags can be combined
+    enum tqcflag
+      {
+      //! The data reaches the saturation level or the logger flagged saturation
+      qcsaturation = 1,
+      //! A channel contains a spike or step that is large compared to the typical first difference
+      qcspike = 2,
+      //! A channel contains a long run of identical values
+      qcflat = 4,
+      //! The time stamps are not continuous within the window
+      qcgap = 8,
+      //! The clock error reported by the logger is too large
+      qcclock = 16,
+      //! The logger marked the record as bad
+      qcstatus = 32,
+      //! The correlation between electric and magnetic channels is too low
+      qccoherence = 64
+      };
+
+    //! The quality control results for one window of samples
+    struct QcWindow
+      {
+      //! The index of the first sample of the window in the file
+      boost::uint64_t firstsample;
+      //! The number of samples in the window, only the last window can be shorter
+      boost::uint32_t nsamples;
+      //! The combination of tqcflag values, 0 for good data
+      boost::uint32_t flags;
+      //! The standard deviation of Ex, Ey, Hx, Hy and Hz in the window
+      float stddev[qcchannels];
+      //! The largest squared correlation between the first differences of Ex and Hy or Ey and Hx
+      float coherence;
+      };
+
+    //! The quality control index of a time series file, usually stored in a sidecar file with the ending .qci
+    /*! The index stores the flags and a few statistics for consecutive windows of fixed length. Processing
+     * programs can read the small index file and skip the bad parts of the time series without having to examine
+     * the data. The binary format is a header with the magic string GPQC, the format version, the window length, the
+     * sampling rate and the number of windows followed by the windows, all in little endian byte order.
+     */
+    class TsQcIndex
+      {
+    private:
+      boost::uint32_t windowlength;
+      double samplerate;
+      std::vector<QcWindow> Windows;
+      template<typename T>
+      static void WriteValue(std::ofstream &outfile, const T &value)
+        {
+          outfile.write(reinterpret_cast<const char *> (&value), sizeof(T));
+        }
+      template<typename T>
+      static void ReadValue(std::ifstream &infile, T &value)
+        {
+          infile.read(reinterpret_cast<char *> (&value), sizeof(T));
+        }
+    public:
+      //! The version of the binary format
+      static boost::uint32_t FormatVersion()
+        {
+          return 1;
+        }
+      //! The name of the index file for the time series file filename
+      static std::string IndexName(const std::string &filename)
+        {
+          return filename + ".qci";
+        }
+      //! The number of samples in each window
+      size_t GetWindowLength() const
+        {
+          return windowlength;
+        }
+      double GetSamplerate() const
+        {
+          return samplerate;
+        }
+      void SetSamplerate(const double rate)
+        {
+          samplerate = rate;
+        }
+      const std::vector<QcWindow> &GetWindows() const
+        {
+          return Windows;
+        }
+      //! Append the results for the next window
+      void AddWindow(const QcWindow &Window)
+        {
+          Windows.push_back(Window);
+        }
+      //! Check whether all samples between start and start + length are in good windows
+      bool IsGood(const size_t start, const size_t length) const
+        {
+          if (length == 0 || windowlength == 0)
+            return true;
+          const size_t first = start / windowlength;
+          const size_t last = std::min((start + length - 1) / windowlength,
+              Windows.size() - 1);
+          for (size_t i = first; i <= last && i < Windows.size(); ++i)
+            if (Windows[i].flags != 0)
+              return false;
+          return true;
+        }
+      //! For nsegments consecutive segments of seglength samples return which segments only contain good data
+      std::vector<bool> GoodSegments(const size_t seglength,
+          const size_t nsegments) const
+        {
+          std::vector<bool> Result(nsegments);
+          for (size_t i = 0; i < nsegments; ++i)
+            Result[i] = IsGood(i * seglength, seglength);
+          return Result;
+        }
+      //! The number of windows with at least one of the flags in mask set
+      size_t CountFlagged(const boost::uint32_t mask = ~boost::uint32_t(0)) const
+        {
+          size_t count = 0;
+          for (size_t i = 0; i < Windows.size(); ++i)
+            if (Windows[i].flags & mask)
+              ++count;
+          return count;
+        }
+      //! Write the index in binary format
+      void WriteIndex(const std::string &filename) const
+        {
+          std::ofstream outfile(filename.c_str(), std::ios::binary);
+          if (!outfile)
+            throw FatalException("Cannot write index file: " + filename);
+          outfile.write("GPQC", 4);
+          WriteValue(outfile, FormatVersion());
+          WriteValue(outfile, windowlength);
+          WriteValue(outfile, samplerate);
+          const boost::uint64_t nwindows = Windows.size();
+          WriteValue(outfile, nwindows);
+          for (size_t i = 0; i < Windows.size(); ++i)
+            {
+              WriteValue(outfile, Windows[i].firstsample);
+              WriteValue(outfile, Windows[i].nsamples);
+              WriteValue(outfile, Windows[i].flags);
+              for (size_t j = 0; j < qcchannels; ++j)
+                WriteValue(outfile, Windows[i].stddev[j]);
+              WriteValue(outfile, Windows[i].coherence);
+            }
+        }
+      //! Read an index that was written with WriteIndex
+      void ReadIndex(const std::string &filename)
+        {
+          std::ifstream infile(filename.c_str(), std::ios::binary);
+          if (!infile)
+            throw FatalException("Cannot read index file: " + filename);
+          char magic[4];
+          infile.read(magic, 4);
+          boost::uint32_t fileversion = 0;
+          ReadValue(infile, fileversion);
+          if (!infile.good() || std::strncmp(magic, "GPQC", 4) != 0
+              || fileversion != FormatVersion())
+            throw FatalException("Not a valid index file: " + filename);
+          ReadValue(infile, windowlength);
+          ReadValue(infile, samplerate);
+          boost::uint64_t nwindows = 0;
+          ReadValue(infile, nwindows);
+          Windows.resize(nwindows);
+          for (size_t i = 0; i < Windows.size(); ++i)
+            {
+              ReadValue(infile, Windows[i].firstsample);
+              ReadValue(infile, Windows[i].nsamples);
+              ReadValue(infile, Windows[i].flags);
+              for (size_t j = 0; j < qcchannels; ++j)
+                ReadValue(infile, Windows[i].stddev[j]);
+              ReadValue(infile, Windows[i].coherence);
+            }
+          if (!infile.good())
+            throw FatalException("Index file is truncated: " + filename);
+        }
+      explicit TsQcIndex(const size_t length = 0, const double rate = 1.0) :
+        windowlength(length), samplerate(rate)
+        {
+        }
+      virtual ~TsQcIndex()
+        {
+        }
+      };
+
+    //! Scan a time series file in a single pass and create a quality control index
+    /*! The files are read in blocks and only one window of samples is kept in memory, so files of any
+     * size can be scanned. Phoenix MTU files are read record by record, the status, saturation and
+     * clock error fields of the record headers and the start times of the records are used in addition to the data.
+     * For LEMI files the time stamp of each sample is checked, BIRRP ascii files do not have time information.
+     * In the data we look for
+     * - samples at the saturation level
+     * - spikes and steps, i.e. first differences larger than spikethreshold times the median absolute first difference
+     * - runs of at least flatlength identical samples
+     * - a low correlation between the first differences of the electric and the orthogonal magnetic channel
+     */
+    class TsQualityControl
+      {
+    private:
+      size_t windowlength;
+      //! Samples with an absolute value of at least this level are saturated, 0 disables the test
+      double saturationlevel;
+      //! The threshold for spikes relative to the median absolute first difference, 0 disables the test
+      double spikethreshold;
+      //! The minimum length of a flat line, 0 disables the test
+      size_t flatlength;
+      //! The minimum squared correlation between electric and magnetic channels, 0 disables the test
+      double mincoherence;
+      //! The maximum clock error in the MTU record headers, 0 disables the test
+      double maxclockerror;
+      //! The samples of the current window, one vector per channel
+      std::vector<std::vector<double> > Buffer;
+      //! The flags that were set by the record headers for the current window
+      boost::uint32_t pendingflags;
+      //! The index of the first sample of the current window
+      boost::uint64_t windowstart;
+      //! Temporary storage for the analysis
+      std::vector<double> Differences;
+      //! The maximum number of differences we use to estimate the typical difference
+      static size_t MedianSamples()
+        {
+          return 256;
+        }
+      TsQcIndex Index;
+      //! The longest run of identical values in Data
+      static size_t LongestRun(const std::vector<double> &Data)
+        {
+          size_t longest = Data.empty() ? 0 : 1, current = 1;
+          for (size_t i = 1; i < Data.size(); ++i)
+            {
+              current = (Data[i] == Data[i - 1]) ? current + 1 : 1;
+              longest = std::max(longest, current);
+            }
+          return longest;
+        }
+      //! The squared correlation coefficient of the first differences of two channels
+      static double DiffCorrelation(const std::vector<double> &A,
+          const std::vector<double> &B)
+        {
+          double ab = 0.0, aa = 0.0, bb = 0.0;
+          for (size_t i = 1; i < A.size(); ++i)
+            {
+              const double da = A[i] - A[i - 1];
+              const double db = B[i] - B[i - 1];
+              ab += da * db;
+              aa += da * da;
+              bb += db * db;
+            }
+          return (aa > 0.0 && bb > 0.0) ? ab * ab / (aa * bb) : 0.0;
+        }
+      //! Analyze the samples in the buffer and add the window to the index
+      void FinishWindow()
+        {
+          const size_t nsamples = Buffer.front().size();
+          if (nsamples == 0)
+            return;
+          QcWindow Window;
+          Window.firstsample = windowstart;
+          Window.nsamples = nsamples;
+          Window.flags = pendingflags;
+          for (size_t c = 0; c < qcchannels; ++c)
+            {
+              const std::vector<double> &Data = Buffer[c];
+              double sum = 0.0, minimum = Data.front(), maximum = Data.front();
+              for (size_t i = 0; i < nsamples; ++i)
+                {
+                  sum += Data[i];
+                  minimum = std::min(minimum, Data[i]);
+                  maximum = std::max(maximum, Data[i]);
+                }
+              const double mean = sum / nsamples;
+              double variance = 0.0;
+              for (size_t i = 0; i < nsamples; ++i)
+                variance += (Data[i] - mean) * (Data[i] - mean);
+              Window.stddev[c] = nsamples > 1 ? std::sqrt(variance / (nsamples
+                  - 1)) : 0.0;
+              if (saturationlevel > 0.0 && (maximum >= saturationlevel
+                  || minimum <= -saturationlevel))
+                Window.flags |= qcsaturation;
+              if (flatlength > 0 && LongestRun(Data) >= flatlength)
+                Window.flags |= qcflat;
+              if (spikethreshold > 0.0 && nsamples > 2)
+                {
+                  double maxdiff = 0.0;
+                  for (size_t i = 1; i < nsamples; ++i)
+                    maxdiff = std::max(maxdiff, std::abs(Data[i] - Data[i
+                        - 1]));
+                  //the median of a regular subset of the differences is a sufficient estimate of the typical
+                  //difference and much cheaper than the median of all differences for long windows
+                  const size_t stride = std::max(size_t(1), (nsamples - 1)
+                      / MedianSamples());
+                  Differences.clear();
+                  for (size_t i = 1; i < nsamples; i += stride)
+                    Differences.push_back(std::abs(Data[i] - Data[i - 1]));
+                  std::nth_element(Differences.begin(), Differences.begin()
+                      + Differences.size() / 2, Differences.end());
+                  const double typical = Differences[Differences.size() / 2];
+                  //for flat data the spike test is meaningless, this is caught by the flat line test
+                  if (typical > 0.0 && maxdiff > spikethreshold * typical)
+                    Window.flags |= qcspike;
+                }
+            }
+          //the channels are stored in the order Ex, Ey, Hx, Hy, Hz
+          Window.coherence = std::max(DiffCorrelation(Buffer[0], Buffer[3]),
+              DiffCorrelation(Buffer[1], Buffer[2]));
+          if (mincoherence > 0.0 && Window.coherence < mincoherence)
+            Window.flags |= qccoherence;
+          Index.AddWindow(Window);
+          windowstart += nsamples;
+          pendingflags = 0;
+          for (size_t c = 0; c < qcchannels; ++c)
+            Buffer[c].clear();
+        }
+      //! Add one sample for each channel with the flags that apply to this sample
+      void AddSample(const double *Values, const boost::uint32_t flags)
+        {
+          for (size_t c = 0; c < qcchannels; ++c)
+            Buffer[c].push_back(Values[c]);
+          pendingflags |= flags;
+          if (Buffer.front().size() == windowlength)
+            FinishWindow();
+        }
+    public:
+      //! Scan the file filename, the format is determined from the file extension as in TimeSeriesData
+      const TsQcIndex &Scan(const std::string &filename)
+        {
+          Index = TsQcIndex(windowlength);
+          Buffer.assign(qcchannels, std::vector<double>());
+          for (size_t c = 0; c < qcchannels; ++c)
+            Buffer[c].reserve(windowlength);
+          pendingflags = 0;
+          windowstart = 0;
+          boost::shared_ptr<TsStreamReader> Reader(OpenTsStream(filename));
+          TsStreamBlock Block;
+          double expectedstart = 0.0;
+          bool firstblock = true;
+          while (Reader->ReadBlock(Block))
+            {
+              Index.SetSamplerate(Reader->GetSamplerate());
+              boost::uint32_t flags = 0;
+              if (Block.status != 0)
+                flags |= qcstatus;
+              if (Block.saturation != 0)
+                flags |= qcsaturation;
+              if (maxclockerror > 0.0 && std::abs(Block.clockerror)
+                  > maxclockerror)
+                flags |= qcclock;
+              boost::uint32_t gapflag = 0;
+              if (Block.hastime)
+                {
+                  if (!firstblock && std::abs(Block.starttime - expectedstart)
+                      >= Reader->GetTimeTolerance())
+                    gapflag = qcgap;
+                  expectedstart = Block.starttime + Block.GetNSamples()
+                      / Reader->GetSamplerate();
+                }
+              firstblock = false;
+              const size_t nsamples = Block.GetNSamples();
+              for (size_t i = 0; i < nsamples; ++i)
+                {
+                  AddSample(&Block.Data[i * qcchannels], flags | gapflag);
+                  gapflag = 0;
+                }
+            }
+          FinishWindow();
+          return Index;
+        }
+      //! The index of the last scanned file
+      const TsQcIndex &GetIndex() const
+        {
+          return Index;
+        }
+      //! Set the thresholds, a value of 0 disables the corresponding test
+      void SetThresholds(const double saturation, const double spike,
+          const size_t flat, const double coherence, const double clockerror)
+        {
+          saturationlevel = saturation;
+          spikethreshold = spike;
+          flatlength = flat;
+          mincoherence = coherence;
+          maxclockerror = clockerror;
+        }
+      //! Setup the quality control with windows of length samples and default thresholds for 24 bit data
+      explicit TsQualityControl(const size_t length) :
+        windowlength(length), saturationlevel(8388607.0), spikethreshold(
+            20.0), flatlength(50), mincoherence(0.0), maxclockerror(0.0),
+            pendingflags(0), windowstart(0), Index(length)
+        {
+          if (windowlength == 0)
+            throw FatalException("Window length has to be at least 1 !");
+        }
+      virtual ~TsQualityControl()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /* TSQUALITYCONTROL_H_ */
@@ -0,0 +1,288 @@
+#ifndef TSSTREAMREADER_H_
+#define TSSTREAMREADER_H_
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cmath>
+#include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/gregorian/gregorian_types.hpp>
+#include "FatalException.h"
+#include "Util.h"
+#include "FastAscii.h"
+
+namespace gplib
+  {
+    /** \addtogroup tstools Time series analysis methods */
+    /* @{ */
+
+    //! The number of channels in a time series stream: Ex, Ey, Hx, Hy, Hz
+    const size_t tsstreamchannels = 5;
+
+    //! Seconds since 1.1.1970 for a date and time
+    inline double TsSeconds(const int year, const int month, const int day,
+        const int hour, const int minute, const double second)
+      {
+        const long days = (boost::gregorian::date(year, month, day)
+            - boost::gregorian::date(1970, 1, 1)).days();
+        return days * 86400.0 + hour * 3600.0 + minute * 60.0 + second;
+      }
+
+    //! A block of continuous samples read from a time series file
+    struct TsStreamBlock
+      {
+      //! The time of the first sample in seconds since 1.1.1970, only valid if hastime is true
+      double starttime;
+      //! Does the file format provide time stamps
+      bool hastime;
+      //! The status of the record as reported by the logger, 0 if the format does not provide it
+      int status;
+      //! The saturation flags of the record as reported by the logger, 0 if the format does not provide them
+      int saturation;
+      //! The clock error of the logger, 0 if the format does not provide it
+      double clockerror;
+      //! The samples, interleaved in the order Ex, Ey, Hx, Hy, Hz
+      std::vector<double> Data;
+      //! The number of samples for each channel
+      size_t GetNSamples() const
+        {
+          return Data.size() / tsstreamchannels;
+        }
+      TsStreamBlock() :
+        starttime(0.0), hastime(false), status(0), saturation(0), clockerror(
+            0.0)
+        {
+        }
+      };
+
+    //! The base class for sequential readers that process a time series file block by block
+    /*! In contrast to the classes derived from TimeSeries, the readers do not keep the whole time series
+     * in memory, so they can be used for files of any size and for many files at once.
+     */
+    class TsStreamReader
+      {
+    protected:
+      double samplerate;
+      //! The resolution of the time stamps in seconds
+      double timeresolution;
+    public:
+      //! Read the next block of continuous samples, returns false when the end of the file is reached
+      virtual bool ReadBlock(TsStreamBlock &Block) = 0;
+      //! The sampling rate in Hz, only valid after the first block has been read
+      double GetSamplerate() const
+        {
+          return samplerate;
+        }
+      //! Two blocks are continuous if the time difference is smaller than this tolerance
+      double GetTimeTolerance() const
+        {
+          return std::max(timeresolution, 0.5 / samplerate);
+        }
+      TsStreamReader(const double rate, const double resolution) :
+        samplerate(rate), timeresolution(resolution)
+        {
+        }
+      virtual ~TsStreamReader()
+        {
+        }
+      };
+
+    //! Read Phoenix MTU files (.ts3, .ts4, .ts5) record by record
+    class MtuStreamReader: public TsStreamReader
+      {
+    private:
+      std::ifstream infile;
+      std::vector<unsigned char> Record;
+      static const size_t tagsize = 32;
+    public:
+      virtual bool ReadBlock(TsStreamBlock &Block)
+        {
+          unsigned char Tag[tagsize];
+          if (!infile.read(reinterpret_cast<char *> (Tag), tagsize))
+            return false;
+          const int nscans = Tag[11] * 256 + Tag[10];
+          const int nchannels = Tag[12];
+          const int samplelength = Tag[17];
+          const double rate = Tag[19] * 256 + Tag[18];
+          if (nchannels < int(tsstreamchannels) || samplelength != 3 || rate
+              <= 0.0)
+            throw FatalException("Unsupported MTU record format !");
+          //the sample unit is either seconds or minutes
+          samplerate = Tag[20] == 1 ? rate / 60.0 : rate;
+          Record.resize(nscans * nchannels * samplelength);
+          if (!Record.empty() && !infile.read(
+              reinterpret_cast<char *> (&Record[0]), Record.size()))
+            return false;
+          Block.hastime = true;
+          //the start time of the record has a resolution of one second
+          Block.starttime = TsSeconds(Tag[7] * 100 + Tag[5], Tag[4], Tag[3],
+              Tag[2], Tag[1], Tag[0]);
+          Block.status = Tag[14];
+          Block.saturation = Tag[15];
+          Block.clockerror = boost::int32_t(boost::uint32_t(Tag[25]) << 24
+              | boost::uint32_t(Tag[24]) << 16 | boost::uint32_t(Tag[23])
+              << 8 | Tag[22]);
+          Block.Data.resize(nscans * tsstreamchannels);
+          const unsigned char *current = Record.empty() ? NULL : &Record[0];
+          double *out = Block.Data.empty() ? NULL : &Block.Data[0];
+          for (int i = 0; i < nscans; ++i)
+            {
+              for (int c = 0; c < nchannels; ++c, current += samplelength)
+                {
+                  if (c >= int(tsstreamchannels))
+                    continue;
+                  //24 bit little endian two's complement
+                  boost::int32_t value = current[0] | (current[1] << 8)
+                      | (current[2] << 16);
+                  if (value & 0x800000)
+                    value -= 0x1000000;
+                  *out++ = value;
+                }
+            }
+          return true;
+        }
+      explicit MtuStreamReader(const std::string &filename) :
+        TsStreamReader(1.0, 1.0), infile(filename.c_str(), std::ios::binary)
+        {
+          if (!infile)
+            throw FatalException("Cannot open file: " + filename);
+        }
+      virtual ~MtuStreamReader()
+        {
+        }
+      };
+
+    //! Read LEMI ascii files line by line, a block ends at a gap in the time stamps or after maxblock samples
+    class LemiStreamReader: public TsStreamReader
+      {
+    private:
+      LineReader infile;
+      //! A sample that has been read, but belongs to the next block
+      std::vector<double> Pending;
+      double pendingtime;
+      bool havepending;
+      size_t maxblock;
+      //! Parse the next valid line, returns false at the end of the file
+      bool ReadLine(double &time, double *Values)
+        {
+          double Fields[16];
+          const char *line = NULL;
+          size_t length = 0;
+          while (infile.NextLine(line, length))
+            {
+              if (ParseValues(line, Fields, 16) < 13)
+                continue;
+              time = TsSeconds(int(Fields[0]), int(Fields[1]), int(Fields[2]),
+                  int(Fields[3]), int(Fields[4]), Fields[5]);
+              //the file contains Hx, Hy, Hz, two temperatures, Ex and Ey
+              Values[0] = Fields[11];
+              Values[1] = Fields[12];
+              Values[2] = Fields[6];
+              Values[3] = Fields[7];
+              Values[4] = Fields[8];
+              return true;
+            }
+          return false;
+        }
+    public:
+      virtual bool ReadBlock(TsStreamBlock &Block)
+        {
+          Block.Data.clear();
+          Block.hastime = true;
+          Block.status = 0;
+          Block.saturation = 0;
+          Block.clockerror = 0.0;
+          double time = 0.0, lasttime = 0.0;
+          double Values[tsstreamchannels];
+          if (havepending)
+            {
+              Block.Data.assign(Pending.begin(), Pending.end());
+              Block.starttime = lasttime = pendingtime;
+              havepending = false;
+            }
+          while (Block.GetNSamples() < maxblock && ReadLine(time, Values))
+            {
+              if (Block.Data.empty())
+                Block.starttime = lasttime = time;
+              else if (std::abs(time - lasttime - 1.0 / samplerate) > 0.5
+                  / samplerate)
+                {
+                  Pending.assign(Values, Values + tsstreamchannels);
+                  pendingtime = time;
+                  havepending = true;
+                  break;
+                }
+              Block.Data.insert(Block.Data.end(), Values, Values
+                  + tsstreamchannels);
+              lasttime = time;
+            }
+          return !Block.Data.empty();
+        }
+      explicit LemiStreamReader(const std::string &filename, const size_t block =
+          4096) :
+        TsStreamReader(4.0, 0.0), infile(filename), pendingtime(0.0),
+            havepending(false), maxblock(block)
+        {
+        }
+      virtual ~LemiStreamReader()
+        {
+        }
+      };
+
+    //! Read BIRRP ascii files with the columns Ex, Ey, Hx, Hy, Hz, these files do not contain time information
+    class BirrpStreamReader: public TsStreamReader
+      {
+    private:
+      LineReader infile;
+      size_t maxblock;
+    public:
+      virtual bool ReadBlock(TsStreamBlock &Block)
+        {
+          Block.Data.clear();
+          Block.hastime = false;
+          Block.status = 0;
+          Block.saturation = 0;
+          Block.clockerror = 0.0;
+          double Values[tsstreamchannels];
+          const char *line = NULL;
+          size_t length = 0;
+          while (Block.GetNSamples() < maxblock && infile.NextLine(line, length))
+            {
+              const size_t nvalues = ParseValues(line, Values, tsstreamchannels);
+              if (nvalues == tsstreamchannels)
+                Block.Data.insert(Block.Data.end(), Values, Values
+                    + tsstreamchannels);
+            }
+          return !Block.Data.empty();
+        }
+      explicit BirrpStreamReader(const std::string &filename,
+          const double rate = 1.0, const size_t block = 4096) :
+        TsStreamReader(rate, 0.0), infile(filename), maxblock(block)
+        {
+        }
+      virtual ~BirrpStreamReader()
+        {
+        }
+      };
+
+    //! Create a reader for filename, the format is determined from the file extension as in TimeSeriesData
+    inline boost::shared_ptr<TsStreamReader> OpenTsStream(
+        const std::string &filename)
+      {
+        const std::string ending = GetFileExtension(filename);
+        if (ending == ".ts3" || ending == ".TS3" || ending == ".ts4" || ending
+            == ".TS4" || ending == ".ts5" || ending == ".TS5")
+          return boost::shared_ptr<TsStreamReader>(new MtuStreamReader(
+              filename));
+        if (ending == ".lem")
+          return boost::shared_ptr<TsStreamReader>(new LemiStreamReader(
+              filename));
+        if (ending == ".asc")
+          return boost::shared_ptr<TsStreamReader>(new BirrpStreamReader(
+              filename));
+        throw FatalException("Unsupported format for streaming: " + filename);
+      }
+  /* @} */
+  }
+#endif /* TSSTREAMREADER_H_ */
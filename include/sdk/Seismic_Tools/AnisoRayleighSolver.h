@@ -0,0 +1,168 @@
+#ifndef ANISORAYLEIGHSOLVER_H_
+#define ANISORAYLEIGHSOLVER_H_
+#include "AnisoSurfaceWaveModel.h"
+#include "ParkSurfaceWaveData.h"
+#include "RayleighDispersion.h"
+#include "types.h"
+#include "FatalException.h"
+#include <vector>
+#include <cmath>
+
+namespace gplib
+  {
+    /** \addtogroup seistools Seismic data analysis and modeling */
+    /* @{ */
+
+    //! Calculate fundamental mode Rayleigh phase velocities for an AnisoSurfaceWaveModel without external programs
+    /*! The azimuthal anisotropy enters the calculation through the apparent shear velocities Vs + B cos(2 phi)
+     * stored in the model, so we solve the isotropic problem for the apparent velocities, P-velocities and densities.
+     * Below the inverted layers we use the same fixed reference model as AnisoSurfaceWaveModel::WriteModel:
+     * a gradient from the last inverted layer to 410 km and a fixed mantle down to the core-mantle boundary.
+     * Gradients are approximated by homogeneous sublayers, and the spherical model is transformed to
+     * a flat model with the earth flattening transformation for Rayleigh waves. The calculation is elastic, i.e.
+     * we do not correct for physical dispersion due to attenuation. All methods are const, so one object
+     * can be shared by several threads.
+     */
+    class AnisoRayleighSolver
+      {
+    private:
+      //! The radius of the earth in km
+      double earthradius;
+      //! The maximum thickness of the sublayers that approximate a gradient in km
+      double maxsublayer;
+      //! A point of the piecewise linear velocity profile, two nodes at the same depth form a discontinuity
+      struct ProfileNode
+        {
+        double depth;
+        double density;
+        double vp;
+        double vs;
+        ProfileNode(const double z, const double rho, const double p,
+            const double s) :
+          depth(z), density(rho), vp(p), vs(s)
+          {
+          }
+        };
+      //! Append a flattened homogeneous layer between the depths top and bottom in the spherical model
+      void AddLayer(const double top, const double bottom, const double rho,
+          const double p, const double s, trealdata &Thickness, trealdata &Vp,
+          trealdata &Vs, trealdata &Density) const
+        {
+          const double factor = 2.0 * earthradius / (2.0 * earthradius - top
+              - bottom);
+          Thickness.push_back(earthradius * std::log((earthradius - top)
+              / (earthradius - bottom)));
+          Vp.push_back(p * factor);
+          Vs.push_back(s * factor);
+          Density.push_back(rho * std::pow(factor, -2.275));
+        }
+      //! The velocity profile of the model and the fixed reference model in km, km/s and g/cm^3
+      std::vector<ProfileNode> MakeProfile(const AnisoSurfaceWaveModel &Model) const
+        {
+          const size_t nlayers = Model.GetThicknesses().size();
+          if (nlayers < 2 || Model.GetVp().size() != nlayers
+              || Model.GetVs().size() != nlayers
+              || Model.GetVsapp().size() != nlayers
+              || Model.GetDensities().size() != nlayers)
+            throw FatalException("Inconsistent model in AnisoRayleighSolver !");
+          std::vector<ProfileNode> Profile;
+          double depth = 0.0;
+          for (size_t i = 0; i < nlayers - 1; ++i)
+            {
+              const double rho = Model.GetDensities().at(i);
+              const double p = Model.GetVp().at(i);
+              const double s = Model.GetVsapp().at(i);
+              Profile.push_back(ProfileNode(depth, rho, p, s));
+              depth += Model.GetThicknesses().at(i);
+              Profile.push_back(ProfileNode(depth, rho, p, s));
+            }
+          if (depth >= 410.0)
+            throw FatalException(
+                "The inverted layers in AnisoRayleighSolver have to end above 410 km !");
+          //the last layer is a gradient between the isotropic velocity of layer n-2 and the values at 410 km
+          const double lastvs = Model.GetVs().at(nlayers - 2);
+          Profile.push_back(ProfileNode(depth, lastvs * 0.554 + 0.77, lastvs
+              * 1.80, lastvs));
+          //the fixed reference model from 410 km to the core-mantle boundary
+          const size_t nfixed = 9;
+          static const double Fixed[nfixed][4] =
+            {
+              { 410.0, 3.46798, 8.43509, 4.87000 },
+              { 410.0, 3.93170, 9.31471, 5.04152 },
+              { 660.0, 3.92010, 10.15258, 5.56985 },
+              { 660.0, 4.23870, 10.77504, 5.94718 },
+              { 1007.5, 4.59260, 11.45203, 6.37039 },
+              { 1502.5, 4.85620, 12.17018, 6.66331 },
+              { 1997.5, 5.10270, 12.77147, 6.89860 },
+              { 2492.5, 5.33130, 13.33080, 7.11286 },
+              { 2891.5, 5.77210, 13.62192, 7.24853 } };
+          for (size_t i = 0; i < nfixed; ++i)
+            Profile.push_back(ProfileNode(Fixed[i][0], Fixed[i][1],
+                Fixed[i][2], Fixed[i][3]));
+          return Profile;
+        }
+    public:
+      //! Create the flat layered model for the dispersion calculation
+      RayleighDispersion MakeDispersion(const AnisoSurfaceWaveModel &Model) const
+        {
+          const std::vector<ProfileNode> Profile(MakeProfile(Model));
+          trealdata Thickness, Vp, Vs, Density;
+          for (size_t i = 0; i + 1 < Profile.size(); ++i)
+            {
+              const ProfileNode &Top = Profile[i];
+              const ProfileNode &Bottom = Profile[i + 1];
+              const double length = Bottom.depth - Top.depth;
+              if (length <= 0.0)
+                continue;
+              //a linear gradient is divided into sublayers with the values at their centre
+              const size_t nsub = (Top.vs == Bottom.vs && Top.vp == Bottom.vp
+                  && Top.density == Bottom.density) ? 1 : size_t(std::ceil(
+                  length / maxsublayer));
+              for (size_t j = 0; j < nsub; ++j)
+                {
+                  const double frac = (j + 0.5) / nsub;
+                  AddLayer(Top.depth + j * length / nsub, Top.depth + (j + 1)
+                      * length / nsub, Top.density + frac * (Bottom.density
+                      - Top.density), Top.vp + frac * (Bottom.vp - Top.vp),
+                      Top.vs + frac * (Bottom.vs - Top.vs), Thickness, Vp, Vs,
+                      Density);
+                }
+            }
+          //the lowermost mantle continues as a half-space, which is never reached at the periods of interest
+          const ProfileNode &Last = Profile.back();
+          const double factor = earthradius / (earthradius - Last.depth);
+          Thickness.push_back(0.0);
+          Vp.push_back(Last.vp * factor);
+          Vs.push_back(Last.vs * factor);
+          Density.push_back(Last.density * std::pow(factor, -2.275));
+          return RayleighDispersion(Thickness, Vp, Vs, Density);
+        }
+      //! Calculate the phase velocities for the periods in s
+      ParkSurfaceWaveData CalcData(const AnisoSurfaceWaveModel &Model,
+          const trealdata &Periods) const
+        {
+          if (Periods.empty())
+            throw FatalException(
+                "No periods specified for surface wave calculation !");
+          ParkSurfaceWaveData Result;
+          Result.SetPeriods() = Periods;
+          Result.SetPhaseVelocities() = MakeDispersion(Model).PhaseVelocities(
+              Periods);
+          return Result;
+        }
+      //! The radius is used for the earth flattening, sublayer is the maximum thickness of a gradient sublayer, both in km
+      AnisoRayleighSolver(const double sublayer = 25.0, const double radius =
+          6371.0) :
+        earthradius(radius), maxsublayer(sublayer)
+        {
+          if (maxsublayer <= 0.0 || earthradius <= 0.0)
+            throw FatalException(
+                "Invalid sublayer thickness or earth radius in AnisoRayleighSolver !");
+        }
+      virtual ~AnisoRayleighSolver()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*ANISORAYLEIGHSOLVER_H_*/
@@ -9,7 +9,6 @@
 #include <numeric>
 #include <boost/bind.hpp>
 #include <string>
-#include <boost/filesystem.hpp>
 #include "FatalException.h"
 #include <iostream>
 
@@ -359,52 +358,6 @@ namespace gplib
             i--;
           }
       }
-      //! Write out a script that computes synthetic data for a model with name filename+.dat
-      void WriteRunFile(const std::string &filename) const
-      {
-        std::ofstream runfile(filename.c_str());
-        std::ofstream inputfile((filename + ".in").c_str());
-        inputfile << "isomodel" << " " << std::endl;
-        inputfile << "output" << " " << std::endl;
-        inputfile << "phase" << " " << std::endl;
-        // periods for Germany and synthetics
-        inputfile << 34 << " " << std::endl;
-        inputfile << 14.08 << " " << 14.49 << " " << 14.92 << " " << 15.38
-            << " " << 15.87 << " " << 16.39 << " " << 16.94 << " " << 17.54
-            << " " << 18.18 << " " << 18.86 << " " << 19.60 << " " << 20.40
-            << " " << 21.27 << " " << 22.22 << " " << 23.25 << " " << 24.39
-            << " " << 25.64 << " " << 27.02 << " " << 29.41 << " " << 31.25
-            << " " << 33.33 << " " << 35.71 << " " << 38.46 << " " << 41.66
-            << " " << 45.45 << " " << 50. << " " << 55.55 << " " << 62.50
-            << " " << 71.42 << " " << 83.33 << " " << 100. << " " << 125.
-            << " " << 166.66 << " " << 250. << " " << std::endl;
-        // periods for Slave
-        /*    inputfile << 31 << " " << std::endl;
-         inputfile << 15.15 << " " << 15.62 << " " << 16.12 << " " << 16.67 << " " << 17.24 << " " << 17.86
-         << " " << 18.52 << " " << 19.23 << " " << 20.00 << " " << 20.83 << " " << 21.74 << " " << 22.73
-         << " " << 23.81 << " " << 25.00 << " " << 26.31 << " " << 27.78 << " " << 29.41 << " " << 31.25
-         << " " << 33.33 << " " << 35.71 << " " << 38.46 << " " << 41.67 << " " << 45.45 << " " << 50.00
-         << " " << 55.55 << " " << 62.50 << " " << 71.40 << " " << 83.33 << " " << 100. << " " << 125.
-         << " " << 166.67 << " " << std::endl;
-         */
-        boost::filesystem::path Path(filename);
-        std::string dirname(filename + "_dir");
-        runfile << "#!/bin/bash" << std::endl;
-        runfile << "mkdir " << dirname << std::endl;
-        runfile << "mv " << filename << ".* " << dirname << std::endl;
-        runfile << "cd " << dirname << std::endl;
-        runfile << "cp " << Path.leaf() << ".mod isomodel" << std::endl;
-        runfile << "cp " << Path.leaf() << ".in input" << std::endl;
-        // Run on Wegener
-        runfile << "isoraylC_fund < input 2>&1> /dev/null" << std::endl;
-        runfile << "cp �MXAe ../" << filename + ".cvel" << std::endl;
-        // Run on Stokes
-        //    runfile << "../bin/isoraylC_fund < input 2>&1> /dev/null" << std::endl;
-        //    runfile << "cp phase ../" << filename + ".cvel" << std::endl;
-        if (!runfile.good())
-          throw FatalException("Problem writing to file: " + filename);
-      }
-
       //!Write out an ascii file for plotting the model with xmgrace
       void WritePlot(const std::string &filename) const
       {
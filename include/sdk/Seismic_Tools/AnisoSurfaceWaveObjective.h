@@ -55,6 +55,7 @@ namespace gplib
           {
             errorlevel = Old.errorlevel;
             poisson = Old.poisson;
+            backazimuth = Old.backazimuth;
             avelratio = Old.avelratio;
           }
       AnisoSurfaceWaveObjective& operator=(
@@ -68,6 +69,7 @@ namespace gplib
         Synthetic = source.Synthetic;
         errorlevel = source.errorlevel;
         poisson = source.poisson;
+        backazimuth = source.backazimuth;
         avelratio = source.avelratio;
         return *this;
       }
@@ -81,6 +83,8 @@ namespace gplib
             backazimuth = ba;
             poisson = pois;
             errorlevel = err;
+            //we calculate synthetic data for the measured periods
+            Synthetic.SetCalculationPeriods(MeasuredData.GetPeriods());
           }
 
       virtual ~AnisoSurfaceWaveObjective();
@@ -89,6 +93,11 @@ namespace gplib
         {
           return new AnisoSurfaceWaveObjective(*this);
         }
+      //! The anisotropic dispersion calculation is about ten times the cost of a 1D MT forward calculation
+      virtual double GetCostEstimate() const
+        {
+          return 10.0;
+        }
       //! Some operations cannot be done in parallel, these are done before
       virtual void PreParallel(const ttranscribed &member)
       {
@@ -3,11 +3,13 @@
 
 #include "ParkSurfaceWaveData.h"
 #include "AnisoSurfaceWaveModel.h"
+#include "AnisoRayleighSolver.h"
 #include <string>
+#include <algorithm>
+#include <iterator>
 #include <boost/shared_ptr.hpp>
 
 #include "types.h"
-#include "Util.h"
 
 
 namespace gplib
@@ -15,12 +17,16 @@ namespace gplib
     /** \addtogroup seistools Seismic data analysis and modeling */
     /* @{ */
     //! Calculate synthetic anisotropic surface wave data
+    /*! The phase velocities are calculated in memory with AnisoRayleighSolver, so no files are written
+     * and SafeParallel can be called for different objects from several threads.
+     */
     class AnisoSurfaceWaveSynthetic
       {
     private:
       trealdata calculationperiods;
       boost::shared_ptr<const AnisoSurfaceWaveModel> Model;
       ParkSurfaceWaveData SynthData;
+      AnisoRayleighSolver Solver;
     public:
       const ParkSurfaceWaveData &GetSynthData() const
         {
@@ -42,18 +48,27 @@ namespace gplib
         {
           Model->WritePlot(filename);
         }
+      //! Get the vector of periods in s for which we want to calculate phase velocities
+      const trealdata &GetCalculationPeriods() const
+        {
+          return calculationperiods;
+        }
+      //! Set the vector of periods in s for which we want to calculate phase velocities
+      void SetCalculationPeriods(const trealdata &c)
+        {
+          calculationperiods.clear();
+          std::copy(c.begin(), c.end(), std::back_inserter(calculationperiods));
+        }
+      //! Nothing has to be done before the parallel part, we keep the function for compatibility with the other synthetics
       void PreParallel(const std::string &filename)
       {
-        Model->WriteRunFile(filename);
-        Model->WriteModel(filename + ".mod");
       }
-
+      //! Calculate the phase velocities for the current model, the filename is not used any more
       ParkSurfaceWaveData SafeParallel(const std::string &filename)
       {
-        const std::string fullname = filename;
-        int result = std::system(("bash ./" + fullname).c_str());
-        SynthData.ReadAscii(fullname + ".cvel");
-        CleanFiles(fullname);
+        if (!Model)
+          throw FatalException("No model set in AnisoSurfaceWaveSynthetic !");
+        SynthData = Solver.CalcData(*Model, calculationperiods);
         return SynthData;
       }
       ParkSurfaceWaveData GetSynthData(const std::string &filename)
@@ -0,0 +1,228 @@
+#ifndef CCPSTACK_H_
+#define CCPSTACK_H_
+#include "PsTraveltimeTable.h"
+#include "SeismicStationList.h"
+#include "SeismicDataComp.h"
+#include "FatalException.h"
+#include "types.h"
+#include "netcdfcpp.h"
+#include <vector>
+#include <string>
+#include <cmath>
+#include <boost/cstdint.hpp>
+
+namespace gplib
+  {
+    /** \addtogroup seistools Seismic data analysis and modeling */
+    /* @{ */
+
+    //! Common conversion point stacking of receiver functions into a regular volume
+    /*! Each receiver function is migrated from time to depth with the delay times of a PsTraveltimeTable
+     * and the amplitude for each depth is added to the bin that contains the conversion point at this depth.
+     * The bins are defined in a local cartesian system with the origin at originlat, originlon. The x-axis
+     * points in the direction azimuth (in degree clockwise from north), the y-axis is perpendicular to it. For a
+     * two-dimensional profile we use a single bin in y-direction whose width determines how far from the
+     * profile conversion points are still included. Distances are calculated with a flat earth approximation,
+     * which is sufficient for the aperture of typical arrays.
+     */
+    class CcpStack
+      {
+    private:
+      const PsTraveltimeTable &Table;
+      double originlat;
+      double originlon;
+      double azimuth;
+      double xmin;
+      double dx;
+      size_t nx;
+      double ymin;
+      double dy;
+      size_t ny;
+      size_t nz;
+      //! The sum of amplitudes in each bin, the index is (ix * ny + iy) * nz + iz
+      trealdata Sum;
+      //! The number of amplitudes that were added to each bin
+      std::vector<boost::uint32_t> Fold;
+      //! Add a single trace to the arrays LocalSum and LocalFold
+      void AddToVolume(const SeismicDataComp &Rec, const double slowness,
+          trealdata &LocalSum, std::vector<boost::uint32_t> &LocalFold) const
+        {
+          trealdata Amplitudes, Offsets;
+          Table.MigrateToDepth(Rec, slowness, Amplitudes);
+          Table.GetOffsets(slowness, Offsets);
+          //kilometre per degree on the earth surface
+          const double kmperdegree = 111.195;
+          const double coslat = std::cos(originlat * PI / 180.0);
+          //position of the station relative to the origin in km
+          const double stnorth = (Rec.GetStLa() - originlat) * kmperdegree;
+          const double steast = (Rec.GetStLo() - originlon) * kmperdegree
+              * coslat;
+          //the conversion points move from the station towards the source
+          const double bazrad = Rec.GetBaz() * PI / 180.0;
+          const double azrad = azimuth * PI / 180.0;
+          const double cosbaz = std::cos(bazrad), sinbaz = std::sin(bazrad);
+          const double cosaz = std::cos(azrad), sinaz = std::sin(azrad);
+          for (size_t i = 0; i < nz; ++i)
+            {
+              const double north = stnorth + Offsets[i] * cosbaz;
+              const double east = steast + Offsets[i] * sinbaz;
+              const double x = north * cosaz + east * sinaz;
+              const double y = -north * sinaz + east * cosaz;
+              const double xpos = (x - xmin) / dx;
+              const double ypos = (y - ymin) / dy;
+              if (xpos < 0.0 || ypos < 0.0 || xpos >= nx || ypos >= ny)
+                continue;
+              const size_t index = (size_t(xpos) * ny + size_t(ypos)) * nz
+                  + i;
+              LocalSum[index] += Amplitudes[i];
+              LocalFold[index] += 1;
+            }
+        }
+    public:
+      //! The number of bins in x-direction
+      size_t GetNx() const
+        {
+          return nx;
+        }
+      //! The number of bins in y-direction
+      size_t GetNy() const
+        {
+          return ny;
+        }
+      //! The number of depths, this is determined by the traveltime table
+      size_t GetNz() const
+        {
+          return nz;
+        }
+      //! The number of amplitudes that were stacked in a bin
+      boost::uint32_t GetFold(const size_t ix, const size_t iy, const size_t iz) const
+        {
+          return Fold.at((ix * ny + iy) * nz + iz);
+        }
+      //! The average amplitude in a bin, 0 for bins without data
+      double GetAmplitude(const size_t ix, const size_t iy, const size_t iz) const
+        {
+          const size_t index = (ix * ny + iy) * nz + iz;
+          return Fold.at(index) > 0 ? Sum.at(index) / Fold.at(index) : 0.0;
+        }
+      //! Add a single receiver function with slowness in s/km to the stack
+      void AddTrace(const SeismicDataComp &Rec, const double slowness)
+        {
+          AddToVolume(Rec, slowness, Sum, Fold);
+        }
+      //! Add all receiver functions in List to the stack, Slownesses contains the slowness for each trace in s/km
+      /*! The traces are processed in parallel, each thread stacks into its own volume and the volumes
+       * are added at the end.
+       */
+      void Migrate(const SeismicStationList &List, const trealdata &Slownesses)
+        {
+          const SeismicStationList::tseiscompvector &Traces = List.GetList();
+          if (Traces.size() != Slownesses.size())
+            throw FatalException(
+                "Number of slownesses does not match number of traces !");
+          const int ntraces = Traces.size();
+          std::string errormessage;
+#pragma omp parallel default(shared)
+            {
+              trealdata LocalSum(Sum.size(), 0.0);
+              std::vector<boost::uint32_t> LocalFold(Fold.size(), 0);
+#pragma omp for schedule(dynamic)
+              for (int i = 0; i < ntraces; ++i)
+                {
+                  //exceptions cannot leave an openmp block
+                  try
+                    {
+                      AddToVolume(*Traces[i], Slownesses[i], LocalSum,
+                          LocalFold);
+                    } catch (FatalException &e)
+                    {
+#pragma omp critical(ccpstack_error)
+                      errormessage = Traces[i]->GetName() + ": " + e.what();
+                    }
+                }
+#pragma omp critical(ccpstack_reduce)
+                {
+                  for (size_t j = 0; j < Sum.size(); ++j)
+                    {
+                      Sum[j] += LocalSum[j];
+                      Fold[j] += LocalFold[j];
+                    }
+                }
+            }
+          if (!errormessage.empty())
+            throw FatalException(errormessage);
+        }
+      //! Write the stacked amplitudes and the fold of each bin to a netcdf file
+      /*! The coordinates are the centres of the bins in km, the attributes of the file contain the origin
+       * and the azimuth of the x-axis.
+       */
+      void WriteNetCDF(const std::string &filename) const
+        {
+          NcFile ccpcdf(filename.c_str(), NcFile::Replace);
+          if (!ccpcdf.is_valid())
+            throw FatalException("Cannot create netcdf file: " + filename);
+          ccpcdf.add_att("origin_latitude", originlat);
+          ccpcdf.add_att("origin_longitude", originlon);
+          ccpcdf.add_att("azimuth", azimuth);
+          NcDim* xd = ccpcdf.add_dim("x", nx);
+          NcDim* yd = ccpcdf.add_dim("y", ny);
+          NcDim* zd = ccpcdf.add_dim("depth", nz);
+          NcVar* x = ccpcdf.add_var("x", ncFloat, xd);
+          NcVar* y = ccpcdf.add_var("y", ncFloat, yd);
+          NcVar* z = ccpcdf.add_var("depth", ncFloat, zd);
+          NcVar* amp = ccpcdf.add_var("amplitude", ncFloat, xd, yd, zd);
+          NcVar* fold = ccpcdf.add_var("fold", ncInt, xd, yd, zd);
+          x->add_att("units", "km");
+          y->add_att("units", "km");
+          z->add_att("units", "km");
+          std::vector<float> xvals(nx), yvals(ny), zvals(nz);
+          for (size_t i = 0; i < nx; ++i)
+            xvals[i] = xmin + (i + 0.5) * dx;
+          for (size_t i = 0; i < ny; ++i)
+            yvals[i] = ymin + (i + 0.5) * dy;
+          for (size_t i = 0; i < nz; ++i)
+            zvals[i] = i * Table.GetDepthStep();
+          std::vector<float> ampvals(Sum.size());
+          std::vector<int> foldvals(Fold.size());
+          for (size_t i = 0; i < Sum.size(); ++i)
+            {
+              ampvals[i] = Fold[i] > 0 ? Sum[i] / Fold[i] : 0.0;
+              foldvals[i] = Fold[i];
+            }
+          x->put(&xvals[0], nx);
+          y->put(&yvals[0], ny);
+          z->put(&zvals[0], nz);
+          amp->put(&ampvals[0], amp->edges());
+          fold->put(&foldvals[0], fold->edges());
+        }
+      //! Define the volume for stacking
+      /*! @param TheTable The traveltime table, it has to exist as long as the CcpStack object, the depth axis of the volume is the same as in the table
+       * @param lat The latitude of the origin in degree
+       * @param lon The longitude of the origin in degree
+       * @param az The direction of the x-axis in degree clockwise from north
+       * @param xstart The start of the x-axis in km relative to the origin
+       * @param xstep The bin size in x-direction in km
+       * @param nxbins The number of bins in x-direction
+       * @param ystart The start of the y-axis in km relative to the origin
+       * @param ystep The bin size in y-direction in km
+       * @param nybins The number of bins in y-direction, 1 for a profile
+       */
+      CcpStack(const PsTraveltimeTable &TheTable, const double lat,
+          const double lon, const double az, const double xstart,
+          const double xstep, const size_t nxbins, const double ystart,
+          const double ystep, const size_t nybins) :
+        Table(TheTable), originlat(lat), originlon(lon), azimuth(az),
+            xmin(xstart), dx(xstep), nx(nxbins), ymin(ystart), dy(ystep),
+            ny(nybins), nz(TheTable.GetNDepth()), Sum(nx * ny * nz, 0.0),
+            Fold(nx * ny * nz, 0)
+        {
+          if (dx <= 0.0 || dy <= 0.0 || nx == 0 || ny == 0)
+            throw FatalException("Invalid bin definition for CcpStack !");
+        }
+      virtual ~CcpStack()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /* CCPSTACK_H_ */
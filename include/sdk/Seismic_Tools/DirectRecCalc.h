@@ -0,0 +1,209 @@
+#ifndef DIRECTRECCALC_H_
+#define DIRECTRECCALC_H_
+#include "SeismicDataComp.h"
+#include "ResPkModel.h"
+#include "TsSpectrum.h"
+#include "PsvLayer.h"
+#include "SeisTools.h"
+#include "types.h"
+#include "FatalException.h"
+#include "convert.h"
+#include <complex>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace gplib
+  {
+    /** \addtogroup seistools Seismic data analysis and modeling */
+    /* @{ */
+
+    //! Calculate synthetic receiver functions for a 1D model directly in the frequency domain
+    /*! RecCalc calculates synthetic seismograms with an external program and deconvolves them. For an incident plane
+     * P-wave the receiver function of an isotropic, elastic 1D model is the ratio of the radial and vertical surface
+     * displacement, which we calculate for each frequency with the propagator matrix method. We multiply
+     * the ratio with the same gaussian filter and phase shift as RecCalc::SpectralDivision and transform the
+     * result to the time domain. As the eigenvectors of a layer do not depend on frequency,
+     * we factor each layer only once, and we only evaluate frequencies where the gaussian filter is not negligible.
+     * The plan for the inverse fourier transform is kept between calls with the same length. An object is
+     * not thread-safe because of the plan, but each thread can use its own copy.
+     */
+    class DirectRecCalc
+      {
+    private:
+      typedef std::complex<double> tcomp;
+      //! The eigen-system of one layer for the current slowness
+      struct LayerSystem
+        {
+        tcomp eta[4];
+        tcomp E[4][4];
+        tcomp EInv[4][4];
+        double thickness;
+        };
+      //! Shift of the initial correlation peak in s
+      int shift;
+      //! The width of the gaussian filter
+      double sigma;
+      //! Should the receiver function be normalized to maximum amplitude
+      bool normalize;
+      //! The minimum length of the response in s before it repeats, as for the external program
+      double mintime;
+      TsSpectrum Spectrum;
+      std::vector<LayerSystem> Layers;
+      tcompdata RecSpec;
+      trealdata Trace;
+      //! Calculate the eigen-systems of all layers for slowness p, the last layer is the half-space
+      void Factor(const ResPkModel &Model, const double p)
+        {
+          const size_t nlayers = Model.GetSVelocity().size();
+          if (nlayers == 0 || Model.GetPVelocity().size() != nlayers
+              || Model.GetDensity().size() != nlayers
+              || Model.GetThickness().size() != nlayers)
+            throw FatalException("Inconsistent model in DirectRecCalc !");
+          if (p * Model.GetPVelocity().back() >= 1.0)
+            throw FatalException(
+                "The incident P-wave does not propagate in the half-space for slowness: "
+                    + stringify(p));
+          Layers.resize(nlayers);
+          for (size_t i = 0; i < nlayers; ++i)
+            {
+              //the eigenvectors are degenerate if the apparent velocity equals a layer velocity
+              double vp = Model.GetPVelocity().at(i);
+              double vs = Model.GetSVelocity().at(i);
+              if (std::abs(p * vp - 1.0) < 1e-6)
+                vp *= 1.0 - 1e-6;
+              if (std::abs(p * vs - 1.0) < 1e-6)
+                vs *= 1.0 - 1e-6;
+              PsvEigenSystem(vp, vs, Model.GetDensity().at(i), p,
+                  Layers[i].eta, Layers[i].E);
+              InvertPsvMatrix(Layers[i].E, Layers[i].EInv);
+              Layers[i].thickness = Model.GetThickness().at(i);
+            }
+        }
+      //! The ratio of radial to upward vertical displacement at angular frequency omega
+      /*! We propagate the motion-stress vectors for unit horizontal and unit vertical displacement at the free surface
+       * to the top of the half-space and choose the combination that does not contain an upgoing S-wave there.
+       */
+      tcomp SpectralRatio(const double omega) const
+        {
+          tcomp Horizontal[4] =
+            { 1.0, 0.0, 0.0, 0.0 };
+          tcomp Vertical[4] =
+            { 0.0, 1.0, 0.0, 0.0 };
+          tcomp *Vectors[2] =
+            { Horizontal, Vertical };
+          const size_t nlayers = Layers.size();
+          for (size_t i = 0; i + 1 < nlayers; ++i)
+            {
+              const LayerSystem &Layer = Layers[i];
+              tcomp Phase[4];
+              for (size_t j = 0; j < 4; ++j)
+                Phase[j] = std::exp(omega * Layer.thickness * Layer.eta[j]);
+              for (size_t v = 0; v < 2; ++v)
+                {
+                  tcomp Amplitudes[4];
+                  for (size_t j = 0; j < 4; ++j)
+                    {
+                      Amplitudes[j] = 0.0;
+                      for (size_t l = 0; l < 4; ++l)
+                        Amplitudes[j] += Layer.EInv[j][l] * Vectors[v][l];
+                      Amplitudes[j] *= Phase[j];
+                    }
+                  for (size_t j = 0; j < 4; ++j)
+                    {
+                      Vectors[v][j] = 0.0;
+                      for (size_t l = 0; l < 4; ++l)
+                        Vectors[v][j] += Layer.E[j][l] * Amplitudes[l];
+                    }
+                }
+            }
+          //the amplitude of the upgoing S-wave in the half-space for each vector
+          const LayerSystem &HalfSpace = Layers.back();
+          tcomp UpS[2];
+          for (size_t v = 0; v < 2; ++v)
+            {
+              UpS[v] = 0.0;
+              for (size_t l = 0; l < 4; ++l)
+                UpS[v] += HalfSpace.EInv[3][l] * Vectors[v][l];
+            }
+          //the vertical displacement is i times the second component of the vector and positive downwards
+          return tcomp(0.0, -1.0) * UpS[1] / UpS[0];
+        }
+    public:
+      //! Change whether the output receiver function is normalized to a maximum amplitude of 1
+      void SetNormalize(const bool what)
+        {
+          normalize = what;
+        }
+      //! Calculate the receiver function for the model, slowness, sampling interval and number of points given in Model
+      /*! The result has the same time axis as the receiver functions from RecCalc, the first sample is at -shift.
+       */
+      void CalcRecData(const ResPkModel &Model, SeismicDataComp &Receiver)
+        {
+          const double dt = Model.GetDt();
+          const size_t npts = Model.GetNpts();
+          if (dt <= 0.0 || npts == 0)
+            throw FatalException(
+                "Invalid sampling interval or number of points in DirectRecCalc !");
+          Factor(Model, Model.GetSlowness());
+          //the response is periodic in time, so we use at least twice the length the external program calculates
+          const size_t minlength = 2 * std::max(npts, size_t(mintime / dt));
+          size_t nfft = 1;
+          while (nfft < minlength)
+            nfft *= 2;
+          const size_t nfreq = nfft / 2 + 1;
+          RecSpec.assign(nfreq, tcomp(0.0, 0.0));
+          Trace.resize(nfft);
+          const double omegastep = 2. * PI / (dt * nfft);
+          const double denom = 1. / (4.0 * sigma * sigma);
+          //above this exponent the gaussian filter is smaller than 1e-13
+          const double maxexponent = 30.0;
+          for (size_t i = 0; i < nfreq; ++i)
+            {
+              const double omega = omegastep * i;
+              const double exponent = omega * omega * denom;
+              if (exponent > maxexponent)
+                break;
+              RecSpec[i] = SpectralRatio(omega) * std::exp(tcomp(-exponent,
+                  -omega * shift));
+            }
+          Spectrum.CalcTimeSeries(RecSpec.begin(), RecSpec.end(), Trace.begin(),
+              Trace.end());
+          Receiver.GetData().assign(Trace.begin(), Trace.begin() + npts);
+          Receiver.SetB(-shift);
+          Receiver.SetDt(dt);
+          if (normalize)
+            {
+              Normalize(Receiver.GetData());
+            }
+        }
+      //! The parameters have the same meaning as for RecCalc
+      DirectRecCalc(const int myshift, const double mysigma,
+          const bool mynormalize = false) :
+        shift(myshift), sigma(mysigma), normalize(mynormalize), mintime(200.0),
+            Spectrum(true)
+        {
+        }
+      //! The copy gets its own fourier transform object, so copies can be used by different threads
+      DirectRecCalc(const DirectRecCalc &Old) :
+        shift(Old.shift), sigma(Old.sigma), normalize(Old.normalize), mintime(
+            Old.mintime), Spectrum(true)
+        {
+        }
+      DirectRecCalc& operator=(const DirectRecCalc& source)
+        {
+          if (this == &source)
+            return *this;
+          shift = source.shift;
+          sigma = source.sigma;
+          normalize = source.normalize;
+          mintime = source.mintime;
+          return *this;
+        }
+      virtual ~DirectRecCalc()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*DIRECTRECCALC_H_*/
@@ -2,11 +2,9 @@
 #define MOVEOUTCORRECTION_H_
 #include "SeismicDataComp.h"
 #include "ResPkModel.h"
+#include "PsTraveltimeTable.h"
 #include <vector>
-#include <iostream>
-#include <fstream>
-#include <gsl/gsl_errno.h>
-#include <gsl/gsl_spline.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -15,107 +13,77 @@ namespace gplib
     /** \addtogroup seistools Seismic data analysis and modeling */
     /* @{ */
 
+    //! Correct receiver functions for the moveout of Ps conversions so that they look as if recorded with a reference slowness
+    /*! The delay times of the conversions for each depth are taken from a PsTraveltimeTable that is calculated
+     * once in the constructor. The correction of a trace only needs two interpolated delay curves and
+     * a single pass over the samples, so a MoveoutCorrection object can be used for large numbers of
+     * receiver functions and, as DoCorrection does not change the object, by several threads at the same time.
+     */
     class MoveoutCorrection
       {
     private:
       double refslowness;
-      ResPkModel Model;
-        //double CalcTraveltime(const double rayparameter, const double depth)
-        //  {
-        //    Model.SetSourceDepth(depth);
-        //    double precdist = Model.MatchSlowness(rayparameter, SeismicModel::DirectP);
-        //    Model.SetRecDist().push_back(precdist);
-        //    double ptime = Model.CalcArrival(SeismicModel::DirectP, Model.GetRecDist().size()-1);
-        //    double srecdist = Model.MatchSlowness(rayparameter, SeismicModel::DirectS);
-        //    Model.SetRecDist().back() = srecdist;
-        //    double stime = Model.CalcArrival(SeismicModel::DirectS, Model.GetRecDist().size()-1);
-        //    double distdiff = precdist - srecdist;
-        //    double angle = PI/2. - asin(rayparameter*Model.GetPVelocity().at(Model.FindLayer(Model.GetSourceDepth())));
-        //    double extratotaldist = sin(angle) * distdiff;
-        //    double extravdist = cos(PI/2.0 - angle) * extratotaldist;
-        //    double extratime = Model.CalcTravelTime(SeismicModel::DirectP, extravdist
-        //        +depth, depth, rayparameter);
-        //    timesfile << depth << "  " << stime << " " << ptime << " "<< extratime
-        //        << endl;
-        //    return stime + extratime - ptime;
-        //  }
-      double CalcTraveltime(const double rayparameter, const double depth)
-      {
-        int sourceindex = Model.FindLayer(depth);
-        double deltat = 0.0;
-        double currdepth = 0.0;
-        const double p2 = rayparameter * rayparameter;
-        for (int i = 0; i < sourceindex; ++i)
-          {
-            currdepth += Model.GetThickness().at(i);
-            double u = 1. / Model.GetPVelocity().at(i);
-            deltat += Model.GetThickness().at(i) * (sqrt(pow(1.
-                / Model.GetSVelocity().at(i), 2) - p2) - sqrt(pow(1.
-                / Model.GetPVelocity().at(i), 2) - p2));
-          }
-        deltat += (depth - currdepth) * (sqrt(pow(1. / Model.GetSVelocity().at(
-            sourceindex), 2) - p2) - sqrt(pow(1. / Model.GetPVelocity().at(
-            sourceindex), 2) - p2));
-        return deltat;
-      }
-
-      void InterpolateTo(trealdata &oldx, trealdata &y, trealdata &newx,
-          trealdata &newy)
-      {
-        gsl_interp_accel *gslacc = gsl_interp_accel_alloc();
-        gsl_spline *spline = gsl_spline_alloc(gsl_interp_linear, oldx.size());
-        cout << "Oldx: " << oldx.size() << endl;
-        cout << "Newx: " << newx.size() << endl;
-        gsl_spline_init(spline, &oldx[0], &y[0], newx.size());
-        newy.clear();
-        for (int i = 0; i < newx.size(); ++i)
-          {
-            newy.push_back(gsl_spline_eval(spline, newx.at(i), gslacc));
-          }
-
-        gsl_spline_free(spline);
-        gsl_interp_accel_free(gslacc);
-      }
-
+      PsTraveltimeTable Table;
     public:
-      void DoCorrection(SeismicDataComp &Rec, const double slowness)
+      //! Correct the receiver function Rec recorded with slowness in s/km to the reference slowness
+      /*! The first sample of Rec is at time GetB() relative to the direct P-wave. Samples before the
+       * P-wave are not changed, samples later than the conversion from the maximum depth in the table
+       * are corrected with the ratio of the delay times at the maximum depth.
+       */
+      void DoCorrection(SeismicDataComp &Rec, const double slowness) const
       {
-        const double maxdepth = 350;
-        const int nelements = Rec.GetData().size();
+        trealdata refdeltat, deltat;
+        Table.GetDelays(refslowness, refdeltat);
+        Table.GetDelays(slowness, deltat);
+        const trealdata amps(Rec.GetData());
+        const int nelements = amps.size();
+        if (nelements < 2)
+          return;
         const double dt = Rec.GetDt();
-        std::vector<double> refdeltat, deltat, depths, refdepths, actdepths,
-            times, newtimes, amps, newamps;
-        copy(Rec.GetData().begin(), Rec.GetData().end(), back_inserter(amps));
-        cout << "Ref slow: " << refslowness << " Slow: " << slowness << endl;
-        ofstream depthfile("depths");
-        ofstream deltatfile("deltat");
-        ofstream timesfile("times");
-        for (double i = 1.0; i < maxdepth; i += 1.0)
+        const double b = Rec.GetB();
+        const size_t ndepth = refdeltat.size();
+        const double lastratio = deltat.back() / refdeltat.back();
+        //the delay times increase with depth, so we can move through the depths together with the samples
+        size_t depthindex = 0;
+        for (int i = 0; i < nelements; ++i)
           {
-            depths.push_back(i);
-            times.push_back(i * dt + Rec.GetB());
-            refdeltat.push_back(CalcTraveltime(refslowness, i));
-            deltat.push_back(CalcTraveltime(slowness, i));
-            deltatfile << deltat.at(i) << " " << depths.at(i) << endl;
-            cout << "Deltat: " << deltat.back() << " Ref Deltat: "
-                << refdeltat.back() << endl;
+            const double reftime = b + i * dt;
+            if (reftime <= 0.0)
+              continue;
+            while (depthindex + 1 < ndepth && refdeltat[depthindex + 1]
+                < reftime)
+              ++depthindex;
+            double time;
+            if (depthindex + 1 < ndepth)
+              {
+                const double weight = (reftime - refdeltat[depthindex])
+                    / (refdeltat[depthindex + 1] - refdeltat[depthindex]);
+                time = deltat[depthindex] + weight * (deltat[depthindex + 1]
+                    - deltat[depthindex]);
+              }
+            else
+              time = reftime * lastratio;
+            //interpolate the original trace at the delay time for the actual slowness
+            const double pos = std::min(std::max((time - b) / dt, 0.0),
+                double(nelements - 1));
+            const int index = std::min(int(pos), nelements - 2);
+            const double weight = pos - index;
+            Rec.GetData().at(i) = (1.0 - weight) * amps[index] + weight
+                * amps[index + 1];
           }
-        InterpolateTo(deltat, depths, times, actdepths);
-        InterpolateTo(depths, refdeltat, actdepths, newtimes);
-        InterpolateTo(newtimes, amps, times, newamps);
-
-        //    for (int i = 0; i < actdepths.size(); ++i)
-        //      {
-        //        depthfile << actdepths.at(i) << " " << amps.at(i) << endl;
-        //
-        //        timesfile << times.at(i) << " " << actdepths.at(i) << endl;
-        //      }
-        copy(newamps.begin(), newamps.end(), Rec.GetData().begin());
       }
-      MoveoutCorrection(const double refslow, const ResPkModel &TheModel):
-          refslowness(refslow), Model(TheModel)
-          {
-          }
+      //! Construct the correction for reference slowness refslow in s/km and the model TheModel
+      /*! The remaining parameters specify the range of the traveltime table, the slowness of all
+       * corrected traces and the reference slowness have to be between minslow and maxslow.
+       */
+      MoveoutCorrection(const double refslow, const ResPkModel &TheModel,
+          const double maxdepth = 350.0, const double dz = 1.0,
+          const double minslow = 0.03, const double maxslow = 0.1,
+          const size_t nslow = 71) :
+        refslowness(refslow), Table(TheModel, maxdepth, dz, std::min(
+            minslow, refslow), std::max(maxslow, refslow), nslow)
+      {
+      }
       virtual ~MoveoutCorrection()
         {
         }
@@ -24,6 +24,14 @@ namespace gplib
         {
           return new MultiAnisoSurfaceWaveObjective(*this);
         }
+      //! We calculate the dispersion curves for each measurement
+      virtual double GetCostEstimate() const
+        {
+          double cost = 0.0;
+          for (size_t i = 0; i < IndividualObjectives.size(); ++i)
+            cost += IndividualObjectives.at(i)->GetCostEstimate();
+          return cost;
+        }
       void AddMeasurement(const ParkSurfaceWaveData &Measured,
           const double back, const double avel)
       {
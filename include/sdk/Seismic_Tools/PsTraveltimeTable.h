@@ -0,0 +1,219 @@
+#ifndef PSTRAVELTIMETABLE_H_
+#define PSTRAVELTIMETABLE_H_
+#include "SeismicModel.h"
+#include "SeismicDataComp.h"
+#include "types.h"
+#include "FatalException.h"
+#include "convert.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+
+namespace gplib
+  {
+    /** \addtogroup seistools Seismic data analysis and modeling */
+    /* @{ */
+
+    //! Precalculated delay times and conversion point offsets of Ps converted waves for a range of slownesses
+    /*! For a 1D model we calculate for each slowness on a regular grid and each depth on a regular grid
+     * the delay time of the Ps converted wave with respect to the direct P wave and the horizontal distance
+     * between the station and the conversion point. The tables are calculated once in the constructor,
+     * afterwards the values for arbitrary slownesses within the range are obtained by linear interpolation
+     * between the two neighbouring slownesses. All methods are const, so a single table can be used
+     * by several threads.
+     */
+    class PsTraveltimeTable
+      {
+    private:
+      //! The depth increment in km
+      double depthstep;
+      //! The number of depths, the first depth is 0
+      size_t ndepth;
+      //! The smallest slowness in the table in s/km
+      double minslowness;
+      //! The slowness increment in s/km
+      double slownessstep;
+      //! The number of slownesses
+      size_t nslowness;
+      //! The delay times, the index is slownessindex * ndepth + depthindex
+      trealdata Delays;
+      //! The horizontal distance of the conversion point from the station in km, same layout as Delays
+      trealdata Offsets;
+      //! One layer segment within a depth step
+      struct Segment
+        {
+        size_t step;
+        double thickness;
+        double vp;
+        double vs;
+        };
+      //! Split the depth steps at the layer interfaces of the model
+      std::vector<Segment> MakeSegments(const SeismicModel &Model) const
+        {
+          const trealdata &Thickness = Model.GetThickness();
+          const size_t nlayers = Thickness.size();
+          if (nlayers == 0 || Model.GetPVelocity().size() != nlayers
+              || Model.GetSVelocity().size() != nlayers)
+            throw FatalException("Inconsistent model in PsTraveltimeTable !");
+          std::vector<Segment> Segments;
+          size_t layer = 0;
+          double layerbottom = Thickness.at(0);
+          for (size_t i = 0; i + 1 < ndepth; ++i)
+            {
+              double top = i * depthstep;
+              const double bottom = (i + 1) * depthstep;
+              while (top < bottom)
+                {
+                  //the last layer is the halfspace and extends to any depth
+                  while (layer + 1 < nlayers && layerbottom <= top)
+                    {
+                      ++layer;
+                      layerbottom += Thickness.at(layer);
+                    }
+                  const double segbottom = (layer + 1 < nlayers) ? std::min(
+                      bottom, layerbottom) : bottom;
+                  Segment Curr;
+                  Curr.step = i;
+                  Curr.thickness = segbottom - top;
+                  Curr.vp = Model.GetPVelocity().at(layer);
+                  Curr.vs = Model.GetSVelocity().at(layer);
+                  Segments.push_back(Curr);
+                  top = segbottom;
+                }
+            }
+          return Segments;
+        }
+      //! Return the lower slowness index and the weight of the upper index for linear interpolation
+      void SlownessIndex(const double slowness, size_t &index, double &weight) const
+        {
+          const double pos = (slowness - minslowness) / slownessstep;
+          if (pos < -1e-6 || pos > (nslowness - 1) + 1e-6)
+            throw FatalException("Slowness " + stringify(slowness)
+                + " outside range of traveltime table !");
+          if (nslowness == 1)
+            {
+              index = 0;
+              weight = 0.0;
+              return;
+            }
+          index = std::min(size_t(std::max(pos, 0.0)), nslowness - 2);
+          weight = std::min(std::max(pos - index, 0.0), 1.0);
+        }
+      //! Interpolate a complete depth curve from Table for the given slowness
+      void InterpolateCurve(const trealdata &Table, const double slowness,
+          trealdata &Curve) const
+        {
+          size_t index;
+          double weight;
+          SlownessIndex(slowness, index, weight);
+          Curve.resize(ndepth);
+          const size_t lower = index * ndepth;
+          const size_t upper = std::min(index + 1, nslowness - 1) * ndepth;
+          for (size_t i = 0; i < ndepth; ++i)
+            Curve[i] = (1.0 - weight) * Table[lower + i] + weight
+                * Table[upper + i];
+        }
+    public:
+      //! The number of depth values in each curve
+      size_t GetNDepth() const
+        {
+          return ndepth;
+        }
+      //! The depth increment in km
+      double GetDepthStep() const
+        {
+          return depthstep;
+        }
+      //! Get the delay times of the Ps conversion relative to P for all depths for a given slowness in s/km
+      void GetDelays(const double slowness, trealdata &Curve) const
+        {
+          InterpolateCurve(Delays, slowness, Curve);
+        }
+      //! Get the horizontal distance between station and conversion point in km for all depths
+      void GetOffsets(const double slowness, trealdata &Curve) const
+        {
+          InterpolateCurve(Offsets, slowness, Curve);
+        }
+      //! Convert a receiver function from time to depth, the amplitudes at each depth are stored in Amplitudes
+      /*! The time of each sample of the receiver function is calculated from the B header value and the
+       * sampling interval, so the direct P arrival has to be at time 0. Depths whose delay time is outside the
+       * trace get amplitude 0.
+       */
+      void MigrateToDepth(const SeismicDataComp &Rec, const double slowness,
+          trealdata &Amplitudes) const
+        {
+          trealdata Curve;
+          GetDelays(slowness, Curve);
+          const trealdata &Data = Rec.GetData();
+          const double dt = Rec.GetDt();
+          const double b = Rec.GetB();
+          Amplitudes.assign(ndepth, 0.0);
+          if (Data.size() < 2)
+            return;
+          for (size_t i = 0; i < ndepth; ++i)
+            {
+              const double pos = (Curve[i] - b) / dt;
+              if (pos < 0.0 || pos > double(Data.size()) - 1.0)
+                continue;
+              const size_t index = std::min(size_t(pos), Data.size() - 2);
+              const double weight = pos - index;
+              Amplitudes[i] = (1.0 - weight) * Data[index] + weight
+                  * Data[index + 1];
+            }
+        }
+      //! Calculate the tables for the model Model
+      /*! @param Model The 1D velocity model, the last layer is treated as a halfspace
+       * @param maxdepth The maximum depth in km
+       * @param dz The depth increment in km
+       * @param minslow The minimum slowness in s/km
+       * @param maxslow The maximum slowness in s/km
+       * @param nslow The number of slownesses in the table
+       */
+      PsTraveltimeTable(const SeismicModel &Model, const double maxdepth,
+          const double dz, const double minslow, const double maxslow,
+          const size_t nslow) :
+        depthstep(dz), ndepth(size_t(maxdepth / dz + 0.5) + 1),
+            minslowness(minslow), slownessstep(nslow > 1 ? (maxslow
+                - minslow) / (nslow - 1) : 1.0), nslowness(nslow)
+        {
+          if (dz <= 0.0 || maxdepth <= 0.0 || nslow == 0 || (nslow > 1
+              && maxslow <= minslow))
+            throw FatalException("Invalid parameters for PsTraveltimeTable !");
+          const std::vector<Segment> Segments(MakeSegments(Model));
+          const double maxvelocity = *std::max_element(
+              Model.GetPVelocity().begin(), Model.GetPVelocity().end());
+          if (maxslow * maxvelocity >= 1.0)
+            throw FatalException(
+                "Maximum slowness too large, P-waves are evanescent !");
+          Delays.assign(nslowness * ndepth, 0.0);
+          Offsets.assign(nslowness * ndepth, 0.0);
+          const int nparallel = nslowness;
+#pragma omp parallel for default(shared)
+          for (int i = 0; i < nparallel; ++i)
+            {
+              const double p = minslowness + i * slownessstep;
+              const double p2 = p * p;
+              trealdata StepDelay(ndepth, 0.0), StepOffset(ndepth, 0.0);
+              for (size_t j = 0; j < Segments.size(); ++j)
+                {
+                  const Segment &Curr = Segments[j];
+                  const double qs = std::sqrt(1.0 / (Curr.vs * Curr.vs) - p2);
+                  const double qp = std::sqrt(1.0 / (Curr.vp * Curr.vp) - p2);
+                  StepDelay[Curr.step + 1] += Curr.thickness * (qs - qp);
+                  StepOffset[Curr.step + 1] += Curr.thickness * p / qs;
+                }
+              double *CurrDelays = &Delays[i * ndepth];
+              double *CurrOffsets = &Offsets[i * ndepth];
+              std::partial_sum(StepDelay.begin(), StepDelay.end(), CurrDelays);
+              std::partial_sum(StepOffset.begin(), StepOffset.end(),
+                  CurrOffsets);
+            }
+        }
+      virtual ~PsTraveltimeTable()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /* PSTRAVELTIMETABLE_H_ */
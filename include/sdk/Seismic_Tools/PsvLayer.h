@@ -0,0 +1,93 @@
+#ifndef PSVLAYER_H_
+#define PSVLAYER_H_
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+namespace gplib
+  {
+    /** \addtogroup seistools Seismic data analysis and modeling */
+    /* @{ */
+
+    /*! \file PsvLayer.h
+     * Plane P-SV waves in a homogeneous, isotropic layer. We use the motion-stress vector
+     * (horizontal displacement, vertical displacement, shear stress, normal stress) with the depth z positive downwards
+     * and a time and space dependence exp(i(omega t - k x)) with k = omega p. The vertical displacement is i times
+     * the second component and the normal stress i times the fourth. The stress components are divided by omega, so
+     * the eigenvectors only depend on the horizontal slowness p and each solution varies with depth as exp(omega eta z).
+     */
+
+    //! Calculate the vertical slownesses eta and the eigenvectors (columns of E) for a layer and a horizontal slowness p
+    /*! The solutions are in the order P decaying/downgoing, P growing/upgoing, S decaying/downgoing, S growing/upgoing.
+     * Velocities are in km/s, the density in g/cm^3 and p in s/km. The eigenvectors are degenerate when 1/p is
+     * equal to vp or vs.
+     */
+    inline void PsvEigenSystem(const double vp, const double vs,
+        const double density, const double p, std::complex<double> eta[4],
+        std::complex<double> E[4][4])
+      {
+        typedef std::complex<double> tcomp;
+        const double mu = density * vs * vs;
+        //the principal square root gives a positive imaginary part for propagating waves
+        const tcomp nua = std::sqrt(tcomp(1.0 - 1.0 / (p * p * vp * vp)));
+        const tcomp nub = std::sqrt(tcomp(1.0 - 1.0 / (p * p * vs * vs)));
+        const double t = (2.0 * mu * p * p - density) / p;
+        for (size_t i = 0; i < 2; ++i)
+          {
+            const tcomp sa = (i == 0 ? -nua : nua);
+            const tcomp sb = (i == 0 ? -nub : nub);
+            eta[i] = p * sa;
+            eta[i + 2] = p * sb;
+            //P-wave solution
+            E[0][i] = 1.0;
+            E[1][i] = sa;
+            E[2][i] = 2.0 * mu * p * sa;
+            E[3][i] = t;
+            //SV-wave solution
+            E[0][i + 2] = sb;
+            E[1][i + 2] = 1.0;
+            E[2][i + 2] = t;
+            E[3][i + 2] = 2.0 * mu * p * sb;
+          }
+      }
+
+    //! Invert a complex 4x4 matrix with Gauss-Jordan elimination and partial pivoting
+    inline void InvertPsvMatrix(const std::complex<double> In[4][4],
+        std::complex<double> Out[4][4])
+      {
+        typedef std::complex<double> tcomp;
+        tcomp A[4][8];
+        for (size_t i = 0; i < 4; ++i)
+          for (size_t j = 0; j < 4; ++j)
+            {
+              A[i][j] = In[i][j];
+              A[i][j + 4] = (i == j ? 1.0 : 0.0);
+            }
+        for (size_t col = 0; col < 4; ++col)
+          {
+            size_t pivot = col;
+            for (size_t i = col + 1; i < 4; ++i)
+              if (std::abs(A[i][col]) > std::abs(A[pivot][col]))
+                pivot = i;
+            if (pivot != col)
+              for (size_t j = 0; j < 8; ++j)
+                std::swap(A[col][j], A[pivot][j]);
+            const tcomp factor = 1.0 / A[col][col];
+            for (size_t j = 0; j < 8; ++j)
+              A[col][j] *= factor;
+            for (size_t i = 0; i < 4; ++i)
+              {
+                if (i == col)
+                  continue;
+                const tcomp f = A[i][col];
+                for (size_t j = 0; j < 8; ++j)
+                  A[i][j] -= f * A[col][j];
+              }
+          }
+        for (size_t i = 0; i < 4; ++i)
+          for (size_t j = 0; j < 4; ++j)
+            Out[i][j] = A[i][j + 4];
+      }
+  /* @} */
+  }
+#endif /*PSVLAYER_H_*/
@@ -0,0 +1,260 @@
+#ifndef RAYLEIGHDISPERSION_H_
+#define RAYLEIGHDISPERSION_H_
+#include "types.h"
+#include "FatalException.h"
+#include "convert.h"
+#include "PsvLayer.h"
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+namespace gplib
+  {
+    /** \addtogroup seistools Seismic data analysis and modeling */
+    /* @{ */
+
+    //! Calculate fundamental mode Rayleigh wave phase velocities for a flat, isotropic 1D model
+    /*! The model consists of homogeneous layers over a half-space, the thickness of the last layer is ignored.
+     * For a given period we search for the smallest phase velocity where the free surface condition
+     * can be fulfilled by the solutions that decay in the half-space. The motion-stress vectors of these
+     * two solutions are propagated to the surface as a compound (2x2 minor) vector, which avoids the loss of
+     * precision of the original Thomson-Haskell method for high frequencies and thick layers. Layers deeper than
+     * the penetration depth of the surface wave are treated as the half-space. All methods are const and do not use
+     * any global state, so a single object can be used by several threads.
+     */
+    class RayleighDispersion
+      {
+    private:
+      typedef std::complex<double> tcomp;
+      //! The number of 2x2 minors of a 4x4 matrix
+      static size_t NMinors()
+        {
+          return 6;
+        }
+      //! The row indices of each minor in the order (0,1),(0,2),(0,3),(1,2),(1,3),(2,3)
+      static size_t MinorRow(const size_t minor, const size_t which)
+        {
+          static const size_t Rows[6][2] =
+            {
+              { 0, 1 },
+              { 0, 2 },
+              { 0, 3 },
+              { 1, 2 },
+              { 1, 3 },
+              { 2, 3 } };
+          return Rows[minor][which];
+        }
+      trealdata Thickness;
+      trealdata Vp;
+      trealdata Vs;
+      trealdata Density;
+      //! The smallest shear velocity in the model
+      double minvs;
+      //! Compare the indices of two periods
+      struct PeriodLess
+        {
+        const trealdata &Periods;
+        bool operator()(const size_t a, const size_t b) const
+          {
+            return Periods[a] < Periods[b];
+          }
+        PeriodLess(const trealdata &P) :
+          Periods(P)
+          {
+          }
+        };
+      //! Multiply the compound matrix of M with the minor vector In
+      static void CompoundMultiply(const tcomp M[4][4], const tcomp In[6],
+          tcomp Out[6])
+        {
+          for (size_t p = 0; p < NMinors(); ++p)
+            {
+              const size_t a = MinorRow(p, 0), b = MinorRow(p, 1);
+              Out[p] = 0.0;
+              for (size_t q = 0; q < NMinors(); ++q)
+                {
+                  const size_t i = MinorRow(q, 0), j = MinorRow(q, 1);
+                  Out[p] += (M[a][i] * M[b][j] - M[a][j] * M[b][i]) * In[q];
+                }
+            }
+        }
+      //! Move c away from the shear and compressional velocities, where the eigenvectors are degenerate
+      double AvoidDegeneracy(const double c) const
+        {
+          const double mindist = 1e-6;
+          double result = c;
+          for (size_t i = 0; i < Vs.size(); ++i)
+            {
+              if (std::abs(1.0 - result / Vs[i]) < mindist)
+                result = Vs[i] * (1.0 - mindist);
+              if (std::abs(1.0 - result / Vp[i]) < mindist)
+                result = Vp[i] * (1.0 - mindist);
+            }
+          return result;
+        }
+      //! The dispersion function, its zeros are the phase velocities of the Rayleigh modes
+      /*! The value is scaled arbitrarily, but the sign changes continuously with c.
+       */
+      double Secular(const double omega, const double cin) const
+        {
+          const double c = AvoidDegeneracy(cin);
+          const double k = omega / c;
+          //the surface wave does not feel layers below the depth where it has decayed by a factor exp(-maxdecay)
+          const double maxdecay = 30.0;
+          const size_t nlayers = Vs.size();
+          size_t bottom = nlayers - 1;
+          double decay = 0.0;
+          for (size_t i = 0; i < nlayers - 1; ++i)
+            {
+              if (decay > maxdecay && c < Vs[i])
+                {
+                  bottom = i;
+                  break;
+                }
+              if (c < Vs[i])
+                decay += k * std::sqrt(1.0 - c * c / (Vs[i] * Vs[i]))
+                    * Thickness[i];
+            }
+          tcomp eta[4], E[4][4], EInv[4][4];
+          //the minors of the two decaying solutions in the half-space
+          PsvEigenSystem(Vp[bottom], Vs[bottom], Density[bottom], 1.0 / c, eta, E);
+          tcomp Minors[6], Temp[6];
+          for (size_t p = 0; p < NMinors(); ++p)
+            {
+              const size_t a = MinorRow(p, 0), b = MinorRow(p, 1);
+              Minors[p] = E[a][0] * E[b][2] - E[b][0] * E[a][2];
+            }
+          //propagate from the bottom to the top of each layer
+          for (size_t layer = bottom; layer-- > 0;)
+            {
+              PsvEigenSystem(Vp[layer], Vs[layer], Density[layer], 1.0 / c, eta,
+                  E);
+              InvertPsvMatrix(E, EInv);
+              CompoundMultiply(EInv, Minors, Temp);
+              //the propagator for each pair of solutions is exp(-omega (eta_i+eta_j) h), we scale by the largest value
+              double maxexponent = -1e300;
+              double Exponents[6];
+              for (size_t p = 0; p < NMinors(); ++p)
+                {
+                  Exponents[p] = -omega * std::real(eta[MinorRow(p, 0)]
+                      + eta[MinorRow(p, 1)]) * Thickness[layer];
+                  maxexponent = std::max(maxexponent, Exponents[p]);
+                }
+              for (size_t p = 0; p < NMinors(); ++p)
+                {
+                  const double phase = -omega * std::imag(eta[MinorRow(p, 0)]
+                      + eta[MinorRow(p, 1)]) * Thickness[layer];
+                  Temp[p] *= std::exp(Exponents[p] - maxexponent) * tcomp(
+                      std::cos(phase), std::sin(phase));
+                }
+              CompoundMultiply(E, Temp, Minors);
+              double maxabs = 0.0;
+              for (size_t p = 0; p < NMinors(); ++p)
+                maxabs = std::max(maxabs, std::abs(Minors[p]));
+              if (maxabs > 0.0)
+                for (size_t p = 0; p < NMinors(); ++p)
+                  Minors[p] /= maxabs;
+            }
+          //at the free surface both stress components vanish
+          return std::real(Minors[5]);
+        }
+      //! Find a zero of the dispersion function between clow and chigh with bisection
+      double Bisect(const double omega, double clow, double chigh, double flow) const
+        {
+          const double tolerance = 1e-9;
+          while (chigh - clow > tolerance * chigh)
+            {
+              const double cmid = 0.5 * (clow + chigh);
+              const double fmid = Secular(omega, cmid);
+              if ((fmid < 0.0) == (flow < 0.0))
+                {
+                  clow = cmid;
+                  flow = fmid;
+                }
+              else
+                chigh = cmid;
+            }
+          return 0.5 * (clow + chigh);
+        }
+    public:
+      //! Calculate the phase velocity of the fundamental mode in km/s for a period in s
+      /*! If start is positive it is a guess for the phase velocity, e.g. the result for a neighbouring period,
+       * that speeds up the search.
+       */
+      double PhaseVelocity(const double period, const double start = 0.0) const
+        {
+          if (period <= 0.0)
+            throw FatalException("Period has to be positive !");
+          const double omega = 2.0 * M_PI / period;
+          //the fundamental mode is always faster than 0.8 times the slowest shear velocity
+          const double cmin = 0.8 * minvs;
+          const double cmax = Vs.back() * (1.0 - 1e-6);
+          const double step = 0.005 * minvs;
+          const double fmin = Secular(omega, cmin);
+          double clow = cmin;
+          double flow = fmin;
+          //we can start close to the guess, if there is no sign change between cmin and this starting point
+          if (start > cmin)
+            {
+              const double cstart = std::min(0.95 * start, cmax);
+              const double fstart = Secular(omega, cstart);
+              if ((fstart < 0.0) == (fmin < 0.0))
+                {
+                  clow = cstart;
+                  flow = fstart;
+                }
+            }
+          while (clow < cmax)
+            {
+              const double chigh = std::min(clow + step, cmax);
+              const double fhigh = Secular(omega, chigh);
+              if ((fhigh < 0.0) != (flow < 0.0))
+                return Bisect(omega, clow, chigh, flow);
+              clow = chigh;
+              flow = fhigh;
+            }
+          throw FatalException(
+              "No fundamental mode Rayleigh wave slower than the half-space for period: "
+                  + stringify(period));
+        }
+      //! Calculate the phase velocities in km/s for a vector of periods in s
+      trealdata PhaseVelocities(const trealdata &Periods) const
+        {
+          const size_t nperiods = Periods.size();
+          trealdata Result(nperiods, 0.0);
+          //we process the periods in increasing order, so each result is a good guess for the next period
+          std::vector<size_t> Order(nperiods);
+          for (size_t i = 0; i < nperiods; ++i)
+            Order[i] = i;
+          std::sort(Order.begin(), Order.end(), PeriodLess(Periods));
+          double guess = 0.0;
+          for (size_t i = 0; i < nperiods; ++i)
+            {
+              guess = PhaseVelocity(Periods[Order[i]], guess);
+              Result[Order[i]] = guess;
+            }
+          return Result;
+        }
+      //! The model is given by the layer thicknesses in km, the velocities in km/s and the densities in g/cm^3
+      RayleighDispersion(const trealdata &Thick, const trealdata &P,
+          const trealdata &S, const trealdata &Dens) :
+        Thickness(Thick), Vp(P), Vs(S), Density(Dens), minvs(0.0)
+        {
+          const size_t nlayers = Vs.size();
+          if (nlayers == 0 || Thickness.size() != nlayers || Vp.size()
+              != nlayers || Density.size() != nlayers)
+            throw FatalException("Inconsistent model in RayleighDispersion !");
+          for (size_t i = 0; i < nlayers; ++i)
+            if (Vs[i] <= 0.0 || Vp[i] <= Vs[i] || Density[i] <= 0.0)
+              throw FatalException(
+                  "RayleighDispersion needs solid layers with Vp > Vs > 0 !");
+          minvs = *std::min_element(Vs.begin(), Vs.end());
+        }
+      virtual ~RayleighDispersion()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*RAYLEIGHDISPERSION_H_*/
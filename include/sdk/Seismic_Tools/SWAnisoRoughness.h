@@ -22,6 +22,8 @@ public:
 	//! Regularize the difference between the seismic and electric strike. This is zero by default
 	void SetDeltaStrikeDiffWeight(const double w){deltastrikediffweight = w;}
 	virtual SWAnisoRoughness *clone() const {return new SWAnisoRoughness(*this);}
+	//! The roughness only depends on the model, so it is much cheaper than a forward calculation
+	virtual double GetCostEstimate() const {return 0.01;}
         virtual void SafeParallel(const ttranscribed &member)
         {
           const unsigned int length = member.size() / 6; //we have 6 parameters in the model, so size/6 layers
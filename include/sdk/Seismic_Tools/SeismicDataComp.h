@@ -55,7 +55,7 @@ namespace gplib
       //! Set the longitude of the station
       void SetStLo(const double lon)
         {
-          stla = lon;
+          stlo = lon;
         }
       //! Get the elevation of the station in m
       double GetStEl() const
@@ -107,6 +107,11 @@ namespace gplib
         {
           return baz;
         }
+      //! Set the back-azimuth of the event
+      void SetBaz(const double thebaz)
+        {
+          baz = thebaz;
+        }
       //! Get the distance between station and event along a great circle
       double GetGcarc() const
         {
@@ -227,7 +232,6 @@ namespace gplib
           }
         return 0;
       }
-  }
       //! Copy the information in the header from another object
       void CopyHeader(const SeismicDataComp& source)
       {
@@ -48,6 +48,11 @@ namespace gplib
         {
           return new SurfaceWaveObjective(*this);
         }
+      //! The dispersion calculation is about ten times the cost of a 1D MT forward calculation
+      virtual double GetCostEstimate() const
+        {
+          return 10.0;
+        }
       ;
       //! Some operations cannot be done in parallel, these are done before
       virtual void PreParallel(const ttranscribed &member)
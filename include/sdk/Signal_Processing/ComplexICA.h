@@ -6,76 +6,148 @@
 #include <boost/numeric/ublas/lu.hpp>
 #include <boost/numeric/ublas/io.hpp>
 #include <complex>
-#include <iostream>
+#include <vector>
+#include <algorithm>
 #include "PCA.h"
 #include "VecMat.h"
+#include "LinAlgKernels.h"
 
 namespace gplib
   {
     namespace ublas = boost::numeric::ublas;
-    std::complex<double> sign(const std::complex<double> &z)
+
+    /** \addtogroup sigproc Signal processing methods */
+    /* @{ */
+
+    //! The number of samples ComplexICA processes together
+    const size_t complexicachunk = 2048;
+
+    //! Calculate E[z conj(y) |y|^2] with y = w^H z for each column w of W over all samples of the whitened data in input
+    void ComplexFastICAContrast(const cmat &input, const cmat &W, cmat &result)
       {
-        if (abs(z) == 0)
-          return std::complex<double>(0.0, 0.0);
-        else
-          return z / abs(z);
+        const size_t nchannels = input.size1();
+        const size_t nsamples = input.size2();
+        const std::complex<double> one(1.0), zero(0.0);
+        result = ublas::zero_matrix<std::complex<double> >(nchannels, nchannels);
+        const int nchunks = (nsamples + complexicachunk - 1) / complexicachunk;
+#pragma omp parallel default(shared)
+          {
+            std::vector<std::complex<double> > Y(nchannels * complexicachunk);
+            std::vector<std::complex<double> > LocalResult(nchannels
+                * nchannels, zero);
+#pragma omp for
+            for (int chunk = 0; chunk < nchunks; ++chunk)
+              {
+                const size_t start = chunk * complexicachunk;
+                const size_t length = std::min(complexicachunk, nsamples - start);
+                const std::complex<double> *Z = &input.data()[start * nchannels];
+                //Y = W^H Z
+                linalg::Gemm('C', 'N', nchannels, length, nchannels, one,
+                    &W.data()[0], nchannels, Z, nchannels, zero, &Y[0],
+                    nchannels);
+                //we work on the real and imaginary parts, so the compiler can vectorize the loop
+                double *y = reinterpret_cast<double *> (&Y[0]);
+                const size_t nvalues = 2 * nchannels * length;
+                for (size_t i = 0; i < nvalues; i += 2)
+                  {
+                    const double power = y[i] * y[i] + y[i + 1] * y[i + 1];
+                    y[i] *= power;
+                    y[i + 1] *= -power;
+                  }
+                //LocalResult += Z G^T with G = conj(Y) |Y|^2
+                linalg::Gemm('N', 'T', nchannels, nchannels, length, one, Z,
+                    nchannels, &Y[0], nchannels, one, &LocalResult[0],
+                    nchannels);
+              }
+#pragma omp critical(complexica_reduce)
+            for (size_t i = 0; i < LocalResult.size(); ++i)
+              result.data()[i] += LocalResult[i];
+          }
+        result /= double(nsamples);
       }
 
-    double non_lin(const double x)
+    //! Symmetric decorrelation of the columns of a complex W, W = W (W^H W)^{-1/2}, calculated iteratively
+    void ComplexSymmetricDecorrelation(cmat &W)
       {
-        return (1.0 - exp(-x)) / (1.0 + exp(x));
+        const size_t n = W.size1();
+        cmat wwh(linalg::Prod(W, cmat(herm(W))));
+        W /= std::sqrt(norm_inf(wwh));
+        const int maxiterations = 1000;
+        for (int i = 0; i < maxiterations; ++i)
+          {
+            wwh = linalg::Prod(W, cmat(herm(W)));
+            double deviation = 0.0;
+            for (size_t j = 0; j < n; ++j)
+              for (size_t k = 0; k < n; ++k)
+                deviation = std::max(deviation, std::abs(wwh(j, k) - (j == k ? 1.0
+                    : 0.0)));
+            if (deviation < 1e-12)
+              break;
+            cmat neww(W);
+            neww *= 1.5;
+            neww -= 0.5 * linalg::Prod(wwh, W);
+            W = neww;
+          }
       }
 
-    void ComplexICA(cmat &input, cmat &source_estimate, cmat &mixing_matrix)
+    //! Run the complex fixed-point iteration on whitened data (one channel per row)
+    /*! On entry W contains the initial guess for the unmixing vectors in its columns, e.g. the result
+     * for a neighbouring frequency, on exit the converged vectors. Returns the number of iterations.
+     */
+    int ComplexFastICAIterate(const cmat &whitened, cmat &W,
+        const int maxiterations, const double tolerance)
       {
-        mixing_matrix = ublas::identity_matrix<double>(input.size1());
-        cmat mix_grad(input.size1(), input.size1());
-        const int maxiterations = 100;
-        const double min_improv = 0.01;
-        double improvement = 10.0;
+        const size_t nchannels = whitened.size1();
+        ComplexSymmetricDecorrelation(W);
+        cmat new_mix(nchannels, nchannels);
         int niter = 0;
-
-        cmat white_mat(mixing_matrix);
-        cmat evec(input.size1(), input.size1());
-        cvec eval(input.size1());
-        PCA(input, evec, eval);
-        white_mat = WhiteMat(evec, eval);
-        std::cout << "white_mat: " << white_mat << std::endl;
-        input = prod(white_mat, input);
-
-        while (improvement > min_improv && niter < maxiterations)
+        while (niter < maxiterations)
           {
-            std::cout << std::endl << std::endl << "Iter: " << niter
-                << std::endl;
-            ublas::noalias(source_estimate) = ublas::prod(mixing_matrix, input);
-            cmat outer_expect(input.size1(), input.size1());
-            cmat v(input.size1(), input.size2());
-            for (size_t i = 0; i < v.size1(); ++i)
-              {
-                for (size_t j = 0; j < v.size2(); ++j)
-                  v(i, j) = sign(source_estimate(i, j)) * non_lin(abs(
-                      source_estimate(i, j)));
-              }
-            for (size_t i = 0; i < input.size2(); ++i)
+            ++niter;
+            ComplexFastICAContrast(whitened, W, new_mix);
+            new_mix -= 2.0 * W;
+            ComplexSymmetricDecorrelation(new_mix);
+            //the phase of each vector is arbitrary, so we only compare the directions
+            double change = 0.0;
+            for (size_t j = 0; j < nchannels; ++j)
               {
-                outer_expect += ublas::outer_prod(ublas::column(v, i),
-                    ublas::herm(ublas::column(source_estimate, i)));
+                std::complex<double> overlap(0.0);
+                for (size_t i = 0; i < nchannels; ++i)
+                  overlap += std::conj(new_mix(i, j)) * W(i, j);
+                change = std::max(change, std::abs(1.0 - std::abs(overlap)));
               }
-            outer_expect /= input.size2();
-            mix_grad = mixing_matrix;
-            ublas::axpy_prod(-outer_expect, mixing_matrix, mix_grad);
-            mixing_matrix += real(mix_grad);
-            //std::cout << "source: " << source_estimate << std::endl;
-            std::cout << "mixing: " << mixing_matrix << std::endl;
-            std::cout << "mix_grad: " << mix_grad << std::endl;
-            std::cout << "Norm(mix_grad): " << ublas::norm_inf(mix_grad)
-                << std::endl;
-            std::cout << "outer_expect: " << outer_expect << std::endl;
-            improvement = ublas::norm_inf(mix_grad) / ublas::norm_inf(
-                mixing_matrix);
-            std::cout << "improvement: " << improvement << std::endl;
-            ++niter;
+            W = new_mix;
+            if (change < tolerance)
+              break;
           }
+        return niter;
+      }
+
+    //! Separate complex channels in input (one channel per row) into statistically independent circular sources
+    /*! We use the complex fixed-point algorithm of Bingham and Hyvaerinen with a kurtosis based contrast and
+     * symmetric decorrelation. On exit input contains the whitened data, source_estimate the independent components
+     * and mixing_matrix the matrix that transforms the original data into the sources.
+     */
+    void ComplexICA(cmat &input, cmat &source_estimate, cmat &mixing_matrix,
+        const int maxiterations = 100, const double tolerance = 1e-6)
+      {
+        const size_t nchannels = input.size1();
+        const size_t nsamples = input.size2();
+        const std::complex<double> one(1.0), zero(0.0);
+        cmat evec(nchannels, nchannels);
+        cvec eval(nchannels);
+        PCA(input, evec, eval);
+        //for complex data the whitening matrix contains the conjugate eigenvectors
+        const cmat white_mat(conj(WhiteMat(evec, eval)));
+        input = linalg::Prod(white_mat, input);
+        cmat W = ublas::identity_matrix<std::complex<double> >(nchannels);
+        ComplexFastICAIterate(input, W, maxiterations, tolerance);
+        source_estimate.resize(nchannels, nsamples);
+        linalg::Gemm('C', 'N', nchannels, nsamples, nchannels, one,
+            &W.data()[0], nchannels, &input.data()[0], nchannels, zero,
+            &source_estimate.data()[0], nchannels);
+        mixing_matrix = linalg::Prod(cmat(herm(W)), white_mat);
       }
+  /* @} */
   }
 #endif /*COMPLEXICA_H_*/
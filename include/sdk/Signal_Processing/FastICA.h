@@ -5,6 +5,9 @@
 #include <iostream>
 #include <cmath>
 #include "PCA.h"
+#include "LinAlgKernels.h"
+#include <vector>
+#include <algorithm>
 
 namespace ublas = boost::numeric::ublas;
 
@@ -13,57 +16,136 @@ namespace gplib
     /** \addtogroup sigproc Signal processing methods */
     /* @{ */
 
-    void FastICA(rmat &input, rmat &source_estimate, rmat &mixing_matrix)
+    //! The number of samples FastICA processes together, the temporary arrays for each chunk stay in the cache
+    const size_t fasticachunk = 4096;
+
+    //! Calculate E[x (w^T x)^3] for each column w of W over all samples of the whitened data in input
+    void FastICAContrast(const rmat &input, const rmat &W, rmat &result)
       {
-        mixing_matrix = ublas::identity_matrix<double>(input.size1());
-        rmat old_mix(mixing_matrix);
-        rmat new_mix(mixing_matrix);
-        rmat white_mat(mixing_matrix);
-        cmat evec(input.size1(), input.size1());
-        cvec eval(input.size1());
-        PCA(input, evec, eval);
-        white_mat = real(WhiteMat(evec, eval));
-        std::cout << "white_mat: " << white_mat << std::endl;
-        input = prod(white_mat, input);
-        const int maxiterations = 1000;
-        const double min_improv = 0.01;
-        double improvement = 10.0;
-        int niter = 0;
-        while (niter < maxiterations)
+        const size_t nchannels = input.size1();
+        const size_t nsamples = input.size2();
+        result = ublas::zero_matrix<double>(nchannels, nchannels);
+        const int nchunks = (nsamples + fasticachunk - 1) / fasticachunk;
+#pragma omp parallel default(shared)
           {
-            //std::cout << std::endl << std::endl << "Iter: " << niter << std::endl;
-            ublas::noalias(source_estimate) = ublas::prod(mixing_matrix, input);
-            rmat pow3mat = prod(trans(input), mixing_matrix);
-
-            for (size_t i = 0; i < pow3mat.size1(); ++i)
+            std::vector<double> Y(nchannels * fasticachunk);
+            std::vector<double> LocalResult(nchannels * nchannels, 0.0);
+#pragma omp for
+            for (int chunk = 0; chunk < nchunks; ++chunk)
               {
-                for (size_t j = 0; j < pow3mat.size2(); ++j)
-                  pow3mat(i, j) = std::pow(pow3mat(i, j), 3);
+                const size_t start = chunk * fasticachunk;
+                const size_t length = std::min(fasticachunk, nsamples - start);
+                const double *X = &input.data()[start * nchannels];
+                //Y = W^T X, the projections of the samples on each vector
+                linalg::Gemm('T', 'N', nchannels, length, nchannels, 1.0,
+                    &W.data()[0], nchannels, X, nchannels, 0.0, &Y[0],
+                    nchannels);
+                for (size_t i = 0; i < nchannels * length; ++i)
+                  Y[i] = Y[i] * Y[i] * Y[i];
+                //LocalResult += X Y^T
+                linalg::Gemm('N', 'T', nchannels, nchannels, length, 1.0, X,
+                    nchannels, &Y[0], nchannels, 1.0, &LocalResult[0],
+                    nchannels);
               }
-            new_mix = prod(input, pow3mat);
-            new_mix /= input.size2();
-            new_mix -= 3.0 * mixing_matrix;
-            mixing_matrix = new_mix;
+#pragma omp critical(fastica_reduce)
+            for (size_t i = 0; i < LocalResult.size(); ++i)
+              result.data()[i] += LocalResult[i];
+          }
+        result /= double(nsamples);
+      }
 
-            rmat wwt = prod(mixing_matrix, trans(mixing_matrix));
-            mixing_matrix /= sqrt(norm_inf(wwt));
-            for (int i = 0; i < maxiterations; ++i)
-              {
-                rmat neww(mixing_matrix);
-                wwt = prod(mixing_matrix, trans(mixing_matrix));
-                neww *= 1.5;
-                mixing_matrix = prod(wwt, mixing_matrix);
-                mixing_matrix *= 0.5;
-                neww -= mixing_matrix;
-                mixing_matrix = neww;
-                //std::cout << "neww: " << neww << std::endl;
-              }
+    //! Symmetric decorrelation of the columns of W, W = W (W^T W)^{-1/2}, calculated iteratively
+    void SymmetricDecorrelation(rmat &W)
+      {
+        const size_t n = W.size1();
+        rmat wwt(linalg::Prod(W, rmat(trans(W))));
+        W /= std::sqrt(norm_inf(wwt));
+        const int maxiterations = 1000;
+        for (int i = 0; i < maxiterations; ++i)
+          {
+            wwt = linalg::Prod(W, rmat(trans(W)));
+            double deviation = 0.0;
+            for (size_t j = 0; j < n; ++j)
+              for (size_t k = 0; k < n; ++k)
+                deviation = std::max(deviation, std::abs(wwt(j, k) - (j == k ? 1.0
+                    : 0.0)));
+            if (deviation < 1e-12)
+              break;
+            rmat neww(W);
+            neww *= 1.5;
+            neww -= 0.5 * linalg::Prod(wwt, W);
+            W = neww;
+          }
+      }
 
+    //! Run the symmetric fixed-point iteration on whitened data (one channel per row)
+    /*! On entry W contains the initial guess for the unmixing vectors in its columns, e.g. the result from a
+     * neighbouring time window, on exit the converged vectors. Returns the number of iterations.
+     */
+    int FastICAIterate(const rmat &whitened, rmat &W, const int maxiterations,
+        const double tolerance)
+      {
+        const size_t nchannels = whitened.size1();
+        SymmetricDecorrelation(W);
+        rmat new_mix(nchannels, nchannels);
+        int niter = 0;
+        while (niter < maxiterations)
+          {
             ++niter;
+            FastICAContrast(whitened, W, new_mix);
+            new_mix -= 3.0 * W;
+            SymmetricDecorrelation(new_mix);
+            //the vectors have converged when they point in the same direction as before
+            double change = 0.0;
+            for (size_t j = 0; j < nchannels; ++j)
+              change = std::max(change, std::abs(1.0 - std::abs(inner_prod(
+                  column(new_mix, j), column(W, j)))));
+            W = new_mix;
+            if (change < tolerance)
+              break;
           }
+        return niter;
+      }
 
-        noalias(source_estimate) = prod(trans(mixing_matrix), input);
-        mixing_matrix = prod(trans(mixing_matrix), white_mat);
+    //! Separate the channels in input (one channel per row) into statistically independent sources
+    /*! We use the symmetric FastICA algorithm with a cubic non-linearity. On exit input contains the whitened data,
+     * source_estimate the independent components and mixing_matrix the matrix that transforms the original data into the sources.
+     * The data is processed in chunks of samples, so no temporary matrices of the size of the data are created.
+     * The iteration stops when the columns of the unmixing matrix change by less than tolerance.
+     */
+    void FastICA(rmat &input, rmat &source_estimate, rmat &mixing_matrix,
+        const int maxiterations = 1000, const double tolerance = 1e-6)
+      {
+        const size_t nchannels = input.size1();
+        const size_t nsamples = input.size2();
+        cmat evec(nchannels, nchannels);
+        cvec eval(nchannels);
+        PCA(input, evec, eval);
+        const rmat white_mat(real(WhiteMat(evec, eval)));
+        //whiten the data chunk by chunk in place
+        const int nchunks = (nsamples + fasticachunk - 1) / fasticachunk;
+#pragma omp parallel default(shared)
+          {
+            std::vector<double> Chunk(nchannels * fasticachunk);
+#pragma omp for
+            for (int chunk = 0; chunk < nchunks; ++chunk)
+              {
+                const size_t start = chunk * fasticachunk;
+                const size_t length = std::min(fasticachunk, nsamples - start);
+                double *X = &input.data()[start * nchannels];
+                linalg::Gemm('N', 'N', nchannels, length, nchannels, 1.0,
+                    &white_mat.data()[0], nchannels, X, nchannels, 0.0,
+                    &Chunk[0], nchannels);
+                std::copy(Chunk.begin(), Chunk.begin() + nchannels * length, X);
+              }
+          }
+        rmat W = ublas::identity_matrix<double>(nchannels);
+        FastICAIterate(input, W, maxiterations, tolerance);
+        source_estimate.resize(nchannels, nsamples);
+        linalg::Gemm('T', 'N', nchannels, nsamples, nchannels, 1.0,
+            &W.data()[0], nchannels, &input.data()[0], nchannels, 0.0,
+            &source_estimate.data()[0], nchannels);
+        mixing_matrix = linalg::Prod(rmat(trans(W)), white_mat);
       }
   /* @} */
   }
@@ -0,0 +1,688 @@
+#ifndef WINDOWEDICA_H_
+#define WINDOWEDICA_H_
+#include "FastICA.h"
+#include "ComplexICA.h"
+#include "Cov.h"
+#include "LinAlgKernels.h"
+#include "VecMat.h"
+#include "TimeSeriesComponent.h"
+#include "TsSpectrum.h"
+#include "FatalException.h"
+#include "convert.h"
+#include "types.h"
+#include <vector>
+#include <string>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+namespace gplib
+  {
+    /** \addtogroup sigproc Signal processing methods */
+    /* @{ */
+
+    //! Check that all input components have the same length and sampling rate and return the length
+    inline size_t CheckIcaInput(
+        const std::vector<const TimeSeriesComponent*> &Input)
+      {
+        if (Input.size() < 2)
+          throw FatalException("Need at least two channels for ICA !");
+        const size_t nsamples = Input.front()->GetData().size();
+        for (size_t i = 1; i < Input.size(); ++i)
+          {
+            if (Input[i]->GetData().size() != nsamples)
+              throw FatalException(
+                  "All channels for ICA need the same number of samples: "
+                      + Input[i]->GetName());
+            if (std::abs(Input[i]->GetSamplerate()
+                - Input.front()->GetSamplerate()) > 1e-6
+                * Input.front()->GetSamplerate())
+              throw FatalException(
+                  "All channels for ICA need the same sampling rate: "
+                      + Input[i]->GetName());
+          }
+        return nsamples;
+      }
+
+    //! Calculate the whitening matrix that projects onto the ncomp strongest principal components and its pseudo-inverse
+    /*! Covariance is the nchannels x nchannels covariance matrix in column major order, it is overwritten.
+     * On exit White is ncomp x nchannels and DeWhite is nchannels x ncomp, so that White * DeWhite is the identity.
+     */
+    template<typename ScalarType>
+    void ReducedWhitening(std::vector<ScalarType> &Covariance,
+        const size_t nchannels, const size_t ncomp, ublas::matrix<ScalarType,
+            ublas::column_major> &White, ublas::matrix<ScalarType,
+            ublas::column_major> &DeWhite)
+      {
+        std::vector<double> Values;
+        std::vector<ScalarType> Vectors;
+        linalg::HermitianEigen(Covariance, nchannels, Values, Vectors);
+        if (Values.front() <= 0.0 || Values[ncomp - 1] <= 1e-12
+            * Values.front())
+          throw FatalException(
+              "Data covariance is rank deficient, reduce the number of components !");
+        White.resize(ncomp, nchannels);
+        DeWhite.resize(nchannels, ncomp);
+        for (size_t k = 0; k < ncomp; ++k)
+          {
+            const double scale = std::sqrt(Values[k]);
+            for (size_t i = 0; i < nchannels; ++i)
+              {
+                White(k, i) = linalg::Conj(Vectors[k * nchannels + i]) / scale;
+                DeWhite(i, k) = Vectors[k * nchannels + i] * scale;
+              }
+          }
+      }
+
+    //! Find the assignment between two sets of n components from their similarities
+    /*! Similarity(i, j) (column major) is the signed similarity between component i of the current
+     * set and component j of the reference set. We greedily assign the most similar pairs, Match[i]
+     * is the reference component for component i and Sign[i] the sign of the similarity.
+     */
+    inline void MatchComponents(const std::vector<double> &Similarity,
+        const size_t n, std::vector<size_t> &Match, std::vector<double> &Sign)
+      {
+        Match.assign(n, 0);
+        Sign.assign(n, 1.0);
+        std::vector<bool> RowUsed(n, false), ColUsed(n, false);
+        for (size_t pair = 0; pair < n; ++pair)
+          {
+            double best = -1.0;
+            size_t bestrow = 0, bestcol = 0;
+            for (size_t j = 0; j < n; ++j)
+              for (size_t i = 0; i < n; ++i)
+                if (!RowUsed[i] && !ColUsed[j] && std::abs(Similarity[i + j
+                    * n]) > best)
+                  {
+                    best = std::abs(Similarity[i + j * n]);
+                    bestrow = i;
+                    bestcol = j;
+                  }
+            RowUsed[bestrow] = true;
+            ColUsed[bestcol] = true;
+            Match[bestrow] = bestcol;
+            Sign[bestrow] = Similarity[bestrow + bestcol * n] < 0.0 ? -1.0
+                : 1.0;
+          }
+      }
+
+    //! Separate synchronized recordings into independent components with FastICA in overlapping time windows
+    /*! This is meant for arrays of synchronized stations where the mixing changes slowly with time, e.g.
+     * to separate cultural noise from the natural signal. Each window is whitened and reduced to the
+     * ncomp strongest principal components and separated with FastICA. Consecutive windows form chains,
+     * within a chain each window starts from the unmixing matrix of the previous window (a warm start),
+     * so usually only a few iterations are needed. The chains are processed in parallel. Afterwards
+     * the order and sign of the components in each window are matched to the previous window by
+     * correlating the sources over the overlapping samples and the sources are combined with a
+     * tapered overlap-add into one TimeSeriesComponent per independent component.
+     */
+    class WindowedICA
+      {
+    private:
+      //! The length of each window in samples
+      size_t windowlength;
+      //! The shift between the start of two windows in samples
+      size_t windowshift;
+      //! The number of independent components, 0 means the number of channels
+      size_t ncomponents;
+      //! The number of windows that are processed in sequence with warm starts
+      size_t chainlength;
+      //! The maximum number of FastICA iterations per window
+      int maxiterations;
+      //! The convergence criterion for FastICA
+      double tolerance;
+      //! The first sample of each window
+      std::vector<size_t> WindowStarts;
+      //! The unmixing matrix for each window, it is applied to the data after removing Means
+      std::vector<rmat> Unmixing;
+      //! The mean of each channel in each window
+      std::vector<std::vector<double> > Means;
+      //! The number of FastICA iterations for each window
+      std::vector<int> Iterations;
+      //! Copy the samples between start and start + length into a channels x samples matrix
+      static void CopyWindow(const std::vector<const TimeSeriesComponent*> &Input,
+          const size_t start, const size_t length, rmat &X)
+        {
+          const size_t nchannels = Input.size();
+          X.resize(nchannels, length, false);
+          for (size_t i = 0; i < nchannels; ++i)
+            {
+              const std::vector<double> &Data = Input[i]->GetData();
+              for (size_t k = 0; k < length; ++k)
+                X.data()[i + k * nchannels] = Data[start + k];
+            }
+        }
+      //! Calculate the sources S = B (X - Mean) for the samples in X
+      static void ApplyUnmixing(const rmat &B, const std::vector<double> &Mean,
+          const rmat &X, rmat &S)
+        {
+          const size_t ncomp = B.size1();
+          const size_t nchannels = B.size2();
+          const size_t length = X.size2();
+          S.resize(ncomp, length, false);
+          linalg::Gemm('N', 'N', ncomp, length, nchannels, 1.0, &B.data()[0],
+              ncomp, &X.data()[0], nchannels, 0.0, &S.data()[0], ncomp);
+          for (size_t i = 0; i < ncomp; ++i)
+            {
+              double offset = 0.0;
+              for (size_t j = 0; j < nchannels; ++j)
+                offset += B(i, j) * Mean[j];
+              for (size_t k = 0; k < length; ++k)
+                S.data()[i + k * ncomp] -= offset;
+            }
+        }
+      //! Estimate the unmixing matrix for the window starting at start, Previous is the result for the previous window or empty
+      void EstimateWindow(const std::vector<const TimeSeriesComponent*> &Input,
+          const size_t start, const size_t ncomp, const rmat &Previous,
+          rmat &B, std::vector<double> &Mean, int &niter) const
+        {
+          const size_t nchannels = Input.size();
+          rmat X;
+          CopyWindow(Input, start, windowlength, X);
+          CovAccumulator<double> Accumulator(nchannels);
+          Accumulator.Add(X);
+          Mean = Accumulator.GetMean();
+          std::vector<double> Covariance(Accumulator.GetCovariance(true));
+          for (size_t k = 0; k < windowlength; ++k)
+            for (size_t i = 0; i < nchannels; ++i)
+              X.data()[i + k * nchannels] -= Mean[i];
+          rmat White, DeWhite;
+          ReducedWhitening(Covariance, nchannels, ncomp, White, DeWhite);
+          rmat Z(ncomp, windowlength);
+          linalg::Gemm('N', 'N', ncomp, windowlength, nchannels, 1.0,
+              &White.data()[0], ncomp, &X.data()[0], nchannels, 0.0,
+              &Z.data()[0], ncomp);
+          //express the unmixing matrix of the previous window in the whitened coordinates of this window
+          rmat W;
+          if (Previous.size1() == ncomp)
+            W = trans(linalg::Prod(Previous, DeWhite));
+          else
+            W = ublas::identity_matrix<double>(ncomp);
+          niter = FastICAIterate(Z, W, maxiterations, tolerance);
+          B = linalg::Prod(rmat(trans(W)), White);
+        }
+      //! Bring the components of all windows into the same order and sign as in the first window
+      void AlignWindows(const std::vector<const TimeSeriesComponent*> &Input)
+        {
+          const size_t nwindows = WindowStarts.size();
+          const size_t ncomp = Unmixing.front().size1();
+          std::vector<std::vector<size_t> > Match(nwindows);
+          std::vector<std::vector<double> > Signs(nwindows);
+          const int nparallel = nwindows;
+#pragma omp parallel for default(shared) schedule(dynamic)
+          for (int w = 1; w < nparallel; ++w)
+            {
+              std::vector<double> Similarity(ncomp * ncomp, 0.0);
+              const size_t overlapstart = WindowStarts[w];
+              const size_t overlapend = WindowStarts[w - 1] + windowlength;
+              rmat Current, Reference;
+              if (overlapend > overlapstart)
+                {
+                  //correlate the sources of both windows over the common samples
+                  rmat X;
+                  CopyWindow(Input, overlapstart, overlapend - overlapstart, X);
+                  ApplyUnmixing(Unmixing[w], Means[w], X, Current);
+                  ApplyUnmixing(Unmixing[w - 1], Means[w - 1], X, Reference);
+                }
+              else
+                {
+                  //without overlap we compare the unmixing vectors
+                  Current = Unmixing[w];
+                  Reference = Unmixing[w - 1];
+                }
+              const size_t length = Current.size2();
+              linalg::Gemm('N', 'T', ncomp, ncomp, length, 1.0,
+                  &Current.data()[0], ncomp, &Reference.data()[0], ncomp, 0.0,
+                  &Similarity[0], ncomp);
+              for (size_t j = 0; j < ncomp; ++j)
+                for (size_t i = 0; i < ncomp; ++i)
+                  {
+                    const double norm = std::sqrt(inner_prod(row(Current, i),
+                        row(Current, i)) * inner_prod(row(Reference, j), row(
+                        Reference, j)));
+                    if (norm > 0.0)
+                      Similarity[i + j * ncomp] /= norm;
+                  }
+              MatchComponents(Similarity, ncomp, Match[w], Signs[w]);
+            }
+          //the permutations are relative to the previous window, so we combine them in sequence
+          std::vector<size_t> Slot(ncomp), PrevSlot(ncomp);
+          std::vector<double> Sign(ncomp, 1.0), PrevSign(ncomp);
+          for (size_t i = 0; i < ncomp; ++i)
+            Slot[i] = i;
+          for (size_t w = 1; w < nwindows; ++w)
+            {
+              PrevSlot = Slot;
+              PrevSign = Sign;
+              for (size_t i = 0; i < ncomp; ++i)
+                {
+                  Slot[i] = PrevSlot[Match[w][i]];
+                  Sign[i] = PrevSign[Match[w][i]] * Signs[w][i];
+                }
+              const rmat Original(Unmixing[w]);
+              for (size_t i = 0; i < ncomp; ++i)
+                row(Unmixing[w], Slot[i]) = Sign[i] * row(Original, i);
+            }
+        }
+      //! Combine the sources of all windows with a tapered overlap-add
+      void CombineWindows(const std::vector<const TimeSeriesComponent*> &Input,
+          const size_t nsamples, std::vector<TimeSeriesComponent> &Sources) const
+        {
+          const size_t nwindows = WindowStarts.size();
+          const size_t ncomp = Unmixing.front().size1();
+          Sources.assign(ncomp, TimeSeriesComponent());
+          for (size_t i = 0; i < ncomp; ++i)
+            {
+              Sources[i].SetSamplerate(Input.front()->GetSamplerate());
+              Sources[i].SetName("IC" + stringify(i));
+              Sources[i].GetData().assign(nsamples, 0.0);
+            }
+          std::vector<double> Taper(windowlength);
+          for (size_t k = 0; k < windowlength; ++k)
+            {
+              const double s = std::sin(PI * (k + 0.5) / windowlength);
+              Taper[k] = s * s;
+            }
+          //the samples between the start of two windows form a segment, each thread writes to different segments
+          const int nsegments = nwindows;
+#pragma omp parallel default(shared)
+            {
+              rmat X, S;
+              std::vector<double> Sum, WeightSum;
+#pragma omp for schedule(dynamic)
+              for (int seg = 0; seg < nsegments; ++seg)
+                {
+                  const size_t segstart = WindowStarts[seg];
+                  const size_t segend = (seg + 1 < nsegments) ? WindowStarts[seg
+                      + 1] : nsamples;
+                  const size_t length = segend - segstart;
+                  CopyWindow(Input, segstart, length, X);
+                  Sum.assign(ncomp * length, 0.0);
+                  WeightSum.assign(length, 0.0);
+                  //the first window that still covers the start of the segment
+                  size_t first = 0;
+                  if (segstart >= windowlength)
+                    first = std::upper_bound(WindowStarts.begin(),
+                        WindowStarts.end(), segstart - windowlength)
+                        - WindowStarts.begin();
+                  for (int w = first; w <= seg; ++w)
+                    {
+                      ApplyUnmixing(Unmixing[w], Means[w], X, S);
+                      //earlier windows can end before the end of the segment
+                      const size_t offset = segstart - WindowStarts[w];
+                      const size_t covered = std::min(length, windowlength
+                          - offset);
+                      for (size_t k = 0; k < covered; ++k)
+                        {
+                          const double weight = Taper[offset + k];
+                          WeightSum[k] += weight;
+                          for (size_t i = 0; i < ncomp; ++i)
+                            Sum[i + k * ncomp] += weight * S.data()[i + k
+                                * ncomp];
+                        }
+                    }
+                  for (size_t i = 0; i < ncomp; ++i)
+                    {
+                      std::vector<double> &Out = Sources[i].GetData();
+                      for (size_t k = 0; k < length; ++k)
+                        Out[segstart + k] = Sum[i + k * ncomp] / WeightSum[k];
+                    }
+                }
+            }
+        }
+    public:
+      //! The first sample of each window of the last separation
+      const std::vector<size_t> &GetWindowStarts() const
+        {
+          return WindowStarts;
+        }
+      //! The unmixing matrix for each window, the rows are aligned so that each row corresponds to the same output component
+      const std::vector<rmat> &GetUnmixing() const
+        {
+          return Unmixing;
+        }
+      //! The number of FastICA iterations for each window
+      const std::vector<int> &GetIterations() const
+        {
+          return Iterations;
+        }
+      //! Separate the channels in Input into independent components, on exit Sources contains one component per independent component
+      void Separate(const std::vector<const TimeSeriesComponent*> &Input,
+          std::vector<TimeSeriesComponent> &Sources)
+        {
+          const size_t nchannels = Input.size();
+          const size_t nsamples = CheckIcaInput(Input);
+          const size_t ncomp = ncomponents > 0 ? ncomponents : nchannels;
+          if (ncomp > nchannels)
+            throw FatalException(
+                "Cannot estimate more components than there are channels !");
+          if (windowlength > nsamples || windowlength <= ncomp)
+            throw FatalException("Invalid window length for WindowedICA !");
+          WindowStarts.clear();
+          for (size_t start = 0; start + windowlength <= nsamples; start
+              += windowshift)
+            WindowStarts.push_back(start);
+          if (WindowStarts.back() + windowlength < nsamples)
+            WindowStarts.push_back(nsamples - windowlength);
+          const size_t nwindows = WindowStarts.size();
+          Unmixing.assign(nwindows, rmat());
+          Means.assign(nwindows, std::vector<double>());
+          Iterations.assign(nwindows, 0);
+          const int nchains = (nwindows + chainlength - 1) / chainlength;
+          std::string errormessage;
+          //with a single chain we let FastICA parallelize over the samples instead
+#pragma omp parallel for default(shared) schedule(dynamic) if(nchains > 1)
+          for (int chain = 0; chain < nchains; ++chain)
+            {
+              //exceptions cannot leave an openmp block
+              try
+                {
+                  rmat Previous;
+                  const size_t chainend = std::min(nwindows, (chain + 1)
+                      * chainlength);
+                  for (size_t w = chain * chainlength; w < chainend; ++w)
+                    {
+                      EstimateWindow(Input, WindowStarts[w], ncomp, Previous,
+                          Unmixing[w], Means[w], Iterations[w]);
+                      Previous = Unmixing[w];
+                    }
+                } catch (FatalException &e)
+                {
+#pragma omp critical(windowedica_error)
+                  errormessage = e.what();
+                }
+            }
+          if (!errormessage.empty())
+            throw FatalException(errormessage);
+          AlignWindows(Input);
+          CombineWindows(Input, nsamples, Sources);
+        }
+      //! Setup the separation
+      /*! @param length The length of each window in samples
+       * @param shift The shift between consecutive windows in samples, has to be between 1 and length
+       * @param ncomp The number of independent components, 0 for as many as there are channels
+       * @param chain The number of consecutive windows that are processed by one thread with warm starts
+       * @param maxit The maximum number of FastICA iterations per window
+       * @param tol The convergence criterion for FastICA
+       */
+      WindowedICA(const size_t length, const size_t shift,
+          const size_t ncomp = 0, const size_t chain = 16, const int maxit =
+              200, const double tol = 1e-6) :
+        windowlength(length), windowshift(shift), ncomponents(ncomp),
+            chainlength(chain), maxiterations(maxit), tolerance(tol)
+        {
+          if (windowshift == 0 || windowshift > windowlength || chainlength
+              == 0)
+            throw FatalException("Invalid window setup for WindowedICA !");
+        }
+      virtual ~WindowedICA()
+        {
+        }
+      };
+
+    //! Separate synchronized recordings into independent components in the frequency domain
+    /*! The recordings are transformed with a short time Fourier transform with a sqrt-Hann window. For each
+     * frequency the spectral coefficients of all windows are the observations for ComplexICA, so the sources can
+     * have a different mixing at each frequency, e.g. due to different transfer functions at each station.
+     * The frequencies are processed in parallel, chains of neighbouring frequencies use warm starts.
+     * The scaling of the sources is fixed by projecting them back onto the reference channel, so the output is the
+     * contribution of each source to the reference channel and the sum of all outputs gives the reference channel
+     * if all components are retained. The order of the components at each frequency is matched by correlating the
+     * amplitude envelopes over time. The sources are transformed back with weighted overlap-add.
+     */
+    class SpectralICA
+      {
+    private:
+      //! The length of each fft window in samples
+      size_t fftlength;
+      //! The shift between consecutive windows in samples
+      size_t windowshift;
+      //! The number of independent components, 0 means the number of channels
+      size_t ncomponents;
+      //! The index of the channel that determines the scaling of the sources
+      size_t refchannel;
+      //! The number of neighbouring frequencies that are processed in sequence with warm starts
+      size_t chainlength;
+      //! The maximum number of iterations per frequency
+      int maxiterations;
+      //! The convergence criterion for ComplexICA
+      double tolerance;
+      //! The number of iterations for each frequency
+      std::vector<int> Iterations;
+      //! Separate one frequency, on exit Spectrum contains the sources and Envelope their normalized amplitude envelopes
+      void EstimateFrequency(cmat &Spectrum, const size_t ncomp,
+          const cmat &Previous, cmat &B, std::vector<double> &Envelope,
+          int &niter) const
+        {
+          const size_t nchannels = Spectrum.size1();
+          const size_t nframes = Spectrum.size2();
+          const std::complex<double> one(1.0), zero(0.0);
+          CovAccumulator<std::complex<double> > Accumulator(nchannels);
+          Accumulator.Add(Spectrum);
+          //fourier coefficients have zero mean, so we do not remove it
+          std::vector<std::complex<double> > Covariance(
+              Accumulator.GetCovariance(false));
+          cmat White, DeWhite;
+          ReducedWhitening(Covariance, nchannels, ncomp, White, DeWhite);
+          cmat Z(ncomp, nframes);
+          linalg::Gemm('N', 'N', ncomp, nframes, nchannels, one,
+              &White.data()[0], ncomp, &Spectrum.data()[0], nchannels, zero,
+              &Z.data()[0], ncomp);
+          cmat W;
+          if (Previous.size1() == ncomp)
+            W = herm(linalg::Prod(Previous, DeWhite));
+          else
+            W = ublas::identity_matrix<std::complex<double> >(ncomp);
+          niter = ComplexFastICAIterate(Z, W, maxiterations, tolerance);
+          B = linalg::Prod(cmat(herm(W)), White);
+          //project back onto the reference channel, A = DeWhite W is the mixing matrix
+          const cmat A(linalg::Prod(DeWhite, W));
+          cmat Sources(ncomp, nframes);
+          linalg::Gemm('C', 'N', ncomp, nframes, ncomp, one, &W.data()[0],
+              ncomp, &Z.data()[0], ncomp, zero, &Sources.data()[0], ncomp);
+          Envelope.resize(ncomp * nframes);
+          for (size_t i = 0; i < ncomp; ++i)
+            {
+              const std::complex<double> scale = A(refchannel, i);
+              double mean = 0.0;
+              for (size_t t = 0; t < nframes; ++t)
+                {
+                  Sources(i, t) *= scale;
+                  Envelope[i + t * ncomp] = std::abs(Sources(i, t));
+                  mean += Envelope[i + t * ncomp];
+                }
+              mean /= nframes;
+              double norm = 0.0;
+              for (size_t t = 0; t < nframes; ++t)
+                {
+                  Envelope[i + t * ncomp] -= mean;
+                  norm += Envelope[i + t * ncomp] * Envelope[i + t * ncomp];
+                }
+              norm = norm > 0.0 ? 1.0 / std::sqrt(norm) : 0.0;
+              for (size_t t = 0; t < nframes; ++t)
+                Envelope[i + t * ncomp] *= norm;
+            }
+          Spectrum.swap(Sources);
+        }
+    public:
+      //! The number of ComplexICA iterations for each frequency
+      const std::vector<int> &GetIterations() const
+        {
+          return Iterations;
+        }
+      //! Separate the channels in Input into independent components, on exit Sources contains one component per independent component
+      void Separate(const std::vector<const TimeSeriesComponent*> &Input,
+          std::vector<TimeSeriesComponent> &Sources)
+        {
+          const size_t nchannels = Input.size();
+          const size_t nsamples = CheckIcaInput(Input);
+          const size_t ncomp = ncomponents > 0 ? ncomponents : nchannels;
+          if (ncomp > nchannels || refchannel >= nchannels)
+            throw FatalException(
+                "Invalid number of components or reference channel for SpectralICA !");
+          const size_t nfreq = fftlength / 2 + 1;
+          //the last window is padded with zeros
+          const size_t nframes = nsamples <= fftlength ? 1 : (nsamples
+              - fftlength + windowshift - 1) / windowshift + 1;
+          if (nframes <= ncomp)
+            throw FatalException(
+                "Not enough windows for SpectralICA, use shorter windows !");
+          std::vector<double> Window(fftlength);
+          for (size_t k = 0; k < fftlength; ++k)
+            Window[k] = std::sin(PI * (k + 0.5) / fftlength);
+          //short time fourier transform, each thread works on different windows
+          std::vector<cmat> Spectra(nfreq, cmat(nchannels, nframes));
+          const int nparallelframes = nframes;
+#pragma omp parallel default(shared)
+            {
+              TsSpectrum Spectrum(true);
+              std::vector<double> Segment(fftlength);
+              std::vector<std::complex<double> > Frequencies(nfreq);
+#pragma omp for
+              for (int frame = 0; frame < nparallelframes; ++frame)
+                {
+                  const size_t start = frame * windowshift;
+                  for (size_t i = 0; i < nchannels; ++i)
+                    {
+                      const std::vector<double> &Data = Input[i]->GetData();
+                      for (size_t k = 0; k < fftlength; ++k)
+                        Segment[k] = (start + k < nsamples) ? Window[k]
+                            * Data[start + k] : 0.0;
+                      Spectrum.CalcSpectrum(Segment.begin(), Segment.end(),
+                          Frequencies.begin(), Frequencies.end());
+                      for (size_t f = 0; f < nfreq; ++f)
+                        Spectra[f](i, frame) = Frequencies[f];
+                    }
+                }
+            }
+          std::vector<cmat> Unmixing(nfreq);
+          std::vector<std::vector<double> > Envelopes(nfreq, std::vector<
+              double>(ncomp * nframes, 0.0));
+          Iterations.assign(nfreq, 0);
+          const int nchains = (nfreq + chainlength - 1) / chainlength;
+          std::string errormessage;
+#pragma omp parallel for default(shared) schedule(dynamic) if(nchains > 1)
+          for (int chain = 0; chain < nchains; ++chain)
+            {
+              //exceptions cannot leave an openmp block
+              try
+                {
+                  cmat Previous;
+                  const size_t chainend = std::min(nfreq, (chain + 1)
+                      * chainlength);
+                  for (size_t f = chain * chainlength; f < chainend; ++f)
+                    {
+                      EstimateFrequency(Spectra[f], ncomp, Previous,
+                          Unmixing[f], Envelopes[f], Iterations[f]);
+                      Previous = Unmixing[f];
+                    }
+                } catch (FatalException &e)
+                {
+#pragma omp critical(spectralica_error)
+                  errormessage = e.what();
+                }
+            }
+          if (!errormessage.empty())
+            throw FatalException(errormessage);
+          //match the order of the components at each frequency to the average envelopes of the frequencies below
+          //Rows[f][j] is the row of the spectrum at frequency f that belongs to output component j
+          std::vector<std::vector<size_t> > Rows(nfreq, std::vector<size_t>(
+              ncomp));
+          for (size_t j = 0; j < ncomp; ++j)
+            Rows[0][j] = j;
+          std::vector<double> Centroid(Envelopes[0]), Similarity(ncomp * ncomp);
+          std::vector<size_t> Match;
+          std::vector<double> Sign;
+          for (size_t f = 1; f < nfreq; ++f)
+            {
+              linalg::Gemm('N', 'T', ncomp, ncomp, nframes, 1.0,
+                  &Envelopes[f][0], ncomp, &Centroid[0], ncomp, 0.0,
+                  &Similarity[0], ncomp);
+              for (size_t j = 0; j < ncomp; ++j)
+                {
+                  double norm = 0.0;
+                  for (size_t t = 0; t < nframes; ++t)
+                    norm += Centroid[j + t * ncomp] * Centroid[j + t * ncomp];
+                  norm = norm > 0.0 ? 1.0 / std::sqrt(norm) : 0.0;
+                  for (size_t i = 0; i < ncomp; ++i)
+                    Similarity[i + j * ncomp] *= norm;
+                }
+              //only positive correlation of envelopes indicates the same source
+              for (size_t i = 0; i < Similarity.size(); ++i)
+                Similarity[i] = std::max(Similarity[i], 0.0);
+              MatchComponents(Similarity, ncomp, Match, Sign);
+              for (size_t i = 0; i < ncomp; ++i)
+                {
+                  Rows[f][Match[i]] = i;
+                  for (size_t t = 0; t < nframes; ++t)
+                    Centroid[Match[i] + t * ncomp] += Envelopes[f][i + t
+                        * ncomp];
+                }
+            }
+          Sources.assign(ncomp, TimeSeriesComponent());
+          for (size_t j = 0; j < ncomp; ++j)
+            {
+              Sources[j].SetSamplerate(Input.front()->GetSamplerate());
+              Sources[j].SetName("IC" + stringify(j));
+              Sources[j].GetData().assign(nsamples, 0.0);
+            }
+          std::vector<double> WindowSum(nsamples, 0.0);
+          for (size_t frame = 0; frame < nframes; ++frame)
+            for (size_t k = 0; k < fftlength && frame * windowshift + k
+                < nsamples; ++k)
+              WindowSum[frame * windowshift + k] += Window[k] * Window[k];
+          //inverse transform with weighted overlap-add, each thread works on a different component
+          const int nparallelcomp = ncomp;
+#pragma omp parallel default(shared)
+            {
+              TsSpectrum Spectrum(true);
+              std::vector<double> Segment(fftlength);
+              std::vector<std::complex<double> > Frequencies(nfreq);
+#pragma omp for
+              for (int j = 0; j < nparallelcomp; ++j)
+                {
+                  std::vector<double> &Out = Sources[j].GetData();
+                  for (size_t frame = 0; frame < nframes; ++frame)
+                    {
+                      for (size_t f = 0; f < nfreq; ++f)
+                        Frequencies[f] = Spectra[f](Rows[f][j], frame);
+                      Spectrum.CalcTimeSeries(Frequencies.begin(),
+                          Frequencies.end(), Segment.begin(), Segment.end());
+                      const size_t start = frame * windowshift;
+                      for (size_t k = 0; k < fftlength && start + k < nsamples; ++k)
+                        Out[start + k] += Window[k] * Segment[k];
+                    }
+                  for (size_t t = 0; t < nsamples; ++t)
+                    if (WindowSum[t] > 0.0)
+                      Out[t] /= WindowSum[t];
+                }
+            }
+        }
+      //! Setup the separation
+      /*! @param length The length of the fft windows in samples
+       * @param shift The shift between consecutive windows in samples, has to be between 1 and length
+       * @param ncomp The number of independent components, 0 for as many as there are channels
+       * @param reference The index of the channel the sources are projected onto
+       * @param chain The number of neighbouring frequencies that are processed by one thread with warm starts
+       * @param maxit The maximum number of ComplexICA iterations per frequency
+       * @param tol The convergence criterion for ComplexICA
+       */
+      SpectralICA(const size_t length, const size_t shift,
+          const size_t ncomp = 0, const size_t reference = 0,
+          const size_t chain = 8, const int maxit = 200,
+          const double tol = 1e-6) :
+        fftlength(length), windowshift(shift), ncomponents(ncomp),
+            refchannel(reference), chainlength(chain), maxiterations(maxit),
+            tolerance(tol)
+        {
+          if (fftlength < 4 || windowshift == 0 || windowshift > fftlength
+              || chainlength == 0)
+            throw FatalException("Invalid window setup for SpectralICA !");
+        }
+      virtual ~SpectralICA()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /* WINDOWEDICA_H_ */
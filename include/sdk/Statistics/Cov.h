@@ -2,6 +2,10 @@
 #define COV_H_
 
 #include "VecMat.h"
+#include "LinAlgKernels.h"
+#include "FatalException.h"
+#include <vector>
+#include <complex>
 
 namespace gplib
   {
@@ -32,6 +36,145 @@ namespace gplib
         result /= (nsamples - 1);
         return result;
       }
+
+    //! Accumulate the covariance matrix of multichannel data that is passed in chunks of samples
+    /*! The data does not have to be in memory at the same time, so we can calculate the covariance
+     * for recordings of arbitrary length. We accumulate the sum of the samples and the sum of the outer products, so the
+     * mean can be removed at the end without a second pass over the data. For complex data the covariance is
+     * hermitian, i.e. we use the complex conjugate of the second channel.
+     */
+    template<typename ScalarType>
+    class CovAccumulator
+      {
+    private:
+      size_t nchannels;
+      size_t nsamples;
+      //! The sum of the outer products, only the lower triangle is updated
+      std::vector<ScalarType> OuterSum;
+      //! The sum of the samples for each channel
+      std::vector<ScalarType> Sum;
+    public:
+      //! Add nsamp samples, sample k of channel i is stored at Data[i + k * ld], i.e. a column major matrix with the channels as rows
+      void Add(const ScalarType *Data, const size_t nsamp, const size_t ld)
+        {
+          if (nsamp == 0)
+            return;
+          linalg::RankKUpdate(Data, nchannels, nsamp, ld, &OuterSum[0]);
+          for (size_t k = 0; k < nsamp; ++k)
+            for (size_t i = 0; i < nchannels; ++i)
+              Sum[i] += Data[i + k * ld];
+          nsamples += nsamp;
+        }
+      //! Add all samples in a column major ublas matrix with the channels as rows
+      template<typename MatrixType>
+      void Add(const MatrixType &Chunk)
+        {
+          if (Chunk.size1() != nchannels)
+            throw FatalException(
+                "Number of channels does not match in CovAccumulator !");
+          if (Chunk.size2() > 0)
+            Add(&Chunk.data()[0], Chunk.size2(), nchannels);
+        }
+      //! Add the samples between start and start + length from a vector for each channel
+      template<typename VectorType>
+      void Add(const std::vector<VectorType*> &Channels, const size_t start,
+          const size_t length)
+        {
+          if (Channels.size() != nchannels)
+            throw FatalException(
+                "Number of channels does not match in CovAccumulator !");
+          //we copy in blocks so the outer products can work on contiguous memory
+          std::vector<ScalarType> Block(nchannels * linalg::blocksize);
+          for (size_t blockstart = start; blockstart < start + length; blockstart
+              += linalg::blocksize)
+            {
+              const size_t nblock = std::min(linalg::blocksize, start + length
+                  - blockstart);
+              for (size_t k = 0; k < nblock; ++k)
+                for (size_t i = 0; i < nchannels; ++i)
+                  Block[i + k * nchannels] = (*Channels[i])[blockstart + k];
+              Add(&Block[0], nblock, nchannels);
+            }
+        }
+      //! Add the sums of another accumulator, e.g. from a different thread
+      void Merge(const CovAccumulator &Other)
+        {
+          if (Other.nchannels != nchannels)
+            throw FatalException(
+                "Number of channels does not match in CovAccumulator !");
+          for (size_t i = 0; i < OuterSum.size(); ++i)
+            OuterSum[i] += Other.OuterSum[i];
+          for (size_t i = 0; i < nchannels; ++i)
+            Sum[i] += Other.Sum[i];
+          nsamples += Other.nsamples;
+        }
+      //! The number of samples added so far
+      size_t GetNSamples() const
+        {
+          return nsamples;
+        }
+      size_t GetNChannels() const
+        {
+          return nchannels;
+        }
+      //! The mean of each channel
+      std::vector<ScalarType> GetMean() const
+        {
+          std::vector<ScalarType> Mean(Sum);
+          for (size_t i = 0; i < nchannels; ++i)
+            Mean[i] /= double(nsamples);
+          return Mean;
+        }
+      //! Return the covariance matrix as a column major vector, if removemean is false we assume the data has zero mean
+      std::vector<ScalarType> GetCovariance(const bool removemean = true) const
+        {
+          if (nsamples < 2)
+            throw FatalException("Need at least two samples for covariance !");
+          std::vector<ScalarType> Result(OuterSum);
+          if (removemean)
+            {
+              for (size_t j = 0; j < nchannels; ++j)
+                for (size_t i = j; i < nchannels; ++i)
+                  Result[j * nchannels + i] -= Sum[i] * linalg::Conj(Sum[j])
+                      / double(nsamples);
+            }
+          for (size_t i = 0; i < Result.size(); ++i)
+            Result[i] /= double(nsamples - 1);
+          linalg::FillUpper(&Result[0], nchannels);
+          return Result;
+        }
+      explicit CovAccumulator(const size_t nchan) :
+        nchannels(nchan), nsamples(0), OuterSum(nchan * nchan, ScalarType(0.0)),
+            Sum(nchan, ScalarType(0.0))
+        {
+        }
+      virtual ~CovAccumulator()
+        {
+        }
+      };
+
+    //! Calculate the covariance matrix of column major real observations with 0 mean, the channels are the rows
+    inline gplib::rmat Cov(const gplib::rmat &observations)
+      {
+        CovAccumulator<double> Acc(observations.size1());
+        Acc.Add(observations);
+        const std::vector<double> Result(Acc.GetCovariance(false));
+        gplib::rmat result(observations.size1(), observations.size1());
+        std::copy(Result.begin(), Result.end(), result.data().begin());
+        return result;
+      }
+
+    //! Calculate the hermitian covariance matrix of column major complex observations with 0 mean, the channels are the rows
+    inline gplib::cmat Cov(const gplib::cmat &observations)
+      {
+        CovAccumulator<std::complex<double> > Acc(observations.size1());
+        Acc.Add(observations);
+        const std::vector<std::complex<double> > Result(Acc.GetCovariance(
+            false));
+        gplib::cmat result(observations.size1(), observations.size1());
+        std::copy(Result.begin(), Result.end(), result.data().begin());
+        return result;
+      }
   /* @} */
   }
 #endif /*COV_H_*/
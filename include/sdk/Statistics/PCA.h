@@ -4,6 +4,7 @@
 #include "VecMat.h"
 #include "statutils.h"
 #include "Cov.h"
+#include "LinAlgKernels.h"
 
 namespace ublas = boost::numeric::ublas;
 
@@ -17,26 +18,44 @@ namespace gplib
      *  This file contains function connected to Principal Component Analysis
      */
 
+    //! Calculate the principal components from the covariance accumulated over the whole recording
+    /*! This version can be used for recordings that do not fit into memory, the data is passed in chunks to
+     * the CovAccumulator. The mean of each channel is removed. The eigenvectors are the columns of evectors and
+     * are sorted by descending eigenvalue.
+     */
+    template<typename ScalarType>
+    void PCA(const CovAccumulator<ScalarType> &Accumulator,
+        gplib::cmat &evectors, gplib::cvec &evalues)
+      {
+        const size_t nchannels = Accumulator.GetNChannels();
+        std::vector<ScalarType> Covariance(Accumulator.GetCovariance(true));
+        std::vector<double> Values;
+        std::vector<ScalarType> Vectors;
+        linalg::HermitianEigen(Covariance, nchannels, Values, Vectors);
+        evectors.resize(nchannels, nchannels);
+        evalues.resize(nchannels);
+        for (size_t j = 0; j < nchannels; ++j)
+          {
+            evalues(j) = Values[j];
+            for (size_t i = 0; i < nchannels; ++i)
+              evectors(i, j) = Vectors[j * nchannels + i];
+          }
+      }
+
     //! This template function calculates the principal component rotation matrix from a matrix of observations
-    /*! The input matrix observations has the different channels (or datasets) as rows and corresponding samples as columns
-     * the parameter pcatrans will contain the matrix of principal component vectors, at the moment in no particular order
+    /*! The input matrix observations has the different channels (or datasets) as rows and corresponding samples as columns,
+     * it has to be stored in column major order as gplib::rmat and gplib::cmat. The parameter evectors will contain the
+     * matrix of principal component vectors as columns, sorted by descending eigenvalue. The mean of each channel is removed
+     * before the calculation, the observations are not copied.
      */
     template<typename UblasMatrix>
     void PCA(const UblasMatrix &observations, gplib::cmat &evectors,
         gplib::cvec &evalues)
       {
-        UblasMatrix loc_obs(observations);
-        for (unsigned int i = 0; i < loc_obs.size1(); ++i)
-          SubMean(row(loc_obs, i).begin(), row(loc_obs, i).end());
-        UblasMatrix covariance = Cov(loc_obs);
-
-        const int nchannels = covariance.size1();
-
-        gplib::rvec s(nchannels);
-        gplib::cmat vl(nchannels, nchannels), vr(nchannels, nchannels), in(
-            nchannels, nchannels);
-//        boost::numeric::bindings::lapack::geev(covariance, evalues, &vl,
-//            &evectors, boost::numeric::bindings::lapack::optimal_workspace());
+        CovAccumulator<typename UblasMatrix::value_type> Accumulator(
+            observations.size1());
+        Accumulator.Add(observations);
+        PCA(Accumulator, evectors, evalues);
       }
 
     //! Calculate the Whitening Matrix
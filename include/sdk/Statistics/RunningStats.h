@@ -0,0 +1,338 @@
+#ifndef RUNNINGSTATS_H_
+#define RUNNINGSTATS_H_
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <cmath>
+#include "FatalException.h"
+
+namespace gplib
+  {
+
+    /** \addtogroup statistics Statistical methods */
+    /* @{ */
+
+    /*! /file This header contains statistics in moving windows. Each output sample is calculated from a window
+     * of windowlength input samples centred on the sample, at the beginning and the end of the input the windows
+     * are truncated. The accumulators are updated with the sample that enters the window and the sample that
+     * leaves it, so for mean, variance and rms the cost per sample does not depend on the window length.
+     */
+
+    //! A sum with Neumaier compensation, so adding and removing values over long series does not accumulate rounding errors
+    class CompensatedSum
+      {
+    private:
+      double sum;
+      double compensation;
+    public:
+      void Add(const double x)
+        {
+          const double t = sum + x;
+          if (std::abs(sum) >= std::abs(x))
+            compensation += (sum - t) + x;
+          else
+            compensation += (x - t) + sum;
+          sum = t;
+        }
+      double Get() const
+        {
+          return sum + compensation;
+        }
+      CompensatedSum() :
+        sum(0.0), compensation(0.0)
+        {
+        }
+      };
+
+    //! Accumulator for the mean in a moving window
+    class WindowMean
+      {
+    private:
+      CompensatedSum Sum;
+      size_t n;
+    public:
+      void Add(const size_t, const double x)
+        {
+          Sum.Add(x);
+          ++n;
+        }
+      void Remove(const size_t, const double x)
+        {
+          Sum.Add(-x);
+          --n;
+        }
+      double Get() const
+        {
+          return Sum.Get() / n;
+        }
+      WindowMean() :
+        n(0)
+        {
+        }
+      };
+
+    //! Accumulator for the unbiased variance in a moving window
+    /*! We accumulate the values relative to the first value to avoid cancellation for data with a large offset.
+     */
+    class WindowVariance
+      {
+    private:
+      CompensatedSum Sum;
+      CompensatedSum SquareSum;
+      size_t n;
+      double shift;
+      bool haveshift;
+    public:
+      void Add(const size_t, const double x)
+        {
+          if (!haveshift)
+            {
+              shift = x;
+              haveshift = true;
+            }
+          Sum.Add(x - shift);
+          SquareSum.Add((x - shift) * (x - shift));
+          ++n;
+        }
+      void Remove(const size_t, const double x)
+        {
+          Sum.Add(shift - x);
+          SquareSum.Add(-(x - shift) * (x - shift));
+          --n;
+        }
+      double Get() const
+        {
+          if (n < 2)
+            return 0.0;
+          const double s = Sum.Get();
+          return std::max((SquareSum.Get() - s * s / n) / (n - 1), 0.0);
+        }
+      WindowVariance() :
+        n(0), shift(0.0), haveshift(false)
+        {
+        }
+      };
+
+    //! Accumulator for the root mean square in a moving window
+    class WindowRMS
+      {
+    private:
+      CompensatedSum SquareSum;
+      size_t n;
+    public:
+      void Add(const size_t, const double x)
+        {
+          SquareSum.Add(x * x);
+          ++n;
+        }
+      void Remove(const size_t, const double x)
+        {
+          SquareSum.Add(-x * x);
+          --n;
+        }
+      double Get() const
+        {
+          return std::sqrt(std::max(SquareSum.Get() / n, 0.0));
+        }
+      WindowRMS() :
+        n(0)
+        {
+        }
+      };
+
+    //! Accumulator for the minimum or maximum in a moving window, implemented with a monotonic deque
+    /*! The deque contains the candidates for the extremum in the order they entered the window, each sample
+     * enters and leaves the deque at most once, so the cost per sample is constant on average.
+     * With Compare = std::greater_equal we get the maximum, with std::less_equal the minimum.
+     */
+    template<typename Compare>
+    class WindowExtremum
+      {
+    private:
+      std::deque<std::pair<size_t, double> > Candidates;
+      Compare Comp;
+    public:
+      void Add(const size_t index, const double x)
+        {
+          while (!Candidates.empty() && Comp(x, Candidates.back().second))
+            Candidates.pop_back();
+          Candidates.push_back(std::make_pair(index, x));
+        }
+      void Remove(const size_t index, const double)
+        {
+          if (!Candidates.empty() && Candidates.front().first == index)
+            Candidates.pop_front();
+        }
+      double Get() const
+        {
+          return Candidates.front().second;
+        }
+      };
+
+    //! Accumulator for the maximum in a moving window
+    typedef WindowExtremum<std::greater_equal<double> > WindowMax;
+    //! Accumulator for the minimum in a moving window
+    typedef WindowExtremum<std::less_equal<double> > WindowMin;
+
+    //! Accumulator for an arbitrary percentile in a moving window, e.g. 50 for the median
+    /*! We keep the values in the window sorted, the position for inserting and removing is found by bisection.
+     * Between the values we interpolate linearly.
+     */
+    class WindowPercentile
+      {
+    private:
+      std::vector<double> Sorted;
+      double fraction;
+    public:
+      void Add(const size_t, const double x)
+        {
+          Sorted.insert(std::upper_bound(Sorted.begin(), Sorted.end(), x), x);
+        }
+      void Remove(const size_t, const double x)
+        {
+          Sorted.erase(std::lower_bound(Sorted.begin(), Sorted.end(), x));
+        }
+      double Get() const
+        {
+          const double pos = fraction * (Sorted.size() - 1);
+          const size_t index = std::min(size_t(pos), Sorted.size() - 1);
+          if (index + 1 >= Sorted.size())
+            return Sorted[index];
+          return Sorted[index] + (pos - index) * (Sorted[index + 1]
+              - Sorted[index]);
+        }
+      explicit WindowPercentile(const double percentile = 50.0) :
+        fraction(percentile / 100.0)
+        {
+          if (percentile < 0.0 || percentile > 100.0)
+            throw FatalException("Percentile has to be between 0 and 100 !");
+        }
+      };
+
+    //! Apply the accumulator Acc in a window of windowlength samples centred on each sample of the input range
+    /*! The input is read only once and the last windowlength input values are kept in a ring buffer, so the
+     * output range can be the same as the input range, i.e. the calculation can be done in place.
+     */
+    template<typename InputIterator, typename OutputIterator,
+        typename Accumulator>
+    void RunningWindow(InputIterator begin, InputIterator end,
+        OutputIterator out, const size_t windowlength, Accumulator &Acc)
+      {
+        if (windowlength == 0)
+          throw FatalException("Window length has to be at least 1 !");
+        const size_t before = (windowlength - 1) / 2;
+        const size_t after = windowlength / 2;
+        std::vector<double> Ring(windowlength);
+        //the window for the current input sample j covers the input samples low to j
+        size_t j = 0, low = 0;
+        for (InputIterator it = begin; it != end; ++it, ++j)
+          {
+            if (j >= windowlength)
+              {
+                Acc.Remove(low, Ring[low % windowlength]);
+                ++low;
+              }
+            Ring[j % windowlength] = *it;
+            Acc.Add(j, *it);
+            //output sample j - after has all its samples in the window
+            if (j >= after)
+              {
+                *out = Acc.Get();
+                ++out;
+              }
+          }
+        const size_t nsamples = j;
+        //the windows at the end are truncated, we only remove samples
+        for (size_t i = (nsamples > after ? nsamples - after : 0); i < nsamples; ++i)
+          {
+            const size_t newlow = i > before ? i - before : 0;
+            while (low < newlow)
+              {
+                Acc.Remove(low, Ring[low % windowlength]);
+                ++low;
+              }
+            *out = Acc.Get();
+            ++out;
+          }
+      }
+
+    //! Calculate the mean in a moving window centred on each sample
+    template<typename InputIterator, typename OutputIterator>
+    void RunningMean(InputIterator begin, InputIterator end,
+        OutputIterator out, const size_t windowlength)
+      {
+        WindowMean Acc;
+        RunningWindow(begin, end, out, windowlength, Acc);
+      }
+
+    //! Calculate the variance in a moving window centred on each sample
+    template<typename InputIterator, typename OutputIterator>
+    void RunningVariance(InputIterator begin, InputIterator end,
+        OutputIterator out, const size_t windowlength)
+      {
+        WindowVariance Acc;
+        RunningWindow(begin, end, out, windowlength, Acc);
+      }
+
+    //! Calculate the root mean square in a moving window centred on each sample
+    template<typename InputIterator, typename OutputIterator>
+    void RunningRMS(InputIterator begin, InputIterator end,
+        OutputIterator out, const size_t windowlength)
+      {
+        WindowRMS Acc;
+        RunningWindow(begin, end, out, windowlength, Acc);
+      }
+
+    //! Calculate the minimum in a moving window centred on each sample
+    template<typename InputIterator, typename OutputIterator>
+    void RunningMin(InputIterator begin, InputIterator end,
+        OutputIterator out, const size_t windowlength)
+      {
+        WindowMin Acc;
+        RunningWindow(begin, end, out, windowlength, Acc);
+      }
+
+    //! Calculate the maximum in a moving window centred on each sample
+    template<typename InputIterator, typename OutputIterator>
+    void RunningMax(InputIterator begin, InputIterator end,
+        OutputIterator out, const size_t windowlength)
+      {
+        WindowMax Acc;
+        RunningWindow(begin, end, out, windowlength, Acc);
+      }
+
+    //! Calculate a percentile (between 0 and 100) in a moving window centred on each sample
+    template<typename InputIterator, typename OutputIterator>
+    void RunningPercentile(InputIterator begin, InputIterator end,
+        OutputIterator out, const size_t windowlength, const double percentile)
+      {
+        WindowPercentile Acc(percentile);
+        RunningWindow(begin, end, out, windowlength, Acc);
+      }
+
+    //! Replace the data of each component by a moving window statistic, the components are processed in parallel
+    /*! ComponentType can be any type with a member GetData() that returns a reference to a std::vector<double>,
+     * e.g. TimeSeriesComponent. Each component uses a copy of Prototype as accumulator.
+     */
+    template<typename ComponentType, typename Accumulator>
+    void RunningStatistic(const std::vector<ComponentType*> &Components,
+        const size_t windowlength, const Accumulator &Prototype)
+      {
+        if (windowlength == 0)
+          throw FatalException("Window length has to be at least 1 !");
+        const int ncomponents = Components.size();
+#pragma omp parallel for default(shared) schedule(dynamic)
+        for (int i = 0; i < ncomponents; ++i)
+          {
+            Accumulator Acc(Prototype);
+            std::vector<double> &Data = Components[i]->GetData();
+            RunningWindow(Data.begin(), Data.end(), Data.begin(),
+                windowlength, Acc);
+          }
+      }
+  /* @} */
+  }
+#endif /*RUNNINGSTATS_H_*/
@@ -0,0 +1,125 @@
+#ifndef NETCDFSPECTROGRAM_H_
+#define NETCDFSPECTROGRAM_H_
+#include <netcdf.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "Spectrogram.h"
+#include "convert.h"
+#include "FatalException.h"
+
+namespace gplib
+  {
+
+    /** \addtogroup tstools Time series analysis methods */
+    /* @{ */
+
+    //! Write a spectrogram row by row to a compressed netcdf-4 file
+    /*! The legacy netcdf c++ interface we use in NetCDFTools.h can only write netcdf-3 files that have to be written
+     * in one piece, so we use the c interface here. Level 0 is stored in the variable "power" with the dimensions
+     * "time" and "frequency", each overview level k in "power_k" with the dimensions "time_k" and "frequency".
+     * The time dimensions are unlimited, so the rows can be appended as they are calculated, and the variables
+     * are chunked in blocks of rows and compressed with deflate.
+     */
+    class NetCDFSpectrogramWriter: public SpectrogramSink
+      {
+    private:
+      int ncid;
+      int deflatelevel;
+      size_t chunkrows;
+      size_t nfrequencies;
+      std::vector<int> TimeVar;
+      std::vector<int> PowerVar;
+      //! The number of rows written so far for each level
+      std::vector<size_t> NRows;
+      static void Check(const int status)
+        {
+          if (status != NC_NOERR)
+            throw FatalException(std::string("Netcdf error: ") + nc_strerror(
+                status));
+        }
+      static std::string LevelName(const std::string &name, const size_t level)
+        {
+          return level == 0 ? name : name + "_" + stringify(level);
+        }
+    public:
+      virtual void Setup(const std::vector<double> &Frequencies,
+          const size_t nlevels)
+        {
+          nfrequencies = Frequencies.size();
+          int freqdim, freqvar;
+          Check(nc_def_dim(ncid, "frequency", nfrequencies, &freqdim));
+          Check(nc_def_var(ncid, "frequency", NC_DOUBLE, 1, &freqdim, &freqvar));
+          Check(nc_put_att_text(ncid, freqvar, "units", 2, "Hz"));
+          TimeVar.resize(nlevels);
+          PowerVar.resize(nlevels);
+          NRows.assign(nlevels, 0);
+          for (size_t level = 0; level < nlevels; ++level)
+            {
+              int dims[2];
+              Check(nc_def_dim(ncid, LevelName("time", level).c_str(),
+                  NC_UNLIMITED, &dims[0]));
+              dims[1] = freqdim;
+              Check(nc_def_var(ncid, LevelName("time", level).c_str(),
+                  NC_DOUBLE, 1, &dims[0], &TimeVar[level]));
+              Check(nc_put_att_text(ncid, TimeVar[level], "units", 1, "s"));
+              Check(nc_def_var(ncid, LevelName("power", level).c_str(),
+                  NC_FLOAT, 2, dims, &PowerVar[level]));
+              const std::string description =
+                  "log10 of the mean fourier amplitude in each band";
+              Check(nc_put_att_text(ncid, PowerVar[level], "long_name",
+                  description.size(), description.c_str()));
+              size_t chunks[2] =
+                { chunkrows, std::max(nfrequencies, size_t(1)) };
+              Check(nc_def_var_chunking(ncid, PowerVar[level], NC_CHUNKED,
+                  chunks));
+              if (deflatelevel > 0)
+                Check(nc_def_var_deflate(ncid, PowerVar[level], 1, 1,
+                    deflatelevel));
+            }
+          Check(nc_enddef(ncid));
+          if (nfrequencies > 0)
+            Check(nc_put_var_double(ncid, freqvar, &Frequencies[0]));
+        }
+      virtual void AppendRows(const size_t level,
+          const std::vector<double> &Times, const std::vector<float> &Values)
+        {
+          if (Times.empty())
+            return;
+          if (Values.size() != Times.size() * nfrequencies)
+            throw FatalException("Spectrogram rows have the wrong size !");
+          size_t start[2] =
+            { NRows.at(level), 0 };
+          size_t count[2] =
+            { Times.size(), nfrequencies };
+          Check(nc_put_vara_double(ncid, TimeVar[level], start, count,
+              &Times[0]));
+          Check(nc_put_vara_float(ncid, PowerVar[level], start, count,
+              &Values[0]));
+          NRows[level] += Times.size();
+        }
+      //! Add a global attribute, e.g. the sampling rate or the start time
+      void AddAttribute(const std::string &name, const double value)
+        {
+          Check(nc_redef(ncid));
+          Check(nc_put_att_double(ncid, NC_GLOBAL, name.c_str(), NC_DOUBLE, 1,
+              &value));
+          Check(nc_enddef(ncid));
+        }
+      //! Create the file, deflate is the compression level between 0 (no compression) and 9, rows the number of rows in a chunk
+      NetCDFSpectrogramWriter(const std::string &filename, const int deflate = 4,
+          const size_t rows = 64) :
+        ncid(-1), deflatelevel(deflate), chunkrows(rows), nfrequencies(0)
+        {
+          if (deflatelevel < 0 || deflatelevel > 9 || chunkrows == 0)
+            throw FatalException("Invalid compression level or chunk size !");
+          Check(nc_create(filename.c_str(), NC_NETCDF4 | NC_CLOBBER, &ncid));
+        }
+      virtual ~NetCDFSpectrogramWriter()
+        {
+          nc_close(ncid);
+        }
+      };
+  /* @} */
+  }
+#endif /*NETCDFSPECTROGRAM_H_*/
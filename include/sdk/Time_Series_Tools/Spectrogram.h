@@ -0,0 +1,283 @@
+#ifndef SPECTROGRAM_H_
+#define SPECTROGRAM_H_
+#include <complex>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include "TsSpectrum.h"
+#include "statutils.h"
+#include "WFunc.h"
+#include "FatalException.h"
+
+namespace gplib
+  {
+
+    /** \addtogroup tstools Time series analysis methods */
+    /* @{ */
+
+    //! The frequency bands of a spectrogram, either the individual fourier coefficients or logarithmically spaced bands
+    class FrequencyBands
+      {
+    private:
+      //! The index of the first fourier coefficient for each band, the last element is the end of the last band
+      std::vector<size_t> Start;
+      std::vector<double> Frequencies;
+    public:
+      //! The number of bands
+      size_t GetNBands() const
+        {
+          return Frequencies.size();
+        }
+      //! The centre frequency of each band in Hz
+      const std::vector<double> &GetFrequencies() const
+        {
+          return Frequencies;
+        }
+      //! The index of the first fourier coefficient in band i
+      size_t GetStart(const size_t i) const
+        {
+          return Start[i];
+        }
+      //! The index behind the last fourier coefficient in band i
+      size_t GetEnd(const size_t i) const
+        {
+          return Start[i + 1];
+        }
+      //! Setup the bands for segments of seglength samples
+      /*! If perdecade is 0 each fourier coefficient except the mean forms its own band. Otherwise the frequency axis
+       * is divided into perdecade logarithmically spaced bands per decade, bands that do not contain a fourier
+       * coefficient are left out, so at low frequencies the bands are the individual coefficients.
+       */
+      FrequencyBands(const size_t seglength, const double samplerate,
+          const size_t perdecade = 0)
+        {
+          if (seglength < 2)
+            throw FatalException("Segment length has to be at least 2 !");
+          const size_t ncoeff = seglength / 2 + 1;
+          const double freqstep = samplerate / seglength;
+          if (perdecade == 0)
+            {
+              for (size_t i = 1; i < ncoeff; ++i)
+                {
+                  Start.push_back(i);
+                  Frequencies.push_back(i * freqstep);
+                }
+              Start.push_back(ncoeff);
+              return;
+            }
+          //the edges of the bands are at freqstep * 10^(k/perdecade)
+          size_t current = 1;
+          for (size_t k = 1; current < ncoeff; ++k)
+            {
+              const double upper = freqstep * std::pow(10.0, double(k)
+                  / perdecade);
+              size_t end = current;
+              while (end < ncoeff && end * freqstep < upper)
+                ++end;
+              if (end > current)
+                {
+                  Start.push_back(current);
+                  Frequencies.push_back(std::sqrt(current * freqstep * (end - 1)
+                      * freqstep));
+                  current = end;
+                }
+            }
+          Start.push_back(ncoeff);
+        }
+      };
+
+    //! The destination for the rows of a spectrogram, e.g. a file
+    /*! Level 0 contains the spectrogram itself, the higher levels are overviews with fewer rows.
+     */
+    class SpectrogramSink
+      {
+    public:
+      //! Called once before the first row with the frequencies of the bands and the number of levels including level 0
+      virtual void Setup(const std::vector<double> &Frequencies,
+          const size_t nlevels) = 0;
+      //! Append rows to a level, Values contains the values for all bands of the first row, then the second row etc.
+      virtual void AppendRows(const size_t level,
+          const std::vector<double> &Times, const std::vector<float> &Values) = 0;
+      virtual ~SpectrogramSink()
+        {
+        }
+      };
+
+    //! Calculate a spectrogram of a time series that is passed in pieces and does not have to fit into memory
+    /*! The samples are collected until a batch of segments is complete, the spectra of the segments in the batch
+     * are calculated in parallel and passed to the sink as rows in the order of the segments. Each value is
+     * the logarithm of the mean amplitude of the fourier coefficients in a frequency band. In addition to the
+     * spectrogram we can create overview levels for plotting, each row of level k is the mean of levelfactor rows of level k-1.
+     * The memory needed is independent of the length of the time series.
+     */
+    template<typename WindowFunctype = Hanning>
+    class Spectrogram
+      {
+    private:
+      size_t seglength;
+      size_t shift;
+      double samplerate;
+      FrequencyBands Bands;
+      SpectrogramSink &Sink;
+      size_t nlevels;
+      size_t levelfactor;
+      size_t batchsize;
+      WindowFunctype WFunc;
+      //! The samples that have not been processed completely
+      std::vector<double> Pending;
+      //! The index of the first sample in Pending in the whole time series
+      size_t pendingstart;
+      //! For each overview level the sum of the rows, the sum of the times and the number of rows so far
+      std::vector<std::vector<float> > LevelSum;
+      std::vector<double> LevelTime;
+      std::vector<size_t> LevelCount;
+      //! Add rows of level - 1 to the accumulator of an overview level
+      void AddToLevel(const size_t level, const std::vector<double> &Times,
+          const std::vector<float> &Values)
+        {
+          const size_t nbands = Bands.GetNBands();
+          std::vector<double> OutTimes;
+          std::vector<float> OutValues;
+          for (size_t row = 0; row < Times.size(); ++row)
+            {
+              for (size_t j = 0; j < nbands; ++j)
+                LevelSum[level][j] += Values[row * nbands + j];
+              LevelTime[level] += Times[row];
+              ++LevelCount[level];
+              if (LevelCount[level] == levelfactor)
+                FlushLevel(level, OutTimes, OutValues);
+            }
+          if (!OutTimes.empty())
+            Emit(level, OutTimes, OutValues);
+        }
+      //! Append the mean of the accumulated rows of a level to OutTimes and OutValues and reset the accumulator
+      void FlushLevel(const size_t level, std::vector<double> &OutTimes,
+          std::vector<float> &OutValues)
+        {
+          if (LevelCount[level] == 0)
+            return;
+          OutTimes.push_back(LevelTime[level] / LevelCount[level]);
+          for (size_t j = 0; j < LevelSum[level].size(); ++j)
+            OutValues.push_back(LevelSum[level][j] / LevelCount[level]);
+          std::fill(LevelSum[level].begin(), LevelSum[level].end(), 0.0f);
+          LevelTime[level] = 0.0;
+          LevelCount[level] = 0;
+        }
+      //! Pass rows to the sink and to the next overview level
+      void Emit(const size_t level, const std::vector<double> &Times,
+          const std::vector<float> &Values)
+        {
+          Sink.AppendRows(level, Times, Values);
+          if (level + 1 < nlevels)
+            AddToLevel(level + 1, Times, Values);
+        }
+      //! Calculate the spectra for nsegments segments starting at the beginning of Pending
+      void ProcessSegments(const size_t nsegments)
+        {
+          const size_t nbands = Bands.GetNBands();
+          const size_t ncoeff = seglength / 2 + 1;
+          std::vector<double> Times(nsegments);
+          std::vector<float> Values(nsegments * nbands);
+          const int nseg = nsegments;
+#pragma omp parallel default(shared)
+            {
+              TsSpectrum SpecEst(false);
+              std::vector<double> Segment(seglength);
+              std::vector<std::complex<double> > Spectrum(ncoeff);
+#pragma omp for schedule(static)
+              for (int i = 0; i < nseg; ++i)
+                {
+                  std::copy(Pending.begin() + i * shift, Pending.begin() + i
+                      * shift + seglength, Segment.begin());
+                  SubMean(Segment.begin(), Segment.end());
+                  ApplyWindow(Segment.begin(), Segment.end(), Segment.begin(),
+                      WFunc);
+                  SpecEst.CalcSpectrum(Segment.begin(), Segment.end(),
+                      Spectrum.begin(), Spectrum.end());
+                  for (size_t j = 0; j < nbands; ++j)
+                    {
+                      double amplitude = 0.0;
+                      for (size_t k = Bands.GetStart(j); k < Bands.GetEnd(j); ++k)
+                        amplitude += std::abs(Spectrum[k]);
+                      amplitude /= Bands.GetEnd(j) - Bands.GetStart(j);
+                      Values[i * nbands + j] = std::log10(amplitude);
+                    }
+                  //the time of the centre of the segment relative to the first sample
+                  Times[i] = (pendingstart + i * shift + 0.5 * (seglength - 1))
+                      / samplerate;
+                }
+            }
+          Emit(0, Times, Values);
+          Pending.erase(Pending.begin(), Pending.begin() + nsegments * shift);
+          pendingstart += nsegments * shift;
+        }
+      //! The number of complete segments in Pending
+      size_t AvailableSegments() const
+        {
+          return Pending.size() < seglength ? 0 : (Pending.size() - seglength)
+              / shift + 1;
+        }
+    public:
+      //! The frequency bands of the spectrogram
+      const FrequencyBands &GetBands() const
+        {
+          return Bands;
+        }
+      //! Add the samples between begin and end to the time series and process all complete batches of segments
+      template<typename InputIterator>
+      void Add(InputIterator begin, InputIterator end)
+        {
+          Pending.insert(Pending.end(), begin, end);
+          while (AvailableSegments() >= batchsize)
+            ProcessSegments(batchsize);
+        }
+      //! Process the remaining complete segments and write the incomplete rows of the overview levels
+      /*! An incomplete segment at the end of the time series is discarded as in TimeFrequency.
+       */
+      void Finish()
+        {
+          const size_t nsegments = AvailableSegments();
+          if (nsegments > 0)
+            ProcessSegments(nsegments);
+          for (size_t level = 1; level < nlevels; ++level)
+            {
+              std::vector<double> OutTimes;
+              std::vector<float> OutValues;
+              FlushLevel(level, OutTimes, OutValues);
+              if (!OutTimes.empty())
+                Emit(level, OutTimes, OutValues);
+            }
+        }
+      //! Setup the spectrogram
+      /*! \param length The length of each segment in samples
+       *  \param segshift The shift between consecutive segments in samples, length gives segments without overlap
+       *  \param rate The sampling rate in Hz
+       *  \param OutSink The destination for the rows
+       *  \param perdecade The number of logarithmic frequency bands per decade, 0 gives the individual fourier coefficients
+       *  \param overviews The number of overview levels in addition to the spectrogram itself
+       *  \param factor The number of rows that are averaged for each row of the next overview level
+       *  \param batch The number of segments that are processed in parallel
+       */
+      Spectrogram(const size_t length, const size_t segshift, const double rate,
+          SpectrogramSink &OutSink, const size_t perdecade = 0,
+          const size_t overviews = 0, const size_t factor = 8,
+          const size_t batch = 256, WindowFunctype Window = WindowFunctype()) :
+        seglength(length), shift(segshift), samplerate(rate), Bands(length,
+            rate, perdecade), Sink(OutSink), nlevels(overviews + 1),
+            levelfactor(factor), batchsize(batch), WFunc(Window), pendingstart(
+                0), LevelSum(nlevels, std::vector<float>(Bands.GetNBands(),
+                0.0f)), LevelTime(nlevels, 0.0), LevelCount(nlevels, 0)
+        {
+          if (shift == 0 || batchsize == 0 || levelfactor < 2)
+            throw FatalException(
+                "Segment shift and batch size have to be > 0 and the overview factor > 1 !");
+          Sink.Setup(Bands.GetFrequencies(), nlevels);
+        }
+      virtual ~Spectrogram()
+        {
+        }
+      };
+  /* @} */
+  }
+#endif /*SPECTROGRAM_H_*/
@@ -17,8 +17,9 @@ namespace gplib
 
     //! The class CTsSpectrum is used to calculate spectra from (real) time series data
     /*! CTsSpectrum is basically a wrapper for the fftw3 functionality for real data
-     * it manages both the plans and the local data needed by fftw3. This class is not
-     * thread-safe. DO NOT use it within an openmp parallelized loop or any kind of threaded program.
+     * it manages both the plans and the local data needed by fftw3. A single object is not
+     * thread-safe. DO NOT share an object between the threads of an openmp parallelized loop.
+     * The creation and destruction of plans is serialized, so each thread can use its own object.
      */
     class TsSpectrum
       {
@@ -45,20 +46,23 @@ namespace gplib
         if (size != oldsize) // if the size changed
           {
             AssignMem(size); //reassign memory
-
-            if (MultiCalc) // generate a new plan
-              {
-                p_reverse = fftw_plan_dft_c2r_1d(size, freqdomain, timedomain,
-                    FFTW_MEASURE);
-                p_forward = fftw_plan_dft_r2c_1d(size, timedomain, freqdomain,
-                    FFTW_MEASURE);
-              }
-            else
+            //the fftw planner is not thread-safe
+#pragma omp critical(fftw_planner)
               {
-                p_reverse = fftw_plan_dft_c2r_1d(size, freqdomain, timedomain,
-                    FFTW_ESTIMATE);
-                p_forward = fftw_plan_dft_r2c_1d(size, timedomain, freqdomain,
-                    FFTW_ESTIMATE);
+                if (MultiCalc) // generate a new plan
+                  {
+                    p_reverse = fftw_plan_dft_c2r_1d(size, freqdomain,
+                        timedomain, FFTW_MEASURE);
+                    p_forward = fftw_plan_dft_r2c_1d(size, timedomain,
+                        freqdomain, FFTW_MEASURE);
+                  }
+                else
+                  {
+                    p_reverse = fftw_plan_dft_c2r_1d(size, freqdomain,
+                        timedomain, FFTW_ESTIMATE);
+                    p_forward = fftw_plan_dft_r2c_1d(size, timedomain,
+                        freqdomain, FFTW_ESTIMATE);
+                  }
               }
             ExistsPlanReverse = true; // we will have to deallocate at some point
             ExistsPlanForward = true;
@@ -83,10 +87,13 @@ namespace gplib
       {
         if (ExistsPlanForward || ExistsPlanReverse) // if we did some calculations before
           {
-            if (ExistsPlanForward)
-              fftw_destroy_plan(p_forward); // we destroy the old plans
-            if (ExistsPlanReverse)
-              fftw_destroy_plan(p_reverse);
+#pragma omp critical(fftw_planner)
+              {
+                if (ExistsPlanForward)
+                  fftw_destroy_plan(p_forward); // we destroy the old plans
+                if (ExistsPlanReverse)
+                  fftw_destroy_plan(p_reverse);
+              }
             fftw_free(timedomain); // and free the memory allocated
             fftw_free(freqdomain);
             ExistsPlanForward = false; // now there is no plan anymore, so we don't double deallocate
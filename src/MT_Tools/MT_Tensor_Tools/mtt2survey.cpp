@@ -0,0 +1,74 @@
+#include <iostream>
+#include <string>
+#include "MTStationList.h"
+#include "MTSurvey.h"
+#include "Util.h"
+
+using namespace std;
+using namespace gplib;
+
+/*!
+ * \addtogroup UtilProgs Utility Programs
+ *@{
+ * \file mtt2survey.cpp
+ * Convert a list of MT data files in any of the supported formats into a single binary survey file and back.
+ * Binary survey files are memory mapped when reading, so repeated processing of the same survey does
+ * not have to parse the individual text files again.
+ */
+
+int main(int argc, char* argv[])
+  {
+    string version = "$Id: mtt2survey.cpp $";
+    cout << endl << endl;
+    cout << "Program " << version << endl;
+    cout << " Convert a station list file with MT data in .mtt .j .edi etc. format" << endl;
+    cout << " into a binary survey file with ending " << MTSurveyEnding << endl;
+    cout << " If the input is a survey file, each station is written as a .mtt file" << endl;
+    cout << endl << endl;
+
+    try
+      {
+        string infilename, outfilename;
+        if (argc > 1)
+          {
+            infilename = argv[1];
+          }
+        else
+          {
+            infilename = AskFilename("Input Filename: ");
+          }
+
+        MTStationList MTSites;
+        MTSites.GetData(infilename);
+        const size_t nsites = MTSites.GetList().size();
+        if (boost::filesystem::extension(infilename) == MTSurveyEnding)
+          {
+            for (size_t i = 0; i < nsites; ++i)
+              {
+                cout << "Writing site " << MTSites.at(i).GetName() << endl;
+                MTSites.at(i).WriteAsMtt(MTSites.at(i).GetName());
+              }
+            MTSites.WriteList();
+          }
+        else
+          {
+            if (argc > 2)
+              {
+                outfilename = argv[2];
+              }
+            else
+              {
+                outfilename = AskFilename("Output Filename: ");
+              }
+            if (boost::filesystem::extension(outfilename) != MTSurveyEnding)
+              outfilename += MTSurveyEnding;
+            MTSites.WriteSurvey(outfilename);
+            cout << "Wrote " << nsites << " sites to " << outfilename << endl;
+          }
+      } catch (FatalException &e)
+      {
+        cerr << e.what() << endl;
+        return -1;
+      }
+  }
+/*@}*/
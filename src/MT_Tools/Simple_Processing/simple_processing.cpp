@@ -1,6 +1,7 @@
 #include <iostream>
 #include <iterator>
 #include <fstream>
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include "TsSpectrum.h"
 #include "TimeSeriesData.h"
@@ -12,6 +13,7 @@
 #include "VecMat.h"
 #include "MtuFilter.h"
 #include "Util.h"
+#include "TsQualityControl.h"
 
 using namespace std;
 using namespace gplib;
@@ -44,6 +46,7 @@ int main(int argc, char *argv[])
     string infilename, basefilename;
     unsigned int seglength = 2400;
     bool mtufilter = false;
+    bool useqc = false;
     double rate = 1.0;
     po::options_description desc("Allowed options");
     desc.add_options()("help", "produce help message")("seglength", po::value<
@@ -52,7 +55,10 @@ int main(int argc, char *argv[])
         "rate", po::value(&rate)->default_value(1.0),
         "Set the sampling rate in Hz")("mtufilter",
         po::value<bool>(&mtufilter)->default_value(false),
-        "Read in filter information for mtu data")("input-file", po::value<
+        "Read in filter information for mtu data")("qc",
+        po::value<bool>(&useqc)->default_value(false),
+        "Skip segments that are marked as bad in the quality control index created by mtuqc")(
+        "input-file", po::value<
         string>(&infilename), "input file");
 
     po::positional_options_description p;
@@ -70,6 +76,7 @@ int main(int argc, char *argv[])
         return 1;
       }
     MtuData.GetData(infilename.c_str());
+    const string qcname = TsQcIndex::IndexName(infilename);
     size_t dotpos = infilename.find('.', 0);
     if (dotpos != string::npos)
       basefilename = infilename.erase(dotpos);
@@ -122,11 +129,23 @@ int main(int argc, char *argv[])
         MtuData.GetData().GetHy().GetData().end(), seglength, Hanning());
 
     const unsigned int nsegs = ExTimeFrequency.size1();
+    std::vector<bool> GoodSegment(nsegs, true);
+    if (useqc)
+      {
+        TsQcIndex QcIndex;
+        QcIndex.ReadIndex(qcname);
+        GoodSegment = QcIndex.GoodSegments(seglength, nsegs);
+        cout << "Using "
+            << std::count(GoodSegment.begin(), GoodSegment.end(), true)
+            << " of " << nsegs << " segments." << endl;
+      }
     ofstream logfile((infilename + ".log").c_str());
     for (size_t i = 0; i < Zxx.size(); ++i)
       {
         for (size_t j = 0; j < nsegs; ++j)
           {
+            if (!GoodSegment[j])
+              continue;
             if (mtufilter)
               {
                 ExTimeFrequency(j, i) /= ExFilter.GetFilterCoeff().at(i);
@@ -1,94 +1,133 @@
-#include <iostream>
-#include <string>
-#include <numeric>
-#include "statutils.h"
-#include "TimeSeriesData.h"
-#include <rapidjson/document.h>
-
-using namespace rapidjson;
-using namespace std;
-using namespace gplib;
-
-string version = "$Id: ";
-
-int main(int argc, char *argv[])
-  {
-    string infilename;
-    size_t seglength = 0;
-    if (argc == 2)
-      {
-        Document opt;
-               char* buffer = argv[1];
-               if(opt.Parse(buffer).HasParseError())
-               {
-                   FILE *fp = fopen(argv[1], "rb");
-                   if (!fp)
-                   {
-                       printf("file '%s' not found\n", argv[1]);
-                       return -1;
-                   }
-                   fseek(fp, 0, SEEK_END);
-                   size_t filesize = (size_t)ftell(fp);
-                   fseek(fp, 0, SEEK_SET);
-                   buffer = (char*)malloc(filesize + 1);
-                   size_t readLength = fread(buffer, 1, filesize, fp);
-                   buffer[readLength] = '\0';
-                   fclose(fp);
-
-                   opt.Parse(buffer);
-               }
-
-               {
-                   printf("Input JSON is valid.\n");
-                   printf("\nAccess values in document:\n");
-                   assert(opt.IsObject());   // Document is a JSON value represents the root of DOM. Root can be either an object or array.
-
-                   assert(opt.HasMember("infilename"));
-                   assert(opt["infilename"].IsString());
-                   infilename = opt["infilename"].GetString();
-
-                   assert(opt["seglength"].IsInt());
-                   seglength = opt["seglength"].GetInt();
-               }
-               free(buffer);      // 释放json内存
-      }
-    else
-      {
-        cout
-            << "This is mtumedian: Apply a median filter to  Phoenix time series"
-            << endl << endl;
-        cout << " Usage:      mtumedian infilename " << endl;
-        cout << " Ending '.med'  will be automatically assigned to outfilename"
-            << endl << endl;
-        cout << " This is Version: " << version << endl << endl;
-        cout << " Mtu-Filename: ";
-        cin >> infilename;
-
-        cout << "Segment length for Median: ";
-        cin >> seglength;
-      }
-
-
-    TimeSeriesData Data;
-
-    Data.GetData(infilename);
-    size_t datalength = Data.GetData().GetEx().GetData().size();
-    for (size_t i = seglength / 2; i < datalength - seglength / 2; ++i)
-      {
-        const size_t startindex = i - seglength / 2;
-        const size_t endindex = i + seglength / 2;
-        Data.GetData().GetEx().GetData().at(i) = Median(
-            Data.GetData().GetEx().GetData().begin() + startindex,
-            Data.GetData().GetEx().GetData().begin() + endindex);
-        Data.GetData().GetEx().GetData().at(i) = Median(
-            Data.GetData().GetEy().GetData().begin() + startindex,
-            Data.GetData().GetEy().GetData().begin() + endindex);
-        Data.GetData().GetEx().GetData().at(i) = Median(
-            Data.GetData().GetHx().GetData().begin() + startindex,
-            Data.GetData().GetHx().GetData().begin() + endindex);
-        Data.GetData().GetEx().GetData().at(i) = Median(
-            Data.GetData().GetHy().GetData().begin() + startindex,
-            Data.GetData().GetHy().GetData().begin() + endindex);
-      }
-    Data.WriteAsMtu(infilename + ".med");
-  }
+#include <iostream>
+#include <string>
+#include <numeric>
+#include "statutils.h"
+#include "RunningStats.h"
+#include "TimeSeriesData.h"
+#include <rapidjson/document.h>
+
+using namespace rapidjson;
+using namespace std;
+using namespace gplib;
+
+string version = "$Id: ";
+
+/*!
+ * \addtogroup UtilProgs Utility Programs
+ *@{
+ * \file
+ * Apply a running median filter to all components of a Phoenix time series. If a threshold
+ * is given, only spikes are replaced by the median, i.e. samples that deviate from the median by more
+ * than threshold times a robust estimate of the standard deviation from the interquartile range.
+ */
+
+int main(int argc, char *argv[])
+  {
+    string infilename;
+    size_t seglength = 0;
+    double threshold = 0.0;
+    if (argc == 2)
+      {
+        Document opt;
+               char* buffer = argv[1];
+               if(opt.Parse(buffer).HasParseError())
+               {
+                   FILE *fp = fopen(argv[1], "rb");
+                   if (!fp)
+                   {
+                       printf("file '%s' not found\n", argv[1]);
+                       return -1;
+                   }
+                   fseek(fp, 0, SEEK_END);
+                   size_t filesize = (size_t)ftell(fp);
+                   fseek(fp, 0, SEEK_SET);
+                   buffer = (char*)malloc(filesize + 1);
+                   size_t readLength = fread(buffer, 1, filesize, fp);
+                   buffer[readLength] = '\0';
+                   fclose(fp);
+
+                   opt.Parse(buffer);
+               }
+
+               {
+                   printf("Input JSON is valid.\n");
+                   printf("\nAccess values in document:\n");
+                   assert(opt.IsObject());   // Document is a JSON value represents the root of DOM. Root can be either an object or array.
+
+                   assert(opt.HasMember("infilename"));
+                   assert(opt["infilename"].IsString());
+                   infilename = opt["infilename"].GetString();
+
+                   assert(opt["seglength"].IsInt());
+                   seglength = opt["seglength"].GetInt();
+
+                   if (opt.HasMember("threshold"))
+                     threshold = opt["threshold"].GetDouble();
+               }
+               free(buffer);      // 释放json内存
+      }
+    else
+      {
+        cout
+            << "This is mtumedian: Apply a median filter to  Phoenix time series"
+            << endl << endl;
+        cout << " Usage:      mtumedian infilename " << endl;
+        cout << " Ending '.med'  will be automatically assigned to outfilename"
+            << endl << endl;
+        cout << " This is Version: " << version << endl << endl;
+        cout << " Mtu-Filename: ";
+        cin >> infilename;
+
+        cout << "Segment length for Median: ";
+        cin >> seglength;
+
+        cout << "Spike threshold (0 for median filter): ";
+        cin >> threshold;
+      }
+
+
+    TimeSeriesData Data;
+
+    if (seglength == 0)
+      {
+        cout << "Segment length has to be at least 1 !" << endl;
+        return -1;
+      }
+    Data.GetData(infilename);
+    std::vector<TimeSeriesComponent*> Components;
+    Components.push_back(&Data.GetData().GetEx());
+    Components.push_back(&Data.GetData().GetEy());
+    Components.push_back(&Data.GetData().GetHx());
+    Components.push_back(&Data.GetData().GetHy());
+    Components.push_back(&Data.GetData().GetHz());
+    if (threshold <= 0.0)
+      {
+        RunningStatistic(Components, seglength, WindowPercentile(50.0));
+      }
+    else
+      {
+        //the quartiles give a robust estimate of the spread that is not affected by the spikes
+        const int ncomponents = Components.size();
+#pragma omp parallel for default(shared)
+        for (int i = 0; i < ncomponents; ++i)
+          {
+            std::vector<double> &Values = Components[i]->GetData();
+            std::vector<double> Medians(Values.size()), Lower(Values.size()), Upper(
+                Values.size());
+            RunningPercentile(Values.begin(), Values.end(), Medians.begin(),
+                seglength, 50.0);
+            RunningPercentile(Values.begin(), Values.end(), Lower.begin(),
+                seglength, 25.0);
+            RunningPercentile(Values.begin(), Values.end(), Upper.begin(),
+                seglength, 75.0);
+            for (size_t j = 0; j < Values.size(); ++j)
+              {
+                const double sigma = (Upper[j] - Lower[j]) / 1.349;
+                if (std::abs(Values[j] - Medians[j]) > threshold * sigma)
+                  Values[j] = Medians[j];
+              }
+          }
+      }
+    Data.WriteAsMtu(infilename + ".med");
+  }
+/*@}*/
@@ -0,0 +1,161 @@
+//============================================================================
+// Name        : mtuica.cpp
+// Version     :
+// Copyright   : 2010, mmoorkamp
+//============================================================================
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+#include "Util.h"
+#include "TimeSeriesData.h"
+#include "WindowedICA.h"
+#include "FatalException.h"
+#include "rapidjson/document.h"
+
+using namespace std;
+using namespace gplib;
+using namespace rapidjson;
+
+/*!
+ * \addtogroup UtilProgs Utility Programs
+ *@{
+ * \file mtuica.cpp
+ * Separate the synchronized recordings of several sites into independent components, e.g.
+ * to isolate a common noise source. The separation is done in overlapping time windows
+ * either with FastICA in the time domain or with ComplexICA for each frequency. Each
+ * independent component is written as a single column ascii file.
+ */
+
+string version = "$Id: mtuica.cpp 1 2010-06-01 12:00:00Z mmoorkamp $";
+
+//! Return the component of Data with the name compname
+TimeSeriesComponent &SelectComponent(TimeSeriesData &Data,
+    const string &compname)
+  {
+    if (compname == "Ex")
+      return Data.GetData().GetEx();
+    if (compname == "Ey")
+      return Data.GetData().GetEy();
+    if (compname == "Hx")
+      return Data.GetData().GetHx();
+    if (compname == "Hy")
+      return Data.GetData().GetHy();
+    if (compname == "Hz")
+      return Data.GetData().GetHz();
+    throw FatalException("Unknown component: " + compname);
+  }
+
+int main(int argc, char *argv[])
+  {
+    try
+      {
+        cout
+            << "This is mtuica: Separate synchronized time series into independent components"
+            << endl << endl;
+        cout << " Usage: mtuica options.json " << endl;
+        cout
+            << " The json file contains the list of synchronized sites in \"Input\" and the components to use in \"Components\". "
+            << endl;
+        cout << " This is Version: " << version << endl << endl;
+
+        string optionname;
+        if (argc == 2)
+          optionname = argv[1];
+        else
+          optionname = AskFilename("Option file: ");
+
+        Document opt;
+        char *buffer = argv[argc - 1];
+        bool ownbuffer = false;
+        if (argc != 2 || opt.Parse(buffer).HasParseError())
+          {
+            FILE *fp = fopen(optionname.c_str(), "r");
+            if (!fp)
+              {
+                printf("file '%s' not found\n", optionname.c_str());
+                return -1;
+              }
+            fseek(fp, 0, SEEK_END);
+            size_t filesize = (size_t) ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+            buffer = (char*) malloc(filesize + 1);
+            size_t readLength = fread(buffer, 1, filesize, fp);
+            buffer[readLength] = '\0';
+            fclose(fp);
+            ownbuffer = true;
+            if (opt.Parse(buffer).HasParseError())
+              {
+                free(buffer);
+                throw FatalException("Invalid json in file: " + optionname);
+              }
+          }
+        if (!opt.HasMember("Input") || !opt["Input"].IsArray()
+            || !opt.HasMember("Components") || !opt["Components"].IsArray())
+          throw FatalException("Need arrays \"Input\" and \"Components\" !");
+        vector<string> Filenames, Components;
+        for (SizeType i = 0; i < opt["Input"].Size(); ++i)
+          Filenames.push_back(opt["Input"][i].GetString());
+        for (SizeType i = 0; i < opt["Components"].Size(); ++i)
+          Components.push_back(opt["Components"][i].GetString());
+        const string method = opt.HasMember("method") ? opt["method"].GetString()
+            : "time";
+        const size_t windowlength = opt["windowlength"].GetInt();
+        const size_t windowshift = opt.HasMember("windowshift")
+            ? opt["windowshift"].GetInt() : windowlength / 2;
+        const size_t ncomponents = opt.HasMember("ncomponents")
+            ? opt["ncomponents"].GetInt() : 0;
+        const size_t reference = opt.HasMember("reference")
+            ? opt["reference"].GetInt() : 0;
+        const string outname = opt.HasMember("output")
+            ? opt["output"].GetString() : "ica";
+        if (ownbuffer)
+          free(buffer);
+
+        vector<TimeSeriesData> Sites(Filenames.size());
+        vector<const TimeSeriesComponent*> Input;
+        for (size_t i = 0; i < Filenames.size(); ++i)
+          {
+            Sites[i].GetData(Filenames[i]);
+            for (size_t j = 0; j < Components.size(); ++j)
+              Input.push_back(&SelectComponent(Sites[i], Components[j]));
+          }
+
+        cout << "Separating " << Input.size() << " channels ..." << endl;
+        vector<TimeSeriesComponent> Sources;
+        if (method == "time")
+          {
+            WindowedICA ICA(windowlength, windowshift, ncomponents);
+            ICA.Separate(Input, Sources);
+          }
+        else if (method == "spectral")
+          {
+            SpectralICA ICA(windowlength, windowshift, ncomponents, reference);
+            ICA.Separate(Input, Sources);
+          }
+        else
+          throw FatalException("Unknown method: " + method);
+
+        for (size_t i = 0; i < Sources.size(); ++i)
+          {
+            ofstream outfile((outname + "." + Sources[i].GetName()).c_str());
+            copy(Sources[i].GetData().begin(), Sources[i].GetData().end(),
+                ostream_iterator<double> (outfile, "\n"));
+          }
+        cout << "Wrote " << Sources.size() << " components." << endl;
+      } catch (FatalException& fataException)
+      {
+        printf("%s", fataException.what());
+      } catch (...)
+      {
+        printf("\nCaught unknown exception\n");
+      }
+
+    system("pause");
+    return 0;
+  }
+/*@}*/
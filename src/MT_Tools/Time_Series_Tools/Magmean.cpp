@@ -3,13 +3,20 @@
  *@{
  * \file
  * This program calculates the mean magnetic time series for several MT sites. The user has to input the number of sites and the
- * filename for each site. The program then writes a file 'magmean.out' in birrp ascii format that contains the average Hx,Hy and Hz for the input sites.
+ * filename for each site, or give a json file with the list of sites in "Input". The sites are read chunk by chunk and aligned by
+ * their time stamps, so the memory does not depend on the length of the recordings. For each sample the mean or the median
+ * of Hx, Hy and Hz over all sites is calculated. The output is either a binary file with the three averaged channels
+ * or, as before, a file in birrp ascii format with Ex and Ey of the first site and the averaged magnetic channels.
  */
 
 #include <iostream>
+#include <fstream>
+#include <iomanip>
 #include <string>
 #include <vector>
-#include "TimeSeriesData.h"
+#include <cstdio>
+#include <cstdlib>
+#include "MultiSiteStream.h"
 #include "Util.h"
 #include "convert.h"
 #include "rapidjson/document.h"
@@ -20,120 +27,143 @@ using namespace rapidjson;
 
 string version = "$Id: magmean.cpp 1816 2009-09-07 11:28:35Z mmoorkamp $";
 
-/*
-     nfiles : ?
-     ar :
-
-*/
-
 int main(int argc, char *argv[])
   {
-    string infilename, outfilename;
-    vector<TimeSeriesData> Sites;
-    std::string prompt;
-
-    unsigned int nfiles = 0;
-try{
-        if(argc != 2)
-        {
-    cout
-        << "This is magmean: Calculate the mean magnetic time series from several stations"
-        << endl<< endl;
-    cout << "Usage: magmean" << endl;
-    cout << "There are no command line arguments, only interactive mode"
-        << endl<< endl;
-    cout << "This is Version: " << version << endl << endl;
-    cout << "How many stations: ";
-    cin >> nfiles;
-
-    for (unsigned int i = 0; i < nfiles; ++i)
+    string outfilename = "magmean.out";
+    string method = "mean";
+    string format = "birrp";
+    size_t chunksize = 65536;
+    vector<string> Filenames;
+    try
       {
-
-        std::string prompt = "Site File " + stringify(i+1) + " :";
-        TimeSeriesData CurrSite;
-        infilename = AskFilename(prompt);
-        CurrSite.GetData(infilename);
-        Sites.push_back(CurrSite);
-      }
-        }
+        cout
+            << "This is magmean: Calculate the mean magnetic time series from several stations"
+            << endl << endl;
+        cout << "Usage: magmean [options.json]" << endl;
+        cout << "Without arguments the program runs in interactive mode"
+            << endl << endl;
+        cout << "This is Version: " << version << endl << endl;
+        if (argc != 2)
+          {
+            unsigned int nfiles = 0;
+            cout << "How many stations: ";
+            cin >> nfiles;
+            for (unsigned int i = 0; i < nfiles; ++i)
+              Filenames.push_back(AskFilename("Site File " + stringify(i + 1)
+                  + " :"));
+            outfilename = AskFilename("Output file: ");
+          }
         else
-        {
+          {
             Document opt;
-                        char* buffer = argv[1];
-                        if(opt.Parse(buffer).HasParseError())
-                        {
-                            FILE *fp = fopen(argv[1], "r");
-                            if (!fp) {
-                                printf("file '%s' not found\n", argv[1]);
-                                return -1;
-                            }
-
-                            fseek(fp, 0, SEEK_END);
-                            size_t filesize = (size_t)ftell(fp);
-                            fseek(fp, 0, SEEK_SET);
-                            buffer = (char*)malloc(filesize + 1);
-                            size_t readLength = fread(buffer, 1, filesize, fp);
-                            buffer[readLength] = '\0';
-                            fclose(fp);
-
-                            opt.Parse(buffer);
-
-                        }
-
-                        {
-                            printf("Input JSON is valid.\n");
-                                            printf("\nAccess values in document:\n");
-                                            assert(opt.IsObject());   // Document is a JSON value represents the root of DOM. Root can be either an object or array.
-
-
-
-                                            assert(opt.HasMember("outfilename"));
-                                            assert(opt["outfilename"].IsString());
-                                            outfilename = opt["outfilename"].GetString();
-
-                                            const Value& a = opt["arr"];
-                                            assert(a.IsArray());
-
-                        for (unsigned int i = 0; i < nfiles; ++i)
-                          {
-                            prompt = "Site File " + stringify(i+1) + a[i].GetString();
-                            TimeSeriesData CurrSite;
-                            infilename = AskFilename(prompt);
-                            CurrSite.GetData(infilename);
-                            Sites.push_back(CurrSite);
-                          }
-                        }
-        }
-
-    cout << "Calculating mean ... " << endl;
-
-    for (unsigned int i = 1; i < nfiles; ++i)
+            char* buffer = argv[1];
+            bool ownbuffer = false;
+            if (opt.Parse(buffer).HasParseError())
+              {
+                FILE *fp = fopen(argv[1], "r");
+                if (!fp)
+                  {
+                    printf("file '%s' not found\n", argv[1]);
+                    return -1;
+                  }
+                fseek(fp, 0, SEEK_END);
+                size_t filesize = (size_t) ftell(fp);
+                fseek(fp, 0, SEEK_SET);
+                buffer = (char*) malloc(filesize + 1);
+                size_t readLength = fread(buffer, 1, filesize, fp);
+                buffer[readLength] = '\0';
+                fclose(fp);
+                ownbuffer = true;
+                if (opt.Parse(buffer).HasParseError())
+                  {
+                    free(buffer);
+                    throw FatalException("Invalid json in file: "
+                        + string(argv[1]));
+                  }
+              }
+            if (!opt.HasMember("Input") || !opt["Input"].IsArray())
+              throw FatalException("Need array \"Input\" with the site files !");
+            for (SizeType i = 0; i < opt["Input"].Size(); ++i)
+              Filenames.push_back(opt["Input"][i].GetString());
+            if (opt.HasMember("outfilename"))
+              outfilename = opt["outfilename"].GetString();
+            if (opt.HasMember("method"))
+              method = opt["method"].GetString();
+            if (opt.HasMember("format"))
+              format = opt["format"].GetString();
+            if (opt.HasMember("chunksize"))
+              chunksize = opt["chunksize"].GetInt();
+            if (ownbuffer)
+              free(buffer);
+          }
+        if (method != "mean" && method != "median")
+          throw FatalException("Unknown method: " + method);
+        if (format != "birrp" && format != "binary")
+          throw FatalException("Unknown output format: " + format);
+
+        MultiSiteStream Stream(Filenames, chunksize);
+        cout << "Calculating " << method << " of " << Stream.GetNSites()
+            << " sites ... " << endl;
+        ofstream birrpfile;
+        boost::shared_ptr<BinaryTsWriter> BinaryFile;
+        if (format == "binary")
+          BinaryFile.reset(new BinaryTsWriter(outfilename, 3,
+              Stream.GetSamplerate(), Stream.GetTime()));
+        else
+          {
+            birrpfile.open(outfilename.c_str());
+            birrpfile.precision(8);
+          }
+        //the averaged Hx, Hy and Hz for one chunk
+        vector<double> Mean(3 * chunksize);
+        vector<const double *> Values(Stream.GetNSites());
+        size_t nsamples = 0, total = 0;
+        while ((nsamples = Stream.ReadChunk()) > 0)
+          {
+            for (size_t c = 0; c < 3; ++c)
+              {
+                //the magnetic channels are channel 2 to 4
+                for (size_t s = 0; s < Values.size(); ++s)
+                  Values[s] = Stream.GetChannel(s, c + 2);
+                if (method == "mean")
+                  SiteMean(Values, nsamples, &Mean[c * chunksize]);
+                else
+                  SiteMedian(Values, nsamples, &Mean[c * chunksize]);
+              }
+            if (BinaryFile)
+              {
+                vector<const double *> Channels;
+                for (size_t c = 0; c < 3; ++c)
+                  Channels.push_back(&Mean[c * chunksize]);
+                BinaryFile->Write(Channels, nsamples);
+              }
+            else
+              {
+                const double *ex = Stream.GetChannel(0, 0);
+                const double *ey = Stream.GetChannel(0, 1);
+                for (size_t i = 0; i < nsamples; ++i)
+                  {
+                    birrpfile << setw(20) << ex[i] << " ";
+                    birrpfile << setw(20) << ey[i] << " ";
+                    birrpfile << setw(20) << Mean[i] << " ";
+                    birrpfile << setw(20) << Mean[chunksize + i] << " ";
+                    birrpfile << setw(20) << Mean[2 * chunksize + i] << "\n";
+                  }
+              }
+            total += nsamples;
+          }
+        cout << "Wrote " << total << " samples to " << outfilename << endl;
+        cout << "... done " << endl;
+      } catch (FatalException& fataException)
       {
-        Sites.at(0).GetData().GetHx() += Sites.at(i).GetData().GetHx();
-        Sites.at(0).GetData().GetHy() += Sites.at(i).GetData().GetHy();
-        Sites.at(0).GetData().GetHz() += Sites.at(i).GetData().GetHz();
+        printf("%s", fataException.what());
+      } catch (...)
+      {
+        printf("\nCaught unknown exception\n");
       }
-    Sites.at(0).GetData().GetHx() *= 1./nfiles;
-    Sites.at(0).GetData().GetHy() *= 1./nfiles;
-    Sites.at(0).GetData().GetHz() *= 1./nfiles;
-    Sites.at(0).WriteAsBirrp("outfilename");
-    cout << "... done " << endl;
-    }
-
-
-    catch( FatalException& fataException )
-        {
-            printf( "%s", fataException.what());
-        }
-        catch ( ... )
-        {
-            printf( "\nCaught unknown exception\n" );
-        }
-
-        cout << "End" << endl;
-        system("pause");
-        return 0;
 
+    cout << "End" << endl;
+    system("pause");
+    return 0;
   }
 /*@}*/
-
@@ -1,17 +1,19 @@
 //============================================================================
 // Name        : generatemtts.cpp
 // Author      : May 7, 2010
-// Version     : 
+// Version     :
 // Copyright   : 2010, mmoorkamp
 //============================================================================
 
 #include "rapidjson/document.h"
 #include "Util.h"
 #include "TimeSeriesData.h"
-#include "TsSpectrum.h"
-#include "WFunc.h"
-#include "statutils.h"
+#include "MTSynthFilter.h"
 #include "C1DMTSynthData.h"
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <boost/shared_ptr.hpp>
 
 using namespace gplib;
 using namespace std;
@@ -21,17 +23,83 @@ using namespace rapidjson;
  * \addtogroup UtilProgs Utility Programs
  *@{
  * \file generatemtts.cpp
- * Generate a synthetic MT times series from a recorded magnetic field
- * and a 1D model.
+ * Generate synthetic MT times series from a recorded magnetic field
+ * and one or more 1D models. The impedance of each model is only calculated on a
+ * sparse logarithmic frequency grid and converted to a short filter that is applied
+ * to the magnetic field in chunks, so the length of the time series is only limited
+ * by the disk space. Birrp ascii files are read and written chunk by chunk, other
+ * formats are read completely before filtering.
  */
 
 string version =
     "$Id: generatemtts.cpp 1852 2010-05-20 09:14:53Z mmoorkamp $";
 
+//! The magnetic field of a chunk of the input time series
+struct HChunk
+  {
+  trealdata Hx, Hy, Hz;
+  };
+
+//! Read the magnetic field of up to chunksize samples from a birrp ascii file, returns false at the end of the file
+bool ReadBirrpChunk(std::ifstream &infile, const size_t chunksize,
+    HChunk &Chunk)
+  {
+    Chunk.Hx.clear();
+    Chunk.Hy.clear();
+    Chunk.Hz.clear();
+    double currex, currey, currhx, currhy, currhz;
+    while (Chunk.Hx.size() < chunksize && infile >> currex >> currey >> currhx
+        >> currhy >> currhz)
+      {
+        Chunk.Hx.push_back(currhx);
+        Chunk.Hy.push_back(currhy);
+        Chunk.Hz.push_back(currhz);
+      }
+    return !Chunk.Hx.empty();
+  }
+
+//! Copy the next chunk of the magnetic field from a completely read time series, returns false at the end
+bool CopyChunk(TimeSeries &Data, const size_t start, const size_t chunksize,
+    HChunk &Chunk)
+  {
+    const size_t nsamples = Data.GetHx().GetData().size();
+    const size_t end = std::min(start + chunksize, nsamples);
+    if (start >= end)
+      return false;
+    Chunk.Hx.assign(Data.GetHx().GetData().begin() + start,
+        Data.GetHx().GetData().begin() + end);
+    Chunk.Hy.assign(Data.GetHy().GetData().begin() + start,
+        Data.GetHy().GetData().begin() + end);
+    Chunk.Hz.assign(Data.GetHz().GetData().begin() + start,
+        Data.GetHz().GetData().begin() + end);
+    return true;
+  }
+
+//! Write nout samples in birrp ascii format, the magnetic field is taken from the front of Pending
+void WriteBirrpRows(std::ofstream &outfile, const trealdata &Ex,
+    const trealdata &Ey, const std::deque<double> &PendingHx,
+    const std::deque<double> &PendingHy, const std::deque<double> &PendingHz,
+    const size_t nout)
+  {
+    outfile.precision(8);
+    for (size_t i = 0; i < nout; ++i)
+      {
+        outfile << setw(20) << Ex.at(i) << " ";
+        outfile << setw(20) << Ey.at(i) << " ";
+        outfile << setw(20) << PendingHx.at(i) << " ";
+        outfile << setw(20) << PendingHy.at(i) << " ";
+        outfile << setw(20) << PendingHz.at(i) << "\n";
+      }
+  }
+
 int main(int argc, char *argv[])
   {
     std::string intsname;
-    string modelfilename;
+    std::vector<std::string> modelfilenames;
+    double samplerate = 0.0;
+    size_t filterlength = 4096;
+    int nperdecade = 20;
+    size_t chunksize = 1 << 16;
     try
     {
         if(argc != 2)
@@ -44,17 +112,20 @@ int main(int argc, char *argv[])
     cout << " Output will have the same name as the modelfile with _ts.asc appended\n  ";
     cout << " and will contain the magnetic field and an electric field obeying the impedance \n  ";
     cout << " relationship calculate from the 1D model. \n  ";
+    cout << " With a json option file you can give a list of model files in \"modelfilename\", \n  ";
+    cout << " the \"samplerate\" for birrp files, the \"filterlength\" and the \"chunksize\". \n  ";
     cout << " This is Version: " << version << endl << endl;
 
     intsname = AskFilename(
         "File with magnetic field times series: ");
 
-    modelfilename = AskFilename("Model filename: ");
+    modelfilenames.push_back(AskFilename("Model filename: "));
         }
     else
         {
             Document opt;
                         char* buffer = argv[1];
+                        bool ownbuffer = false;
                         if(opt.Parse(buffer).HasParseError())
                         {
                             FILE *fp = fopen(argv[1], "r");
@@ -70,6 +141,7 @@ int main(int argc, char *argv[])
                             size_t readLength = fread(buffer, 1, filesize, fp);
                             buffer[readLength] = '\0';
                             fclose(fp);
+                            ownbuffer = true;
 
                             opt.Parse(buffer);
                         }
@@ -85,67 +157,118 @@ int main(int argc, char *argv[])
                                             intsname = opt["intsname"].GetString();
 
                                             assert(opt.HasMember("modelfilename"));
-                                            assert(opt["modelfilename"].IsString());
-                                            modelfilename = opt["modelfilename"].GetString();
+                                            if (opt["modelfilename"].IsArray())
+                                              {
+                                                for (SizeType i = 0; i < opt["modelfilename"].Size(); ++i)
+                                                  modelfilenames.push_back(opt["modelfilename"][i].GetString());
+                                              }
+                                            else
+                                              {
+                                                assert(opt["modelfilename"].IsString());
+                                                modelfilenames.push_back(opt["modelfilename"].GetString());
+                                              }
+                                            if (opt.HasMember("samplerate"))
+                                              samplerate = opt["samplerate"].GetDouble();
+                                            if (opt.HasMember("filterlength"))
+                                              filterlength = opt["filterlength"].GetUint();
+                                            if (opt.HasMember("nperdecade"))
+                                              nperdecade = opt["nperdecade"].GetInt();
+                                            if (opt.HasMember("chunksize"))
+                                              chunksize = opt["chunksize"].GetUint();
                                         }
-                                        free(buffer);      // 释放json内存
+                                        if (ownbuffer)
+                                          free(buffer);      // 释放json内存
                         }
 
+    //birrp ascii files are streamed, all other formats are read completely
+    const bool streaming = (GetFileExtension(intsname) == ".asc");
     TimeSeriesData HTsData;
-    HTsData.GetData(intsname);
-
-    TsSpectrum SpecCalc;
-    const size_t nsamples = HTsData.GetData().GetHx().GetData().size();
-    const size_t nfreq = nsamples / 2 + 1;
-    cvec HxSpec(nfreq), HySpec(nfreq), ExSpec(nfreq), EySpec(nfreq);
-
-    SubMean(HTsData.GetData().GetHx().GetData().begin(),
-        HTsData.GetData().GetHx().GetData().end());
-    SubMean(HTsData.GetData().GetHy().GetData().begin(),
-        HTsData.GetData().GetHy().GetData().end());
-
-    ApplyWindow(HTsData.GetData().GetHx().GetData().begin(),
-        HTsData.GetData().GetHx().GetData().end(),
-        HTsData.GetData().GetHx().GetData().begin(), Hamming());
-    ApplyWindow(HTsData.GetData().GetHy().GetData().begin(),
-        HTsData.GetData().GetHy().GetData().end(),
-        HTsData.GetData().GetHy().GetData().begin(), Hamming());
-
-    SpecCalc.CalcSpectrum(HTsData.GetData().GetHx().GetData().begin(),
-        HTsData.GetData().GetHx().GetData().end(), HxSpec.begin(), HxSpec.end());
-    SpecCalc.CalcSpectrum(HTsData.GetData().GetHy().GetData().begin(),
-        HTsData.GetData().GetHy().GetData().end(), HySpec.begin(), HySpec.end());
-
-
-    C1DMTSynthData Synthetic;
-    Synthetic.ReadModel(modelfilename);
-
-    double samplerate = 1.0;
-    const double eps = 1e-5;
-    const size_t samplelength = nsamples;
-    const double freqstep = samplerate / samplelength;
-    trealdata frequency;
-    frequency.push_back(eps); //zero frequency means not valid so we use a small value for the static
-    for (size_t i = 1; i < samplelength / 2 +1; ++i) // add frequencies
+    std::ifstream birrpfile;
+    if (streaming)
       {
-        frequency.push_back(freqstep * i);
+        birrpfile.open(intsname.c_str());
+        if (!birrpfile.good())
+          throw FatalException("Cannot open file: " + intsname);
+        //birrp files do not contain the samplerate
+        if (samplerate <= 0.0)
+          samplerate = 1.0;
       }
-    Synthetic.SetFrequencies(frequency);//copy them to forward calculation object
-    Synthetic.CalcSynthetic();
-    for (size_t i = 0; i < nfreq; ++i)
+    else
       {
-        ExSpec(i) = Synthetic.at(i).GetZxy() * HySpec(i);
-        EySpec(i) = Synthetic.at(i).GetZyx() * HxSpec(i);
+        HTsData.GetData(intsname);
+        if (samplerate <= 0.0)
+          samplerate = HTsData.GetData().GetSamplerate();
       }
-    SpecCalc.CalcTimeSeries(ExSpec.begin(), ExSpec.end(),
-        HTsData.GetData().GetEx().GetData().begin(),
-        HTsData.GetData().GetEx().GetData().end());
-    SpecCalc.CalcTimeSeries(EySpec.begin(), EySpec.end(),
-        HTsData.GetData().GetEy().GetData().begin(),
-        HTsData.GetData().GetEy().GetData().end());
 
-    HTsData.WriteAsBirrp(modelfilename+"_ts.asc");
+    //the filter design and the creation of the fftw plans is not thread safe
+    const size_t nmodels = modelfilenames.size();
+    const trealdata Frequencies(MTSynthFilter::LogFrequencies(samplerate,
+        filterlength, nperdecade));
+    std::vector<boost::shared_ptr<MTSynthStream> > Streams;
+    std::vector<boost::shared_ptr<std::ofstream> > OutFiles;
+    for (size_t i = 0; i < nmodels; ++i)
+      {
+        C1DMTSynthData Synthetic;
+        Synthetic.ReadModel(modelfilenames.at(i));
+        Synthetic.SetFrequencies(Frequencies);
+        Synthetic.CalcSynthetic();
+        MTSynthFilter Filter(Synthetic, samplerate, filterlength);
+        Streams.push_back(boost::shared_ptr<MTSynthStream>(new MTSynthStream(
+            Filter)));
+        OutFiles.push_back(boost::shared_ptr<std::ofstream>(new std::ofstream(
+            (modelfilenames.at(i) + "_ts.asc").c_str())));
+      }
 
+    //the output lags behind the input by the filter delay, so we keep the magnetic field
+    //that has not been written yet, all models have the same delay
+    std::deque<double> PendingHx, PendingHy, PendingHz;
+    std::vector<trealdata> Ex(nmodels), Ey(nmodels);
+    HChunk Chunk;
+    size_t position = 0;
+    size_t nout = 0;
+    bool finished = false;
+    while (!finished)
+      {
+        const bool havechunk = streaming ? ReadBirrpChunk(birrpfile, chunksize,
+            Chunk) : CopyChunk(HTsData.GetData(), position, chunksize, Chunk);
+        finished = !havechunk;
+        const size_t nin = Chunk.Hx.size();
+        if (havechunk)
+          {
+            position += nin;
+            PendingHx.insert(PendingHx.end(), Chunk.Hx.begin(), Chunk.Hx.end());
+            PendingHy.insert(PendingHy.end(), Chunk.Hy.begin(), Chunk.Hy.end());
+            PendingHz.insert(PendingHz.end(), Chunk.Hz.begin(), Chunk.Hz.end());
+          }
+        const int nparallel = nmodels;
+#pragma omp parallel for default(shared)
+        for (int i = 0; i < nparallel; ++i)
+          {
+            size_t curr;
+            if (havechunk)
+              {
+                Ex.at(i).resize(nin);
+                Ey.at(i).resize(nin);
+                curr = Streams.at(i)->Process(&Chunk.Hx[0], &Chunk.Hy[0], nin,
+                    &Ex.at(i)[0], &Ey.at(i)[0]);
+              }
+            else
+              {
+                Ex.at(i).resize(Streams.at(i)->GetDelay());
+                Ey.at(i).resize(Streams.at(i)->GetDelay());
+                curr = Streams.at(i)->Finish(&Ex.at(i)[0], &Ey.at(i)[0]);
+              }
+            WriteBirrpRows(*OutFiles.at(i), Ex.at(i), Ey.at(i), PendingHx,
+                PendingHy, PendingHz, curr);
+            if (i == 0)
+              nout = curr;
+          }
+        PendingHx.erase(PendingHx.begin(), PendingHx.begin() + nout);
+        PendingHy.erase(PendingHy.begin(), PendingHy.begin() + nout);
+        PendingHz.erase(PendingHz.begin(), PendingHz.begin() + nout);
+      }
+    cout << "Wrote " << position << " samples for " << nmodels << " models."
+        << endl;
     }
 
         catch( FatalException& fataException )
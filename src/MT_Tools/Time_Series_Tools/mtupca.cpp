@@ -1,10 +1,12 @@
 #include "PCA.h"
 #include "statutils.h"
 #include "VecMat.h"
+#include "LinAlgKernels.h"
 #include "TimeSeriesData.h"
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <algorithm>
 
 using namespace gplib;
 
@@ -20,19 +22,19 @@ int main()
 
     const size_t nobs = TsData.GetData().Size();
     const size_t nchan = 4;
-    gplib::rmat input(nchan, nobs);
     gplib::cmat evec(nchan, nchan);
     gplib::cvec eval(nchan);
 
-    for (unsigned int i = 0; i < nobs; ++i)
-      {
-        input(0, i) = TsData.GetData().GetEx().GetData().at(i);
-        input(1, i) = TsData.GetData().GetEy().GetData().at(i);
-        input(2, i) = TsData.GetData().GetHx().GetData().at(i);
-        input(3, i) = TsData.GetData().GetHy().GetData().at(i);
-      }
+    //we accumulate the covariance directly from the components, so we do not need a copy of the data
+    std::vector<std::vector<double>*> Channels(nchan);
+    Channels.at(0) = &TsData.GetData().GetEx().GetData();
+    Channels.at(1) = &TsData.GetData().GetEy().GetData();
+    Channels.at(2) = &TsData.GetData().GetHx().GetData();
+    Channels.at(3) = &TsData.GetData().GetHy().GetData();
+    CovAccumulator<double> Accumulator(nchan);
+    Accumulator.Add(Channels, 0, nobs);
 
-    PCA(input, evec, eval);
+    PCA(Accumulator, evec, eval);
 
     gplib::cmat wmat(WhiteMat(evec, eval));
     std::cout << "pca evec: " << evec << std::endl;
@@ -40,14 +42,21 @@ int main()
     std::cout << "pca WhM: " << wmat << std::endl;
     std::cout << "pca DeWhM: " << DeWhiteMat(evec, eval) << std::endl;
 
-    gplib::cmat output(nchan, nobs);
-    noalias(output) = prec_prod(wmat, input);
-    for (unsigned int i = 0; i < nobs; ++i)
+    //apply the whitening matrix block by block and write the result back into the components
+    const gplib::rmat rwmat(real(wmat));
+    const size_t blocklength = linalg::blocksize;
+    std::vector<double> Block(nchan * blocklength), Output(nchan * blocklength);
+    for (size_t start = 0; start < nobs; start += blocklength)
       {
-        TsData.GetData().GetEx().GetData().at(i) = output(0, i).real();
-        TsData.GetData().GetEy().GetData().at(i) = output(1, i).real();
-        TsData.GetData().GetHx().GetData().at(i) = output(2, i).real();
-        TsData.GetData().GetHy().GetData().at(i) = output(3, i).real();
+        const size_t length = std::min(blocklength, nobs - start);
+        for (size_t k = 0; k < length; ++k)
+          for (size_t i = 0; i < nchan; ++i)
+            Block[i + k * nchan] = (*Channels.at(i))[start + k];
+        linalg::Gemm('N', 'N', nchan, length, nchan, 1.0, &rwmat.data()[0],
+            nchan, &Block[0], nchan, 0.0, &Output[0], nchan);
+        for (size_t k = 0; k < length; ++k)
+          for (size_t i = 0; i < nchan; ++i)
+            (*Channels.at(i))[start + k] = Output[i + k * nchan];
       }
     TsData.WriteAsBirrp(mtuname + ".pca");
   }
@@ -0,0 +1,121 @@
+//============================================================================
+// Name        : mtupipeline.cpp
+// Version     :
+// Copyright   : 2010, mmoorkamp
+//============================================================================
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Util.h"
+#include "TsPipeline.h"
+#include "FatalException.h"
+#include "rapidjson/document.h"
+
+using namespace std;
+using namespace gplib;
+using namespace rapidjson;
+
+/*!
+ * \addtogroup UtilProgs Utility Programs
+ *@{
+ * \file mtupipeline.cpp
+ * Run a chain of time series processing steps, e.g. cut, bandpass, first difference
+ * and power spectra, on one or more sites without writing intermediate files.
+ * The stages and the input files are described in a json file, see TsPipeline
+ * for the format. Sites and components are processed in parallel and the
+ * time spent in each stage is reported at the end.
+ */
+
+string version = "$Id: mtupipeline.cpp 1 2010-06-01 12:00:00Z mmoorkamp $";
+
+int main(int argc, char *argv[])
+  {
+    try
+      {
+        cout
+            << "This is mtupipeline: Run several processing steps on MT time series"
+            << endl << endl;
+        cout << " Usage: mtupipeline pipeline.json " << endl;
+        cout
+            << " The json file contains the list of input files in \"Input\" and the processing steps in \"Stages\". "
+            << endl;
+        cout << " This is Version: " << version << endl << endl;
+
+        string pipelinename;
+        if (argc == 2)
+          pipelinename = argv[1];
+        else
+          pipelinename = AskFilename("Pipeline description: ");
+
+        Document opt;
+        char *buffer = argv[argc - 1];
+        bool ownbuffer = false;
+        if (argc != 2 || opt.Parse(buffer).HasParseError())
+          {
+            FILE *fp = fopen(pipelinename.c_str(), "r");
+            if (!fp)
+              {
+                printf("file '%s' not found\n", pipelinename.c_str());
+                return -1;
+              }
+            fseek(fp, 0, SEEK_END);
+            size_t filesize = (size_t) ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+            buffer = (char*) malloc(filesize + 1);
+            size_t readLength = fread(buffer, 1, filesize, fp);
+            buffer[readLength] = '\0';
+            fclose(fp);
+            ownbuffer = true;
+            if (opt.Parse(buffer).HasParseError())
+              {
+                free(buffer);
+                throw FatalException("Invalid json in file: " + pipelinename);
+              }
+          }
+
+        vector<string> Filenames;
+        if (opt.HasMember("Input") && opt["Input"].IsArray())
+          {
+            for (SizeType i = 0; i < opt["Input"].Size(); ++i)
+              Filenames.push_back(opt["Input"][i].GetString());
+          }
+        else if (opt.HasMember("Input") && opt["Input"].IsString())
+          Filenames.push_back(opt["Input"].GetString());
+        else
+          throw FatalException("No input files specified !");
+
+        string timingname;
+        if (opt.HasMember("MainInfo") && opt["MainInfo"].HasMember(
+            "timingfile"))
+          timingname = opt["MainInfo"]["timingfile"].GetString();
+
+        TsPipeline Pipeline;
+        Pipeline.ReadJson(opt);
+        if (ownbuffer)
+          free(buffer);
+
+        cout << "Processing " << Filenames.size() << " sites ..." << endl;
+        const size_t nfailed = Pipeline.Run(Filenames);
+        Pipeline.WriteTimings(cout);
+        if (!timingname.empty())
+          {
+            ofstream timingfile(timingname.c_str());
+            Pipeline.WriteTimings(timingfile);
+          }
+        if (nfailed > 0)
+          cout << nfailed << " of " << Filenames.size()
+              << " sites could not be processed." << endl;
+      } catch (FatalException& fataException)
+      {
+        printf("%s", fataException.what());
+      } catch (...)
+      {
+        printf("\nCaught unknown exception\n");
+      }
+
+    system("pause");
+    return 0;
+  }
+/*@}*/
@@ -0,0 +1,150 @@
+//============================================================================
+// Name        : mtuqc.cpp
+// Version     :
+// Copyright   : 2010, mmoorkamp
+//============================================================================
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include "Util.h"
+#include "TsQualityControl.h"
+#include "FatalException.h"
+#include "rapidjson/document.h"
+
+using namespace std;
+using namespace gplib;
+using namespace rapidjson;
+
+/*!
+ * \addtogroup UtilProgs Utility Programs
+ *@{
+ * \file mtuqc.cpp
+ * Scan Phoenix MTU, LEMI or BIRRP ascii time series files for saturation, spikes, flat lines,
+ * gaps in the time stamps, clock errors and low coherence between electric and magnetic channels.
+ * The files are read in a single pass without loading the whole time series. For each file
+ * the flags for consecutive windows are written to a sidecar index with the ending .qci, that can be used by
+ * the processing programs, e.g. simple_processing --qc 1, to skip bad data.
+ */
+
+string version = "$Id: mtuqc.cpp 1 2010-06-01 12:00:00Z mmoorkamp $";
+
+int main(int argc, char *argv[])
+  {
+    try
+      {
+        cout
+            << "This is mtuqc: Create a quality control index for MT time series"
+            << endl << endl;
+        cout << " Usage: mtuqc options.json " << endl;
+        cout
+            << " The json file contains the list of files in \"Input\" and the window length in \"windowlength\". "
+            << endl;
+        cout << " The index for each file is written to filename.qci" << endl;
+        cout << " This is Version: " << version << endl << endl;
+
+        string optionname;
+        if (argc == 2)
+          optionname = argv[1];
+        else
+          optionname = AskFilename("Option file: ");
+
+        Document opt;
+        char *buffer = argv[argc - 1];
+        bool ownbuffer = false;
+        if (argc != 2 || opt.Parse(buffer).HasParseError())
+          {
+            FILE *fp = fopen(optionname.c_str(), "r");
+            if (!fp)
+              {
+                printf("file '%s' not found\n", optionname.c_str());
+                return -1;
+              }
+            fseek(fp, 0, SEEK_END);
+            size_t filesize = (size_t) ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+            buffer = (char*) malloc(filesize + 1);
+            size_t readLength = fread(buffer, 1, filesize, fp);
+            buffer[readLength] = '\0';
+            fclose(fp);
+            ownbuffer = true;
+            if (opt.Parse(buffer).HasParseError())
+              {
+                free(buffer);
+                throw FatalException("Invalid json in file: " + optionname);
+              }
+          }
+        if (!opt.HasMember("Input") || !opt["Input"].IsArray()
+            || !opt.HasMember("windowlength"))
+          throw FatalException("Need array \"Input\" and \"windowlength\" !");
+        vector<string> Filenames;
+        for (SizeType i = 0; i < opt["Input"].Size(); ++i)
+          Filenames.push_back(opt["Input"][i].GetString());
+        const size_t windowlength = opt["windowlength"].GetInt();
+        //a value of 0 disables the corresponding test
+        const double saturation = opt.HasMember("saturation")
+            ? opt["saturation"].GetDouble() : 8388607.0;
+        const double spike = opt.HasMember("spikethreshold")
+            ? opt["spikethreshold"].GetDouble() : 20.0;
+        const size_t flat = opt.HasMember("flatlength")
+            ? opt["flatlength"].GetInt() : 50;
+        const double coherence = opt.HasMember("mincoherence")
+            ? opt["mincoherence"].GetDouble() : 0.0;
+        const double clockerror = opt.HasMember("maxclockerror")
+            ? opt["maxclockerror"].GetDouble() : 0.0;
+        if (ownbuffer)
+          free(buffer);
+
+        const int nfiles = Filenames.size();
+        bool haveerror = false;
+        string errormessage;
+        //the files are independent, so we scan them in parallel
+#pragma omp parallel for default(shared) schedule(dynamic)
+        for (int i = 0; i < nfiles; ++i)
+          {
+            try
+              {
+                TsQualityControl QC(windowlength);
+                QC.SetThresholds(saturation, spike, flat, coherence,
+                    clockerror);
+                const TsQcIndex &Index = QC.Scan(Filenames[i]);
+                Index.WriteIndex(TsQcIndex::IndexName(Filenames[i]));
+#pragma omp critical(mtuqc_output)
+                  {
+                    cout << Filenames[i] << ": "
+                        << Index.CountFlagged() << " of "
+                        << Index.GetWindows().size()
+                        << " windows flagged (saturation "
+                        << Index.CountFlagged(qcsaturation) << ", spikes "
+                        << Index.CountFlagged(qcspike) << ", flat "
+                        << Index.CountFlagged(qcflat) << ", gaps "
+                        << Index.CountFlagged(qcgap) << ", clock "
+                        << Index.CountFlagged(qcclock) << ", status "
+                        << Index.CountFlagged(qcstatus) << ", coherence "
+                        << Index.CountFlagged(qccoherence) << ")" << endl;
+                  }
+              } catch (FatalException &e)
+              {
+#pragma omp critical(mtuqc_error)
+                  {
+                    haveerror = true;
+                    errormessage = e.what();
+                  }
+              }
+          }
+        if (haveerror)
+          throw FatalException(errormessage);
+      } catch (FatalException& fataException)
+      {
+        printf("%s", fataException.what());
+      } catch (...)
+      {
+        printf("\nCaught unknown exception\n");
+      }
+
+    system("pause");
+    return 0;
+  }
+/*@}*/
@@ -1,12 +1,11 @@
 #include <iostream>
 #include <string>
-#include <fstream>
 #include <vector>
-#include "TimeFrequency.h"
+#include <boost/shared_ptr.hpp>
+#include "Spectrogram.h"
+#include "NetCDFSpectrogram.h"
+#include "TsStreamReader.h"
 #include "WFunc.h"
-#include "TimeSeriesData.h"
-#include "netcdfcpp.h"
-#include "VecMat.h"
 #include "Util.h"
 
 using namespace std;
@@ -21,54 +20,19 @@ string version =
  * \file
  * Calculate a time-frequency diagram for each component of a MT time-series file.
  * Output is 4 netcdf file where the ending signals the component.
+ * The file is read block by block and the spectra of the segments are calculated in parallel,
+ * so the length of the time series is not limited by the available memory. The spectrogram
+ * is written to a compressed netcdf-4 file together with optional overview levels with fewer rows
+ * for fast plotting. The frequency axis can be divided into logarithmically spaced bands.
  */
 
-void CalcTfAndWrite(ttsdata Data, const double samplerate, const int seglength,
-    const int timeavg, const string name)
-  {
-
-    gplib::cmat result = TimeFrequency(Data.begin(), Data.end(), seglength,
-        Steep());
-    const size_t ylength = result.size2() - timeavg;
-    NcFile combrescdf(name.c_str(), NcFile::Replace);
-    NcDim* xd = combrescdf.add_dim("x", result.size1());
-    NcDim* yd = combrescdf.add_dim("y", ylength);
-    NcVar* x = combrescdf.add_var("x", ncFloat, xd);
-    NcVar* y = combrescdf.add_var("y", ncFloat, yd);
-    NcVar* z = combrescdf.add_var("z", ncFloat, xd, yd);
-    float *xvals = new float[xd->size()];
-    float *yvals = new float[yd->size()];
-    float *zvals = new float[xd->size() * yd->size()];
-    float avg = 0.0;
-    for (size_t i = 0; i < result.size1(); ++i) // time index
-      {
-        xvals[i] = i;
-
-        for (size_t j = 0; j < ylength; ++j) //frequency index
-          {
-            avg = 0.0;
-            for (int k = 0; k < timeavg; ++k)
-              {
-                avg += abs(result(i, j + k));
-              }
-            zvals[i * ylength + j] = log10(avg);
-          }
-
-      }
-    for (size_t j = 0; j < ylength; ++j)
-      yvals[j] = j * samplerate / seglength;
-    x->put(xvals, xd->size());
-    y->put(yvals, yd->size());
-    z->put(zvals, z->edges());
-  }
-
 int main(int argc, char *argv[])
   {
-    TimeSeriesData TsData;
-
     string infilename;
-    size_t timeavg = 5;
     size_t seglength = 2400;
+    size_t shift = 2400;
+    size_t perdecade = 0;
+    size_t noverviews = 0;
     cout
         << "This is mtutf: Calculate time frequency matrix from  Phoenix time series"
         << endl << endl;
@@ -88,20 +52,62 @@ int main(int argc, char *argv[])
         cout << "Infilename: ";
         cin >> infilename;
       }
-    TsData.GetData(infilename);
     cout << "Length of individual segments in points: ";
     cin >> seglength;
-    cout << "Number of segments for time averaging: ";
-    cin >> timeavg;
-    const double samplerate = TsData.GetData().GetSamplerate();
-    CalcTfAndWrite(TsData.GetData().GetEx().GetData(), samplerate, seglength,
-        timeavg, (infilename + "_tfex.nc"));
-    CalcTfAndWrite(TsData.GetData().GetEy().GetData(), samplerate, seglength,
-        timeavg, (infilename + "_tfey.nc"));
-    CalcTfAndWrite(TsData.GetData().GetHx().GetData(), samplerate, seglength,
-        timeavg, (infilename + "_tfhx.nc"));
-    CalcTfAndWrite(TsData.GetData().GetHy().GetData(), samplerate, seglength,
-        timeavg, (infilename + "_tfhy.nc"));
-
+    cout << "Shift between segments in points: ";
+    cin >> shift;
+    cout << "Number of frequency bands per decade (0 for all frequencies): ";
+    cin >> perdecade;
+    cout << "Number of overview levels: ";
+    cin >> noverviews;
+    try
+      {
+        boost::shared_ptr<TsStreamReader> Reader(OpenTsStream(infilename));
+        TsStreamBlock Block;
+        if (!Reader->ReadBlock(Block))
+          throw FatalException("No data in file: " + infilename);
+        const double samplerate = Reader->GetSamplerate();
+        //we calculate the spectrogram for Ex, Ey, Hx and Hy, the first four channels in the blocks
+        const size_t ncomponents = 4;
+        const string endings[ncomponents] =
+          { "_tfex.nc", "_tfey.nc", "_tfhx.nc", "_tfhy.nc" };
+        vector<boost::shared_ptr<NetCDFSpectrogramWriter> > Writers;
+        vector<boost::shared_ptr<Spectrogram<Steep> > > Spectrograms;
+        for (size_t i = 0; i < ncomponents; ++i)
+          {
+            Writers.push_back(boost::shared_ptr<NetCDFSpectrogramWriter>(
+                new NetCDFSpectrogramWriter(infilename + endings[i])));
+            Spectrograms.push_back(boost::shared_ptr<Spectrogram<Steep> >(
+                new Spectrogram<Steep> (seglength, shift, samplerate,
+                    *Writers.back(), perdecade, noverviews)));
+            Writers.back()->AddAttribute("samplerate", samplerate);
+            if (Block.hastime)
+              Writers.back()->AddAttribute("starttime", Block.starttime);
+          }
+        vector<double> Component;
+        size_t nsamples = 0;
+        do
+          {
+            const size_t blocksize = Block.GetNSamples();
+            Component.resize(blocksize);
+            for (size_t i = 0; i < ncomponents; ++i)
+              {
+                for (size_t j = 0; j < blocksize; ++j)
+                  Component[j] = Block.Data[j * tsstreamchannels + i];
+                Spectrograms[i]->Add(Component.begin(), Component.end());
+              }
+            nsamples += blocksize;
+          } while (Reader->ReadBlock(Block));
+        for (size_t i = 0; i < ncomponents; ++i)
+          Spectrograms[i]->Finish();
+        cout << "Processed " << nsamples << " samples in "
+            << Spectrograms.front()->GetBands().GetNBands()
+            << " frequency bands." << endl;
+      } catch (FatalException &e)
+      {
+        cerr << e.what() << endl;
+        return 1;
+      }
+    return 0;
   }
 /*@}*/
@@ -2,9 +2,8 @@
 #include <string>
 #include "MTStationList.h"
 #include "PTensorMTStation.h"
-#include "Adaptors.h"
-#include "Jacknife.h"
-#include "MTSampleGenerator.h"
+#include "MTSurvey.h"
+#include "MTSurveyQuantities.h"
 #include "Util.h"
 
 using namespace std;
@@ -44,34 +43,34 @@ int main(int argc, char* argv[])
     MTSites.GetData(infilename);
     const unsigned int nsites = MTSites.GetList().size();
     const unsigned int ntestcases = 10000;
+    //calculate the phase tensor elements and their bootstrap errors
+    //for all sites and frequencies in one go
+    MTSurvey Survey;
+    Survey.Assign(MTSites.GetList());
+    MTSurveyQuantities Quantities;
+    Quantities.SetNSamples(ntestcases);
+    Quantities.Calculate(Survey, MTSurveyQuantities::bootstrap);
     for (unsigned int i = 0; i < nsites; ++i)
       {
         cout << "Writing site " << MTSites.GetList().at(i).GetName();
         PTensorMTStation PTData;
-        const unsigned int nfreq = MTSites.at(i).GetMTData().size();
+        const unsigned int nfreq = Survey.GetStationSize(i);
+        const size_t offset = Survey.GetStationOffset(i);
         for (unsigned j = 0; j < nfreq; ++j)
           {
-            double JackMean, Phi11Var, Phi12Var, Phi21Var, Phi22Var;
-            Jacknife<MTSampleGenerator> (ntestcases, MTSampleGenerator(
-                &MTTensor::GetPhi11, MTSites.at(i).at(j))).CalcErrors(JackMean,
-                Phi11Var);
-            Jacknife<MTSampleGenerator> (ntestcases, MTSampleGenerator(
-                &MTTensor::GetPhi21, MTSites.at(i).at(j))).CalcErrors(JackMean,
-                Phi12Var);
-            Jacknife<MTSampleGenerator> (ntestcases, MTSampleGenerator(
-                &MTTensor::GetPhi12, MTSites.at(i).at(j))).CalcErrors(JackMean,
-                Phi21Var);
-            Jacknife<MTSampleGenerator> (ntestcases, MTSampleGenerator(
-                &MTTensor::GetPhi22, MTSites.at(i).at(j))).CalcErrors(JackMean,
-                Phi22Var);
-
+            const size_t row = offset + j;
             PTData.GetTensor().push_back(PTensorMTData(
-                MTSites.at(i).at(j).GetFrequency(),
-                MTSites.at(i).at(j).GetPhi11(), MTSites.at(i).at(j).GetPhi12(),
-                MTSites.at(i).at(j).GetPhi21(), MTSites.at(i).at(j).GetPhi22(),
-                sqrt(Phi11Var), sqrt(Phi12Var), sqrt(Phi21Var), sqrt(Phi22Var)));
-            PTData.WriteData(MTSites.GetList().at(i).GetName());
+                Survey.GetColumn(MTSurvey::frequency)[row],
+                Quantities.GetValues(MTSurveyQuantities::phi11)[row],
+                Quantities.GetValues(MTSurveyQuantities::phi12)[row],
+                Quantities.GetValues(MTSurveyQuantities::phi21)[row],
+                Quantities.GetValues(MTSurveyQuantities::phi22)[row],
+                Quantities.GetErrors(MTSurveyQuantities::phi11)[row],
+                Quantities.GetErrors(MTSurveyQuantities::phi12)[row],
+                Quantities.GetErrors(MTSurveyQuantities::phi21)[row],
+                Quantities.GetErrors(MTSurveyQuantities::phi22)[row]));
           }
+        PTData.WriteData(MTSites.GetList().at(i).GetName());
         cout << "    ... done" << endl;
       }
   }